@@ -86,6 +86,7 @@ Accounts::Account Accounts::suggestAccount() const
     next.enableSecureServer = false;
     next.enableCompression  = false;
     next.enablePipelining   = false;
+    next.enableEventLoop    = false;
     next.enableLogin        = false;
     next.quotaSpent         = 0;
     next.quotaAvail         = 0;
@@ -307,6 +308,7 @@ bool Accounts::saveState(Settings& store) const
         store.set(key, "enable_general_server", acc.enableGeneralServer);
         store.set(key, "enable_secure_server", acc.enableSecureServer);
         store.set(key, "enable_pipelining", acc.enablePipelining);
+        store.set(key, "enable_event_loop", acc.enableEventLoop);
         store.set(key, "enable_compression", acc.enableCompression);
         store.set(key, "enable_login", acc.enableLogin);
         store.set(key, "quota_spent", acc.quotaSpent);
@@ -366,6 +368,7 @@ void Accounts::loadState(Settings& store)
         acc.enableSecureServer  = store.get(key, "enable_secure_server").toBool();
         acc.enableCompression   = store.get(key, "enable_compression").toBool();
         acc.enablePipelining    = store.get(key, "enable_pipelining").toBool();
+        acc.enableEventLoop     = store.get(key, "enable_event_loop").toBool();
         acc.enableLogin         = store.get(key, "enable_login").toBool();
         acc.quotaSpent          = store.get(key, "quota_spent", quint64(0));
         acc.quotaAvail          = store.get(key, "quota_avail", quint64(0));
@@ -70,6 +70,7 @@ namespace app
             bool enableSecureServer  = false;
             bool enableCompression   = false;
             bool enablePipelining    = false;
+            bool enableEventLoop     = false;
             bool enableLogin         = false;
             quint64 quotaSpent = 0;
             quint64 quotaAvail = 0;
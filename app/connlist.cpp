@@ -122,6 +122,15 @@ QVariant ConnList::data(const QModelIndex& index, int role) const
             QIcon("icons:ico_lock.png") :
             QIcon("icons:ico_unlock.png");
     }
+    else if (role == Qt::ToolTipRole && col == (int)Columns::Kbs)
+    {
+        if (!ui.rtt)
+            return QVariant();
+        return QString("Latency %1 ms\nArticles per request %2\nHeaders per XOVER %3")
+            .arg(ui.rtt)
+            .arg(ui.pipeline)
+            .arg(ui.xover_range);
+    }
     return QVariant();
 }
 
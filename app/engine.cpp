@@ -117,6 +117,7 @@ void Engine::testAccount(const Accounts::Account& acc)
     a.enable_general_server = acc.enableGeneralServer;
     a.enable_compression    = acc.enableCompression;
     a.enable_pipelining     = acc.enablePipelining;
+    a.enable_event_loop     = acc.enableEventLoop;
     a.connections = 1;
     engine_->TryAccount(a);
 }
@@ -134,6 +135,7 @@ void Engine::setAccount(const Accounts::Account& acc)
     a.general_port          = acc.generalPort;
     a.enable_compression    = acc.enableCompression;
     a.enable_pipelining     = acc.enablePipelining;
+    a.enable_event_loop     = acc.enableEventLoop;
     a.enable_general_server = acc.enableGeneralServer;
     a.enable_secure_server  = acc.enableSecureServer;
     a.connections           = acc.maxConnections;
@@ -365,6 +367,10 @@ void Engine::loadState(Settings& s)
         QCoreApplication::postEvent(this, new AsyncNotifyEvent);
     });
 
+    // let the engine process the completed actions in its own thread
+    // so that the GUI thread only gets the callbacks.
+    engine_->SetEngineThread(true);
+
     engine_->SetOverwriteExistingFiles(overwrite);
     engine_->SetDiscardTextContent(discard);
     engine_->SetEnableThrottle(throttle);
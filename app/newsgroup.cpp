@@ -31,6 +31,7 @@
 #include "newsflash/warnpop.h"
 
 #include <limits>
+#include <vector>
 
 #include "engine/nntp.h"
 #include "engine/utf8.h"
@@ -221,11 +222,11 @@ NewsGroup::NewsGroup()
         auto& c = mCatalogs[key];
         return c.load(catalog::index_t{idx});
     };
-    mIndex.on_filter = [this](const Article& article) {
-        if (!mShowTheseFileTypes.test(article.type()))
+    mIndex.on_filter_row = [this](const newsflash::catalog_view& view, std::size_t i) {
+        if (!mShowTheseFileTypes.test(view.type(i)))
             return false;
 
-        const auto bits = article.bits();
+        const auto bits = view.bits(i);
         if (!mShowTheseFileFlags.test(FileFlag::broken) &&
             bits.test(FileFlag::broken))
             return false;
@@ -233,22 +234,26 @@ NewsGroup::NewsGroup()
             bits.test(FileFlag::deleted))
             return false;
 
-        const auto date = article.pubdate();
+        const auto date = view.pubdate(i);
         if (date < mMinShowPubdate|| date > mMaxShowPubdate)
             return false;
 
-        const auto size = article.bytes();
+        const auto size = view.bytes(i);
         if (size < mMinShowFileSize || size > mMaxShowFileSize)
             return false;
 
-        if (mFilterStringUtf8.empty())
+        if (mFilterMatcher.empty())
             return true;
 
-        const auto& subject = article.subject();
-        if (article.is_utf8_enabled() && mIsFilterStringCaseSensitive)
-            return mFilterStringUtf8.search(subject.c_str(), subject.size());
+        // the matcher works on the raw bytes which is fine for an ASCII
+        // filter string regardless of the subject encoding and for a case
+        // sensitive UTF-8 filter string when the subject is UTF-8.
+        const auto utf8 = bits.test(FileFlag::enable_utf8);
+        const auto subject = view.subject(i);
+        if (mFilterMatcher.is_ascii() || (utf8 && mFilterMatcher.is_case_sensitive()))
+            return mFilterMatcher.search(subject.c_str(), subject.size());
 
-        const auto& wide = toString(subject, article.is_utf8_enabled());
+        const auto& wide = toString(subject, utf8);
         if (mIsFilterStringCaseSensitive)
             return (bool)wide.contains(mFilterString, Qt::CaseSensitive);
 
@@ -353,7 +358,10 @@ QVariant NewsGroup::data(const QModelIndex& index, int role) const
 {
     const auto row   = (std::size_t)index.row();
     const auto col   = (Columns)index.column();
-    const auto& item = mIndex[row];
+    // render straight from the view columns and the mapped
+    // subject lines without loading the article.
+    const auto& view = mViews[mIndex.item_key(row)];
+    const auto i     = mIndex.item_index(row);
 
     if (role == Qt::DisplayRole)
     {
@@ -366,7 +374,7 @@ QVariant NewsGroup::data(const QModelIndex& index, int role) const
                 return {};
 
             case Columns::Type:
-                switch (item.type())
+                switch (view.type(i))
                 {
                     case FileType::none:     return "n/a";
                     case FileType::audio:    return toString(app::FileType::Audio);
@@ -382,15 +390,15 @@ QVariant NewsGroup::data(const QModelIndex& index, int role) const
                 break;
 
             case Columns::Age:
-                if (item.pubdate() == 0)
+                if (view.pubdate(i) == 0)
                     return "???";
-                return toString(age { QDateTime::fromTime_t(item.pubdate()) });
+                return toString(age { QDateTime::fromTime_t(view.pubdate(i)) });
 
             case Columns::Size:
-                return toString(size { item.bytes() });
+                return toString(size { view.bytes(i) });
 
             case Columns::Subject:
-                return toString(item.subject(), item.is_utf8_enabled());
+                return toString(view.subject(i), view.is_utf8_enabled(i));
 
             case Columns::LAST: Q_ASSERT(false);
         }
@@ -400,22 +408,22 @@ QVariant NewsGroup::data(const QModelIndex& index, int role) const
         switch (col)
         {
             case Columns::BrokenFlag:
-                if (item.test(FileFlag::broken))
+                if (view.test(i, FileFlag::broken))
                     return QIcon("icons:ico_flag_broken.png");
                 break;
 
             case Columns::DownloadFlag:
-                if (item.test(FileFlag::downloaded))
+                if (view.test(i, FileFlag::downloaded))
                     return QIcon("icons:ico_flag_download.png");
                 break;
 
             case Columns::BookmarkFlag:
-                if (item.test(FileFlag::bookmarked))
+                if (view.test(i, FileFlag::bookmarked))
                     return QIcon("icons:ico_flag_bookmark.png");
                 break;
 
             case Columns::Type:
-                switch (item.type())
+                switch (view.type(i))
                 {
                     case FileType::none:     return findFileIcon(app::FileType::Text);
                     case FileType::audio:    return findFileIcon(app::FileType::Audio);
@@ -440,7 +448,7 @@ QVariant NewsGroup::data(const QModelIndex& index, int role) const
     }
     else if (role == Qt::FontRole)
     {
-        if (item.is_deleted())
+        if (view.is_deleted(i))
         {
             QFont font;
             font.setStrikeOut(true);
@@ -550,6 +558,8 @@ bool NewsGroup::init(QString path, QString name)
         block.purge      = false;
         mLoadedBlocks.push_back(block);
         mCatalogs.emplace_back();
+        mViews.emplace_back();
+        mIndex.attach(block.index, &mViews.back());
     }
 
     return true;
@@ -637,10 +647,10 @@ void NewsGroup::killSelected(const QModelIndexList& list)
         minRow = std::min(row, minRow);
         maxRow = std::max(row, maxRow);
 
-        auto article  = mIndex[row];
-        auto deletion = article.is_deleted();
-        article.set_bits(FileFlag::deleted, !deletion);
-        //article.save();
+        auto& view    = mViews[mIndex.item_key(row)];
+        auto article  = mIndex.item_index(row);
+        auto deletion = view.is_deleted(article);
+        view.set_bits(article, FileFlag::deleted, !deletion);
     }
     if (!showDeleted())
     {
@@ -689,9 +699,10 @@ void NewsGroup::bookmark(const QModelIndexList& list)
         const auto row = i.row();
         minRow = std::min(row, minRow);
         maxRow = std::max(row, maxRow);
-        auto article  = mIndex[row];
-        auto bookmark = article.is_bookmarked();
-        article.set_bits(FileFlag::bookmarked, !bookmark);
+        auto& view    = mViews[mIndex.item_key(row)];
+        auto article  = mIndex.item_index(row);
+        auto bookmark = view.test(article, FileFlag::bookmarked);
+        view.set_bits(article, FileFlag::bookmarked, !bookmark);
     }
 
     const auto first = QAbstractTableModel::index(minRow, 0);
@@ -763,8 +774,7 @@ void NewsGroup::download(const QModelIndexList& list, quint32 acc, const QString
             nzb.segments.push_back(std::to_string(seg));
 
         pack.push_back(nzb);
-        article.set_bits(FileFlag::downloaded, true);
-        //article.save();
+        mViews[mIndex.item_key(row)].set_bits(mIndex.item_index(row), FileFlag::downloaded, true);
     }
 
     bool priority = false;
@@ -822,8 +832,8 @@ quint64 NewsGroup::sumDataSizes(const QModelIndexList& list) const
     for (const auto& i : list)
     {
         const auto row = i.row();
-        const auto& article = mIndex[row];
-        ret += article.bytes();
+        const auto& view = mViews[mIndex.item_key(row)];
+        ret += view.bytes(mIndex.item_index(row));
     }
     return ret;
 }
@@ -837,8 +847,8 @@ QString NewsGroup::suggestName(const QModelIndexList& list) const
     for (const auto& i : list)
     {
         const auto row = i.row();
-        const auto& article = mIndex[row];
-        subjectLines.push_back(article.subject_as_string());
+        const auto& view = mViews[mIndex.item_key(row)];
+        subjectLines.push_back(view.subject(mIndex.item_index(row)).as_str());
     }
     if (subjectLines.size() == 1)
     {
@@ -941,6 +951,8 @@ void NewsGroup::newHeaderDataAvailable(const app::HeaderUpdateInfo& info)
         block.index      = mCatalogs.size();
         block.purge      = false;
         mCatalogs.emplace_back();
+        mViews.emplace_back();
+        mIndex.attach(block.index, &mViews.back());
 
 #ifdef NEWSFLASH_DEBUG
         ASSERT(std::is_sorted(std::begin(mLoadedBlocks), std::end(mLoadedBlocks),
@@ -1029,7 +1041,8 @@ void NewsGroup::loadData(Block& block, bool guiLoad, const void* snapshot)
     // however using beginInsertRows and endInsertRows would need to be
     // done for each row because the insertions into the index are not
     // necessarily consecutive. This was tried and turns out that it's
-    // much slower than just resetting the model.
+    // much slower than just resetting the model. So the new articles
+    // are inserted as a single batch and the model is reset once.
     // however this means that we must maintain stuff like the current
     // selection manually. this is easily accomplished by having a
     // selection bit for each item in the index. When the GUI makes
@@ -1050,6 +1063,10 @@ void NewsGroup::loadData(Block& block, bool guiLoad, const void* snapshot)
         db.open(narrow(block.file));
     }
 
+    // opening the catalog creates a new mapping.
+    auto& view = mViews[block.index];
+    view.bind(db);
+
     if (db.size() == block.prevSize)
         return;
 
@@ -1062,19 +1079,23 @@ void NewsGroup::loadData(Block& block, bool guiLoad, const void* snapshot)
     std::size_t numItems = db.size();
 
     // load all the articles, starting at the latest offset that we know off.
-    auto beg = db.begin(block.prevOffset);
-    auto end = db.end();
-    for (; beg != end; ++beg, ++curItem)
+    // the articles are decoded into the view columns and the index
+    // is then built from the columns.
+    std::vector<std::size_t> articles;
+    if (numItems > block.prevSize)
+        articles.reserve(numItems - block.prevSize);
+
+    std::size_t offset = block.prevOffset;
+    for (; offset != view.end(); ++curItem)
     {
-        const auto& article  = *beg;
-
-        mIndex.insert(article, block.index, article.index());
+        articles.push_back(view.load(offset));
 
         if (guiLoad)
         {
             onLoadProgress(curItem, numItems);
         }
     }
+    mIndex.insert(block.index, std::begin(articles), std::end(articles));
 
     DEBUG("Load done. Index now has %1 articles", mIndex.size());
 
@@ -1082,7 +1103,7 @@ void NewsGroup::loadData(Block& block, bool guiLoad, const void* snapshot)
     // when new data is added to the same database
     // we reload the db and then use the current latest
     // index to start loading the objects.
-    block.prevOffset = beg.offset();
+    block.prevOffset = offset;
     block.prevSize   = db.size();
     DEBUG("Block %1 is at new offset %2", block.file, block.prevOffset);
 
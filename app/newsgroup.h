@@ -37,10 +37,11 @@
 #include "engine/filebuf.h"
 #include "engine/filemap.h"
 #include "engine/catalog.h"
+#include "engine/catalogview.h"
 #include "engine/index.h"
 #include "engine/idlist.h"
+#include "engine/substring.h"
 #include "engine/bitflag.h"
-#include "stringlib/string.h"
 #include "filetype.h"
 #include "debug.h"
 #include "format.h"
@@ -121,10 +122,14 @@ namespace app
 
         void setTypeFilter(FileType type, bool onOff)
         {
+            if (onOff && !mShowTheseFileTypes.test(type))
+                mFilterIsRelaxed = true;
             mShowTheseFileTypes.set(type, onOff);
         }
         void setFlagFilter(FileFlag flag, bool onOff)
         {
+            if (onOff && !mShowTheseFileFlags.test(flag))
+                mFilterIsRelaxed = true;
             mShowTheseFileFlags.set(flag, onOff);
         }
 
@@ -132,6 +137,9 @@ namespace app
         {
             DEBUG("Size filter %1 - %2", app::size{minSize}, app::size{maxSize});
 
+            if (minSize < mMinShowFileSize || maxSize > mMaxShowFileSize)
+                mFilterIsRelaxed = true;
+
             mMinShowFileSize = minSize;
             mMaxShowFileSize = maxSize;
         }
@@ -144,14 +152,28 @@ namespace app
 
             DEBUG("Date filter %1 - %2", app::age{beg}, app::age{end});
 
-            mMinShowPubdate = end.toTime_t();
-            mMaxShowPubdate = beg.toTime_t();
+            const std::time_t minPubdate = end.toTime_t();
+            const std::time_t maxPubdate = beg.toTime_t();
+            if (minPubdate < mMinShowPubdate || maxPubdate > mMaxShowPubdate)
+                mFilterIsRelaxed = true;
+
+            mMinShowPubdate = minPubdate;
+            mMaxShowPubdate = maxPubdate;
         }
 
         void setStringFilter(const QString& str, bool case_sensitive)
         {
+            // every subject that contains the new string must also contain
+            // the previous string for the new filter to be a refinement.
+            // this is the case when typing more characters into the filter.
+            if (mIsFilterStringCaseSensitive && !case_sensitive)
+                mFilterIsRelaxed = true;
+            else if (!str.contains(mFilterString, mIsFilterStringCaseSensitive
+                ? Qt::CaseSensitive : Qt::CaseInsensitive))
+                mFilterIsRelaxed = true;
+
             mFilterString = str;
-            mFilterStringUtf8.reset(toUtf8(str), case_sensitive);
+            mFilterMatcher.reset(toUtf8(str), case_sensitive);
             mIsFilterStringCaseSensitive = case_sensitive;
         }
 
@@ -160,8 +182,13 @@ namespace app
             //CALLGRIND_START_INSTRUMENTATION;
             //CALLGRIND_ZERO_STATS;
 
+            // when the filter has only become stricter we only need
+            // to check the items that are currently visible.
             QAbstractTableModel::beginResetModel();
-            mIndex.filter();
+            if (mFilterIsRelaxed)
+                mIndex.filter();
+            else mIndex.refine();
+            mFilterIsRelaxed = false;
             QAbstractTableModel::endResetModel();
 
             //CALLGRIND_DUMP_STATS_AT("applyFilter");
@@ -193,6 +220,7 @@ namespace app
 
         using catalog = newsflash::catalog<newsflash::filemap>;
         using index   = newsflash::index<newsflash::filemap>;
+        using view    = newsflash::catalog_view;
         using idlist  = newsflash::idlist<newsflash::filebuf>;
 
         enum class State {
@@ -213,6 +241,7 @@ namespace app
 
         std::deque<Block> mLoadedBlocks;
         std::deque<catalog> mCatalogs;
+        std::deque<view> mViews;
         index mIndex;
         idlist mArticleNumberList;
 
@@ -232,7 +261,8 @@ namespace app
 
         QString mFilterString;
         bool mIsFilterStringCaseSensitive = false;
-        str::string_matcher<> mFilterStringUtf8;
+        bool mFilterIsRelaxed = false;
+        newsflash::substring_matcher mFilterMatcher;
 
     };
 } // app
\ No newline at end of file
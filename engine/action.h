@@ -49,7 +49,11 @@ namespace newsflash
             // dispatch the action to a single thread with affinity to the
             // action id. this means that all actions with single_thread
             // affinity and with the same id will execute in the same thread.
-            single_thread
+            single_thread,
+
+            // dispatch the action to the reactor which performs the
+            // non-blocking IO of the action. (see reactor.h)
+            event_loop
         };
 
         virtual ~action() = default;
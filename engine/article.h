@@ -102,7 +102,9 @@ namespace newsflash
             // where existing data is updated. so instead of calculating the hash from the utf-8
             // subject line we do it as before, i.e. from the subject line.
             //m_hash    = nntp::hashvalue(m_subject.c_str(), m_subject.size());
-            m_hash = nntp::hashvalue(data.subject.start, data.subject.len);
+            const auto fingerprint = nntp::fingerprint(data.subject.start, data.subject.len);
+            m_hash = std::uint32_t(fingerprint);
+            m_fingerprint = std::uint32_t(fingerprint >> 32);
 
             if (m_author.size() > 64)
                 m_author.resize(64);
@@ -216,6 +218,7 @@ namespace newsflash
             m_subject.clear();
             m_author.clear();
             m_hash   = 0;
+            m_fingerprint = 0;
             m_partno = 0;
         }
 
@@ -265,6 +268,15 @@ namespace newsflash
             return m_hash;
         }
 
+        // get the upper 32 bits of the subject line fingerprint.
+        // see nntp::fingerprint
+        const std::uint32_t fingerprint() const
+        {
+            if (!m_fingerprint)
+                m_fingerprint = std::uint32_t(nntp::fingerprint(m_subject.c_str(), m_subject.size()) >> 32);
+            return m_fingerprint;
+        }
+
         bool test(fileflag flag) const
         {
             return m_bits.test(flag);
@@ -429,6 +441,7 @@ namespace newsflash
     private:
         mutable std::uint16_t m_partno;
         mutable std::uint32_t m_hash;
+        mutable std::uint32_t m_fingerprint;
     };
 
     template<typename T>
@@ -32,13 +32,17 @@
 #  endif
 #  include <sys/types.h>
 #  include <sys/stat.h>
+#  include <sys/uio.h>
 #  include <unistd.h>
 #  include <fcntl.h>
+#  include <climits>
 #  include <cerrno>
 #endif
 
 #include <cassert>
 #include <stdexcept>
+#include <algorithm>
+#include <vector>
 
 #include "bigfile.h"
 #include "assert.h"
@@ -190,6 +194,13 @@ size_t bigfile::read(void* buff, size_t bytes)
     return size_t(dw);
 }
 
+native_handle_t bigfile::native_handle() const
+{
+    assert(is_open());
+
+    return pimpl_->file;
+}
+
 void bigfile::flush()
 {
     assert(is_open());
@@ -216,6 +227,33 @@ void bigfile::resize(big_t size)
         throw std::system_error(GetLastError(), std::system_category(), "SetEndOfFile failed");
 }
 
+void bigfile::write(big_t offset, const iobuf* bufs, std::size_t count)
+{
+    assert(is_open());
+    assert(offset >= 0);
+
+    // there's no vectored write for regular (buffered) files
+    // so write the buffers one by one at the explicit offsets.
+    for (std::size_t i=0; i<count; ++i)
+    {
+        OVERLAPPED ov = {0};
+        ov.Offset     = static_cast<DWORD>(offset & 0xFFFFFFFF);
+        ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        DWORD dw = 0;
+        if (WriteFile(pimpl_->file, bufs[i].data, bufs[i].size, &dw, &ov) == 0)
+            throw std::system_error(GetLastError(), std::system_category(), "WriteFile failed");
+
+        offset += bufs[i].size;
+    }
+}
+
+void bigfile::allocate(big_t size)
+{
+    // setting the end of file allocates the space on NTFS.
+    resize(size);
+}
+
 std::pair<std::error_code, bigfile::big_t> bigfile::size(const std::string& file)
 {
     const std::wstring& wstr = utf8::decode(file);
@@ -380,6 +418,13 @@ size_t bigfile::read(void* buff, size_t bytes)
     return ret;
 }
 
+native_handle_t bigfile::native_handle() const
+{
+    assert(is_open());
+
+    return pimpl_->fd;
+}
+
 void bigfile::flush()
 {
     assert(is_open());
@@ -396,6 +441,67 @@ void bigfile::resize(big_t size)
         throw std::system_error(errno, std::system_category(), "ftruncate64 failed");
 }
 
+void bigfile::write(big_t offset, const iobuf* bufs, std::size_t count)
+{
+    assert(is_open());
+    assert(offset >= 0);
+
+    std::vector<iovec> iov;
+    iov.reserve(count);
+    for (std::size_t i=0; i<count; ++i)
+    {
+        if (!bufs[i].size)
+            continue;
+        iovec v;
+        v.iov_base = const_cast<void*>(bufs[i].data);
+        v.iov_len  = bufs[i].size;
+        iov.push_back(v);
+    }
+
+    // pwritev can write less than asked for (and at most IOV_MAX
+    // buffers at once) so keep writing until everything is done.
+    std::size_t index = 0;
+    while (index < iov.size())
+    {
+        const auto num = std::min<std::size_t>(iov.size() - index, IOV_MAX);
+        const auto ret = pwritev64(pimpl_->fd, &iov[index], num, offset);
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::system_category(), "pwritev64 failed");
+        }
+        offset += ret;
+
+        std::size_t bytes = ret;
+        while (index < iov.size() && bytes >= iov[index].iov_len)
+            bytes -= iov[index++].iov_len;
+        if (bytes)
+        {
+            iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + bytes;
+            iov[index].iov_len -= bytes;
+        }
+    }
+}
+
+void bigfile::allocate(big_t size)
+{
+    assert(is_open());
+
+    if (fallocate64(pimpl_->fd, 0, 0, size) == 0)
+        return;
+
+    // some file systems (for example older NFS and some FUSE mounts) don't
+    // support preallocation. posix_fallocate would emulate it by writing
+    // out the whole file which is the last thing we want so just resize.
+    if (errno == EOPNOTSUPP || errno == ENOSYS)
+    {
+        resize(size);
+        return;
+    }
+    throw std::system_error(errno, std::system_category(), "fallocate64 failed");
+}
+
 std::pair<std::error_code, bigfile::big_t> bigfile::size(const std::string& file)
 {
     struct stat64 st {0};
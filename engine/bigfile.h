@@ -28,6 +28,7 @@
 #include <memory>
 
 #include "utility.h"
+#include "native_types.h"
 
 namespace newsflash
 {
@@ -84,12 +85,32 @@ namespace newsflash
         // returns the actual number of bytes read.
         std::size_t read(void* buff, std::size_t bytes);
 
+        // get the underlying OS file handle.
+        native_handle_t native_handle() const;
+
         // flush buffered writes to the file on device.
         void flush();
 
         // resize the file to the specified size.
         void resize(big_t size);
 
+        // a buffer for a vectored write.
+        struct iobuf {
+            const void* data;
+            std::size_t size;
+        };
+
+        // write the buffers one after another to the file starting at the
+        // given offset. the current file pointer is not used, so the writes
+        // at different offsets can be performed concurrently.
+        void write(big_t offset, const iobuf* bufs, std::size_t count);
+
+        // reserve disk space for the file up to the given size so that the
+        // writes at random offsets don't fragment the file. the file size
+        // is extended to the given size. if the file system doesn't support
+        // preallocation this is the same as resize.
+        void allocate(big_t size);
+
         bigfile& operator=(bigfile&& other);
 
         // get file size.
@@ -22,17 +22,22 @@
 #include "newsflash/config.h"
 
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include <cstdint>
 #include <cassert>
 #include <cstring>
 
 #include "utility.h"
+#include "bufferpool.h"
 
 namespace newsflash
 {
     // NNTP data buffer. the buffer contents are split into 2 segments
-    // the payload (body) and the response line that preceeds the data
+    // the payload (body) and the response line that preceeds the data.
+    // the memory is allocated from the BufferPool and returned there
+    // when the buffer is destroyed. the memory is not initialized.
     class Buffer
     {
     public:
@@ -77,52 +82,55 @@ namespace newsflash
 
         Buffer(std::size_t initial_capacity)
         {
-            buffer_.resize(initial_capacity);
+            Allocate(initial_capacity);
         }
 
         Buffer()
         {}
 
-        Buffer(Buffer&& other) : buffer_(std::move(other.buffer_))
+        Buffer(Buffer&& other)
         {
-            size_   = other.size_;
-            type_   = other.type_;
-            status_ = other.status_;
-            content_start_  = other.content_start_;
-            content_length_ = other.content_length_;
+            take(other);
         }
-        Buffer(const Buffer& other) : buffer_(other.buffer_)
+        Buffer(const Buffer& other)
         {
+            Allocate(other.capacity_);
+            if (other.size_)
+                std::memcpy(buffer_, other.buffer_, other.size_);
             size_   = other.size_;
             type_   = other.type_;
             status_ = other.status_;
             content_start_  = other.content_start_;
             content_length_ = other.content_length_;
         }
+       ~Buffer()
+        {
+            release();
+        }
 
         // return content pointer to the start of the body/payload data
         const u8* Content() const
-        { return &buffer_[content_start_]; }
+        { return buffer_ + content_start_; }
 
         // return head pointer to the start of the whole buffer
         const u8* Head() const
-        { return &buffer_[0]; }
+        { return buffer_; }
 
         // return back pointer for writing data
         u8* Back()
-        { return &buffer_[size_]; }
+        { return buffer_ + size_; }
 
         // after writing to the back() pointer, commit the number
         // of bytes written
         void Append(std::size_t size)
         {
-            assert(size + size_  <= buffer_.size());
+            assert(size + size_  <= capacity_);
             size_ += size;
         }
 
         void Append(const char* str)
         {
-            assert(std::strlen(str) + size_ + 1 <= buffer_.size());
+            assert(std::strlen(str) + size_ + 1 <= capacity_);
             std::strcpy(Back(), str);
             size_ += std::strlen(str);
         }
@@ -134,10 +142,16 @@ namespace newsflash
 
         void Allocate(std::size_t capacity)
         {
-            if (capacity < buffer_.size())
+            if (capacity < capacity_ || capacity == 0)
                 return;
 
-            buffer_.resize(capacity);
+            // grow in place if the memory isn't shared and there's room.
+            if (storage_ && !IsShared() && offset_ + capacity <= storage_->block_size)
+            {
+                capacity_ = capacity;
+                return;
+            }
+            move_to_new_storage(capacity);
         }
 
         void Grow(std::size_t num_bytes)
@@ -152,41 +166,79 @@ namespace newsflash
             content_length_ = 0;
             type_   = Type::None;
             status_ = Status::None;
+
+            // reclaim the space in front of the data if
+            // nobody else is referring to it anymore.
+            if (storage_ && !IsShared())
+            {
+                capacity_ += offset_;
+                offset_ = 0;
+                buffer_ = storage_->block;
+            }
         }
 
+        // discard the first point bytes of the buffer.
         void Pop(std::size_t point)
         {
             assert(point <= size_);
-            //const auto bytes_to_copy = point;
-            const auto bytes_to_move = size_ - point;
-
-            std::memmove(&buffer_[0], &buffer_[point], bytes_to_move);
-            size_ = bytes_to_move;
-            return;
+            buffer_   += point;
+            offset_   += point;
+            capacity_ -= point;
+            size_     -= point;
         }
 
         // split the buffer into two buffers at the specified splitpoint.
         // the size, capacity and the contents of the split buffer are those
         // of this buffer from 0 to splitpoint.
-        // after the split the contents of this buffer are shifted to 0
-        // and current size is decreased by splitpoint bytes.
+        // after the split the contents of this buffer start at the
+        // splitpoint and current size is decreased by splitpoint bytes.
+        // no data is copied, the returned buffer refers to the same memory
+        // and keeps it alive for as long as it's needed.
         Buffer Split(std::size_t splitpoint)
         {
             assert(splitpoint <= size_);
 
-            const auto bytes_to_copy = splitpoint;
-            const auto bytes_to_move = size_ - splitpoint;
+            Buffer ret;
+            if (splitpoint == 0)
+                return ret;
 
-            Buffer ret(bytes_to_copy);
+            storage_->refs++;
+            ret.storage_  = storage_;
+            ret.buffer_   = buffer_;
+            ret.offset_   = offset_;
+            ret.capacity_ = splitpoint;
+            ret.size_     = splitpoint;
 
-            std::memcpy(&ret.buffer_[0],&buffer_[0], bytes_to_copy);
-            std::memmove(&buffer_[0], &buffer_[splitpoint], bytes_to_move);
-
-            ret.size_ = bytes_to_copy;
-            size_ = bytes_to_move;
+            Pop(splitpoint);
             return ret;
         }
 
+        // move the current contents to the start of a memory block that
+        // can hold at least capacity bytes. the current block is reused
+        // if it's not shared with any buffer split off from this buffer
+        // and is large enough. otherwise the contents are copied to a
+        // new block. use this to make room for more data at the back
+        // after Split/Pop have consumed the front of the buffer.
+        void Compact(std::size_t capacity)
+        {
+            capacity = std::max(capacity, size_);
+            if (storage_ && !IsShared() && capacity <= storage_->block_size)
+            {
+                if (offset_ && size_)
+                    std::memmove(storage_->block, buffer_, size_);
+                buffer_   = storage_->block;
+                offset_   = 0;
+                capacity_ = capacity;
+                return;
+            }
+            move_to_new_storage(capacity);
+        }
+
+        // returns true if the memory of this buffer is shared
+        // with another buffer.
+        bool IsShared() const
+        { return storage_ && storage_->refs.load() > 1; }
+
         // set the buffer status
         void SetStatus(Status status)
         { status_ = status; }
@@ -225,7 +277,7 @@ namespace newsflash
 
         // get the total capacity of the buffer
         std::size_t GetCapacity() const
-        { return buffer_.size(); }
+        { return capacity_; }
 
         // get the length of the content
         std::size_t GetContentLength() const
@@ -238,7 +290,7 @@ namespace newsflash
 
         // return how many bytes are available for appending through back() pointer
         std::size_t GetAvailableBytes() const
-        { return buffer_.size() - size_; }
+        { return capacity_ - size_; }
 
         // returns true if buffer is full, i.e.
         // GetAvailableBytes is zero.
@@ -249,13 +301,7 @@ namespace newsflash
         Buffer& operator=(Buffer&& other)
         {
             Buffer tmp(std::move(*this));
-
-            buffer_         = std::move(other.buffer_);
-            size_           = other.size_;
-            content_start_  = other.content_start_;
-            content_length_ = other.content_length_;
-            type_   = other.type_;
-            status_ = other.status_;
+            take(other);
             return *this;
         }
 
@@ -264,17 +310,68 @@ namespace newsflash
             if (this == &other)
                 return *this;
 
-            buffer_ = other.buffer_;
-            size_   = other.size_;
+            Buffer tmp(other);
+            *this = std::move(tmp);
+            return *this;
+        }
+
+    private:
+        // the pooled memory block shared by the buffers that
+        // have been split from the same original buffer.
+        struct Storage {
+            std::atomic<unsigned> refs;
+            std::size_t block_size;
+            u8* block;
+        };
+
+        void take(Buffer& other)
+        {
+            storage_  = other.storage_;
+            buffer_   = other.buffer_;
+            offset_   = other.offset_;
+            capacity_ = other.capacity_;
+            size_     = other.size_;
+            type_     = other.type_;
+            status_   = other.status_;
             content_start_  = other.content_start_;
             content_length_ = other.content_length_;
-            type_   = other.type_;
-            status_ = other.status_;
-            return *this;
+            other.storage_  = nullptr;
+            other.buffer_   = nullptr;
+            other.offset_   = 0;
+            other.capacity_ = 0;
+            other.size_     = 0;
+        }
+
+        void release()
+        {
+            if (storage_ && --storage_->refs == 0)
+            {
+                BufferPool::Get().Release(storage_->block, storage_->block_size);
+                delete storage_;
+            }
+            storage_ = nullptr;
+            buffer_  = nullptr;
+        }
+
+        void move_to_new_storage(std::size_t capacity)
+        {
+            auto* storage = new Storage;
+            storage->refs  = 1;
+            storage->block = BufferPool::Get().Allocate(capacity, &storage->block_size);
+            if (size_)
+                std::memcpy(storage->block, buffer_, size_);
+            release();
+            storage_  = storage;
+            buffer_   = storage->block;
+            offset_   = 0;
+            capacity_ = capacity;
         }
 
     private:
-        std::vector<u8> buffer_;
+        Storage* storage_ = nullptr;
+        u8* buffer_ = nullptr;
+        std::size_t offset_ = 0;
+        std::size_t capacity_ = 0;
         std::size_t size_ = 0;
         std::size_t content_start_  = 0;
         std::size_t content_length_ = 0;
@@ -0,0 +1,153 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "bufferpool.h"
+#include "utility.h"
+
+namespace {
+
+// map a capacity to the pool size class.
+unsigned size_class(std::size_t capacity, unsigned min_class)
+{
+    unsigned c = min_class;
+    while ((std::size_t(1) << c) < capacity)
+        ++c;
+    return c;
+}
+
+} // namespace
+
+namespace newsflash
+{
+
+BufferPool::BufferPool(std::size_t max_pooled_bytes) : max_pooled_bytes_(max_pooled_bytes)
+{}
+
+BufferPool::~BufferPool()
+{
+    Purge();
+}
+
+char* BufferPool::Allocate(std::size_t capacity, std::size_t* block_size)
+{
+    const auto c = size_class(capacity, MinClass);
+    const auto size = c <= MaxClass ? std::size_t(1) << c : capacity;
+
+    *block_size = size;
+
+    if (c <= MaxClass)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes_in_use += size;
+
+        auto& list = free_[c - MinClass];
+        if (!list.empty())
+        {
+            char* block = list.back();
+            list.pop_back();
+            stats_.hits++;
+            stats_.bytes_pooled -= size;
+            return block;
+        }
+        stats_.misses++;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes_in_use += size;
+        stats_.misses++;
+    }
+    // intentionally not value initialized.
+    return new char[size];
+}
+
+void BufferPool::Release(char* block, std::size_t block_size)
+{
+    if (block == nullptr)
+        return;
+
+    const auto c = size_class(block_size, MinClass);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes_in_use -= block_size;
+
+        if (c <= MaxClass && stats_.bytes_pooled + block_size <= max_pooled_bytes_)
+        {
+            free_[c - MinClass].push_back(block);
+            stats_.bytes_pooled += block_size;
+            return;
+        }
+    }
+    delete [] block;
+}
+
+void BufferPool::SetMaxPoolSize(std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_pooled_bytes_ = bytes;
+    trim(bytes);
+}
+
+std::size_t BufferPool::GetMaxPoolSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_pooled_bytes_;
+}
+
+void BufferPool::Purge()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    trim(0);
+}
+
+BufferPool::Stats BufferPool::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+// static
+BufferPool& BufferPool::Get()
+{
+    // enough for a couple of dozen connections worth
+    // of receive buffers.
+    static BufferPool pool(MB(128));
+    return pool;
+}
+
+void BufferPool::trim(std::size_t max_bytes)
+{
+    // drop the largest blocks first.
+    for (int i=NumClasses-1; i>=0 && stats_.bytes_pooled > max_bytes; --i)
+    {
+        const auto size = std::size_t(1) << (i + MinClass);
+        auto& list = free_[i];
+        while (!list.empty() && stats_.bytes_pooled > max_bytes)
+        {
+            delete [] list.back();
+            list.pop_back();
+            stats_.bytes_pooled -= size;
+        }
+    }
+}
+
+} // newsflash
@@ -0,0 +1,102 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "newsflash/config.h"
+
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace newsflash
+{
+    // Pool of recyclable memory blocks for the NNTP data buffers.
+    // Every command executed by a connection needs a receive buffer
+    // and the data moves from the connection to the cmdlist and from
+    // there onwards to the decoding and writing. Allocating (and zeroing)
+    // a new multi megabyte buffer for each one is expensive and makes
+    // the memory usage swing a lot so the blocks are recycled instead.
+    // The blocks are bucketed into power of two size classes and
+    // the blocks are not initialized in any way.
+    class BufferPool
+    {
+    public:
+        struct Stats {
+            // the number of allocations served from the pool.
+            std::uint64_t hits = 0;
+            // the number of allocations that needed a new block.
+            std::uint64_t misses = 0;
+            // the number of bytes currently handed out to buffers.
+            std::uint64_t bytes_in_use = 0;
+            // the number of bytes currently kept in the pool for reuse.
+            std::uint64_t bytes_pooled = 0;
+        };
+
+        // Create a new pool that keeps at most max_pooled_bytes
+        // of free blocks around for reuse.
+        BufferPool(std::size_t max_pooled_bytes);
+       ~BufferPool();
+
+        // Allocate a block that can hold at least capacity bytes.
+        // The actual size of the block is stored in block_size and
+        // the same value must be given back in Release.
+        char* Allocate(std::size_t capacity, std::size_t* block_size);
+
+        // Return a block previously allocated from this pool.
+        // If the pool is already holding the maximum amount of free
+        // memory the block is deleted instead.
+        void Release(char* block, std::size_t block_size);
+
+        // Set the maximum number of bytes the pool will keep
+        // for reuse. Blocks that are currently in use are not
+        // affected but any excess free blocks are deleted immediately.
+        void SetMaxPoolSize(std::size_t bytes);
+
+        // Get the current maximum number of pooled bytes.
+        std::size_t GetMaxPoolSize() const;
+
+        // Delete all the free blocks.
+        void Purge();
+
+        // Get a snapshot of the pool counters.
+        Stats GetStats() const;
+
+        // Get the process wide pool shared by all Buffers.
+        static BufferPool& Get();
+
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+    private:
+        void trim(std::size_t max_bytes);
+
+    private:
+        // blocks from 2^MinClass to 2^MaxClass bytes are pooled,
+        // anything larger is always allocated and deleted directly.
+        enum { MinClass = 10, MaxClass = 26, NumClasses = MaxClass - MinClass + 1 };
+
+        mutable std::mutex mutex_;
+        std::vector<char*> free_[NumClasses];
+        std::size_t max_pooled_bytes_ = 0;
+        Stats stats_;
+    };
+
+} // newsflash
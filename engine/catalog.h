@@ -307,6 +307,11 @@ namespace newsflash
         const StorageDevice& device() const
         { return device_; }
 
+        // get the offset of the first article record in the storage device.
+        // article offsets (see load(offset_t)) are relative to this.
+        static std::size_t data_offset()
+        { return sizeof(header); }
+
     private:
         static const std::uint32_t MAGIC = 0xdeadbabe;
         // version 3. refactoring the way how to we store the data
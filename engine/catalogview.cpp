@@ -0,0 +1,114 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "catalogview.h"
+#include "article.h"
+
+namespace newsflash
+{
+
+void catalog_view::bind(catalog_t& db)
+{
+    map_  = db.device();
+    end_  = db.end().offset();
+    base_ = nullptr;
+    if (map_.is_open() && map_.size())
+        base_ = (const char*)map_.map_ptr(0, map_.size());
+
+    // articles that we've already loaded might have been updated
+    // in place (for example more parts have become available)
+    // so refresh the fixed width columns from the new mapping.
+    for (std::size_t i=0; i<record_.size(); ++i)
+    {
+        if (!record_[i])
+            continue;
+        read(i, record_[i]);
+    }
+}
+
+std::uint32_t catalog_view::load(std::size_t& offset)
+{
+    ASSERT(offset < end_);
+
+    const auto record = offset + catalog_t::data_offset();
+
+    article<filemap> a;
+    a.load(record, map_);
+
+    const auto i = a.index();
+    if (i >= record_.size())
+        resize(i + 1);
+
+    read(i, record);
+
+    offset += a.size_on_disk();
+    return i;
+}
+
+void catalog_view::set_bits(std::size_t i, fileflag flag, bool on_off)
+{
+    ASSERT(has_row(i));
+
+    bitflag<fileflag> bits(bits_[i]);
+    bits.set(flag, on_off);
+    bits_[i] = bits.value();
+
+    article<filemap> a;
+    a.load(record_[i], map_);
+    a.set_bits(flag, on_off);
+}
+
+void catalog_view::read(std::size_t i, std::size_t record)
+{
+    article<filemap> a;
+    a.load(record, map_);
+
+    const auto subject = a.subject();
+    const auto author  = a.author();
+
+    pubdate_[i]     = a.pubdate();
+    bytes_[i]       = a.bytes();
+    bits_[i]        = a.bits().value();
+    type_[i]        = (std::uint8_t)a.type();
+    parts_avail_[i] = a.num_parts_avail();
+    parts_total_[i] = a.num_parts_total();
+    record_[i]      = record;
+    subject_[i]     = subject.c_str() - base_;
+    subject_len_[i] = subject.size();
+    author_len_[i]  = author.size();
+}
+
+void catalog_view::resize(std::size_t rows)
+{
+    pubdate_.resize(rows);
+    bytes_.resize(rows);
+    bits_.resize(rows);
+    type_.resize(rows);
+    parts_avail_.resize(rows);
+    parts_total_.resize(rows);
+    record_.resize(rows);
+    subject_.resize(rows);
+    subject_len_.resize(rows);
+    author_len_.resize(rows);
+}
+
+} // newsflash
@@ -0,0 +1,147 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "newsflash/config.h"
+
+#include <vector>
+#include <cstdint>
+#include <ctime>
+
+#include "stringlib/string_view.h"
+#include "bitflag.h"
+#include "filetype.h"
+#include "filemap.h"
+#include "catalog.h"
+#include "assert.h"
+
+namespace newsflash
+{
+    // columnar read only view into a memory mapped catalog volume.
+    // the fixed width article fields (date, size, flags, type and parts)
+    // are decoded once into separate columns indexed by the article's
+    // index in the catalog. the variable length subject and author strings
+    // are not copied at all, instead the view keeps an offset table into
+    // the mapped article records and returns views to the mapped data.
+    // this allows the header browser to sort, filter and render articles
+    // without loading an article object for each access.
+    class catalog_view
+    {
+    public:
+        using catalog_t = catalog<filemap>;
+
+        // bind the view to the current mapping of the catalog.
+        // this needs to be called every time the catalog is (re)opened
+        // since opening the catalog creates a new mapping. any previously
+        // loaded rows remain valid.
+        void bind(catalog_t& db);
+
+        // decode the article record at the given catalog offset into the columns.
+        // returns the index of the article and advances the offset to the
+        // start of the next record.
+        std::uint32_t load(std::size_t& offset);
+
+        // get the offset to the end of the catalog records.
+        // i.e. loading is complete when offset reaches end.
+        std::size_t end() const
+        { return end_; }
+
+        // set the file flag both in the column and in the mapped article data.
+        void set_bits(std::size_t i, fileflag flag, bool on_off);
+
+        // returns true if an article has been loaded at the given index.
+        bool has_row(std::size_t i) const
+        { return i < record_.size() && record_[i] != 0; }
+
+        // number of rows. note that there might be holes, see has_row.
+        std::size_t size() const
+        { return record_.size(); }
+
+        std::time_t pubdate(std::size_t i) const
+        { return pubdate_[i]; }
+
+        std::uint32_t bytes(std::size_t i) const
+        { return bytes_[i]; }
+
+        bitflag<fileflag> bits(std::size_t i) const
+        { return bitflag<fileflag>(bits_[i]); }
+
+        filetype type(std::size_t i) const
+        { return (filetype)type_[i]; }
+
+        std::uint16_t num_parts_avail(std::size_t i) const
+        { return parts_avail_[i]; }
+
+        std::uint16_t num_parts_total(std::size_t i) const
+        { return parts_total_[i]; }
+
+        bool test(std::size_t i, fileflag flag) const
+        { return bits(i).test(flag); }
+
+        bool is_utf8_enabled(std::size_t i) const
+        { return test(i, fileflag::enable_utf8); }
+
+        bool is_deleted(std::size_t i) const
+        { return test(i, fileflag::deleted); }
+
+        str::string_view subject(std::size_t i) const
+        {
+            ASSERT(has_row(i));
+            return str::string_view{base_ + subject_[i], subject_len_[i]};
+        }
+
+        str::string_view author(std::size_t i) const
+        {
+            ASSERT(has_row(i));
+            // the author record follows the subject and its 16bit length field.
+            const auto offset = subject_[i] + subject_len_[i] + 2;
+            return str::string_view{base_ + offset, author_len_[i]};
+        }
+
+    private:
+        void read(std::size_t i, std::size_t record);
+        void resize(std::size_t rows);
+
+    private:
+        // the mapping that we've loaded the rows from. keeping a
+        // copy of the map keeps the mapping alive for the views
+        // handed out until the view is bound to a new mapping.
+        filemap map_;
+        const char* base_ = nullptr;
+        std::size_t end_ = 0;
+
+    private:
+        // fixed width columns.
+        std::vector<std::time_t> pubdate_;
+        std::vector<std::uint32_t> bytes_;
+        std::vector<std::uint8_t> bits_;
+        std::vector<std::uint8_t> type_;
+        std::vector<std::uint16_t> parts_avail_;
+        std::vector<std::uint16_t> parts_total_;
+
+        // offset table into the mapped article records.
+        std::vector<std::uint32_t> record_;
+        std::vector<std::uint32_t> subject_;
+        std::vector<std::uint16_t> subject_len_;
+        std::vector<std::uint16_t> author_len_;
+    };
+
+} // newsflash
@@ -27,6 +27,7 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <memory>
 
 #include "session.h"
 #include "buffer.h"
@@ -34,6 +35,8 @@
 
 namespace newsflash
 {
+    class throttle;
+
     // cmdlist encapsulates a sequence of nntp operations to be performed
     // for example downloading articles or header overview data.
     // the cmdlist operation is divided into 2 steps, session configuration
@@ -307,6 +310,15 @@ namespace newsflash
         void SetDesc(const std::string& description)
         { desc_ = description; }
 
+        // set the throttle that limits the transfer speed of this cmdlist.
+        // the throttle should be chained to the account's throttle.
+        void SetThrottle(std::shared_ptr<throttle> t)
+        { throttle_ = std::move(t); }
+
+        // get the cmdlist specific throttle if any.
+        throttle* GetThrottle() const
+        { return throttle_.get(); }
+
         // returns whether the CmdList can be filled from another
         // account, i.e. whether the content's are available on any server
         bool IsFillable() const
@@ -363,6 +375,7 @@ namespace newsflash
         std::size_t conn_ = 0;
         std::size_t id_   = 0;
         std::string desc_;
+        std::shared_ptr<throttle> throttle_;
     private:
         // nntp data
         std::vector<Buffer> buffers_;
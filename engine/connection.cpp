@@ -20,16 +20,14 @@
 
 #include "newsflash/config.h"
 
-#include "newsflash/warnpush.h"
-#  include <boost/random/mersenne_twister.hpp>
-#include "newsflash/warnpop.h"
-
-#include <thread>
 #include <mutex>
 #include <fstream>
 #include <cassert>
 #include <atomic>
+#include <algorithm>
+#include <limits>
 #include <map>
+#include <cstdio>
 
 #include "connection.h"
 #include "socket.h"
@@ -40,6 +38,7 @@
 #include "event.h"
 #include "socketapi.h"
 #include "throttle.h"
+#include "reactor.h"
 
 namespace newsflash
 {
@@ -47,6 +46,65 @@ namespace newsflash
 std::map<std::string, std::uint32_t> g_addr_cache;
 std::mutex g_addr_cache_mutex;
 
+namespace {
+
+// the cmdlist may carry a throttle of its own (for a task with a speed limit)
+// which is chained to the connection's throttle.
+throttle* select_throttle(const CmdList& cmds, throttle* conn)
+{
+    if (auto* ret = cmds.GetThrottle())
+        return ret;
+    return conn;
+}
+
+// how long to wait for the throttle to refill. bounded so that
+// changes to the throttle settings are picked up in a reasonable time.
+std::chrono::milliseconds throttle_wait_time(const throttle& t)
+{
+    const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(t.get_wait_time());
+    return std::min(std::max(wait, std::chrono::milliseconds(1)), std::chrono::milliseconds(100));
+}
+
+// collect the pipeline measurement of a completed cmdlist. returns false
+// if the cmdlist isn't one whose size is controlled by the pipeline depth.
+bool make_pipeline_sample(const CmdList& cmds, std::uint64_t bytes,
+    std::chrono::microseconds latency, std::chrono::microseconds duration,
+    PipelineControl::Sample* sample)
+{
+    const auto type = cmds.GetType();
+    if (type == CmdList::Type::Article)
+    {
+        sample->type = PipelineControl::Type::Articles;
+        sample->num_items = cmds.NumDataCommands();
+    }
+    else if (type == CmdList::Type::Header)
+    {
+        // the data commands are XOVER ranges "first-last"
+        sample->type = PipelineControl::Type::Overviews;
+        sample->num_items = 0;
+        for (std::size_t i=0; i<cmds.NumDataCommands(); ++i)
+        {
+            unsigned long long first = 0;
+            unsigned long long last  = 0;
+            const auto& range = cmds.GetCommand(i);
+            if (std::sscanf(range.c_str(), "%llu-%llu", &first, &last) != 2 || last < first)
+                continue;
+            sample->num_items += last - first + 1;
+        }
+    }
+    else return false;
+
+    if (!sample->num_items || !bytes)
+        return false;
+
+    sample->bytes    = bytes;
+    sample->latency  = latency;
+    sample->duration = duration;
+    return true;
+}
+
+} // namespace
+
 struct ConnectionImpl::impl {
     std::mutex  mutex;
     std::string username;
@@ -64,7 +122,6 @@ struct ConnectionImpl::impl {
     bool authenticate_immediately = false;
     double bps = 0.0;
     throttle* pthrottle = nullptr;
-    boost::random::mt19937 random; // std::rand is not MT safe.
 
     std::error_code pending_socket_error;
     Session::Error  pending_session_error = Session::Error::None;
@@ -75,6 +132,15 @@ struct ConnectionImpl::impl {
 
     OnCmdlistDone on_cmdlist_done_callback;
 
+    // adapts the cmdlist sizes to the connection. only accessed
+    // by the engine in Complete and GetPipelineDepth.
+    PipelineControl pipeline;
+
+    // when the connection is event driven the session commands
+    // are queued here and then sent without blocking.
+    std::string sendbuf;
+    bool event_driven = false;
+
     void do_auth(std::string& user, std::string& pass) const
     {
         user = username;
@@ -82,6 +148,12 @@ struct ConnectionImpl::impl {
     }
     void do_send(const std::string& cmd)
     {
+        if (event_driven)
+        {
+            sendbuf.append(cmd);
+            return;
+        }
+
         std::error_code error;
         socket->SendAll(&cmd[0], cmd.size(), &error);
         if (error)
@@ -89,6 +161,40 @@ struct ConnectionImpl::impl {
             pending_socket_error = error;
         }
     }
+
+    void create_session()
+    {
+        session.reset(new Session);
+
+        // there was a lambda here before but the lambda took the state
+        // object by a shared_ptr and created a circular depedency.
+        // i think a cleaner and less error prone system is
+        // to use a boost:bind here with real functions.
+        session->SetSendCallback(std::bind(&impl::do_send, this,
+            std::placeholders::_1));
+
+        session->SetCredentials(username, password);
+        session->SetEnablePipelining(pipelining);
+        session->SetEnableCompression(compression);
+    }
+
+    void cmdlist_done(const std::shared_ptr<CmdList>& cmds, bool has_exception,
+        std::uint64_t total_bytes, std::uint64_t content_bytes)
+    {
+        const bool has_connection_error = pending_connection_error != Connection::Error::None;
+        const bool has_socket_error = pending_socket_error != std::error_code();
+        const bool has_session_error = pending_session_error != Session::Error::None;
+        const bool has_any_error =
+            has_exception || has_connection_error || has_socket_error ||
+            has_session_error;
+
+        Connection::CmdListCompletionData completion;
+        completion.cmds          = cmds;
+        completion.total_bytes   = total_bytes;
+        completion.content_bytes = content_bytes;
+        completion.execution_did_complete = !has_any_error;
+        on_cmdlist_done_callback(completion);
+    }
 };
 
 // perform host resolution
@@ -210,18 +316,7 @@ class ConnectionImpl::initialize : public action
 public:
     initialize(std::shared_ptr<impl> s) : state_(s)
     {
-        state_->session.reset(new Session);
-
-        // there was a lambda here before but the lambda took the state
-        // object by a shared_ptr and created a circular depedency.
-        // i think a cleaner and less error prone system is
-        // to use a boost:bind here with real functions.
-        state_->session->SetSendCallback(std::bind(&impl::do_send, state_.get(),
-            std::placeholders::_1));
-
-        state_->session->SetCredentials(state_->username, state_->password);
-        state_->session->SetEnablePipelining(s->pipelining);
-        state_->session->SetEnableCompression(s->compression);
+        state_->create_session();
     }
     virtual std::string describe() const override
     {
@@ -315,7 +410,7 @@ public:
         auto& session  = state_->session;
         auto& cancel   = state_->cancel;
         auto& socket   = state_->socket;
-        auto* throttle = state_->pthrottle;
+        auto* throttle = select_throttle(*cmds_, state_->pthrottle);
         auto& cmdlist  = cmds_;
 
         LOG_D("Execute cmdlist ", cmdlist->GetCmdListId());
@@ -367,6 +462,9 @@ public:
                         else if (cancelled)
                             return;
 
+                        if (recvbuf.GetAvailableBytes() < KB(64))
+                            recvbuf.Compact(MB(4));
+
                         std::error_code recv_error;
                         const auto bytes = socket->RecvSome(recvbuf.Back(), recvbuf.GetAvailableBytes(), &recv_error);
                         if (recv_error)
@@ -424,9 +522,14 @@ public:
 
         std::uint64_t accum = 0;
 
+        clock::time_point first_byte;
+
         while (session->HasPending())
         {
-            Buffer content(MB(4));
+            // the session either replaces the content buffer with a
+            // split of the receive buffer or allocates it when needed,
+            // so there's no need to allocate anything up front.
+            Buffer content;
 
             session->SendNext();
 
@@ -467,12 +570,22 @@ public:
                     }
                 }
 
-                auto quota = throttle->give_quota();
+                // the completed responses are split off the front of the
+                // receive buffer without copying them so eventually we run
+                // out of space at the back. then the pending partial response
+                // is moved to a new buffer while the split off responses
+                // keep the old memory alive until they're done with it.
+                if (recvbuf.GetAvailableBytes() < KB(64))
+                    recvbuf.Compact(MB(4));
+
+                auto quota = throttle->give_quota(recvbuf.GetAvailableBytes());
                 while (!quota)
                 {
-                    const auto ms = state_->random() % 50;
-                    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
-                    quota = throttle->give_quota();
+                    // wait until the throttle has refilled or we're cancelled.
+                    auto cancelled = cancel->GetWaitHandle();
+                    if (newsflash::WaitForSingleHandle(cancelled, throttle_wait_time(*throttle)))
+                        return;
+                    quota = throttle->give_quota(recvbuf.GetAvailableBytes());
                 }
 
                 std::size_t avail = std::min(recvbuf.GetAvailableBytes(), quota);
@@ -495,6 +608,9 @@ public:
 
                 throttle->accumulate(bytes, quota);
 
+                if (accum == 0)
+                    first_byte = clock::now();
+
                 recvbuf.Append(bytes);
                 accum += bytes;
 
@@ -550,35 +666,34 @@ public:
         }
 
         LOG_D("Cmdlist complete");
+
+        using us = std::chrono::microseconds;
+        const auto end = clock::now();
+        has_sample_ = make_pipeline_sample(*cmdlist, accum,
+            std::chrono::duration_cast<us>(first_byte - start),
+            std::chrono::duration_cast<us>(end - start), &sample_);
     }
 
     virtual void run_completion_callbacks() override
     {
-        const bool has_exception = this->has_exception();
-        const bool has_connection_error = state_->pending_connection_error != Connection::Error::None;
-        const bool has_socket_error = state_->pending_socket_error != std::error_code();
-        const bool has_session_error = state_->pending_session_error != Session::Error::None;
-        const bool has_any_error =
-            has_exception || has_connection_error || has_socket_error ||
-            has_session_error;
-
-        Connection::CmdListCompletionData completion;
-        completion.cmds          = cmds_;
-        completion.total_bytes   = total_bytes_;
-        completion.content_bytes = content_bytes_;
-        completion.execution_did_complete = !has_any_error;
-        state_->on_cmdlist_done_callback(completion);
+        state_->cmdlist_done(cmds_, has_exception(), total_bytes_, content_bytes_);
     }
 
     virtual std::string describe() const override
     {
         return "Execute cmdlist";
     }
+
+    // get the pipeline measurement if the cmdlist completed.
+    const PipelineControl::Sample* GetSample() const
+    { return has_sample_ ? &sample_ : nullptr; }
 private:
     std::shared_ptr<impl> state_;
     std::shared_ptr<CmdList> cmds_;
     std::size_t total_bytes_ = 0;
     std::size_t content_bytes_ = 0;
+    PipelineControl::Sample sample_;
+    bool has_sample_ = false;
 private:
 };
 
@@ -724,12 +839,13 @@ std::unique_ptr<action> ConnectionImpl::Connect(const HostDetails& s)
     state_->cancel.reset(new Event);
     state_->cancel->ResetSignal();
     state_->pthrottle = s.pthrottle;
-    state_->random.seed((std::size_t)this);
     state_->state = State::Resolving;
     state_->error = Error::None;
     state_->pending_socket_error = std::error_code();
     state_->pending_session_error = Session::Error::None;
     state_->pending_connection_error = Connection::Error::None;
+    state_->event_driven = false;
+    state_->sendbuf.clear();
     std::unique_ptr<action> act(new resolve(state_));
 
     return act;
@@ -753,6 +869,40 @@ std::unique_ptr<action> ConnectionImpl::Complete(std::unique_ptr<action> a)
 {
     std::unique_ptr<action> next;
 
+    if (map_pending_error())
+        return next;
+
+    auto* ptr = a.get();
+
+    if (dynamic_cast<resolve*>(ptr))
+    {
+        next.reset(new class connect(state_));
+        state_->state = State::Connecting;
+    }
+    else if (dynamic_cast<class connect*>(ptr))
+    {
+        next.reset(new class initialize(state_));
+        state_->state = State::Initializing;
+    }
+    else if (dynamic_cast<class initialize*>(ptr))
+    {
+        state_->state = State::Connected;
+    }
+    else if (dynamic_cast<class disconnect*>(ptr))
+    {
+        state_->state = State::Disconnected;
+    }
+    else if (auto* p = dynamic_cast<class execute*>(ptr))
+    {
+        if (const auto* sample = p->GetSample())
+            state_->pipeline.Update(*sample);
+        state_->state = State::Connected;
+    }
+    return next;
+}
+
+bool ConnectionImpl::map_pending_error()
+{
     // map different levels of errors to higher level connection error.
     if (state_->pending_socket_error)
     {
@@ -825,34 +975,9 @@ std::unique_ptr<action> ConnectionImpl::Complete(std::unique_ptr<action> a)
                 LOG_E("Connection error not known");
                 break;
         }
-        return next;
-    }
-
-    auto* ptr = a.get();
-
-    if (dynamic_cast<resolve*>(ptr))
-    {
-        next.reset(new class connect(state_));
-        state_->state = State::Connecting;
-    }
-    else if (dynamic_cast<class connect*>(ptr))
-    {
-        next.reset(new class initialize(state_));
-        state_->state = State::Initializing;
-    }
-    else if (dynamic_cast<class initialize*>(ptr))
-    {
-        state_->state = State::Connected;
-    }
-    else if (dynamic_cast<class disconnect*>(ptr))
-    {
-        state_->state = State::Disconnected;
-    }
-    else if (auto* p = dynamic_cast<class execute*>(ptr))
-    {
-        state_->state = State::Connected;
+        return true;
     }
-    return next;
+    return false;
 }
 
 std::unique_ptr<action> ConnectionImpl::Execute(std::shared_ptr<CmdList> cmd)
@@ -889,9 +1014,768 @@ Connection::State ConnectionImpl::GetState() const
 Connection::Error ConnectionImpl::GetError() const
 { return state_->error; }
 
+PipelineDepth ConnectionImpl::GetPipelineDepth() const
+{ return state_->pipeline.GetDepth(); }
+
+std::uint32_t ConnectionImpl::GetLatencyMs() const
+{ return state_->pipeline.GetLatencyMs(); }
+
 void ConnectionImpl::SetCallback(const OnCmdlistDone& callback)
 {
     state_->on_cmdlist_done_callback = callback;
 }
 
+// base class for the event driven connection actions.
+// the helpers here move the data between the socket and
+// the session without ever blocking on the socket.
+class EventConnection::io : public IoAction
+{
+public:
+    io(std::shared_ptr<impl> s, std::chrono::seconds timeout, bool cancellable)
+      : state_(s)
+      , timeout_(timeout)
+      , cancellable_(cancellable)
+    {
+        last_io_ = Clock::now();
+    }
+protected:
+    enum class Status {
+        // the current step is complete.
+        Ready,
+        // need to wait for the socket. the wait has been set.
+        Pending,
+        // the other end closed the connection.
+        Closed,
+        // an error occurred and has been stored in the pending errors.
+        Failed
+    };
+
+    // send out the commands queued by the session.
+    Status flush(Wait& wait)
+    {
+        auto& socket = state_->socket;
+        auto& out    = state_->sendbuf;
+
+        // the session only queues more commands once the previous
+        // ones have been sent so the data stays put while we're
+        // waiting to retry the send. (required by SSL)
+        while (!out.empty())
+        {
+            int sent = 0;
+            std::error_code error;
+            const auto ret = socket->TrySend(&out[0], out.size(), &sent, &error);
+            if (ret != Socket::IoStatus::Done)
+                return wait_for(wait, ret);
+            else if (error)
+            {
+                state_->pending_socket_error = error;
+                return Status::Failed;
+            }
+            out.erase(0, sent);
+            touch();
+        }
+        return Status::Ready;
+    }
+
+    // feed the received data into the session and receive more until
+    // the session completes the current command or the socket has no
+    // more data or quota bytes have been received. the receive buffer
+    // is kept at the given capacity.
+    Status receive(Buffer& buff, Buffer& out, Wait& wait, std::size_t capacity,
+        std::size_t quota, std::size_t& received)
+    {
+        auto& socket  = state_->socket;
+        auto& session = state_->session;
+
+        for (;;)
+        {
+            if (session->RecvNext(buff, out))
+                return Status::Ready;
+
+            if (received >= quota)
+            {
+                // let the other actions run and resume as soon as possible.
+                wait.timeout = Clock::now();
+                return Status::Pending;
+            }
+
+            if (buff.GetAvailableBytes() < capacity / 64)
+                buff.Compact(std::max(capacity, buff.GetSize() * 2));
+
+            const auto avail = std::min(buff.GetAvailableBytes(), quota - received);
+
+            int bytes = 0;
+            std::error_code error;
+            const auto ret = socket->TryRecv(buff.Back(), avail, &bytes, &error);
+            if (ret != Socket::IoStatus::Done)
+                return wait_for(wait, ret);
+            else if (error)
+            {
+                state_->pending_socket_error = error;
+                return Status::Failed;
+            }
+            else if (bytes == 0)
+                return Status::Closed;
+
+            buff.Append(bytes);
+            received += bytes;
+            touch();
+        }
+        return Status::Ready;
+    }
+
+    // send the queued commands and then receive the response
+    // for the current command.
+    Status transact(Buffer& buff, Buffer& out, Wait& wait, std::size_t capacity)
+    {
+        const auto status = flush(wait);
+        if (status != Status::Ready)
+            return status;
+
+        std::size_t received = 0;
+        return receive(buff, out, wait, capacity, std::numeric_limits<std::size_t>::max(), received);
+    }
+
+    Status wait_for(Wait& wait, Socket::IoStatus io)
+    {
+        wait.socket  = state_->socket.get();
+        wait.read    = io == Socket::IoStatus::WantRead;
+        wait.write   = io == Socket::IoStatus::WantWrite;
+        wait.timeout = last_io_ + timeout_;
+        if (cancellable_)
+            wait.event = state_->cancel.get();
+        return Status::Pending;
+    }
+
+    // returns true if the action should be cancelled.
+    bool is_cancelled() const
+    {
+        return cancellable_ && state_->cancel->IsSignalled();
+    }
+
+    // returns true if there's been no progress within the timeout.
+    bool is_timeout() const
+    {
+        return Clock::now() >= last_io_ + timeout_;
+    }
+
+    // mark progress.
+    void touch()
+    {
+        last_io_ = Clock::now();
+    }
+
+protected:
+    std::shared_ptr<impl> state_;
+private:
+    Clock::time_point last_io_;
+    std::chrono::seconds timeout_;
+    bool cancellable_ = false;
+};
+
+class EventConnection::connect : public EventConnection::io
+{
+public:
+    connect(std::shared_ptr<impl> s) : io(s, std::chrono::seconds(10), true)
+    {
+        state_->socket = MakeNewsflashSocket(state_->ssl);
+    }
+
+    virtual bool Resume(Wait& wait) override
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+
+        auto& socket = state_->socket;
+
+        if (is_cancelled())
+        {
+            LOG_D("Connection was canceled");
+            return true;
+        }
+        else if (is_timeout())
+        {
+            state_->pending_connection_error = Error::Timeout;
+            return true;
+        }
+
+        if (!started_)
+        {
+            LOG_I("Connecting to ", ipv4{state_->addr}, ", ", state_->port);
+
+            // the socket becomes writeable once the connection is established.
+            socket->BeginConnect(state_->addr, state_->port);
+            started_ = true;
+            touch();
+            wait_for(wait, Socket::IoStatus::WantWrite);
+            return false;
+        }
+
+        std::error_code connection_error;
+        const auto ret = socket->TryCompleteConnect(&connection_error);
+        if (ret != Socket::IoStatus::Done)
+        {
+            // SSL handshake in progress.
+            touch();
+            wait_for(wait, ret);
+            return false;
+        }
+        else if (connection_error)
+        {
+            state_->pending_socket_error = connection_error;
+            return true;
+        }
+
+        LOG_I("Socket connection ready");
+        return true;
+    }
+
+    virtual std::string describe() const override
+    {
+        return str("Connect to ", ipv4{state_->addr}, ":", state_->port);
+    }
+private:
+    bool started_ = false;
+};
+
+class EventConnection::initialize : public EventConnection::io
+{
+public:
+    initialize(std::shared_ptr<impl> s) : io(s, std::chrono::seconds(5), true)
+    {
+        state_->create_session();
+    }
+
+    virtual bool Resume(Wait& wait) override
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+
+        auto& session = state_->session;
+
+        if (is_cancelled())
+        {
+            LOG_D("Initialize was cancelled");
+            return true;
+        }
+        else if (is_timeout())
+        {
+            state_->pending_connection_error = Error::Timeout;
+            return true;
+        }
+
+        if (!started_)
+        {
+            LOG_I("Initializing NNTP session");
+            LOG_I("Enable gzip compress: ", state_->compression);
+            LOG_I("Enable pipelining: ", state_->pipelining);
+
+            session->Start(state_->authenticate_immediately);
+            started_ = true;
+        }
+
+        for (;;)
+        {
+            if (!command_sent_)
+            {
+                if (!session->SendNext())
+                    break;
+                command_sent_ = true;
+            }
+            const auto status = transact(buff_, temp_, wait, KB(4));
+            if (status == Status::Pending)
+                return false;
+            else if (status == Status::Closed)
+            {
+                state_->pending_connection_error = Error::Network;
+                return true;
+            }
+            else if (status == Status::Failed)
+                return true;
+
+            command_sent_ = false;
+        }
+
+        const auto err = session->GetError();
+        if (err != Session::Error::None)
+        {
+            state_->pending_session_error = err;
+            return true;
+        }
+        LOG_I("NNTP Session ready");
+        return true;
+    }
+
+    virtual std::string describe() const override
+    {
+        return "Initialize NNTP session";
+    }
+private:
+    Buffer buff_;
+    Buffer temp_;
+    bool started_ = false;
+    bool command_sent_ = false;
+};
+
+class EventConnection::execute : public EventConnection::io
+{
+public:
+    execute(std::shared_ptr<impl> s, std::shared_ptr<CmdList> cmd)
+      : io(s, std::chrono::seconds(30), true)
+      , cmds_(cmd)
+    {}
+
+    virtual bool Resume(Wait& wait) override
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+
+        if (is_cancelled())
+            return true;
+        else if (is_timeout())
+        {
+            state_->pending_connection_error = Error::Timeout;
+            return true;
+        }
+
+        if (phase_ == Phase::Start)
+        {
+            LOG_D("Execute cmdlist ", cmds_->GetCmdListId());
+            LOG_D("Cmdlist has ", cmds_->NumDataCommands(), " data commands");
+            if (cmds_->IsCancelled())
+            {
+                LOG_D("Cmdlist was canceled");
+                return true;
+            }
+            phase_ = cmds_->NeedsToConfigure() ? Phase::Configure : Phase::Submit;
+        }
+
+        if (phase_ == Phase::Configure)
+        {
+            if (!configure(wait))
+                return false;
+            if (phase_ != Phase::Submit)
+                return true;
+        }
+
+        if (phase_ == Phase::Submit)
+        {
+            if (cmds_->IsCancelled())
+            {
+                LOG_D("Cmdlist was canceled");
+                return true;
+            }
+            LOG_I("Submit data commands");
+
+            cmds_->SubmitDataCommands(*state_->session);
+
+            LOG_FLUSH();
+
+            state_->bps = 0;
+            start_ = Clock::now();
+            phase_ = Phase::Transfer;
+        }
+        return transfer(wait);
+    }
+
+    virtual void run_completion_callbacks() override
+    {
+        state_->cmdlist_done(cmds_, has_exception(), total_bytes_, content_bytes_);
+    }
+
+    virtual std::string describe() const override
+    {
+        return "Execute cmdlist";
+    }
+
+    // get the pipeline measurement if the cmdlist completed.
+    const PipelineControl::Sample* GetSample() const
+    { return has_sample_ ? &sample_ : nullptr; }
+private:
+    // returns false when waiting. otherwise the phase
+    // is changed to Submit if the configuration succeeded.
+    bool configure(Wait& wait)
+    {
+        auto& session = state_->session;
+
+        for (;;)
+        {
+            if (!configure_submitted_)
+            {
+                if (!cmds_->SubmitConfigureCommand(configure_index_, *session))
+                {
+                    LOG_E("Cmdlist session configuration failed");
+                    return true;
+                }
+                if (!session->HasPending())
+                    break;
+
+                config_ = Buffer(KB(1));
+                configure_submitted_ = true;
+            }
+
+            for (;;)
+            {
+                if (!command_sent_)
+                {
+                    if (!session->SendNext())
+                        break;
+                    command_sent_ = true;
+                }
+                const auto status = transact(recvbuf_, config_, wait, MB(4));
+                if (status == Status::Pending)
+                    return false;
+                else if (status == Status::Closed)
+                {
+                    state_->pending_connection_error = Error::Network;
+                    return true;
+                }
+                else if (status == Status::Failed)
+                    return true;
+
+                command_sent_ = false;
+            }
+
+            const auto err = session->GetError();
+            if (err != Session::Error::None)
+            {
+                state_->pending_session_error = err;
+                return true;
+            }
+
+            configure_submitted_ = false;
+            if (cmds_->ReceiveConfigureBuffer(configure_index_++, std::move(config_)))
+                break;
+        }
+
+        phase_ = Phase::Submit;
+        return true;
+    }
+
+    bool transfer(Wait& wait)
+    {
+        auto& session  = state_->session;
+        auto& socket   = state_->socket;
+        auto* throttle = select_throttle(*cmds_, state_->pthrottle);
+
+        while (session->HasPending())
+        {
+            if (!command_sent_)
+            {
+                // the session either replaces the content buffer with a
+                // split of the receive buffer or allocates it when needed.
+                content_ = Buffer();
+                session->SendNext();
+                command_sent_ = true;
+            }
+
+            auto status = flush(wait);
+            if (status == Status::Pending)
+                return false;
+            else if (status == Status::Failed)
+                return true;
+
+            if (cmds_->MightRunSlowly())
+            {
+                // see the comment in ConnectionImpl::execute
+                if (cmds_->IsCancelled())
+                {
+                    LOG_D("Cmdlist was cancelled");
+                    state_->pending_connection_error = Error::PipelineReset;
+                    socket->Close();
+                    return true;
+                }
+            }
+
+            // don't let a single fast connection hog the reactor thread.
+            const auto quota = throttle->give_quota(MB(1));
+            if (!quota)
+            {
+                // out of quota. try again when the throttle has refilled
+                // but this doesn't count towards the timeout.
+                touch();
+                wait.timeout = Clock::now() + throttle_wait_time(*throttle);
+                wait.event   = state_->cancel.get();
+                return false;
+            }
+
+            const auto chunk = quota;
+
+            std::size_t bytes = 0;
+            status = receive(recvbuf_, content_, wait, MB(4), chunk, bytes);
+
+            throttle->accumulate(bytes, quota);
+
+            if (bytes)
+            {
+                if (accum_ == 0)
+                    first_byte_ = Clock::now();
+                accum_ += bytes;
+                const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_);
+                const auto seconds = ms.count() / 1000.0;
+                const auto bps = accum_ / seconds;
+                state_->bps    = 0.05 * bps + (0.95 * state_->bps);
+                state_->bytes += bytes;
+                total_bytes_  += bytes;
+            }
+
+            if (status == Status::Pending)
+            {
+                if (bytes && session->IsCurrentCommandContent())
+                {
+                    const bool compression = session->IsCurrentCommandCompressed();
+                    cmds_->InspectIntermediateContentBuffer(recvbuf_, compression);
+                }
+                return false;
+            }
+            else if (status == Status::Closed)
+            {
+                state_->pending_connection_error = Error::Network;
+                return true;
+            }
+            else if (status == Status::Failed)
+                return true;
+
+            command_sent_ = false;
+
+            content_bytes_ += content_.GetContentLength();
+
+            const auto err = session->GetError();
+            if (err != Session::Error::None)
+            {
+                state_->pending_session_error = err;
+                return true;
+            }
+
+            cmds_->ReceiveDataBuffer(std::move(content_));
+
+            if (cmds_->IsCancelled())
+            {
+                LOG_D("Cmdlist was cancelled");
+                if (state_->pipelining)
+                {
+                    // see the comment in ConnectionImpl::execute
+                    socket->Close();
+                    state_->pending_connection_error = Error::PipelineReset;
+                    return true;
+                }
+                session->Clear();
+                return true;
+            }
+        }
+
+        LOG_D("Cmdlist complete");
+
+        using us = std::chrono::microseconds;
+        has_sample_ = make_pipeline_sample(*cmds_, accum_,
+            std::chrono::duration_cast<us>(first_byte_ - start_),
+            std::chrono::duration_cast<us>(Clock::now() - start_), &sample_);
+        return true;
+    }
+
+private:
+    enum class Phase {
+        Start, Configure, Submit, Transfer
+    };
+    std::shared_ptr<CmdList> cmds_;
+    std::size_t total_bytes_ = 0;
+    std::size_t content_bytes_ = 0;
+    std::uint64_t accum_ = 0;
+    std::size_t configure_index_ = 0;
+    bool configure_submitted_ = false;
+    bool command_sent_ = false;
+    Phase phase_ = Phase::Start;
+    Buffer recvbuf_;
+    Buffer config_;
+    Buffer content_;
+    Clock::time_point start_;
+    Clock::time_point first_byte_;
+    PipelineControl::Sample sample_;
+    bool has_sample_ = false;
+};
+
+class EventConnection::disconnect : public EventConnection::io
+{
+public:
+    disconnect(std::shared_ptr<impl> s) : io(s, std::chrono::seconds(1), false)
+    {}
+
+    virtual bool Resume(Wait& wait) override
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+
+        auto& session = state_->session;
+        auto& socket  = state_->socket;
+
+        if (!started_)
+        {
+            LOG_I("Disconnect");
+            started_ = true;
+
+            // see the comment in ConnectionImpl::disconnect
+            if (session->HasPending())
+                return close();
+
+            session->Quit();
+            session->SendNext();
+        }
+
+        // if no response then khtx bye whatever, we're done anyway
+        if (is_timeout())
+            return close();
+
+        const auto status = transact(buff_, temp_, wait, KB(1));
+        if (status == Status::Pending)
+            return false;
+        else if (status == Status::Failed)
+            return true;
+        else if (status == Status::Closed)
+            LOG_D("Received socket close");
+
+        return close();
+    }
+
+    virtual std::string describe() const override
+    {
+        return "Disconnect";
+    }
+private:
+    bool close()
+    {
+        state_->socket->Close();
+        LOG_D("Disconnect complete");
+        return true;
+    }
+private:
+    Buffer buff_;
+    Buffer temp_;
+    bool started_ = false;
+};
+
+class EventConnection::ping : public EventConnection::io
+{
+public:
+    ping(std::shared_ptr<impl> s) : io(s, std::chrono::seconds(4), false)
+    {}
+
+    virtual bool Resume(Wait& wait) override
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+
+        auto& session = state_->session;
+
+        if (is_timeout())
+        {
+            state_->pending_connection_error = Error::Timeout;
+            return true;
+        }
+
+        if (!started_)
+        {
+            LOG_D("Perform ping");
+            session->Ping();
+            started_ = true;
+        }
+
+        while (session->HasPending())
+        {
+            if (!command_sent_)
+            {
+                session->SendNext();
+                command_sent_ = true;
+            }
+            const auto status = transact(buff_, temp_, wait, KB(1));
+            if (status == Status::Pending)
+                return false;
+            else if (status == Status::Closed)
+            {
+                state_->pending_connection_error = Error::Network;
+                return true;
+            }
+            else if (status == Status::Failed)
+                return true;
+
+            command_sent_ = false;
+        }
+        return true;
+    }
+
+    virtual std::string describe() const override
+    {
+        return "Ping";
+    }
+private:
+    Buffer buff_;
+    Buffer temp_;
+    bool started_ = false;
+    bool command_sent_ = false;
+};
+
+std::unique_ptr<action> EventConnection::Connect(const HostDetails& host)
+{
+    auto act = ConnectionImpl::Connect(host);
+
+    state_->event_driven = true;
+
+    return act;
+}
+
+std::unique_ptr<action> EventConnection::Disconnect()
+{
+    std::unique_ptr<action> a(new class disconnect(state_));
+
+    return a;
+}
+
+std::unique_ptr<action> EventConnection::Ping()
+{
+    std::unique_ptr<action> a(new class ping(state_));
+
+    return a;
+}
+
+std::unique_ptr<action> EventConnection::Complete(std::unique_ptr<action> a)
+{
+    std::unique_ptr<action> next;
+
+    if (map_pending_error())
+        return next;
+
+    auto* ptr = a.get();
+
+    if (dynamic_cast<resolve*>(ptr))
+    {
+        next.reset(new class connect(state_));
+        state_->state = State::Connecting;
+    }
+    else if (dynamic_cast<class connect*>(ptr))
+    {
+        next.reset(new class initialize(state_));
+        state_->state = State::Initializing;
+    }
+    else if (dynamic_cast<class initialize*>(ptr))
+    {
+        state_->state = State::Connected;
+    }
+    else if (dynamic_cast<class disconnect*>(ptr))
+    {
+        state_->state = State::Disconnected;
+    }
+    else if (auto* p = dynamic_cast<class execute*>(ptr))
+    {
+        if (const auto* sample = p->GetSample())
+            state_->pipeline.Update(*sample);
+        state_->state = State::Connected;
+    }
+    return next;
+}
+
+std::unique_ptr<action> EventConnection::Execute(std::shared_ptr<CmdList> cmd)
+{
+    state_->cancel->ResetSignal();
+
+    std::unique_ptr<action> act(new class execute(state_, std::move(cmd)));
+
+    state_->state = State::Active;
+
+    return act;
+}
+
 } // newsflash
@@ -29,6 +29,7 @@
 
 #include <cstdint>
 #include "action.h"
+#include "pipeline.h"
 
 namespace newsflash
 {
@@ -117,6 +118,14 @@ namespace newsflash
         // get the current error when state indicates an error
         virtual Error GetError() const = 0;
 
+        // get the amount of work the connection wants in the next cmdlist.
+        virtual PipelineDepth GetPipelineDepth() const
+        { return PipelineDepth(); }
+
+        // get the measured command round trip time in milliseconds.
+        virtual std::uint32_t GetLatencyMs() const
+        { return 0; }
+
         struct CmdListCompletionData {
             std::shared_ptr<CmdList> cmds;
             std::uint64_t total_bytes = 0;
@@ -178,24 +187,70 @@ namespace newsflash
         // get the current error when state indicates an error
         virtual Error GetError() const override;
 
+        // get the pipeline depth adapted to the measured latency
+        // and throughput of the executed cmdlists.
+        virtual PipelineDepth GetPipelineDepth() const override;
+
+        // get the measured command round trip time in milliseconds.
+        virtual std::uint32_t GetLatencyMs() const override;
+
         // set the callback to be invoked when an action
         // to download a cmdlist has been completed.
         void SetCallback(const OnCmdlistDone& callback) override;
 
-    private:
+    protected:
+        // map the pending errors from the last action to the connection
+        // state and error. returns true if there was an error.
+        bool map_pending_error();
+
+    protected:
         struct impl;
         class resolve;
+
+    private:
         class connect;
         class initialize;
         class execute;
         class disconnect;
         class ping;
 
-    private:
+    protected:
         std::shared_ptr<impl> state_;
 
     };
 
+    // EventConnection does the same as the ConnectionImpl but without
+    // blocking on the sockets. Except for resolving the host all of its
+    // actions are IoActions (see reactor.h) so that the engine can run them
+    // on the reactor and serve all the connections with a few threads
+    // instead of needing a thread per connection.
+    class EventConnection : public ConnectionImpl
+    {
+    public:
+        // begin connecting to the given host specification.
+        virtual std::unique_ptr<action> Connect(const HostDetails& host) override;
+
+        // perform disconnect from the host.
+        virtual std::unique_ptr<action> Disconnect() override;
+
+        // perform ping
+        virtual std::unique_ptr<action> Ping() override;
+
+        // complete the given action. returns a new action if any.
+        virtual std::unique_ptr<action> Complete(std::unique_ptr<action> a) override;
+
+        // execute the given cmdlist
+        virtual std::unique_ptr<action> Execute(std::shared_ptr<CmdList> cmd) override;
+
+    private:
+        class io;
+        class connect;
+        class initialize;
+        class execute;
+        class disconnect;
+        class ping;
+    };
+
 } // newsflash
 
 
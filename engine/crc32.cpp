@@ -0,0 +1,300 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#  define CRC_X86
+#  include <emmintrin.h>
+#  include <smmintrin.h>
+#  include <wmmintrin.h>
+#endif
+
+#if defined(CRC_X86) && (defined(__GCC__) || defined(__CLANG__))
+#  define CRC_TARGET(x) __attribute__((target(x)))
+#else
+#  define CRC_TARGET(x)
+#endif
+
+#include <cstring>
+
+#include "crc32.h"
+#include "platform.h"
+
+namespace {
+
+// reversed polynomial
+const std::uint32_t Polynomial = 0xedb88320;
+
+struct SliceTable {
+    std::uint32_t table[8][256];
+
+    SliceTable()
+    {
+        for (std::uint32_t i=0; i<256; ++i)
+        {
+            std::uint32_t crc = i;
+            for (int j=0; j<8; ++j)
+                crc = (crc >> 1) ^ (Polynomial & (0 - (crc & 1)));
+            table[0][i] = crc;
+        }
+        for (std::uint32_t i=0; i<256; ++i)
+        {
+            for (int j=1; j<8; ++j)
+                table[j][i] = (table[j-1][i] >> 8) ^ table[0][table[j-1][i] & 0xff];
+        }
+    }
+};
+
+const SliceTable& GetSliceTable()
+{
+    static const SliceTable table;
+    return table;
+}
+
+// the crc here is the internal (inverted) state.
+std::uint32_t slice8(std::uint32_t crc, const unsigned char* buf, std::size_t len)
+{
+    const auto& t = GetSliceTable().table;
+
+    while (len && (reinterpret_cast<std::uintptr_t>(buf) & 7))
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *buf++) & 0xff];
+        --len;
+    }
+    while (len >= 8)
+    {
+        // little endian is assumed here.
+        std::uint32_t one;
+        std::uint32_t two;
+        std::memcpy(&one, buf, 4);
+        std::memcpy(&two, buf + 4, 4);
+        one ^= crc;
+        crc = t[7][ one        & 0xff] ^
+              t[6][(one >> 8)  & 0xff] ^
+              t[5][(one >> 16) & 0xff] ^
+              t[4][ one >> 24        ] ^
+              t[3][ two        & 0xff] ^
+              t[2][(two >> 8)  & 0xff] ^
+              t[1][(two >> 16) & 0xff] ^
+              t[0][ two >> 24        ];
+        buf += 8;
+        len -= 8;
+    }
+    while (len--)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *buf++) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(CRC_X86)
+
+// Fold 64 bytes at a time with carry-less multiplication and then
+// reduce with Barrett reduction.
+// See Intel's "Fast CRC Computation for Generic Polynomials Using
+// PCLMULQDQ Instruction". The constants are for the reflected CRC32 polynomial.
+// Requires len >= 64 and a multiple of 16.
+// the crc here is the internal (inverted) state.
+CRC_TARGET("pclmul,sse4.1")
+std::uint32_t fold_pclmul(std::uint32_t crc, const unsigned char* buf, std::size_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x00));
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x10));
+    x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x20));
+    x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    x0 = k1k2;
+
+    buf += 64;
+    len -= 64;
+
+    // fold 4 x 128 bits in parallel
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x00));
+        y6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x10));
+        y7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x20));
+        y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    // fold into 128 bits
+    x0 = k3k4;
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // fold the remaining 128 bit blocks
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    // fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = k5k0;
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduce to 32 bits
+    x0 = poly;
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<std::uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+#endif // CRC_X86
+
+// multiply a and b modulo the polynomial. (a and b are reflected)
+std::uint32_t multmodp(std::uint32_t a, std::uint32_t b)
+{
+    std::uint32_t m = 1u << 31;
+    std::uint32_t p = 0;
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ Polynomial : b >> 1;
+    }
+    return p;
+}
+
+struct PowerTable {
+    // x^2^n modulo the polynomial
+    std::uint32_t table[32];
+
+    PowerTable()
+    {
+        std::uint32_t p = 1u << 30; // x^1
+        table[0] = p;
+        for (int n=1; n<32; ++n)
+            table[n] = p = multmodp(p, p);
+    }
+};
+
+// return x^(n * 2^k) modulo the polynomial
+std::uint32_t x2nmodp(std::uint64_t n, unsigned k)
+{
+    static const PowerTable powers;
+
+    std::uint32_t p = 1u << 31; // x^0 == 1
+    while (n)
+    {
+        if (n & 1)
+            p = multmodp(powers.table[k & 31], p);
+        n >>= 1;
+        k++;
+    }
+    return p;
+}
+
+} // namespace
+
+namespace newsflash
+{
+
+std::uint32_t crc32(std::uint32_t crc, const void* data, std::size_t len)
+{
+    const auto* buf = static_cast<const unsigned char*>(data);
+
+    crc = ~crc;
+#if defined(CRC_X86)
+    static const bool pclmul = get_cpu_features().pclmul && get_cpu_features().sse41;
+    if (pclmul && len >= 64)
+    {
+        const auto chunk = len & ~std::size_t(15);
+        crc  = fold_pclmul(crc, buf, chunk);
+        buf += chunk;
+        len -= chunk;
+    }
+#endif
+    crc = slice8(crc, buf, len);
+    return ~crc;
+}
+
+std::uint32_t crc32_slice8(std::uint32_t crc, const void* data, std::size_t len)
+{
+    return ~slice8(~crc, static_cast<const unsigned char*>(data), len);
+}
+
+std::uint32_t crc32_combine(std::uint32_t crc1, std::uint32_t crc2, std::uint64_t len2)
+{
+    return multmodp(x2nmodp(len2, 3), crc1) ^ crc2;
+}
+
+} // newsflash
@@ -0,0 +1,46 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "newsflash/config.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC32 (the ISO-HDLC/zlib/yEnc variant) computation.
+// The values are the same as with boost::crc_32_type.
+
+namespace newsflash
+{
+    // Update the running crc with len bytes of data and return the new crc.
+    // The initial crc value should be 0. Uses PCLMULQDQ folding when
+    // the CPU supports it and slicing-by-8 otherwise.
+    std::uint32_t crc32(std::uint32_t crc, const void* data, std::size_t len);
+
+    // Same as above but never use the PCLMUL implementation.
+    std::uint32_t crc32_slice8(std::uint32_t crc, const void* data, std::size_t len);
+
+    // Combine the crcs of two consecutive blocks of data into the crc
+    // of the concatenated data. crc1 is the crc of the first block
+    // and crc2 is the crc of the second block which is len2 bytes long.
+    std::uint32_t crc32_combine(std::uint32_t crc1, std::uint32_t crc2, std::uint64_t len2);
+
+} // newsflash
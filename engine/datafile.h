@@ -24,13 +24,17 @@
 
 #include <string>
 #include <mutex>
+#include <condition_variable>
 #include <vector>
+#include <map>
 #include <functional>
 
 #include "assert.h"
 #include "bigfile.h"
+#include "ioring.h"
 #include "action.h"
 #include "filesys.h"
+#include "utility.h"
 
 namespace newsflash
 {
@@ -40,17 +44,19 @@ namespace newsflash
         DataFile(const std::string& filepath,
                  const std::string& filename,
                  const std::string& dataname,
-                 bool is_binary)
+                 bool is_binary,
+                 IoRing* ring = nullptr)
         {
-            impl_ = std::make_shared<Impl>(filepath, filename,  dataname, is_binary);
+            impl_ = std::make_shared<Impl>(filepath, filename,  dataname, is_binary, ring);
         }
         DataFile(const std::string& path,
                  const std::string& binaryname,
                  std::size_t size,
                  bool is_binary,
-                 bool overwrite)
+                 bool overwrite,
+                 IoRing* ring = nullptr)
         {
-            impl_ = std::make_shared<Impl>(path, binaryname, size, is_binary, overwrite);
+            impl_ = std::make_shared<Impl>(path, binaryname, size, is_binary, overwrite, ring);
         }
         void Close()
         {
@@ -64,13 +70,18 @@ namespace newsflash
 
         using OnWriteDone = std::function<void (const WriteComplete&)>;
 
-        std::unique_ptr<action> Write(std::size_t offset, const std::vector<char>& data,
+        std::unique_ptr<action> Write(std::size_t offset, std::vector<char> data,
             const OnWriteDone& callback = OnWriteDone())
         {
             // note that there's a little hack here and the offset is offset by +1
             // so that we're using 0 for indicating that offset is not being used at all.
-            auto write = std::make_unique<WriteOp>(offset, data, impl_);
-            write->set_affinity(action::affinity::single_thread);
+            auto write = std::make_unique<WriteOp>(offset, std::move(data), impl_);
+            // the writes without an offset append to the file so they
+            // must be performed in order. the writes with an offset
+            // go through the reorder buffer and can run on any thread.
+            write->set_affinity(offset ?
+                action::affinity::any_thread :
+                action::affinity::single_thread);
             write->set_callback(callback);
             impl_->AddPendingWrite();
             return std::move(write);
@@ -91,18 +102,35 @@ namespace newsflash
         bool IsOpen() const
         { return impl_->IsOpen(); }
 
+        // the maximum number of bytes of out of order data
+        // kept in memory per file before it's written out anyway.
+        static std::size_t MaxReorderBytes()
+        { return MB(32); }
+
     private:
-        class Impl
+        // Impl keeps the written segments in a reorder buffer and writes
+        // them out as contiguous extents. a segment that continues where
+        // the previous extent ended is written immediately (together with
+        // any buffered segments that follow it) so that the file is written
+        // sequentially even when the segments arrive out of order from many
+        // connections. the segments that leave a gap are kept until the gap
+        // is filled, the buffer grows too big or the file is closed.
+        // when an IoRing is given the extents are queued to the ring and the
+        // writer returns without waiting for the kernel. closing the file
+        // then waits for the queued writes and a linked fdatasync to complete.
+        class Impl : public std::enable_shared_from_this<Impl>
         {
         public:
             Impl(const std::string& filepath,
                  const std::string& filename,
                  const std::string& dataname,
-                 bool is_binary)
+                 bool is_binary,
+                 IoRing* ring)
             : filepath_(filepath)
             , filename_(filename)
             , dataname_(dataname)
             , binary_(is_binary)
+            , ring_(ring)
             {
                 file_.open(fs::joinpath(filepath_, filename_));
             }
@@ -110,8 +138,10 @@ namespace newsflash
                  const std::string& binaryname,
                  std::size_t size,
                  bool is_binary,
-                 bool overwrite)
+                 bool overwrite,
+                 IoRing* ring)
             : binary_(is_binary)
+            , ring_(ring)
             {
                 std::string file;
                 std::string name;
@@ -128,11 +158,7 @@ namespace newsflash
                     // todo: there's a race condition between the call to exists and the open below.
                     file_.open(file, bigfile::o_create | bigfile::o_truncate);
                     if (size)
-                    {
-                        const auto error = bigfile::resize(file, size);
-                        if (error)
-                            throw std::system_error(error, "error resizing file: " + file);
-                    }
+                        file_.allocate(size);
                     break;
                 }
                 if (!file_.is_open())
@@ -144,7 +170,12 @@ namespace newsflash
             }
            ~Impl()
             {
-                Close();
+                // the queued writes keep the object alive so there's
+                // nothing in the ring anymore and the file is closed
+                // synchronously.
+                std::unique_lock<std::mutex> lock(mutex_);
+                ring_ = nullptr;
+                Close(lock);
             }
             void AddPendingWrite()
             {
@@ -154,9 +185,9 @@ namespace newsflash
 
             void CloseWhenPossible()
             {
-                std::lock_guard<std::mutex> lock(mutex_);
+                std::unique_lock<std::mutex> lock(mutex_);
 
-                if (!file_.is_open())
+                if (!file_.is_open() || closing_)
                     return;
 
                 if (num_writes_)
@@ -164,33 +195,75 @@ namespace newsflash
                     close_on_last_write_ = true;
                     return;
                 }
-                Close();
+                Close(lock);
 
             }
-            void Write(std::size_t offset, const std::vector<char>& data)
+            void Write(std::size_t offset, std::vector<char>&& data)
             {
-                std::lock_guard<std::mutex> lock(mutex_);
-
-                if (!discard_)
+                Extents extents;
                 {
-                    // see the comment in the constructor about the offset value
-                    if (offset)
-                        file_.seek(offset - 1);
-                    file_.write(&data[0], data.size());
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!discard_ && !data.empty())
+                    {
+                        // see the comment in the constructor about the offset value.
+                        // without an offset the data goes where the previous write ended.
+                        const std::uint64_t pos = offset ? offset - 1 : position_;
+                        position_ = pos + data.size();
+
+                        auto& segment = segments_[pos];
+                        segment_bytes_ -= segment.size();
+                        segment_bytes_ += data.size();
+                        segment = std::move(data);
+
+                        TakeExtents(extents);
+                    }
                 }
+
+                // perform the actual IO without holding the lock so that
+                // writes to the other parts of the file can proceed.
+                if (ring_)
+                    SubmitExtents(std::move(extents), false);
+                else WriteExtents(extents);
+
+                std::unique_lock<std::mutex> lock(mutex_);
                 ASSERT(num_writes_);
 
                 if (--num_writes_ == 0 && close_on_last_write_)
                 {
-                    Close();
+                    Close(lock);
                 }
+                // a queued write has failed.
+                if (error_)
+                    throw std::system_error(error_, "file write failed");
             }
 
-            void Close()
+            void Close(std::unique_lock<std::mutex>& lock)
             {
-                if (!file_.is_open())
+                if (!file_.is_open() || closing_)
                     return;
 
+                closing_ = true;
+
+                Extents extents;
+                if (!discard_)
+                    TakeAllExtents(extents);
+                segments_.clear();
+                segment_bytes_ = 0;
+
+                if (ring_)
+                {
+                    // the sync is linked after the last writes and waits
+                    // for the writes queued earlier. the lock must be released
+                    // since the completion callbacks need it.
+                    lock.unlock();
+                    SubmitExtents(std::move(extents), !discard_);
+                    lock.lock();
+                    cond_.wait(lock, [&]() {
+                        return inflight_ == 0;
+                    });
+                }
+                else WriteExtents(extents);
+
                 finalsize_ = file_.size();
                 file_.close();
                 if (discard_)
@@ -220,6 +293,153 @@ namespace newsflash
 
             bool IsOpen() const
             { return file_.is_open(); }
+        private:
+            // a contiguous run of segments starting at the offset.
+            struct Extent {
+                std::uint64_t offset = 0;
+                std::vector<std::vector<char>> segments;
+            };
+            using Extents = std::vector<Extent>;
+
+            // take the extent starting at the given segment out of the reorder buffer.
+            // returns the end offset of the extent.
+            std::uint64_t TakeExtent(std::map<std::uint64_t, std::vector<char>>::iterator it, Extents& extents)
+            {
+                Extent extent;
+                extent.offset = it->first;
+
+                auto end = it->first;
+                while (it != segments_.end() && it->first == end)
+                {
+                    end += it->second.size();
+                    segment_bytes_ -= it->second.size();
+                    extent.segments.push_back(std::move(it->second));
+                    it = segments_.erase(it);
+                }
+                extents.push_back(std::move(extent));
+                return end;
+            }
+
+            void TakeExtents(Extents& extents)
+            {
+                // the data continuing from the end of the previous
+                // extent can be written sequentially right away.
+                auto it = segments_.find(cursor_);
+                if (it != segments_.end())
+                    cursor_ = TakeExtent(it, extents);
+
+                // too much out of order data. write out the lowest
+                // extents until the buffer is down to half.
+                if (segment_bytes_ > MaxReorderBytes())
+                {
+                    while (segment_bytes_ > MaxReorderBytes() / 2)
+                        cursor_ = TakeExtent(segments_.begin(), extents);
+                }
+            }
+
+            void TakeAllExtents(Extents& extents)
+            {
+                while (!segments_.empty())
+                    cursor_ = TakeExtent(segments_.begin(), extents);
+            }
+
+            // queue the extents to the ring. the extents are kept alive until
+            // the ring has completed the writes. an extent longer than what
+            // fits in a single write is split and the writes are split
+            // into chains that fit in the ring.
+            void SubmitExtents(Extents&& extents, bool sync)
+            {
+                if (extents.empty() && !sync)
+                    return;
+
+                auto data = std::make_shared<Extents>(std::move(extents));
+
+                std::vector<bigfile::iobuf> bufs;
+                std::vector<IoRing::Write> writes;
+                std::uint64_t end = 0;
+                for (const auto& extent : *data)
+                {
+                    auto offset = extent.offset;
+                    for (const auto& segment : extent.segments)
+                    {
+                        bufs.push_back({segment.data(), segment.size()});
+                        // continue the previous write when possible.
+                        if (!writes.empty() && end == offset &&
+                            writes.back().count < IoRing::GetMaxBuffers())
+                        {
+                            writes.back().count++;
+                        }
+                        else
+                        {
+                            IoRing::Write write;
+                            write.offset = offset;
+                            write.count  = 1;
+                            writes.push_back(write);
+                        }
+                        offset += segment.size();
+                        end = offset;
+                    }
+                }
+                // the bufs vector doesn't move anymore.
+                std::size_t first = 0;
+                for (auto& write : writes)
+                {
+                    write.bufs = &bufs[first];
+                    first += write.count;
+                }
+
+                const auto max_writes = ring_->GetMaxChain() - 1;
+                std::size_t next = 0;
+                do
+                {
+                    const auto count = std::min(max_writes, writes.size() - next);
+                    // only the last chain syncs, after all the others.
+                    const auto last  = next + count == writes.size();
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        ++inflight_;
+                    }
+                    auto self = shared_from_this();
+                    try
+                    {
+                        ring_->Submit(file_, writes.data() + next, count, sync && last,
+                            [self, data](const std::error_code& error) {
+                                self->WriteDone(error);
+                            });
+                    }
+                    catch (const std::exception&)
+                    {
+                        WriteDone(std::error_code());
+                        throw;
+                    }
+                    next += count;
+                }
+                while (next < writes.size());
+            }
+
+            void WriteDone(const std::error_code& error)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (error && !error_)
+                    error_ = error;
+                ASSERT(inflight_);
+                if (--inflight_ == 0)
+                    cond_.notify_all();
+            }
+
+            void WriteExtents(const Extents& extents)
+            {
+                std::vector<bigfile::iobuf> bufs;
+                for (const auto& extent : extents)
+                {
+                    bufs.clear();
+                    for (const auto& segment : extent.segments)
+                        bufs.push_back({segment.data(), segment.size()});
+                    file_.write(extent.offset, bufs.data(), bufs.size());
+                }
+            }
+
         private:
             std::mutex mutex_;
             std::size_t num_writes_ = 0;
@@ -230,7 +450,24 @@ namespace newsflash
             bool binary_ = false;
             bool discard_ = false;
             bool close_on_last_write_ = false;
+            bool closing_ = false;
             bigfile file_;
+            // the ring for queueing the writes or nullptr
+            // for writing synchronously.
+            IoRing* ring_ = nullptr;
+            // the number of chains queued to the ring that haven't completed.
+            std::size_t inflight_ = 0;
+            std::condition_variable cond_;
+            // the first error of a queued write.
+            std::error_code error_;
+            // the reorder buffer of segments keyed by file offset.
+            std::map<std::uint64_t, std::vector<char>> segments_;
+            std::uint64_t segment_bytes_ = 0;
+            // where the last write ended. this is where
+            // the writes without an offset go.
+            std::uint64_t position_ = 0;
+            // where the last extent written to the file ended.
+            std::uint64_t cursor_ = 0;
         };
 
         class WriteOp : public action
@@ -239,15 +476,16 @@ namespace newsflash
             // note that there's a little hack here and the offset is offset by +1
             // so that we're using 0 for indicating that offset is not being used at all.
             WriteOp(std::size_t offset,
-                const std::vector<char>& data, std::shared_ptr<Impl> impl)
+                std::vector<char> data, std::shared_ptr<Impl> impl)
             : impl_(impl)
-            , data_(data)
+            , data_(std::move(data))
+            , size_(data_.size())
             , offset_(offset)
             {}
 
             virtual void xperform() override
             {
-                impl_->Write(offset_, data_);
+                impl_->Write(offset_, std::move(data_));
             }
             virtual std::string describe() const override
             { return "DataFile::WriteOp"; }
@@ -257,7 +495,7 @@ namespace newsflash
                 if (callback_)
                 {
                     WriteComplete completion;
-                    completion.size = data_.size();
+                    completion.size = size_;
                     completion.offset = offset_;
                     callback_(completion);
                 }
@@ -268,6 +506,7 @@ namespace newsflash
         private:
             std::shared_ptr<Impl> impl_;
             std::vector<char> data_;
+            std::size_t size_ = 0;
             std::size_t offset_ = 0;
             OnWriteDone callback_;
         };
@@ -20,10 +20,6 @@
 
 #include "newsflash/config.h"
 
-#include "newsflash/warnpush.h"
-#  include <boost/crc.hpp>
-#include "newsflash/warnpop.h"
-
 #include "decode.h"
 #include "linebuffer.h"
 #include "bodyiter.h"
@@ -75,7 +71,12 @@ void DecodeJob::xperform()
     // for example uuencoded images embedded in a text.
     newsflash::encoding enc = newsflash::encoding::unknown;
 
-    nntp::linebuffer lines(data_.Content(), data_.GetContentLength());
+    // take the input buffer so that it's returned to the
+    // buffer pool as soon as the decoding is done instead of
+    // when this job is eventually destroyed.
+    const Buffer data(std::move(data_));
+
+    nntp::linebuffer lines(data.Content(), data.GetContentLength());
     nntp::linebuffer::iterator beg = lines.begin();
     nntp::linebuffer::iterator end = lines.end();
 
@@ -97,8 +98,8 @@ void DecodeJob::xperform()
     }
 
     std::size_t consumed = 0;
-    const auto dataptr = data_.Content() + binary_start_offset;
-    const auto datalen = data_.GetContentLength() - binary_start_offset;
+    const auto dataptr = data.Content() + binary_start_offset;
+    const auto datalen = data.GetContentLength() - binary_start_offset;
 
     std::stringstream ss;
     ss << "\r\n";
@@ -147,7 +148,7 @@ void DecodeJob::xperform()
     std::copy(std::begin(s), std::end(s), std::back_inserter(text_));
 
     const auto textptr = dataptr + consumed;
-    const auto textend = data_.Content() + data_.GetContentLength();
+    const auto textend = data.Content() + data.GetContentLength();
     std::copy(textptr, textend, std::back_inserter(text_));
 }
 
@@ -160,9 +161,14 @@ std::size_t DecodeJob::decode_yenc_single(const char* data, std::size_t len)
     if (!header.first)
         throw Exception("broken or missing yenc header");
 
+    // the crc is computed while decoding.
     std::vector<char> buff;
-    buff.reserve(header.second.size);
-    yenc::decode(beg, end, std::back_inserter(buff));
+    buff.resize(len - beg.position());
+    std::size_t written = 0;
+    std::uint32_t crc   = 0;
+    const auto pos = yenc::decode_buffer_crc(data, beg.position(), len, buff.data(), written, crc);
+    buff.resize(written);
+    beg = nntp::bodyiter(data, pos, len);
 
     const auto footer = yenc::parse_footer(beg, end);
     if (!footer.first)
@@ -178,11 +184,13 @@ std::size_t DecodeJob::decode_yenc_single(const char* data, std::size_t len)
     flags_.set(Flags::HasOffset, false);
     encoding_ = Encoding::yEnc;
 
+    binary_crc32_ = crc;
     if (footer.second.crc32)
     {
-        boost::crc_32_type crc;
-        crc.process_bytes(binary_.data(), binary_.size());
-        if (footer.second.crc32 != crc.checksum())
+        file_crc32_ = footer.second.crc32;
+        flags_.set(Flags::HasFileCrc32, true);
+
+        if (footer.second.crc32 != crc)
             errors_.set(Error::CrcMismatch);
 
         if (footer.second.size != header.second.size)
@@ -210,9 +218,14 @@ std::size_t DecodeJob::decode_yenc_multi(const char* data, std::size_t len)
     const auto offset = part.second.begin - 1;
     const auto size = part.second.end - offset;
 
+    // the crc is computed while decoding.
     std::vector<char> buff;
-    buff.reserve(size);
-    yenc::decode(beg, end, std::back_inserter(buff));
+    buff.resize(len - beg.position());
+    std::size_t written = 0;
+    std::uint32_t crc   = 0;
+    const auto pos = yenc::decode_buffer_crc(data, beg.position(), len, buff.data(), written, crc);
+    buff.resize(written);
+    beg = nntp::bodyiter(data, pos, len);
 
     const auto footer = yenc::parse_footer(beg, end);
     if (!footer.first)
@@ -228,12 +241,19 @@ std::size_t DecodeJob::decode_yenc_multi(const char* data, std::size_t len)
     flags_.set(Flags::HasOffset, true);
     encoding_ = Encoding::yEnc;
 
-    if (footer.second.pcrc32)
+    binary_crc32_ = crc;
+
+    // the crc32 of the whole file is typically only in the
+    // footer of the last part.
+    if (footer.second.crc32)
     {
-        boost::crc_32_type crc;
-        crc.process_bytes(binary_.data(), binary_.size());
+        file_crc32_ = footer.second.crc32;
+        flags_.set(Flags::HasFileCrc32, true);
+    }
 
-        if (footer.second.pcrc32 != crc.checksum())
+    if (footer.second.pcrc32)
+    {
+        if (footer.second.pcrc32 != crc)
             errors_.set(Error::CrcMismatch);
 
         if (size != binary_.size())
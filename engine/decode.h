@@ -22,6 +22,7 @@
 
 #include "newsflash/config.h"
 
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -127,6 +128,20 @@ namespace newsflash
         bool HasOffset() const
         { return flags_.test(Flags::HasOffset); }
 
+        // get the CRC32 of the decoded binary data. only
+        // computed for yEnc.
+        std::uint32_t GetBinaryCrc32() const
+        { return binary_crc32_; }
+
+        // returns true if the encoding specified a crc32 for the whole binary.
+        // with multipart yEnc this is typically only in the last part.
+        bool HasFileCrc32() const
+        { return flags_.test(Flags::HasFileCrc32); }
+
+        // get the crc32 of the whole binary. see HasFileCrc32
+        std::uint32_t GetFileCrc32() const
+        { return file_crc32_; }
+
     private:
         virtual void xperform() override;
         std::size_t decode_yenc_single(const char* data, std::size_t len);
@@ -140,6 +155,8 @@ namespace newsflash
         std::vector<char> binary_;
         std::size_t binary_offset_ = 0;
         std::size_t binary_size_   = 0;
+        std::uint32_t binary_crc32_ = 0;
+        std::uint32_t file_crc32_   = 0;
         std::string binary_name_;
     private:
         Encoding encoding_ = Encoding::Unknown;
@@ -148,7 +165,8 @@ namespace newsflash
             Multipart,
             FirstPart,
             LastPart,
-            HasOffset
+            HasOffset,
+            HasFileCrc32
         };
         bitflag<Flags> flags_;
         bitflag<Error> errors_;
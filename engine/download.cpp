@@ -40,6 +40,7 @@
 #include "format.h"
 #include "datafile.h"
 #include "cmdlist.h"
+#include "crc32.h"
 
 namespace newsflash
 {
@@ -63,18 +64,17 @@ Download::Download(
 Download::Download()
 {}
 
-std::shared_ptr<CmdList> Download::CreateCommands()
+std::shared_ptr<CmdList> Download::CreateCommands(const PipelineDepth& depth)
 {
     if (articles_.empty())
         return nullptr;
 
-    // take the next list of articles to be downloaded
-    // if each article is about half a meg then this is
-    // about 5 megs. if we're running on a 50mbit/s LAN
-    // at full throttle it will take about a second to download
-    //const std::size_t num_articles_per_cmdlist = 10;
-
-    const std::size_t num_articles_per_cmdlist = 10;
+    // take the next list of articles to be downloaded.
+    // the connection adjusts the number of articles based on the
+    // latency and the throughput so that the pipeline stays full.
+    // by default it's 10, if each article is about half a meg then
+    // this is about 5 megs.
+    const std::size_t num_articles_per_cmdlist = depth.num_articles;
     const std::size_t num_articles = std::min(articles_.size(),
         num_articles_per_cmdlist);
 
@@ -171,6 +171,23 @@ void Download::Complete(action& act, std::vector<std::unique_ptr<action>>& next)
             if (dec->IsMultipart() && ignore_yenc_filename_)
                 name = name_;
 
+            if (dec->IsMultipart())
+            {
+                auto& crc = crcs_[name];
+                crc.size = size;
+                PartCrc part;
+                part.offset = dec->GetBinaryOffset();
+                part.size   = binary.size();
+                part.crc32  = dec->GetBinaryCrc32();
+                crc.parts.push_back(part);
+                if (dec->HasFileCrc32())
+                {
+                    crc.crc32 = dec->GetFileCrc32();
+                    crc.has_crc32 = true;
+                }
+                verify_crc(crc);
+            }
+
             std::shared_ptr<DataFile> file = create_file(name, size);
             std::unique_ptr<action> write  = file->Write(offset, std::move(binary), callback_);
             next.push_back(std::move(write));
@@ -363,6 +380,26 @@ void Download::Pack(std::string* data) const
         json_s["data"] = base64;
         json["stashes"].push_back(json_s);
     }
+
+    for (const auto& pair : crcs_)
+    {
+        const auto& crc = pair.second;
+        nlohmann::json json_c;
+        json_c["name"] = pair.first;
+        json_c["size"] = crc.size;
+        json_c["crc32"] = crc.crc32;
+        json_c["has_crc32"] = crc.has_crc32;
+        json_c["verified"] = crc.verified;
+        for (const auto& part : crc.parts)
+        {
+            nlohmann::json json_p;
+            json_p["offset"] = part.offset;
+            json_p["size"] = part.size;
+            json_p["crc32"] = part.crc32;
+            json_c["parts"].push_back(json_p);
+        }
+        json["crcs"].push_back(json_c);
+    }
     *data = json.dump(2);
 }
 
@@ -421,6 +458,31 @@ void Download::Load(const std::string& data)
             stash_[sequence_number] = std::move(stash);
         }
     }
+
+    if (json.contains("crcs"))
+    {
+        for (const auto& json_c : json["crcs"].items())
+        {
+            const auto& value = json_c.value();
+            const std::string& name = value["name"];
+            auto& crc = crcs_[name];
+            crc.size = value["size"];
+            crc.crc32 = value["crc32"];
+            crc.has_crc32 = value["has_crc32"];
+            crc.verified = value["verified"];
+            if (!value.contains("parts"))
+                continue;
+            for (const auto& json_p : value["parts"].items())
+            {
+                const auto& value = json_p.value();
+                PartCrc part;
+                part.offset = value["offset"];
+                part.size   = value["size"];
+                part.crc32  = value["crc32"];
+                crc.parts.push_back(part);
+            }
+        }
+    }
 }
 
 std::shared_ptr<DataFile> Download::create_file(const std::string& name, std::size_t assumed_size)
@@ -447,5 +509,36 @@ std::shared_ptr<DataFile> Download::create_file(const std::string& name, std::si
     return file;
 }
 
+void Download::verify_crc(FileCrc& file)
+{
+    if (!file.has_crc32 || file.verified)
+        return;
+
+    std::sort(std::begin(file.parts), std::end(file.parts),
+        [](const PartCrc& lhs, const PartCrc& rhs) {
+            return lhs.offset < rhs.offset;
+        });
+
+    // the parts must cover the whole file without gaps
+    // before the crc can be computed.
+    std::uint64_t offset = 0;
+    std::uint32_t crc32  = 0;
+    for (const auto& part : file.parts)
+    {
+        if (part.offset != offset)
+            return;
+        crc32 = crc32_combine(crc32, part.crc32, part.size);
+        offset += part.size;
+    }
+    if (offset != file.size)
+        return;
+
+    if (crc32 != file.crc32)
+        errors_.set(Task::Error::CrcMismatch);
+
+    file.verified = true;
+    file.parts.clear();
+}
+
 } // newsflash
 
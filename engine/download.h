@@ -22,6 +22,8 @@
 
 #include "newsflash/config.h"
 
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -55,7 +57,7 @@ namespace newsflash
         Download();
 
         // Task implementation
-        virtual std::shared_ptr<CmdList> CreateCommands() override;
+        virtual std::shared_ptr<CmdList> CreateCommands(const PipelineDepth& depth = PipelineDepth()) override;
         virtual void Cancel() override;
         virtual void Commit() override;
         virtual void Complete(action& act,
@@ -93,7 +95,24 @@ namespace newsflash
         { return files_[i].get(); }
 
     private:
+        // the crcs of the parts of a multipart yEnc binary. once all the parts
+        // have been decoded the part crcs are combined and compared to the crc of
+        // the whole file without having to read the file back from the disk.
+        struct PartCrc {
+            std::uint64_t offset = 0;
+            std::uint64_t size   = 0;
+            std::uint32_t crc32  = 0;
+        };
+        struct FileCrc {
+            std::vector<PartCrc> parts;
+            std::uint64_t size  = 0;
+            std::uint32_t crc32 = 0;
+            bool has_crc32 = false;
+            bool verified  = false;
+        };
+
         std::shared_ptr<DataFile> create_file(const std::string& name, std::size_t assumed_size);
+        void verify_crc(FileCrc& file);
 
     private:
         using stash = std::vector<char>;
@@ -102,6 +121,7 @@ namespace newsflash
         std::vector<std::string> articles_;
         std::vector<std::shared_ptr<DataFile>> files_;
         std::vector<std::unique_ptr<stash>> stash_;
+        std::map<std::string, FileCrc> crcs_;
         std::string path_;
         std::string name_;
         std::string stash_name_;
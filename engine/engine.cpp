@@ -27,10 +27,15 @@
 
 #include <algorithm>
 #include <numeric> // for accumulate
+#include <array>
 #include <deque>
 #include <mutex>
+#include <thread>
+#include <atomic>
 #include <fstream>
 #include <list>
+#include <set>
+#include <unordered_map>
 #include <cassert>
 #include <cstdlib> // for getenv
 
@@ -49,11 +54,16 @@
 #include "datafile.h"
 #include "listing.h"
 #include "update.h"
+#include "catalog.h"
 #include "throttle.h"
 #include "sslcontext.h"
 #include "encoding.h"
 #include "nntp.h"
 #include "utility.h"
+#include "bufferpool.h"
+#include "reactor.h"
+#include "mpscqueue.h"
+#include "event.h"
 
 namespace newsflash
 {
@@ -93,6 +103,9 @@ public:
 
     std::unique_ptr<Connection> AllocateConnection(const ui::Account& acc)
     {
+        if (acc.enable_event_loop && Reactor::IsSupported())
+            return std::make_unique<EventConnection>();
+
         return std::make_unique<ConnectionImpl>();
     }
     std::unique_ptr<ui::Result> MakeResult(const Task& task, const ui::TaskDesc& desc) const override
@@ -233,6 +246,32 @@ struct Engine::State {
 
     std::vector<ui::Account> accounts;
     std::list<std::shared_ptr<CmdList>> cmds;
+
+    // scheduling indices so that finding the work for an idle connection
+    // doesn't need to scan the whole task and connection lists.
+    // the ready queues contain the tasks per account that are in a runnable
+    // state ordered by their position in the task list. the tasks
+    // might not have commands right now, those are skipped when looking
+    // for the next task. the idle connections are validated lazily as well.
+    struct by_priority {
+        bool operator()(const TaskState* lhs, const TaskState* rhs) const;
+    };
+    using ready_queue = std::set<TaskState*, by_priority>;
+
+    std::unordered_map<std::size_t, TaskState*> task_index;
+    std::unordered_map<std::size_t, ConnState*> conn_index;
+    std::unordered_map<std::size_t, ready_queue> ready_tasks;
+    std::unordered_map<std::size_t, std::set<std::size_t>> idle_conns;
+    std::unordered_map<std::size_t, std::deque<std::shared_ptr<CmdList>>> pending_cmds;
+    std::unordered_map<std::size_t, std::size_t> num_cmds;
+    std::int64_t first_priority = 0;
+    std::int64_t last_priority  = 0;
+
+    // number of tasks in each task state per batch so that the batch
+    // state can be updated without going over the task list.
+    using task_counts = std::array<std::size_t, 7>;
+    std::unordered_map<std::size_t, task_counts> batch_tasks;
+
     std::uint64_t bytes_downloaded = 0;
     std::uint64_t bytes_queued = 0;
     std::uint64_t bytes_ready = 0;
@@ -245,9 +284,29 @@ struct Engine::State {
     std::unique_ptr<Logger> logger;
     std::unique_ptr<ConnTestState> current_connection_test;
 
-    std::mutex mutex;
-    std::queue<std::unique_ptr<action>> actions;
+    // the engine state is accessed by the client thread through the
+    // Engine API and by the engine thread (if any) when it processes
+    // the completed actions. recursive since the callbacks are allowed
+    // to call back into the engine when they're invoked synchronously.
+    std::recursive_mutex engine_mutex;
+
+    // completed actions. pushed by the thread pool and the reactor
+    // threads and consumed by whichever thread pumps the actions.
+    MpscQueue<std::unique_ptr<action>> actions;
+    std::atomic<bool> engine_notify_pending {false};
+
+    // callbacks deferred for the client thread when the completed
+    // actions are processed by the engine thread.
+    MpscQueue<std::function<void ()>> client_events;
+    std::atomic<bool> client_notify_pending {false};
+
+    std::unique_ptr<std::thread> engine_thread;
+    std::atomic<bool> engine_thread_running {false};
+    std::atomic<bool> engine_thread_quit {false};
+    Event engine_event;
+
     std::unique_ptr<ThreadPool> threads;
+    std::unique_ptr<Reactor> reactor;
     std::size_t num_pending_actions = 0;
     std::size_t num_pending_tasks = 0;
 
@@ -275,6 +334,11 @@ struct Engine::State {
 
     throttle ratecontrol;
 
+    // the per account throttles chained to the global ratecontrol.
+    // these are kept around until the engine is destroyed since the
+    // connections and their pending actions refer to them.
+    std::unordered_map<std::size_t, std::unique_ptr<throttle>> account_throttles;
+
     State(bool enable_single_thread_debug)
     {
         ratecontrol.set_quota(std::numeric_limits<std::size_t>::max());
@@ -289,16 +353,23 @@ struct Engine::State {
         {
             const auto max_pooled_threads  = std::size_t(4);
             threads.reset(new ThreadPool(max_pooled_threads));
-        }
-        threads->SetCallback(
-            [&](action* a)
+
+            // the event driven connections are all run
+            // by the reactor threads.
+            if (Reactor::IsSupported())
             {
-                std::lock_guard<std::mutex> lock(mutex);
-                actions.emplace(a);
-                if (on_notify_callback)
-                    on_notify_callback();
+                const auto max_reactor_threads = std::size_t(2);
+                reactor.reset(new Reactor(max_reactor_threads));
             }
-        );
+        }
+        const auto on_action_done = [&](action* a)
+        {
+            actions.Push(std::unique_ptr<action>(a));
+            notify_engine();
+        };
+        threads->SetCallback(on_action_done);
+        if (reactor)
+            reactor->SetCallback(on_action_done);
     }
 
    ~State()
@@ -320,6 +391,14 @@ struct Engine::State {
         return *it;
     }
 
+    throttle* find_account_throttle(std::size_t id)
+    {
+        auto& ret = account_throttles[id];
+        if (!ret)
+            ret.reset(new throttle(&ratecontrol));
+        return ret.get();
+    }
+
     void submit(action* a)
     {
         if (a->get_affinity() == action::affinity::gui_thread)
@@ -327,11 +406,16 @@ struct Engine::State {
             LOG_D("Action ", a->get_id(), " (", a->describe(),  ") perform by current thread.");
 
             a->perform();
-            std::lock_guard<std::mutex> lock(mutex);
-            actions.emplace(a);
-            on_notify_callback();
+            actions.Push(std::unique_ptr<action>(a));
+            notify_engine();
             quit_pump_loop = true;
         }
+        else if (a->get_affinity() == action::affinity::event_loop && reactor)
+        {
+            LOG_D("Action ", a->get_id(), " (", a->describe(), ") submitted to the reactor.");
+
+            reactor->Submit(static_cast<IoAction*>(a));
+        }
         else
         {
             LOG_D("Action ", a->get_id(), " (", a->describe(), ") submitted to the threadpool.");
@@ -349,11 +433,9 @@ struct Engine::State {
 
     std::unique_ptr<action> get_action()
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        if (actions.empty())
+        std::unique_ptr<action> act;
+        if (!actions.Pop(&act))
             return nullptr;
-        std::unique_ptr<action> act = std::move(actions.front());
-        actions.pop();
 
         LOG_D("Action ", act->get_id(), " (", act->describe(), ") is complete");
         LOG_D("Action ", act->get_id(), " has exception: ", act->has_exception());
@@ -361,11 +443,106 @@ struct Engine::State {
     }
 
 
+    // signal that there are completed actions to be processed.
+    // the notifications are coalesced so that there's at most one
+    // pending notification until the actions are pumped again.
+    // this can be called from any thread.
+    void notify_engine()
+    {
+        if (engine_notify_pending.exchange(true))
+            return;
+
+        if (engine_thread_running)
+            engine_event.SetSignal();
+        else if (on_notify_callback)
+            on_notify_callback();
+    }
+
+    // signal the client that there are deferred callbacks or
+    // that the pending actions are done. coalesced like notify_engine.
+    void notify_client()
+    {
+        if (client_notify_pending.exchange(true))
+            return;
+        if (on_notify_callback)
+            on_notify_callback();
+    }
+
+    // wrap a client callback so that when the engine thread is running
+    // the callback is deferred and invoked later by the client thread
+    // in Engine::Pump. the arguments are copied for the deferred call.
+    template<typename... Args>
+    std::function<void (Args...)> to_client(std::function<void (Args...)> callback)
+    {
+        if (!callback)
+            return callback;
+
+        return [this, callback](Args... args) {
+            if (!engine_thread_running)
+            {
+                callback(args...);
+                return;
+            }
+            client_events.Push(std::bind(callback, typename std::decay<Args>::type(args)...));
+            notify_client();
+        };
+    }
+
+    // run the deferred client callbacks.
+    void run_client_events()
+    {
+        client_notify_pending = false;
+
+        std::function<void ()> event;
+        while (client_events.Pop(&event))
+            event();
+    }
+
+    void run_engine_thread()
+    {
+        SetThreadLog(logger.get());
+
+        for (;;)
+        {
+            auto handle = engine_event.GetWaitHandle();
+            WaitForSingleHandle(handle);
+            if (engine_thread_quit)
+                break;
+
+            std::lock_guard<std::recursive_mutex> lock(engine_mutex);
+            engine_event.ResetSignal();
+
+            pump_actions();
+
+            // let the client know when all the actions are done,
+            // the client is waiting on this when shutting down.
+            if (num_pending_actions == 0)
+                notify_client();
+        }
+        SetThreadLog(nullptr);
+    }
+
     Engine::BatchState* find_batch(std::size_t id);
 
+    TaskState* find_task(std::size_t id);
+    ConnState* find_conn(std::size_t id);
+    TaskState* find_runnable_task(std::size_t account);
+
+    void add_task(std::unique_ptr<TaskState> task, bool front);
+    void remove_task(TaskState& task);
+    void update_ready(TaskState& task);
+    void update_task_state(TaskState& task, ui::TaskDesc::States previous);
+    void swap_task_order(TaskState& lhs, TaskState& rhs);
+    void reindex_task_order();
+
+    void add_cmdlist(std::shared_ptr<CmdList> cmdlist, bool pending);
+    void remove_cmdlist(const std::shared_ptr<CmdList>& cmdlist);
+    std::shared_ptr<CmdList> pop_pending_cmdlist(std::size_t account);
+
+    void pump_actions();
     void execute();
     void on_cmdlist_done(const Connection::CmdListCompletionData&);
-    void on_header_update_progress(const HeaderTask::Progress&, std::size_t account);
+    void on_header_update_progress(HeaderTask::Progress&, std::size_t account);
     void on_listing_update_progress(const Listing::Progress&, std::size_t account);
     void on_write_done(const ContentTask::WriteComplete&);
 };
@@ -377,7 +554,6 @@ private:
     ConnState(Engine::State& state, std::size_t cid)
     {
         logger_        = state.factory->AllocateConnectionLogger();
-        thread_        = state.threads->AllocatePrivateThread();
         ui_.error      = errors::None;
         ui_.state      = states::Disconnected;
         ui_.id         = cid;
@@ -385,9 +561,14 @@ private:
         ui_.account    = 0;
         ui_.down       = 0;
         ui_.bps        = 0;
+        ui_.pipeline   = 0;
+        ui_.xover_range = 0;
+        ui_.rtt        = 0;
         ui_.logfile    = logger_->GetName();
         ticks_to_ping_ = 30;
         ticks_to_conn_ = 5;
+        engine_        = &state;
+        engine_->conn_index[cid] = this;
         LOG_D("Connection ", ui_.id);
     }
 
@@ -400,7 +581,7 @@ public:
         const auto& acc = state.find_account(aid);
 
         Connection::HostDetails spec;
-        spec.pthrottle = &state.ratecontrol;
+        spec.pthrottle = state.find_account_throttle(aid);
         spec.password  = acc.password;
         spec.username  = acc.username;
         spec.enable_compression = acc.enable_compression;
@@ -430,6 +611,7 @@ public:
         conn_ = state.factory->AllocateConnection(acc);
         conn_->SetCallback(std::bind(&Engine::State::on_cmdlist_done, &state,
             std::placeholders::_1));
+        allocate_thread(state);
 
         do_action(state, conn_->Connect(spec));
 
@@ -448,7 +630,7 @@ public:
         const auto& acc = state.find_account(dna.ui_.account);
 
         Connection::HostDetails spec;
-        spec.pthrottle = &state.ratecontrol;
+        spec.pthrottle = state.find_account_throttle(dna.ui_.account);
         spec.password  = acc.password;
         spec.username  = acc.username;
         spec.enable_compression = acc.enable_compression;
@@ -460,6 +642,7 @@ public:
         conn_ = state.factory->AllocateConnection(acc);
         conn_->SetCallback(std::bind(&Engine::State::on_cmdlist_done, &state,
             std::placeholders::_1));
+        allocate_thread(state);
 
         do_action(state, conn_->Connect(spec));
 
@@ -468,6 +651,8 @@ public:
 
    ~ConnState()
     {
+        engine_->conn_index.erase(ui_.id);
+        engine_->idle_conns[ui_.account].erase(ui_.id);
         LOG_I("Connection ", ui_.id, " deleted");
     }
 
@@ -493,7 +678,7 @@ public:
 
             const auto& acc = state.find_account(ui_.account);
             Connection::HostDetails host;
-            host.pthrottle = &state.ratecontrol;
+            host.pthrottle = state.find_account_throttle(ui_.account);
             host.password = acc.password;
             host.username = acc.username;
             host.use_ssl  = ui_.secure;
@@ -539,7 +724,8 @@ public:
             do_action(state, conn_->Disconnect());
         }
 
-        state.threads->DetachPrivateThread(thread_);
+        if (thread_)
+            state.threads->DetachPrivateThread(thread_);
     }
 
     void Execute(Engine::State& state, std::shared_ptr<CmdList> cmds)
@@ -609,6 +795,11 @@ public:
 
         auto next  = conn_->Complete(std::move(act));
         auto state = conn_->GetState();
+
+        const auto& depth = conn_->GetPipelineDepth();
+        ui_.pipeline    = depth.num_articles;
+        ui_.xover_range = depth.overview_range;
+        ui_.rtt         = conn_->GetLatencyMs();
         if (state == Connection::State::Error)
         {
             const auto err = conn_->GetError();
@@ -705,6 +896,9 @@ public:
             }
             LOG_D("Connection ", ui_.id,  " => ", str(ui_.state));
 
+            if (ui_.state == states::Connected)
+                engine_state.idle_conns[ui_.account].insert(ui_.id);
+
             do_action(engine_state, std::move(next));
         }
 
@@ -715,6 +909,11 @@ public:
         return ui_.state == states::Connected;
     }
 
+    PipelineDepth GetPipelineDepth() const
+    {
+        return conn_->GetPipelineDepth();
+    }
+
     double bps() const
     {
         if (ui_.state == states::Active)
@@ -752,13 +951,27 @@ private:
         LOG_D("Connection ", ui_.id, " new action ", a->get_id(), "(", a->describe(), ")");
         a->set_owner(ui_.id);
         a->set_log(logger_);
-        state.submit(a.release(), thread_);
+        if (thread_)
+            state.submit(a.release(), thread_);
+        else state.submit(a.release());
+    }
+
+    void allocate_thread(Engine::State& state)
+    {
+        // the event driven connections don't block and are run by the
+        // reactor so they don't need a thread of their own.
+        // (except when there's no reactor)
+        if (dynamic_cast<EventConnection*>(conn_.get()) && state.reactor)
+            return;
+
+        thread_ = state.threads->AllocatePrivateThread();
     }
 
 private:
     ui::Connection ui_;
     std::unique_ptr<Connection> conn_;
     std::shared_ptr<Logger> logger_;
+    Engine::State* engine_ = nullptr;
     ThreadPool::Thread* thread_ = nullptr;
     unsigned ticks_to_ping_ = 0;
     unsigned ticks_to_conn_ = 0;
@@ -927,6 +1140,8 @@ public:
    ~TaskState()
     {
         ASSERT(locking_ == LockState::Unlocked);
+        if (engine_)
+            engine_->remove_task(*this);
         LOG_I("Task ", ui_.task_id, " deleted");
     }
 
@@ -1038,18 +1253,23 @@ public:
 
     bool CanRun() const
     {
-        if (ui_.state == states::Waiting ||
-            ui_.state == states::Queued ||
-            ui_.state == states::Active)
-        {
+        if (IsSchedulable())
             return task_->HasCommands();
-        }
         return false;
     }
 
-    std::shared_ptr<CmdList> CreateCommands()
+    // whether the task is in a state where it can be scheduled
+    // to run, i.e. it belongs in the account's ready queue.
+    bool IsSchedulable() const
+    {
+        return ui_.state == states::Waiting ||
+               ui_.state == states::Queued ||
+               ui_.state == states::Active;
+    }
+
+    std::shared_ptr<CmdList> CreateCommands(const PipelineDepth& depth)
     {
-        return task_->CreateCommands();
+        return task_->CreateCommands(depth);
     }
 
     transition Run(Engine::State& state)
@@ -1232,6 +1452,15 @@ public:
     void SetBatchId(std::size_t batch)
     { ui_.batch_id = batch; }
 
+    // the priority orders the task relative to the other tasks
+    // the same way as the task's position in the task list.
+    void SetPriority(std::int64_t priority)
+    { priority_ = priority; }
+
+    // set the engine state that indexes this task.
+    void SetEngine(Engine::State* state)
+    { engine_ = state; }
+
     std::size_t GetAccountId() const
     { return ui_.account; }
 
@@ -1241,6 +1470,9 @@ public:
     std::size_t GetBatchId() const
     { return ui_.batch_id; }
 
+    std::int64_t GetPriority() const
+    { return priority_; }
+
     states GetState() const
     { return ui_.state; }
 
@@ -1422,6 +1654,9 @@ private:
         LOG_D("Task ", ui_.task_id, " has ", num_active_actions_, " active actions");
         LOG_FLUSH();
 
+        if (engine_)
+            state.update_task_state(*this, old_state);
+
         if (new_state == states::Error || new_state == states::Complete)
         {
             state.num_pending_tasks--;
@@ -1443,6 +1678,8 @@ private:
     std::size_t num_active_actions_  = 0;
     std::size_t num_bytes_queued_    = 0;
     std::size_t num_files_produced_  = 0;
+    std::int64_t priority_ = 0;
+    Engine::State* engine_ = nullptr;
     bool did_receive_content_ = false;
     bool damaged_ = false;
 
@@ -1456,6 +1693,11 @@ private:
 // for msvc...
 const Engine::TaskState::transition Engine::TaskState::no_transition {Engine::TaskState::states::Queued, Engine::TaskState::states::Queued};
 
+bool Engine::State::by_priority::operator()(const TaskState* lhs, const TaskState* rhs) const
+{
+    return lhs->GetPriority() < rhs->GetPriority();
+}
+
 class Engine::BatchState
 {
 public:
@@ -1635,12 +1877,8 @@ public:
 
     bool HasTasks(Engine::State& state) const
     {
-        for (const auto& task : state.tasks)
-        {
-            if (task->GetBatchId() == ui_.batch_id)
-                return true;
-        }
-        return false;
+        const auto& counts = state.batch_tasks[ui_.batch_id];
+        return std::accumulate(std::begin(counts), std::end(counts), std::size_t(0)) != 0;
     }
 
     void UpdateState(Engine::State& state, const TaskState& task, const TaskState::transition& s)
@@ -1723,47 +1961,40 @@ public:
     std::size_t id() const
     { return ui_.batch_id; }
 
-    void UpdateState(Engine::State& state, bool run_callbacks = true)
+    // limit the download speed of the batch. 0 removes the limit.
+    void SetThrottle(unsigned bytes_per_second)
     {
-        size_t num_queued_tasks  = 0;
-        size_t num_waiting_tasks = 0;
-        size_t num_active_tasks  = 0;
-        size_t num_crunching_tasks = 0;
-        size_t num_paused_tasks = 0;
-        size_t num_complete_tasks = 0;
-        size_t num_error_tasks = 0;
-        size_t num_tasks = 0;
-
-        for (const auto& task : state.tasks)
+        if (!bytes_per_second)
         {
-            if (task->GetBatchId() != ui_.batch_id)
-                continue;
-            switch (task->GetState())
-            {
-                case states::Queued:
-                    num_queued_tasks++;
-                    break;
-                case states::Waiting:
-                    num_waiting_tasks++;
-                    break;
-                case states::Active:
-                    num_active_tasks++;
-                    break;
-                case states::Crunching:
-                    num_crunching_tasks++;
-                    break;
-                case states::Paused:
-                    num_paused_tasks++;
-                    break;
-                case states::Complete:
-                    num_complete_tasks++;
-                    break;
-                case states::Error:
-                    num_error_tasks++;
-                    break;
-            }
-            num_tasks++;
+            throttle_.reset();
+            return;
         }
+        if (!throttle_)
+            throttle_ = std::make_shared<throttle>();
+        throttle_->set_quota(bytes_per_second);
+        throttle_->enable(true);
+    }
+
+    // get the batch throttle (if any) chained to the given account throttle.
+    std::shared_ptr<throttle> GetThrottle(throttle* account)
+    {
+        if (throttle_)
+            throttle_->set_parent(account);
+        return throttle_;
+    }
+
+    void UpdateState(Engine::State& state, bool run_callbacks = true)
+    {
+        const auto& counts = state.batch_tasks[ui_.batch_id];
+
+        const size_t num_queued_tasks    = counts[(int)states::Queued];
+        const size_t num_waiting_tasks   = counts[(int)states::Waiting];
+        const size_t num_active_tasks    = counts[(int)states::Active];
+        const size_t num_crunching_tasks = counts[(int)states::Crunching];
+        const size_t num_paused_tasks    = counts[(int)states::Paused];
+        const size_t num_complete_tasks  = counts[(int)states::Complete];
+        const size_t num_error_tasks     = counts[(int)states::Error];
+        const size_t num_tasks = std::accumulate(std::begin(counts), std::end(counts), size_t(0));
 
         LOG_D("Batch has ", num_tasks, " tasks");
         LOG_D("Batch tasks"
@@ -1833,6 +2064,7 @@ private:
     bool damaged_ = false;
     float partial_task_completion_ = 0.0f;
     Type type_ = Type::FileBatch;
+    std::shared_ptr<throttle> throttle_;
 };
 
 void Engine::State::on_cmdlist_done(const Connection::CmdListCompletionData& completion)
@@ -1880,20 +2112,13 @@ void Engine::State::on_cmdlist_done(const Connection::CmdListCompletionData& com
     #endif
 
     // remove the cmdlist from the list of command lists to execute.
-    auto& current_cmdlists = this->cmds;
-    current_cmdlists.erase(std::remove(std::begin(current_cmdlists), std::end(current_cmdlists), cmds),
-        std::end(current_cmdlists));
+    remove_cmdlist(cmds);
 
     // find the task that the cmdlist belongs to, note that it could have been deleted.
-    auto it  = std::find_if(std::begin(tasks), std::end(tasks),
-        [&](const std::unique_ptr<TaskState>& t) {
-            return t->GetTaskId() == tid;
-        });
-    if (it == std::end(tasks))
+    auto* task = find_task(tid);
+    if (task == nullptr)
         return;
 
-    auto& task = *it;
-
     // there are several ways a command list execution can go.
     //
     // - cmdlist could not run because the connection failed
@@ -1937,7 +2162,7 @@ void Engine::State::on_cmdlist_done(const Connection::CmdListCompletionData& com
                 cmds->SetAccountId(this->fill_account);
                 cmds->SetConnId(0);
                 cmds->ClearFailBit();
-                current_cmdlists.push_back(cmds);
+                add_cmdlist(cmds, true);
                 const auto transition = task->UpdateActiveState(*this);
                 if (transition)
                 {
@@ -1960,7 +2185,7 @@ void Engine::State::on_cmdlist_done(const Connection::CmdListCompletionData& com
         // the command list didn't run properly, enqueue it again
         // to be run on some other connection.
         cmds->SetConnId(0);
-        current_cmdlists.push_back(cmds);
+        add_cmdlist(cmds, true);
         const auto transition = task->UpdateActiveState(*this);
         if (transition)
         {
@@ -1990,7 +2215,7 @@ void Engine::State::on_listing_update_progress(const Listing::Progress& progress
     on_listing_update_callback(update);
 }
 
-void Engine::State::on_header_update_progress(const HeaderTask::Progress& progress, std::size_t account)
+void Engine::State::on_header_update_progress(HeaderTask::Progress& progress, std::size_t account)
 {
     if (!on_header_update_callback)
         return;
@@ -2010,7 +2235,21 @@ void Engine::State::on_header_update_progress(const HeaderTask::Progress& progre
     {
         update.snapshots.push_back(snapshot.get());
     }
-    on_header_update_callback(update);
+    if (!engine_thread_running)
+    {
+        on_header_update_callback(update);
+        return;
+    }
+
+    // the snapshots need to outlive the progress object
+    // until the deferred callback has been invoked.
+    std::shared_ptr<std::vector<std::unique_ptr<Snapshot>>> snapshots(
+        new std::vector<std::unique_ptr<Snapshot>>(std::move(progress.snapshots)));
+    auto callback = on_header_update_callback;
+    client_events.Push([callback, update, snapshots]() {
+        callback(update);
+    });
+    notify_client();
 }
 
 void Engine::State::on_write_done(const ContentTask::WriteComplete& write)
@@ -2018,6 +2257,60 @@ void Engine::State::on_write_done(const ContentTask::WriteComplete& write)
     bytes_written += write.size;
 }
 
+void Engine::State::pump_actions()
+{
+    engine_notify_pending = false;
+    quit_pump_loop = false;
+
+    for (;;)
+    {
+        if (quit_pump_loop)
+            break;
+
+        std::unique_ptr<action> action = get_action();
+        if (!action)
+            break;
+
+        action->run_completion_callbacks();
+
+        const auto id = action->get_owner();
+        if (auto* conn = find_conn(id))
+        {
+            conn->CompleteAction(*this, std::move(action));
+        }
+        else if (current_connection_test &&
+            current_connection_test->id() == id)
+        {
+            current_connection_test->on_action(*this, std::move(action));
+            if (current_connection_test->is_finished())
+                current_connection_test.reset();
+        }
+        else
+        {
+            if (auto* task = find_task(id))
+            {
+                const auto transition = task->Complete(*this, std::move(action));
+                if (transition)
+                {
+                    auto* batch = find_batch(task->GetBatchId());
+                    batch->UpdateState(*this, *task, transition);
+                }
+            }
+            execute();
+        }
+        num_pending_actions--;
+    }
+
+    execute();
+
+    // if the loop was cut short make sure we get
+    // notified again for the remaining actions.
+    if (!actions.IsEmpty())
+        notify_engine();
+
+    LOG_FLUSH();
+}
+
 Engine::BatchState* Engine::State::find_batch(std::size_t id)
 {
     auto it = std::find_if(std::begin(batches), std::end(batches),
@@ -2030,25 +2323,159 @@ Engine::BatchState* Engine::State::find_batch(std::size_t id)
     return (*it).get();
 }
 
+Engine::TaskState* Engine::State::find_task(std::size_t id)
+{
+    auto it = task_index.find(id);
+    if (it == std::end(task_index))
+        return nullptr;
+
+    return it->second;
+}
+
+Engine::ConnState* Engine::State::find_conn(std::size_t id)
+{
+    auto it = conn_index.find(id);
+    if (it == std::end(conn_index))
+        return nullptr;
+
+    return it->second;
+}
+
+Engine::TaskState* Engine::State::find_runnable_task(std::size_t account)
+{
+    auto it = ready_tasks.find(account);
+    if (it == std::end(ready_tasks))
+        return nullptr;
+
+    // the tasks at the front of the queue that are already active
+    // but have no more commands to create are skipped. there are
+    // at most as many of those as there are executing cmdlists.
+    for (auto* task : it->second)
+    {
+        if (task->CanRun())
+            return task;
+    }
+    return nullptr;
+}
+
+void Engine::State::add_task(std::unique_ptr<TaskState> task, bool front)
+{
+    auto* ptr = task.get();
+    ptr->SetPriority(front ? --first_priority : ++last_priority);
+    ptr->SetEngine(this);
+    task_index[ptr->GetTaskId()] = ptr;
+    batch_tasks[ptr->GetBatchId()][(int)ptr->GetState()]++;
+    update_ready(*ptr);
+
+    if (front)
+        tasks.push_front(std::move(task));
+    else tasks.push_back(std::move(task));
+}
+
+void Engine::State::remove_task(TaskState& task)
+{
+    ready_tasks[task.GetAccountId()].erase(&task);
+    task_index.erase(task.GetTaskId());
+
+    auto it = batch_tasks.find(task.GetBatchId());
+    auto& counts = it->second;
+    counts[(int)task.GetState()]--;
+    if (std::accumulate(std::begin(counts), std::end(counts), std::size_t(0)) == 0)
+        batch_tasks.erase(it);
+}
+
+void Engine::State::update_ready(TaskState& task)
+{
+    auto& queue = ready_tasks[task.GetAccountId()];
+    queue.erase(&task);
+    if (task.IsSchedulable())
+        queue.insert(&task);
+}
+
+void Engine::State::update_task_state(TaskState& task, ui::TaskDesc::States previous)
+{
+    auto& counts = batch_tasks[task.GetBatchId()];
+    counts[(int)previous]--;
+    counts[(int)task.GetState()]++;
+
+    update_ready(task);
+}
+
+void Engine::State::swap_task_order(TaskState& lhs, TaskState& rhs)
+{
+    ready_tasks[lhs.GetAccountId()].erase(&lhs);
+    ready_tasks[rhs.GetAccountId()].erase(&rhs);
+
+    const auto priority = lhs.GetPriority();
+    lhs.SetPriority(rhs.GetPriority());
+    rhs.SetPriority(priority);
+
+    update_ready(lhs);
+    update_ready(rhs);
+}
+
+void Engine::State::reindex_task_order()
+{
+    ready_tasks.clear();
+    first_priority = 0;
+    last_priority  = 0;
+
+    for (auto& task : tasks)
+    {
+        task->SetPriority(++last_priority);
+        update_ready(*task);
+    }
+}
+
+void Engine::State::add_cmdlist(std::shared_ptr<CmdList> cmdlist, bool pending)
+{
+    const auto account = cmdlist->GetAccountId();
+
+    num_cmds[account]++;
+    if (pending)
+        pending_cmds[account].push_back(cmdlist);
+
+    cmds.push_back(std::move(cmdlist));
+}
+
+void Engine::State::remove_cmdlist(const std::shared_ptr<CmdList>& cmdlist)
+{
+    auto it = std::find(std::begin(cmds), std::end(cmds), cmdlist);
+    if (it == std::end(cmds))
+        return;
+
+    num_cmds[cmdlist->GetAccountId()]--;
+    cmds.erase(it);
+}
+
+std::shared_ptr<CmdList> Engine::State::pop_pending_cmdlist(std::size_t account)
+{
+    auto it = pending_cmds.find(account);
+    if (it == std::end(pending_cmds))
+        return nullptr;
+
+    auto& queue = it->second;
+    while (!queue.empty())
+    {
+        auto cmdlist = queue.front();
+        queue.pop_front();
+        if (cmdlist->IsCancelled())
+            continue;
+
+        return cmdlist;
+    }
+    return nullptr;
+}
+
 void Engine::State::execute()
 {
     if (!started)
         return;
 
-    // spawn connections if needed.
     for (const auto& account : accounts)
     {
-        const bool has_cmds = std::find_if(std::begin(cmds), std::end(cmds),
-            [&](const std::shared_ptr<CmdList>& cmdlist) {
-                return cmdlist->GetAccountId() == account.id;
-            }) != std::end(cmds);
-        const bool has_tasks = std::find_if(std::begin(tasks), std::end(tasks),
-            [&](const std::unique_ptr<TaskState>& task) {
-                return task->GetAccountId() == account.id &&
-                       task->CanRun();
-            }) != std::end(tasks);
-
-        if (has_cmds || has_tasks)
+        // spawn connections if needed.
+        if (num_cmds[account.id] || find_runnable_task(account.id))
         {
             std::size_t num_conns = std::count_if(std::begin(conns), std::end(conns),
                 [&](const std::unique_ptr<ConnState>& conn) {
@@ -2059,65 +2486,55 @@ void Engine::State::execute()
                 conns.emplace_back(new ConnState(*this, account.id, oid++));
             }
         }
-    }
 
-    // schedule cmdlists (if any) to available connections
-    for (auto& conn : conns)
-    {
-        if (!conn->is_ready())
-            continue;
+        // schedule cmdlists (if any) to the idle connections.
+        auto& idle = idle_conns[account.id];
+        while (!idle.empty())
+        {
+            const auto cid = *idle.begin();
+            idle.erase(idle.begin());
 
-        const auto account = conn->account();
+            auto* conn = find_conn(cid);
+            if (conn == nullptr || !conn->is_ready())
+                continue;
 
-        std::shared_ptr<CmdList> cmdlist;
-        TaskState* task = nullptr;
+            TaskState* task = nullptr;
 
-        auto it = std::find_if(std::begin(cmds), std::end(cmds),
-            [&](const std::shared_ptr<CmdList>& cmdlist) {
-                return cmdlist->GetConnId() == 0 &&
-                       cmdlist->GetAccountId() == conn->account() &&
-                       cmdlist->IsCancelled() == false;
-            });
-        if (it != std::end(cmds))
-        {
-            cmdlist = *it;
-            auto it = std::find_if(std::begin(tasks), std::end(tasks),
-                [&](const std::unique_ptr<TaskState>& task) {
-                    return task->GetTaskId() == cmdlist->GetTaskId();
-                });
-            ASSERT(it != std::end(tasks));
-            task = (*it).get();
-        }
-        else
-        {
-            // look for the next runnable task.
-            auto it = std::find_if(std::begin(tasks), std::end(tasks),
-                [&](const std::unique_ptr<TaskState>& task) {
-                    return task->GetAccountId() == account &&
-                           task->CanRun();
-                });
-            if (it != std::end(tasks))
+            auto cmdlist = pop_pending_cmdlist(account.id);
+            if (cmdlist)
             {
-                task = (*it).get();
-                cmdlist = task->CreateCommands();
-                cmds.push_back(cmdlist);
-                const auto transition = task->Run(*this);
-                if (transition)
+                task = find_task(cmdlist->GetTaskId());
+                ASSERT(task);
+            }
+            else
+            {
+                // look for the next runnable task.
+                task = find_runnable_task(account.id);
+                if (task)
                 {
+                    cmdlist = task->CreateCommands(conn->GetPipelineDepth());
+                    cmdlist->SetAccountId(account.id);
                     auto* batch = find_batch(task->GetBatchId());
-                    batch->UpdateState(*this, *task, transition);
+                    cmdlist->SetThrottle(batch->GetThrottle(find_account_throttle(account.id)));
+                    add_cmdlist(cmdlist, false);
+                    const auto transition = task->Run(*this);
+                    if (transition)
+                        batch->UpdateState(*this, *task, transition);
                 }
             }
-        }
 
-        if (!cmdlist)
-            continue;
+            if (!cmdlist)
+            {
+                idle.insert(cid);
+                break;
+            }
 
-        cmdlist->SetAccountId(account);
-        cmdlist->SetTaskId(task->GetTaskId());
-        cmdlist->SetDesc(task->GetDesc());
-        cmdlist->SetConnId(conn->id());
-        conn->Execute(*this, cmdlist);
+            cmdlist->SetAccountId(account.id);
+            cmdlist->SetTaskId(task->GetTaskId());
+            cmdlist->SetDesc(task->GetDesc());
+            cmdlist->SetConnId(conn->id());
+            conn->Execute(*this, cmdlist);
+        }
     }
 }
 
@@ -2166,6 +2583,13 @@ Engine::~Engine()
     assert(state_->conns.empty());
     assert(state_->started == false);
 
+    SetEngineThread(false);
+
+    if (state_->reactor)
+    {
+        state_->reactor->Shutdown();
+        state_->reactor.reset();
+    }
     state_->threads->Shutdown();
     state_->threads.reset();
 }
@@ -2179,6 +2603,16 @@ void Engine::TryAccount(const ui::Account& account)
 
 void Engine::SetAccount(const ui::Account& acc, bool spawn_connections_immediately)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    auto* ratecontrol = state_->find_account_throttle(acc.id);
+    if (ratecontrol->is_enabled() != (acc.max_bps != 0) ||
+        ratecontrol->get_quota() != acc.max_bps)
+    {
+        ratecontrol->set_quota(acc.max_bps);
+        ratecontrol->enable(acc.max_bps != 0);
+    }
+
     auto it = std::find_if(std::begin(state_->accounts), std::end(state_->accounts),
         [&](const ui::Account& a) {
             return a.id == acc.id;
@@ -2269,6 +2703,8 @@ void Engine::SetAccount(const ui::Account& acc, bool spawn_connections_immediate
 
 void Engine::DelAccount(std::size_t id)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     auto end = std::remove_if(std::begin(state_->conns), std::end(state_->conns),
         [&](const std::unique_ptr<ConnState>& c) {
             return c->account() == id;
@@ -2287,11 +2723,15 @@ void Engine::DelAccount(std::size_t id)
 
 void Engine::SetFillAccount(std::size_t id)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     state_->fill_account = id;
 }
 
 Engine::TaskId Engine::DownloadFiles(const ui::FileBatchDownload& batch, bool priority)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     const auto batchid = state_->oid++;
     std::unique_ptr<BatchState> b(new BatchState(batchid, batch));
 
@@ -2316,9 +2756,7 @@ Engine::TaskId Engine::DownloadFiles(const ui::FileBatchDownload& batch, bool pr
         state->SetAccountId(batch.account);
         state->SetBatchId(batchid);
 
-        if (priority)
-            state_->tasks.push_front(std::move(state));
-        else state_->tasks.push_back(std::move(state));
+        state_->add_task(std::move(state), priority);
 
         state_->bytes_queued += file.size;
         state_->num_pending_tasks++;
@@ -2332,6 +2770,8 @@ Engine::TaskId Engine::DownloadFiles(const ui::FileBatchDownload& batch, bool pr
 
 Engine::TaskId Engine::DownloadListing(const ui::GroupListDownload& list)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     const auto batchid = state_->oid++;
     std::unique_ptr<BatchState> batch(new BatchState(batchid, list));
 
@@ -2347,7 +2787,7 @@ Engine::TaskId Engine::DownloadListing(const ui::GroupListDownload& list)
     state->SetAccountId(list.account);
     state->SetBatchId(batchid);
 
-    state_->tasks.push_back(std::move(state));
+    state_->add_task(std::move(state), false);
     state_->batches.push_back(std::move(batch));
     state_->num_pending_tasks++;
     state_->execute();
@@ -2356,6 +2796,8 @@ Engine::TaskId Engine::DownloadListing(const ui::GroupListDownload& list)
 
 Engine::TaskId Engine::DownloadHeaders(const ui::HeaderDownload& download)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     const auto batchid = state_->oid++;
     std::unique_ptr<BatchState> batch(new BatchState(batchid, download));
 
@@ -2371,7 +2813,7 @@ Engine::TaskId Engine::DownloadHeaders(const ui::HeaderDownload& download)
     state->SetAccountId(download.account);
     state->SetBatchId(batchid);
 
-    state_->tasks.push_back(std::move(state));
+    state_->add_task(std::move(state), false);
     state_->batches.push_back(std::move(batch));
     state_->num_pending_tasks++;
     state_->execute();
@@ -2380,67 +2822,25 @@ Engine::TaskId Engine::DownloadHeaders(const ui::HeaderDownload& download)
 
 bool Engine::Pump()
 {
-    state_->quit_pump_loop = false;
+    // the deferred callbacks are run without holding the
+    // engine lock so that they're free to call into the engine.
+    state_->run_client_events();
 
-    SetThreadLog(state_->logger.get());
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
 
-    for (;;)
+    if (!state_->engine_thread_running)
     {
-        if (state_->quit_pump_loop)
-            break;
-
-        std::unique_ptr<action> action = state_->get_action();
-        if (!action)
-            break;
-
-        action->run_completion_callbacks();
-
-        const auto id = action->get_owner();
-        auto it = std::find_if(std::begin(state_->conns), std::end(state_->conns),
-            [&](const std::unique_ptr<ConnState>& c) {
-                return c->id() == id;
-            });
-        if (it != std::end(state_->conns))
-        {
-            auto& conn = *it;
-            conn->CompleteAction(*state_, std::move(action));
-        }
-        else if (state_->current_connection_test &&
-            state_->current_connection_test->id() == id)
-        {
-            state_->current_connection_test->on_action(*state_, std::move(action));
-            if (state_->current_connection_test->is_finished())
-                state_->current_connection_test.reset();
-        }
-        else
-        {
-            for (auto& task : state_->tasks)
-            {
-                if (task->GetTaskId() != id)
-                    continue;
+        SetThreadLog(state_->logger.get());
 
-                const auto transition = task->Complete(*state_, std::move(action));
-                if (transition)
-                {
-                    auto* batch = state_->find_batch(task->GetBatchId());
-                    batch->UpdateState(*state_, *task, transition);
-                }
-                break;
-            }
-            state_->execute();
-        }
-        state_->num_pending_actions--;
+        state_->pump_actions();
     }
-
-    state_->execute();
-
-    LOG_FLUSH();
-
     return state_->num_pending_actions != 0;
 }
 
 void Engine::Tick()
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     if (state_->repartition_task_list)
     {
         auto tit = std::begin(state_->tasks);
@@ -2452,7 +2852,7 @@ void Engine::Tick()
                     return t->GetBatchId() == batch->id();
                 });
         }
-
+        state_->reindex_task_order();
         state_->repartition_task_list = false;
     }
 
@@ -2483,8 +2883,50 @@ void Engine::RunMainThread()
     state_->threads->RunMainThreads();
 }
 
+void Engine::SetEngineThread(bool on_off)
+{
+    if (on_off == state_->engine_thread_running)
+        return;
+
+    if (on_off)
+    {
+        std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+        LOG_D("Starting engine thread");
+
+        state_->engine_thread_quit = false;
+        state_->engine_thread_running = true;
+        state_->engine_thread.reset(new std::thread(
+            std::bind(&State::run_engine_thread, state_.get())));
+
+        // there might be a notification to the client pending which would
+        // no longer pump the actions, so kick the engine thread once.
+        state_->engine_event.SetSignal();
+    }
+    else
+    {
+        LOG_D("Stopping engine thread");
+
+        // the engine thread needs the lock to finish its current round.
+        state_->engine_thread_quit = true;
+        state_->engine_event.SetSignal();
+        state_->engine_thread->join();
+        state_->engine_thread.reset();
+
+        std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+        state_->engine_thread_running = false;
+        state_->engine_event.ResetSignal();
+
+        // the remaining actions are pumped by the client again.
+        state_->engine_notify_pending = false;
+        state_->notify_engine();
+    }
+}
+
 void Engine::Start()
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     if (!state_->started)
     {
         LOG_I("Engine starting");
@@ -2500,6 +2942,8 @@ void Engine::Start()
 
 void Engine::Stop()
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     if (!state_->started)
         return;
 
@@ -2516,6 +2960,8 @@ void Engine::Stop()
 
 void Engine::SaveTasks(const std::string& file)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
 #if defined(WINDOWS_OS)
     // msvc specific extension..
     std::ofstream out(utf8::decode(file), std::ios::out | std::ios::trunc);
@@ -2557,6 +3003,8 @@ void Engine::SaveTasks(const std::string& file)
 
 void Engine::LoadTasks(const std::string& file)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
 
 #if defined(WINDOWS_OS)
     // msvc extension
@@ -2593,7 +3041,7 @@ void Engine::LoadTasks(const std::string& file)
             }
             std::unique_ptr<TaskState> state(new TaskState(std::move(task), json_p.value()));
             state->Configure(settings);
-            state_->tasks.push_back(std::move(state));
+            state_->add_task(std::move(state), false);
             state_->num_pending_tasks++;
         }
     }
@@ -2617,6 +3065,8 @@ void Engine::LoadTasks(const std::string& file)
 
 void Engine::Reset()
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     state_->tasks.clear();
     state_->batches.clear();
     state_->accounts.clear();
@@ -2638,71 +3088,99 @@ void Engine::Reset()
 
 void Engine::SetErrorCallback(on_error error_callback)
 {
-    state_->on_error_callback = std::move(error_callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_error_callback = state_->to_client(std::move(error_callback));
 }
 
 void Engine::SetFileCallback(on_file file_callback)
 {
-    state_->on_file_callback = std::move(file_callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_file_callback = state_->to_client(std::move(file_callback));
 }
 
 void Engine::SetNotifyCallback(on_async_notify notify_callback)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     state_->on_notify_callback = std::move(notify_callback);
 }
 
 void Engine::SetListingUpdateCallback(on_listing_update callback)
 {
-    state_->on_listing_update_callback = std::move(callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_listing_update_callback = state_->to_client(std::move(callback));
 }
 
 void Engine::SetHeaderInfoCallback(on_header_update callback)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     state_->on_header_update_callback = std::move(callback);
 }
 
 void Engine::SetBatchCallback(on_batch batch_callback)
 {
-    state_->on_batch_callback = std::move(batch_callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_batch_callback = state_->to_client(std::move(batch_callback));
 }
 
 void Engine::SetListCallback(on_list list_callback)
 {
-    state_->on_list_callback = std::move(list_callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_list_callback = state_->to_client(std::move(list_callback));
 }
 
 void Engine::SetTaskCallback(on_task task_callback)
 {
-    state_->on_task_callback = std::move(task_callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_task_callback = state_->to_client(std::move(task_callback));
 }
 
 void Engine::SetUpdateCallback(on_update update_callback)
 {
-    state_->on_update_callback = std::move(update_callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_update_callback = state_->to_client(std::move(update_callback));
 }
 
 void Engine::SetFinishCallback(on_finish callback)
 {
-    state_->on_finish_callback = std::move(callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_finish_callback = state_->to_client(std::move(callback));
 }
 
 void Engine::SetQuotaCallback(on_quota callback)
 {
-    state_->on_quota_callback = std::move(callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_quota_callback = state_->to_client(std::move(callback));
 }
 
 void Engine::SetTestCallback(on_conn_test callback)
 {
-    state_->on_test_callback = std::move(callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_test_callback = state_->to_client(std::move(callback));
 }
 
 void Engine::SetTestLogCallback(on_conn_test_log callback)
 {
-    state_->on_test_log_callback = std::move(callback);
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    state_->on_test_log_callback = state_->to_client(std::move(callback));
 }
 
 void Engine::SetOverwriteExistingFiles(bool on_off)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     state_->overwrite_existing = on_off;
 
     Task::Settings settings;
@@ -2715,6 +3193,8 @@ void Engine::SetOverwriteExistingFiles(bool on_off)
 
 void Engine::SetDiscardTextContent(bool on_off)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     state_->discard_text = on_off;
 
     Task::Settings settings;
@@ -2727,24 +3207,40 @@ void Engine::SetDiscardTextContent(bool on_off)
 
 void Engine::SetPreferSecure(bool on_off)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     state_->prefer_secure = on_off;
 }
 
 void Engine::SetEnableThrottle(bool on_off)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     state_->ratecontrol.enable(on_off);
     LOG_D("Throttle is now ", on_off);
 }
 
 void Engine::SetThrottleValue(unsigned value)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     state_->ratecontrol.set_quota(value);
     LOG_D("Throttle value ", value, " bytes per second.");
 }
 
+void Engine::SetBufferPoolLimit(std::uint64_t bytes)
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    BufferPool::Get().SetMaxPoolSize(bytes);
+    LOG_D("Buffer pool limit ", bytes, " bytes.");
+}
+
 
 void Engine::SetGroupItems(bool on_off)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     state_->group_items = on_off;
 
     if (state_->group_items)
@@ -2758,79 +3254,135 @@ void Engine::SetGroupItems(bool on_off)
                     return t->GetBatchId() == batch->id();
                 });
         }
-
+        state_->reindex_task_order();
         state_->repartition_task_list = false;
     }
 }
 
 bool Engine::GetGroupItems() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->group_items;
 }
 
 bool Engine::GetOverwriteExistingFiles() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->overwrite_existing;
 }
 
 bool Engine::GetDiscardTextContent() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->discard_text;
 }
 
 bool Engine::GetPreferSecure() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->prefer_secure;
 }
 
 bool Engine::GetEnableThrottle() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->ratecontrol.is_enabled();
 }
 
 unsigned Engine::GetThrottleValue() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->ratecontrol.get_quota();
 }
 
 std::uint64_t Engine::GetCurrentQueueSize() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->bytes_queued;
 }
 
 std::uint64_t Engine::GetBytesReady() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->bytes_ready;
 }
 
 std::uint64_t Engine::GetTotalBytesWritten() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->bytes_written;
 }
 
 std::uint64_t Engine::GetTotalBytesDownloaded() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->bytes_downloaded;
 }
 
+std::uint64_t Engine::GetBufferPoolHits() const
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    return BufferPool::Get().GetStats().hits;
+}
+
+std::uint64_t Engine::GetBufferPoolMisses() const
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    return BufferPool::Get().GetStats().misses;
+}
+
+std::uint64_t Engine::GetBufferPoolBytesInUse() const
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    return BufferPool::Get().GetStats().bytes_in_use;
+}
+
+std::uint64_t Engine::GetBufferPoolLimit() const
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    return BufferPool::Get().GetMaxPoolSize();
+}
+
 std::string Engine::GetLogfileName() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->logger->GetName();
 }
 
 
 bool Engine::IsStarted() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->started;
 }
 
 bool Engine::HasPendingActions() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->num_pending_actions != 0;
 }
 
 void Engine::GetTasks(std::deque<ui::TaskDesc>* tasklist) const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     if (state_->group_items)
     {
         const auto& batches = state_->batches;
@@ -2853,6 +3405,8 @@ void Engine::GetTasks(std::deque<ui::TaskDesc>* tasklist) const
 
 void Engine::GetTask(std::size_t index, ui::TaskDesc* task) const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     if (state_->group_items)
     {
         ASSERT(index < state_->batches.size());
@@ -2867,6 +3421,8 @@ void Engine::GetTask(std::size_t index, ui::TaskDesc* task) const
 
 void Engine::GetConns(std::deque<ui::Connection>* connlist) const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     const auto& conns = state_->conns;
 
     connlist->resize(conns.size());
@@ -2879,6 +3435,8 @@ void Engine::GetConns(std::deque<ui::Connection>* connlist) const
 
 void Engine::GetConn(std::size_t index, ui::Connection* conn) const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     ASSERT(index < state_->conns.size());
 
     state_->conns[index]->GetStateUpdate(*conn);
@@ -2886,6 +3444,8 @@ void Engine::GetConn(std::size_t index, ui::Connection* conn) const
 
 void Engine::KillConnection(std::size_t i)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     LOG_D("Kill connection ", i);
 
     ASSERT(i < state_->conns.size());
@@ -2898,6 +3458,8 @@ void Engine::KillConnection(std::size_t i)
 
 void Engine::CloneConnection(std::size_t i)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     LOG_D("Clone connection ", i);
 
     ASSERT(i < state_->conns.size());
@@ -2911,6 +3473,8 @@ void Engine::CloneConnection(std::size_t i)
 
 Engine::TaskId Engine::KillTask(std::size_t i)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     TaskId killed = 0;
 
     if (state_->group_items)
@@ -2959,6 +3523,8 @@ Engine::TaskId Engine::KillTask(std::size_t i)
 
 Engine::TaskId Engine::PauseTask(std::size_t index)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     TaskId paused = 0;
 
     if (state_->group_items)
@@ -2988,6 +3554,8 @@ Engine::TaskId Engine::PauseTask(std::size_t index)
 
 Engine::TaskId Engine::ResumeTask(std::size_t index)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     TaskId resumed = 0;
 
     if (state_->group_items)
@@ -3020,6 +3588,8 @@ Engine::TaskId Engine::ResumeTask(std::size_t index)
 
 void Engine::MoveTaskUp(std::size_t index)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     if (state_->group_items)
     {
         if (index > 0 && index < state_->batches.size()
@@ -3034,6 +3604,7 @@ void Engine::MoveTaskUp(std::size_t index)
         if (index > 0 && index < state_->tasks.size()
             && state_->tasks.size() > 1)
         {
+            state_->swap_task_order(*state_->tasks[index], *state_->tasks[index - 1]);
             std::swap(state_->tasks[index], state_->tasks[index - 1]);
         }
     }
@@ -3041,6 +3612,8 @@ void Engine::MoveTaskUp(std::size_t index)
 
 void Engine::MoveTaskDown(std::size_t index)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     if (state_->group_items)
     {
         if (state_->batches.size() > 1
@@ -3055,6 +3628,7 @@ void Engine::MoveTaskDown(std::size_t index)
         if (state_->tasks.size() > 1
             && index < state_->tasks.size() - 1)
         {
+            state_->swap_task_order(*state_->tasks[index], *state_->tasks[index + 1]);
             std::swap(state_->tasks[index], state_->tasks[index + 1]);
         }
     }
@@ -3062,6 +3636,8 @@ void Engine::MoveTaskDown(std::size_t index)
 
 bool Engine::KillTaskById(Engine::TaskId id)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     auto it = std::find_if(std::begin(state_->batches), std::end(state_->batches),
         [&](const std::unique_ptr<BatchState>& b) {
             return b->id() == id;
@@ -3083,6 +3659,8 @@ bool Engine::KillTaskById(Engine::TaskId id)
 
 bool Engine::LockTaskById(TaskId id)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     auto* batch = state_->find_batch(id);
     if (!batch)
         return false;
@@ -3093,6 +3671,8 @@ bool Engine::LockTaskById(TaskId id)
 
 bool Engine::UnlockTaskById(TaskId id)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     auto* batch = state_->find_batch(id);
     if (!batch)
         return false;
@@ -3101,8 +3681,23 @@ bool Engine::UnlockTaskById(TaskId id)
     return true;
 }
 
+bool Engine::SetTaskThrottleById(TaskId id, unsigned bytes_per_second)
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
+    auto* batch = state_->find_batch(id);
+    if (!batch)
+        return false;
+
+    batch->SetThrottle(bytes_per_second);
+    LOG_D("Task ", id, " throttle value ", bytes_per_second, " bytes per second.");
+    return true;
+}
+
 std::size_t Engine::GetNumTasks() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     if (state_->group_items)
         return state_->batches.size();
 
@@ -3111,6 +3706,8 @@ std::size_t Engine::GetNumTasks() const
 
 std::size_t Engine::GetNumPendingTasks() const
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->engine_mutex);
+
     return state_->num_pending_tasks;
 }
 
@@ -148,7 +148,8 @@ namespace newsflash
         TaskId DownloadHeaders(const ui::HeaderDownload& update);
 
         // process pending actions in the engine. You should call this function
-        // as a response to to the async_notify.
+        // as a response to to the async_notify. When the engine thread is
+        // enabled this only invokes the deferred callbacks.
         // returns true if there are still pending actions to be completed later
         // or false if the pending action queue is empty.
         bool Pump();
@@ -163,6 +164,15 @@ namespace newsflash
         // single threaded debugging.
         void RunMainThread();
 
+        // If set the completed actions are processed by a dedicated engine
+        // thread instead of the thread that calls Pump. The engine thread
+        // owns the engine state while it's processing and the API calls
+        // are serialized with it. The client callbacks (except for the notify
+        // callback) are then deferred and invoked by Pump in the client thread
+        // and the notify callback only signals that Pump should be called.
+        // Not supported with the single thread debugging.
+        void SetEngineThread(bool on_off);
+
         // start engine. this will start connections and being processing the
         // tasks currently queued in the tasklist.
         void Start();
@@ -247,6 +257,10 @@ namespace newsflash
         // by all engine connections.
         void SetThrottleValue(unsigned value);
 
+        // set the maximum number of bytes of free data buffers kept
+        // around for reuse by the connections and the decoding.
+        void SetBufferPoolLimit(std::uint64_t bytes);
+
         // if set to true tasklist actions perform actions on batches
         // instead of individual tasks. this includes kill/pause/resume
         // and update_task_list
@@ -279,6 +293,19 @@ namespace newsflash
         // and includes a few bytes of protocol data per transaction.
         std::uint64_t GetTotalBytesDownloaded() const;
 
+        // get the number of data buffer allocations that were served
+        // by recycling a previously used buffer.
+        std::uint64_t GetBufferPoolHits() const;
+
+        // get the number of data buffer allocations that needed new memory.
+        std::uint64_t GetBufferPoolMisses() const;
+
+        // get the number of bytes currently allocated to data buffers.
+        std::uint64_t GetBufferPoolBytesInUse() const;
+
+        // get the current buffer pool limit.
+        std::uint64_t GetBufferPoolLimit() const;
+
         // Get the complete path (including the file name) to the engine's log file.
         std::string GetLogfileName() const;
 
@@ -328,6 +355,11 @@ namespace newsflash
 
         bool UnlockTaskById(TaskId id);
 
+        // limit the download speed of the task to the given bytes per second
+        // in addition to the account and the engine throttle.
+        // 0 removes the limit.
+        bool SetTaskThrottleById(TaskId id, unsigned bytes_per_second);
+
         // get the number of tasks.
         std::size_t GetNumTasks() const;
 
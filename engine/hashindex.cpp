@@ -0,0 +1,204 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include <stdexcept>
+#include <cassert>
+
+#include "hashindex.h"
+#include "bigfile.h"
+
+namespace newsflash
+{
+
+namespace {
+    // erased entries are marked with a value that is never used
+    // as an internal article number so that the probe sequences
+    // going over them remain intact.
+    const std::uint64_t Erased = std::uint64_t(-1);
+
+    const std::size_t MinCapacity = 1024;
+
+#pragma pack(push, 1)
+    struct TableHeader {
+        std::uint64_t capacity = 0;
+        std::uint64_t size = 0;
+    };
+#pragma pack(pop)
+
+    bool is_live(const HashIndex::Entry& e)
+    { return e.value != 0 && e.value != Erased; }
+} // namespace
+
+void HashIndex::Insert(std::uint32_t hash, std::uint32_t fingerprint, std::uint64_t value)
+{
+    assert(value != 0 && value != Erased);
+
+    // keep the load factor below 0.7
+    if ((used_ + 1) * 10 > slots_.size() * 7)
+    {
+        // if most of the used slots are just erased entries then
+        // rehashing to the same size is enough to clean them up.
+        const auto capacity = slots_.empty() ? MinCapacity
+            : ((size_ + 1) * 2 < used_ ? slots_.size() : slots_.size() * 2);
+        rehash(capacity);
+    }
+
+    const auto mask = slots_.size() - 1;
+    auto slot = probe_start(hash);
+    while (is_live(slots_[slot]))
+        slot = (slot + 1) & mask;
+
+    auto& e = slots_[slot];
+    if (e.value == 0)
+        ++used_;
+    e.hash = hash;
+    e.fingerprint = fingerprint;
+    e.value = value;
+    ++size_;
+}
+
+std::size_t HashIndex::FindFirst(std::uint32_t hash) const
+{
+    if (slots_.empty())
+        return npos;
+
+    const auto slot = probe_start(hash);
+    const auto& e = slots_[slot];
+    if (is_live(e) && e.hash == hash)
+        return slot;
+
+    return FindNext(hash, slot);
+}
+
+std::size_t HashIndex::FindNext(std::uint32_t hash, std::size_t slot) const
+{
+    const auto mask = slots_.size() - 1;
+    for (;;)
+    {
+        slot = (slot + 1) & mask;
+        const auto& e = slots_[slot];
+        if (e.value == 0)
+            return npos;
+        if (e.value != Erased && e.hash == hash)
+            return slot;
+    }
+}
+
+void HashIndex::Erase(std::size_t slot)
+{
+    assert(is_live(slots_[slot]));
+
+    slots_[slot].value = Erased;
+    --size_;
+}
+
+void HashIndex::Save(bigfile& file) const
+{
+    // write out a table without the erased entries.
+    if (used_ != size_)
+    {
+        HashIndex compact;
+        compact.rehash(slots_.size());
+        for (const auto& e : slots_)
+        {
+            if (is_live(e))
+                compact.Insert(e.hash, e.fingerprint, e.value);
+        }
+        compact.Save(file);
+        return;
+    }
+
+    TableHeader header;
+    header.capacity = slots_.size();
+    header.size     = size_;
+    file.write(&header, sizeof(header));
+    if (!slots_.empty())
+        file.write(&slots_[0], slots_.size() * sizeof(Entry));
+}
+
+void HashIndex::Load(bigfile& file)
+{
+    TableHeader header;
+    if (file.read(&header, sizeof(header)) != sizeof(header))
+        throw std::runtime_error("hash index is truncated");
+
+    const auto capacity = header.capacity;
+    if ((capacity & (capacity - 1)) || header.size > capacity)
+        throw std::runtime_error("hash index is corrupted");
+
+    std::vector<Entry> slots;
+    slots.resize(capacity);
+    if (capacity)
+    {
+        const auto bytes = capacity * sizeof(Entry);
+        if (file.read(&slots[0], bytes) != bytes)
+            throw std::runtime_error("hash index is truncated");
+    }
+    slots_.swap(slots);
+    size_ = header.size;
+    used_ = header.size;
+}
+
+void HashIndex::Clear()
+{
+    slots_.clear();
+    size_ = 0;
+    used_ = 0;
+}
+
+void HashIndex::rehash(std::size_t capacity)
+{
+    assert((capacity & (capacity - 1)) == 0);
+
+    std::vector<Entry> slots;
+    slots.resize(capacity);
+    slots.swap(slots_);
+    size_ = 0;
+    used_ = 0;
+
+    const auto mask = capacity - 1;
+    for (const auto& e : slots)
+    {
+        if (!is_live(e))
+            continue;
+        auto slot = probe_start(e.hash);
+        while (slots_[slot].value)
+            slot = (slot + 1) & mask;
+        slots_[slot] = e;
+        ++size_;
+        ++used_;
+    }
+}
+
+std::size_t HashIndex::probe_start(std::uint32_t hash) const
+{
+    // the subject line hashes are already well distributed but
+    // mix them up anyway (murmur3 finalizer) in case they're not.
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash & (slots_.size() - 1);
+}
+
+} // newsflash
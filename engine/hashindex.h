@@ -0,0 +1,109 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "newsflash/config.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace newsflash
+{
+    class bigfile;
+
+    // open addressing (linear probing) hash table that maps a subject line
+    // hash to the internal numbers of the articles with that hash.
+    // each entry also carries the upper bits of the subject line fingerprint
+    // (see nntp::fingerprint) so that entries that only collide in the hash
+    // can be rejected without loading the article from the catalog.
+    // the entries are kept in a flat array of fixed size records and the
+    // file layout is the same as the layout in memory, i.e. the table
+    // can be read back (or mapped) as is without rehashing.
+    class HashIndex
+    {
+    public:
+#pragma pack(push, 1)
+        struct Entry {
+            std::uint32_t hash = 0;
+            // upper bits of the subject fingerprint or 0 if it's not known.
+            // (entries converted from the older meta data format)
+            std::uint32_t fingerprint = 0;
+            // the internal article number, 0 for a free slot.
+            std::uint64_t value = 0;
+        };
+#pragma pack(pop)
+
+        static const std::size_t npos = std::size_t(-1);
+
+        // insert a new entry. there can be multiple entries with the same hash.
+        void Insert(std::uint32_t hash, std::uint32_t fingerprint, std::uint64_t value);
+
+        // find the first slot that has an entry with the given hash.
+        // returns npos if there's no such entry.
+        std::size_t FindFirst(std::uint32_t hash) const;
+
+        // find the next slot after the given slot that has an entry
+        // with the given hash. returns npos if there are no more entries.
+        std::size_t FindNext(std::uint32_t hash, std::size_t slot) const;
+
+        // erase the entry in the given slot.
+        void Erase(std::size_t slot);
+
+        Entry& GetEntry(std::size_t slot)
+        { return slots_[slot]; }
+
+        const Entry& GetEntry(std::size_t slot) const
+        { return slots_[slot]; }
+
+        // get the number of entries in the table.
+        std::size_t GetSize() const
+        { return size_; }
+
+        // get the number of slots in the table.
+        std::size_t GetCapacity() const
+        { return slots_.size(); }
+
+        // write the table at the current file position.
+        void Save(bigfile& file) const;
+
+        // read the table written by Save from the current file position.
+        void Load(bigfile& file);
+
+        void Clear();
+
+        // the fingerprint value 0 is reserved for "unknown".
+        static std::uint32_t MakeFingerprint(std::uint32_t fingerprint)
+        { return fingerprint ? fingerprint : 1; }
+
+    private:
+        void rehash(std::size_t capacity);
+        std::size_t probe_start(std::uint32_t hash) const;
+
+    private:
+        std::vector<Entry> slots_;
+        // the number of live entries.
+        std::size_t size_ = 0;
+        // the number of live and erased entries.
+        std::size_t used_ = 0;
+    };
+
+} // newsflash
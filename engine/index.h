@@ -24,13 +24,17 @@
 #include <functional>
 #include <algorithm>
 #include <deque>
+#include <vector>
 #include <limits>
 #include <thread>
 #include <future>
 #include <cstdint>
 #include <cstring>
 #include <cassert>
+#include <type_traits>
 #include "article.h"
+#include "catalogview.h"
+#include "keysort.h"
 #include "assert.h"
 #include "bitflag.h"
 
@@ -63,28 +67,40 @@ namespace newsflash
 
         using article_t = typename newsflash::article<Storage>;
 
-        index() : size_(0), sorting_(sorting::sort_by_date), sortdir_(sortdir::ascending)
+        index() : sorting_(sorting::sort_by_date), sortdir_(sortdir::ascending)
         {}
 
         // loading callback
         using loader = std::function<article_t (std::size_t key, std::size_t index)>;
         // filtering callback (predicate)
         using predicate = std::function<bool (const article_t& a)>;
+        // filtering callback for columnar data (see attach).
+        // this can be called concurrently from multiple threads.
+        using row_predicate = std::function<bool (const catalog_view& view, std::size_t index)>;
 
         loader on_load; // callback to load an article object
         predicate on_filter; // callback to filter an article object
+        row_predicate on_filter_row; // callback to filter a row in a catalog view
+
+        // attach a columnar view to the items with the given key.
+        // once views are attached every key must have a view and the
+        // index sorts and filters straight from the view columns without
+        // ever calling on_load. the row filter is used when it's set.
+        void attach(std::size_t key, const catalog_view* view)
+        {
+            if (key >= views_.size())
+                views_.resize(key + 1);
+            views_[key] = view;
+        }
 
         void sort(sorting column, sortdir up_down)
         {
             if (column == sorting_)
             {
-                auto beg = std::begin(items_);
-                auto mid = std::begin(items_) + size_;
-                auto end = std::end(items_);
-                std::reverse(beg, mid);
-                std::reverse(mid, end);
+                std::reverse(std::begin(items_), std::end(items_));
                 sorting_ = column;
                 sortdir_ = up_down;
+                update_rows();
                 return;
             }
             sorting_ = column;
@@ -93,36 +109,10 @@ namespace newsflash
         }
         void resort()
         {
-            switch (sorting_)
-            {
-                case sorting::sort_by_broken:
-                    sort(sortdir_, fileflag::broken);
-                    break;
-                case sorting::sort_by_binary:
-                    sort(sortdir_, fileflag::binary);
-                    break;
-                case sorting::sort_by_downloaded:
-                    sort(sortdir_, fileflag::downloaded);
-                    break;
-                case sorting::sort_by_bookmarked:
-                    sort(sortdir_, fileflag::bookmarked);
-                    break;
-                case sorting::sort_by_date:
-                    sort(sortdir_, &article_t::pubdate);
-                    break;
-                case sorting::sort_by_type:
-                    sort(sortdir_, &article_t::type);
-                    break;
-                case sorting::sort_by_size:
-                    sort(sortdir_, &article_t::bytes);
-                    break;
-                case sorting::sort_by_author:
-                    sort(sortdir_, &article_t::author);
-                    break;
-                case sorting::sort_by_subject:
-                    sort(sortdir_, &article_t::subject);
-                    break;
-            }
+            with_key([this](auto key) {
+                this->sort(std::begin(items_), std::end(items_), key);
+            });
+            update_rows();
         }
 
         // insert the new item into the index in the right position.
@@ -130,59 +120,50 @@ namespace newsflash
         // this will maintain current sorting.
         void insert(const article_t& a, std::size_t key, std::size_t index)
         {
-            iterator beg;
-            iterator end;
-            iterator pos;
-            if (!is_match(a))
-            {
-                beg = std::begin(items_) + size_;
-                end = std::end(items_);
-            }
-            else
+            insert(a, is_match(a), key, index);
+        }
+
+        // insert the new item into the index in the right position
+        // using the attached view (or on_load) to access the article data.
+        void insert(std::size_t key, std::size_t index)
+        {
+            const item i {key, index};
+            insert(i, is_match(i), key, index);
+        }
+
+        // insert a batch of new items with the same key. the batch is
+        // sorted on its own first and then merged with the current items
+        // in a single linear pass. this is much cheaper than inserting a
+        // large number of items one by one into the middle of the index.
+        template<typename Iterator>
+        void insert(std::size_t key, Iterator beg, Iterator end)
+        {
+            const auto size = items_.size();
+            for (; beg != end; ++beg)
             {
-                beg = std::begin(items_);
-                end = std::begin(items_) + size_;
-                ++size_;
+                const item i {key, std::size_t(*beg)};
+                set_visible(key, i.index, is_match(i));
+                items_.push_back(i);
             }
-            switch (sorting_)
-            {
-                case sorting::sort_by_broken:
-                    pos = lower_bound(beg, end, a, fileflag::broken);
-                    break;
-                case sorting::sort_by_binary:
-                    pos = lower_bound(beg, end, a, fileflag::binary);
-                    break;
-                case sorting::sort_by_downloaded:
-                    pos = lower_bound(beg, end, a, fileflag::downloaded);
-                    break;
-                case sorting::sort_by_bookmarked:
-                    pos = lower_bound(beg, end, a, fileflag::bookmarked);
-                    break;
+            if (items_.size() == size)
+                return;
 
-                case sorting::sort_by_date:
-                    pos = lower_bound(beg, end, a, &article_t::pubdate);
-                    break;
-                case sorting::sort_by_type:
-                    pos = lower_bound(beg, end, a, &article_t::type);
-                    break;
-                case sorting::sort_by_size:
-                    pos = lower_bound(beg, end, a, &article_t::bytes);
-                    break;
-                case sorting::sort_by_author:
-                    pos = lower_bound(beg, end, a, &article_t::author);
-                    break;
-                case sorting::sort_by_subject:
-                    pos = lower_bound(beg, end, a, &article_t::subject);
-                    break;
-            }
-            items_.insert(pos, {key, index});
+            const auto mid = std::begin(items_) + size;
+            with_key([&](auto k) {
+                this->sort(mid, std::end(items_), k);
+                this->merge(std::begin(items_), mid, std::end(items_), k);
+            });
+            update_rows();
         }
 
+        // get the number of visible items.
         std::size_t size() const
         {
-            return size_;
+            return rows_.size();
         }
 
+        // get the number of all items including the ones that
+        // are currently filtered out.
         std::size_t real_size() const
         {
             return items_.size();
@@ -190,11 +171,22 @@ namespace newsflash
 
         article_t operator[](std::size_t index) const
         {
-            assert(index < size_);
-            const auto& item = items_[index];
+            const auto& item = visible_item(index);
             return on_load(item.key, item.index);
         }
 
+        // get the key of the visible item at the given position.
+        std::size_t item_key(std::size_t index) const
+        {
+            return visible_item(index).key;
+        }
+
+        // get the article index of the visible item at the given position.
+        std::size_t item_index(std::size_t index) const
+        {
+            return visible_item(index).index;
+        }
+
         sorting get_sorting() const
         { return sorting_; }
 
@@ -203,284 +195,453 @@ namespace newsflash
 
         void select(std::size_t index, bool val)
         {
-            assert(index < size_);
-            auto& item = items_[index];
+            assert(index < rows_.size());
+            auto& item = items_[rows_[index]];
             item.bits.set(flags::selected, val);
         }
 
         bool is_selected(std::size_t index) const
         {
-            assert(index < size_);
-            const auto& item = items_[index];
-            return item.bits.test(flags::selected);
+            return visible_item(index).bits.test(flags::selected);
         }
 
+        // run the filter on all items. the items are not moved
+        // around, instead the filter produces a visibility bitmap
+        // and the list of the visible rows is built from that.
         void filter()
         {
-            // we might have items from previous filter that are currently
-            // not being displayed. since the filter might become
-            // more "relaxed" and those items might match we need to put them
-            // back into the "visible" range. also note that we must maintain
-            // the correct sorting
-            auto pred = [this](const item& i) {
-                const auto& a = on_load(i.key, i.index);
-                return is_match(a);
-            };
+            filter(false);
+        }
+
+        // run the filter only on the currently visible items.
+        // this can be used when the new filter is a refinement of the
+        // previous filter, i.e. no item that is currently filtered out
+        // can match the new filter. (for example when the filter string
+        // is extended with more characters)
+        void refine()
+        {
+            filter(true);
+        }
+
+    private:
+        // sorting keys. a key extracts the sorting value from an index item
+        // and from an article object that is being inserted.
+
+        // key that loads the article object for each item.
+        template<typename Member>
+        struct member_key {
+            typedef Member (article_t::*MemPtr)(void) const;
+
+            auto operator()(const item& i) const
+            {
+                const auto& a = self->on_load(i.key, i.index);
+                return (a.*ptr)();
+            }
+            auto operator()(const article_t& a) const
+            {
+                return (a.*ptr)();
+            }
+            const index* self;
+            MemPtr ptr;
+        };
+        struct flag_key {
+            std::uint32_t operator()(const item& i) const
+            {
+                const auto& a = self->on_load(i.key, i.index);
+                return (a.bits() & mask).value();
+            }
+            std::uint32_t operator()(const article_t& a) const
+            {
+                return (a.bits() & mask).value();
+            }
+            const index* self;
+            fileflag mask;
+        };
+
+        // keys that read the value straight from the view columns.
+        struct date_column {
+            std::time_t operator()(const item& i) const
+            { return self->view(i).pubdate(i.index); }
+            std::time_t operator()(const article_t& a) const
+            { return a.pubdate(); }
+            const index* self;
+        };
+        struct size_column {
+            std::uint32_t operator()(const item& i) const
+            { return self->view(i).bytes(i.index); }
+            std::uint32_t operator()(const article_t& a) const
+            { return a.bytes(); }
+            const index* self;
+        };
+        struct type_column {
+            filetype operator()(const item& i) const
+            { return self->view(i).type(i.index); }
+            filetype operator()(const article_t& a) const
+            { return a.type(); }
+            const index* self;
+        };
+        struct flag_column {
+            std::uint32_t operator()(const item& i) const
+            { return (self->view(i).bits(i.index) & mask).value(); }
+            std::uint32_t operator()(const article_t& a) const
+            { return (a.bits() & mask).value(); }
+            const index* self;
+            fileflag mask;
+        };
+        struct subject_column {
+            str::string_view operator()(const item& i) const
+            { return self->view(i).subject(i.index); }
+            str::string_view operator()(const article_t& a) const
+            {
+                const auto& s = a.subject();
+                return {s.c_str(), s.size()};
+            }
+            const index* self;
+        };
+        struct author_column {
+            str::string_view operator()(const item& i) const
+            { return self->view(i).author(i.index); }
+            str::string_view operator()(const article_t& a) const
+            {
+                const auto& s = a.author();
+                return {s.c_str(), s.size()};
+            }
+            const index* self;
+        };
 
-            if (size_ == items_.size())
+        template<typename Member>
+        member_key<Member> key(Member (article_t::*p)(void) const) const
+        {
+            return member_key<Member>{this, p};
+        }
+
+        // invoke the function with the key for the current sorting.
+        template<typename Func>
+        void with_key(Func func) const
+        {
+            if (!views_.empty())
             {
-                auto it = std::stable_partition(std::begin(items_), std::end(items_), pred);
-                size_ = std::distance(std::begin(items_), it);
-                deselect_non_visible();
+                switch (sorting_)
+                {
+                    case sorting::sort_by_broken:
+                        func(flag_column{this, fileflag::broken});
+                        break;
+                    case sorting::sort_by_binary:
+                        func(flag_column{this, fileflag::binary});
+                        break;
+                    case sorting::sort_by_downloaded:
+                        func(flag_column{this, fileflag::downloaded});
+                        break;
+                    case sorting::sort_by_bookmarked:
+                        func(flag_column{this, fileflag::bookmarked});
+                        break;
+                    case sorting::sort_by_date:
+                        func(date_column{this});
+                        break;
+                    case sorting::sort_by_type:
+                        func(type_column{this});
+                        break;
+                    case sorting::sort_by_size:
+                        func(size_column{this});
+                        break;
+                    case sorting::sort_by_author:
+                        func(author_column{this});
+                        break;
+                    case sorting::sort_by_subject:
+                        func(subject_column{this});
+                        break;
+                }
                 return;
             }
 
-            std::deque<item> tmp;
-
-            // partition both the currently visible items and the non-visible
-            // items into visible and nonvisible. this partitions the whole
-            // index into 4 sorted ranges like this.
-            //
-            // [aaaaaa|bbbbbbb|cccccccc|dddd]
-            // beg    a   mid          b    end
-            //
-            // where,
-            // [beg, a) is the new visible range in previously visible range
-            // [a, mid) is the new non-visible range in previously visible
-            // [mid, b) is the new visible range in previously non-visible
-            // [b, end) is the new non-visible range in previously non-visible
-            //
-            // all the ranges are sorted according to the current sorting.
-            // then we merge the 4 ranges into 2 sorted ranges such that,
-            // [aaaaaaaa|bbbbbbbbbbb]
-            // beg      mid         end
-            //
-            // where,
-            // [beg, mid) is the new visible range
-            // [mid, end), is the new non-visible range.
-
-            auto beg = std::begin(items_);
-            auto mid = std::begin(items_) + size_;
-            auto end = std::end(items_);
-
-            auto a = std::stable_partition(beg, mid, pred);
-            auto b = std::stable_partition(mid, end, pred);
-
-            auto out = std::back_inserter(tmp);
             switch (sorting_)
             {
                 case sorting::sort_by_broken:
-                    merge(beg, a, mid, b, out, fileflag::broken);
-                    merge(a, mid, b, end, out, fileflag::broken);
+                    func(flag_key{this, fileflag::broken});
                     break;
-
                 case sorting::sort_by_binary:
-                    merge(beg, a, mid, b, out, fileflag::binary);
-                    merge(a, mid, b, end, out, fileflag::binary);
+                    func(flag_key{this, fileflag::binary});
                     break;
-
                 case sorting::sort_by_downloaded:
-                    merge(beg, a, mid, b, out, fileflag::downloaded);
-                    merge(a, mid, b, end, out, fileflag::downloaded);
+                    func(flag_key{this, fileflag::downloaded});
                     break;
-
                 case sorting::sort_by_bookmarked:
-                    merge(beg, a, mid, b, out, fileflag::bookmarked);
-                    merge(a, mid, b, end, out, fileflag::bookmarked);
+                    func(flag_key{this, fileflag::bookmarked});
                     break;
-
                 case sorting::sort_by_date:
-                    merge(beg, a, mid, b, out, &article_t::pubdate);
-                    merge(a, mid, b, end, out, &article_t::pubdate);
+                    func(key(&article_t::pubdate));
                     break;
-
                 case sorting::sort_by_type:
-                    merge(beg, a, mid, b, out, &article_t::type);
-                    merge(a, mid, b, end, out, &article_t::type);
+                    func(key(&article_t::type));
                     break;
-
                 case sorting::sort_by_size:
-                    merge(beg, a, mid, b, out, &article_t::bytes);
-                    merge(a, mid, b, end, out, &article_t::bytes);
+                    func(key(&article_t::bytes));
                     break;
-
                 case sorting::sort_by_author:
-                    merge(beg, a, mid, b, out, &article_t::author);
-                    merge(a, mid, b, end, out, &article_t::author);
+                    func(key(&article_t::author));
                     break;
-
                 case sorting::sort_by_subject:
-                    merge(beg, a, mid, b, out, &article_t::subject);
-                    merge(a, mid, b, end, out, &article_t::subject);
+                    func(key(&article_t::subject));
                     break;
             }
-            size_  = (a - beg) + (b - mid);
-            items_ = std::move(tmp);
-            deselect_non_visible();
         }
 
-    private:
-        template<typename Class, typename Member>
-        struct bigger_t {
-            typedef Member (Class::*MemPtr)(void) const;
-
-            bigger_t(MemPtr p, loader func) : ptr_(p), load_(func)
-            {}
-
-            bool operator()(const item& lhs, const item& rhs) const
+        template<typename Key>
+        struct smaller_t {
+            template<typename Lhs, typename Rhs>
+            bool operator()(const Lhs& lhs, const Rhs& rhs) const
             {
-                const auto& a = load_(lhs.key, lhs.index);
-                const auto& b = load_(rhs.key, rhs.index);
-                return (a.*ptr_)() > (b.*ptr_)();
+                return key(lhs) < key(rhs);
             }
-            bool operator()(const item& lhs, const article_t& rhs) const
+            Key key;
+        };
+        template<typename Key>
+        struct bigger_t {
+            template<typename Lhs, typename Rhs>
+            bool operator()(const Lhs& lhs, const Rhs& rhs) const
             {
-                const auto& a = load_(lhs.key, lhs.index);
-                const auto& b = rhs;
-                return (a.*ptr_)() > (b.*ptr_)();
+                return key(lhs) > key(rhs);
             }
-        private:
-            MemPtr ptr_;
-            loader load_;
+            Key key;
         };
-        template<typename Class, typename Member>
-        struct smaller_t {
-            typedef Member (Class::*MemPtr)(void) const;
 
-            smaller_t(MemPtr p, loader func) : ptr_(p), load_(func)
-            {}
+        using iterator = typename std::deque<item>::iterator;
+
+        // sort the range by first extracting the sort keys into a contiguous
+        // array so that every item's key is only looked up once instead of
+        // twice per comparison. integer keys are radix sorted and string
+        // keys are sorted on their collation prefixes.
+        template<typename Key>
+        void sort(iterator beg, iterator end, Key key)
+        {
+            using value = typename std::decay<decltype(key(*beg))>::type;
+            using is_integer = std::integral_constant<bool,
+                std::is_integral<value>::value || std::is_enum<value>::value>;
+
+            if (std::distance(beg, end) < 2)
+                return;
+
+            sort(beg, end, key, is_integer());
+        }
+
+        template<typename Key>
+        void sort(iterator beg, iterator end, Key key, std::true_type)
+        {
+            const auto descending = sortdir_ == sortdir::descending;
 
-            bool operator()(const item& lhs, const item& rhs) const
+            std::vector<keysort::entry> keys;
+            keys.reserve(std::distance(beg, end));
+
+            std::uint32_t pos = 0;
+            for (auto it = beg; it != end; ++it, ++pos)
             {
-                const auto& a = load_(lhs.key, lhs.index);
-                const auto& b = load_(rhs.key, rhs.index);
-                return (a.*ptr_)() < (b.*ptr_)();
+                const auto k = keysort::to_key(key(*it));
+                keys.push_back({descending ? ~k : k, pos});
             }
-            bool operator()(const item& lhs, const article_t& rhs) const
+            keysort::radix_sort(keys);
+            permute(beg, end, keys);
+        }
+
+        template<typename Key>
+        void sort(iterator beg, iterator end, Key key, std::false_type)
+        {
+            using value = typename std::decay<decltype(key(*beg))>::type;
+            using entry = keysort::string_entry<value>;
+
+            const auto descending = sortdir_ == sortdir::descending;
+
+            std::vector<entry> keys;
+            keys.reserve(std::distance(beg, end));
+
+            std::uint32_t pos = 0;
+            for (auto it = beg; it != end; ++it, ++pos)
             {
-                const auto& a = load_(lhs.key, lhs.index);
-                const auto& b = rhs;
-                return (a.*ptr_)() < (b.*ptr_)();
+                auto str = key(*it);
+                const auto prefix = keysort::to_prefix(str.c_str(), str.size());
+                keys.push_back({prefix, pos, std::move(str)});
             }
-        private:
-            MemPtr ptr_;
-            loader load_;
-        };
 
-        template<typename Class, typename Member>
-        smaller_t<Class, Member> less(Member (Class::*p)(void) const)
-        {
-            return smaller_t<Class, Member>(p, on_load);
+            // the prefixes decide most of the comparisons, only when
+            // the prefixes are equal we need to compare the full strings.
+            auto comp = [=](const entry& lhs, const entry& rhs) {
+                int ret = 0;
+                if (lhs.key != rhs.key)
+                    ret = lhs.key < rhs.key ? -1 : 1;
+                else ret = keysort::compare(lhs.str.c_str(), lhs.str.size(),
+                    rhs.str.c_str(), rhs.str.size());
+                return descending ? ret > 0 : ret < 0;
+            };
+            keysort::parallel_sort(std::begin(keys), std::end(keys), comp);
+            permute(beg, end, keys);
         }
-        template<typename Class, typename Member>
-        bigger_t<Class, Member> greater(Member (Class::*p)(void) const)
+
+        template<typename Entry>
+        void permute(iterator beg, iterator end, const std::vector<Entry>& keys)
         {
-            return bigger_t<Class, Member>(p, on_load);
+            std::vector<item> tmp;
+            tmp.reserve(keys.size());
+            for (const auto& e : keys)
+                tmp.push_back(beg[e.pos]);
+            std::copy(std::begin(tmp), std::end(tmp), beg);
         }
 
-        using iterator = typename std::deque<item>::iterator;
-
-        template<typename OutputIt, typename MemPtr>
-        void merge(iterator first1, iterator last1,
-            iterator first2, iterator last2, OutputIt out, MemPtr p)
+        template<typename Value, typename Key>
+        iterator lower_bound(iterator beg, iterator end, const Value& value, Key key)
         {
             if (sortdir_ == sortdir::ascending)
-                std::merge(first1, last1, first2, last2, out, less(p));
-            else std::merge(first1, last1, first2, last2, out, greater(p));
+                return std::lower_bound(beg, end, value, smaller_t<Key>{key});
+            else return std::lower_bound(beg, end, value, bigger_t<Key>{key});
         }
 
-        template<typename OutputIt>
-        void merge(iterator first1, iterator last1,
-            iterator first2, iterator last2, OutputIt out, fileflag mask)
+        // merge the two consecutive sorted ranges [beg, mid) and [mid, end).
+        template<typename Key>
+        void merge(iterator beg, iterator mid, iterator end, Key key)
         {
             if (sortdir_ == sortdir::ascending)
-            {
-                std::merge(first1, last1, first2, last2, out, [=](const item& lhs, const item& rhs) {
-                    const auto& a = on_load(lhs.key, lhs.index);
-                    const auto& b = on_load(rhs.key, rhs.index);
-                    return (a.bits() & mask).value()  < (b.bits() & mask).value();
-                });
-            }
-            else
-            {
-                std::merge(first1, last1, first2, last2, out, [=](const item& lhs, const item& rhs) {
-                    const auto& a = on_load(lhs.key, lhs.index);
-                    const auto& b = on_load(rhs.key, rhs.index);
-                    return (a.bits() & mask).value() > (b.bits() & mask).value();
-                });
-            }
+                std::inplace_merge(beg, mid, end, smaller_t<Key>{key});
+            else std::inplace_merge(beg, mid, end, bigger_t<Key>{key});
+        }
+
+        template<typename Value>
+        void insert(const Value& value, bool match, std::size_t key, std::size_t index)
+        {
+            set_visible(key, index, match);
+
+            iterator pos;
+            with_key([&](auto k) {
+                pos = this->lower_bound(std::begin(items_), std::end(items_), value, k);
+            });
+            const std::uint32_t row = std::distance(std::begin(items_), pos);
+            items_.insert(pos, {key, index});
+
+            // the positions of the visible items after the new item shift by one.
+            auto it = std::lower_bound(std::begin(rows_), std::end(rows_), row);
+            for (auto r = it; r != std::end(rows_); ++r)
+                ++(*r);
+            if (match)
+                rows_.insert(it, row);
         }
 
-        template<typename MemPtr>
-        void sort(sortdir up_down, MemPtr p)
+        void filter(bool visible_only)
         {
-            auto beg = std::begin(items_);
-            auto mid = std::begin(items_) + size_;
-            auto end = std::end(items_);
-            if (up_down == sortdir::ascending)
+            if (!views_.empty() && on_filter_row)
             {
-                std::sort(beg, mid, less(p));
-                std::sort(mid, end, less(p));
+                filter_views(visible_only);
             }
             else
             {
-                std::sort(beg, mid, greater(p));
-                std::sort(mid, end, greater(p));
+                for (const auto& i : items_)
+                {
+                    if (visible_only && !is_visible(i))
+                        continue;
+                    set_visible(i.key, i.index, is_match(i));
+                }
             }
+            update_rows();
         }
 
-        void sort(sortdir up_down, fileflag mask)
+        // filter the rows of the attached views in parallel. the rows are
+        // split into chunks of whole bitmap words so that each thread
+        // writes to its own words only.
+        void filter_views(bool visible_only)
         {
-            auto beg = std::begin(items_);
-            auto mid = std::begin(items_) + size_;
-            auto end = std::end(items_);
-            if (up_down == sortdir::ascending)
+            struct chunk {
+                std::size_t key;
+                std::size_t first_word;
+                std::size_t last_word;
+            };
+            const std::size_t WordsPerChunk = 1024;
+
+            std::vector<chunk> chunks;
+            for (std::size_t key=0; key<views_.size(); ++key)
             {
-                auto pred = [=](const item& lhs, const item& rhs) {
-                    const auto& a = on_load(lhs.key, lhs.index);
-                    const auto& b = on_load(rhs.key, rhs.index);
-                    return (a.bits() & mask).value()  < (b.bits() & mask).value();
-                };
-                std::sort(beg, mid, pred);
-                std::sort(mid, end, pred);
+                if (!views_[key])
+                    continue;
+                const auto words = (views_[key]->size() + 63) / 64;
+                if (key >= visible_.size())
+                    visible_.resize(key + 1);
+                visible_[key].resize(words);
+                for (std::size_t w=0; w<words; w+=WordsPerChunk)
+                    chunks.push_back({key, w, std::min(w + WordsPerChunk, words)});
             }
-            else
+
+            auto run = [&](std::size_t first, std::size_t last) {
+                for (std::size_t c=first; c<last; ++c)
+                {
+                    const auto& chunk = chunks[c];
+                    const auto& view  = *views_[chunk.key];
+                    auto& bitmap = visible_[chunk.key];
+                    for (std::size_t w=chunk.first_word; w<chunk.last_word; ++w)
+                    {
+                        std::uint64_t bits = 0;
+                        for (std::size_t b=0; b<64; ++b)
+                        {
+                            const auto row = w * 64 + b;
+                            if (visible_only && !(bitmap[w] & (std::uint64_t(1) << b)))
+                                continue;
+                            if (!view.has_row(row))
+                                continue;
+                            if (on_filter_row(view, row))
+                                bits |= std::uint64_t(1) << b;
+                        }
+                        bitmap[w] = bits;
+                    }
+                }
+            };
+
+            const std::size_t threads = std::min<std::size_t>(chunks.size(),
+                std::max(1u, std::thread::hardware_concurrency()));
+            if (threads < 2)
+            {
+                run(0, chunks.size());
+                return;
+            }
+            std::vector<std::future<void>> jobs;
+            for (std::size_t t=0; t<threads; ++t)
             {
-                auto pred = [=](const item& lhs, const item& rhs) {
-                    const auto& a = on_load(lhs.key, lhs.index);
-                    const auto& b = on_load(rhs.key, rhs.index);
-                    return (a.bits() & mask).value() > (b.bits() & mask).value();
-                };
-                std::sort(beg, mid, pred);
-                std::sort(mid, end, pred);
+                const auto first = chunks.size() * t / threads;
+                const auto last  = chunks.size() * (t + 1) / threads;
+                jobs.push_back(std::async(std::launch::async, run, first, last));
             }
+            for (auto& job : jobs)
+                job.get();
         }
 
-        template<typename MemPtr>
-        iterator lower_bound(iterator beg, iterator end, const article_t& a, MemPtr p)
+        const catalog_view& view(const item& i) const
         {
-            if (sortdir_ == sortdir::ascending)
-                return std::lower_bound(beg, end, a, less(p));
-            else return std::lower_bound(beg, end, a, greater(p));
+            ASSERT(i.key < views_.size() && views_[i.key]);
+            return *views_[i.key];
         }
 
-        iterator lower_bound(iterator beg, iterator end, const article_t& a, fileflag mask)
+        const item& visible_item(std::size_t index) const
         {
-            if (sortdir_ == sortdir::ascending) {
-                return std::lower_bound(beg, end, a, [=](const item& lhs, const article_t& rhs) {
-                    const auto& a = on_load(lhs.key, lhs.index);
-                    const auto& b = rhs;
-                    return (a.bits() & mask).value() < (b.bits() & mask).value();
-                });
-            }
-            else
-            {
-                return std::lower_bound(beg, end, a, [=](const item& lhs, const article_t& rhs) {
-                    const auto& a = on_load(lhs.key, lhs.index);
-                    const auto& b = rhs;
-                    return (a.bits() & mask).value() > (b.bits() & mask).value();
-                });
-            }
+            assert(index < rows_.size());
+            return items_[rows_[index]];
+        }
+
+        bool is_visible(const item& i) const
+        {
+            if (i.key >= visible_.size())
+                return false;
+            const auto& bitmap = visible_[i.key];
+            const auto word = i.index / 64;
+            if (word >= bitmap.size())
+                return false;
+            return (bitmap[word] >> (i.index % 64)) & 1;
+        }
+
+        void set_visible(std::size_t key, std::size_t index, bool on_off)
+        {
+            if (key >= visible_.size())
+                visible_.resize(key + 1);
+            auto& bitmap = visible_[key];
+            const auto word = index / 64;
+            if (word >= bitmap.size())
+                bitmap.resize(word + 1);
+            const auto bit = std::uint64_t(1) << (index % 64);
+            if (on_off)
+                bitmap[word] |= bit;
+            else bitmap[word] &= ~bit;
         }
 
         bool is_match(const article_t& a) const
@@ -488,14 +649,26 @@ namespace newsflash
             return on_filter(a);
         }
 
-        void deselect_non_visible()
+        bool is_match(const item& i) const
         {
-            auto beg = std::begin(items_) + size_;
-            auto end = std::end(items_);
-            for (; beg != end; ++beg)
+            if (!views_.empty() && on_filter_row)
+                return on_filter_row(view(i), i.index);
+
+            const auto& a = on_load(i.key, i.index);
+            return on_filter(a);
+        }
+
+        // rebuild the list of visible rows from the visibility bitmap.
+        // the items that are not visible are also deselected.
+        void update_rows()
+        {
+            rows_.clear();
+            for (std::size_t pos=0; pos<items_.size(); ++pos)
             {
-                auto& item = *beg;
-                item.bits.set(flags::selected, false);
+                auto& item = items_[pos];
+                if (is_visible(item))
+                    rows_.push_back(pos);
+                else item.bits.set(flags::selected, false);
             }
         }
 
@@ -506,7 +679,11 @@ namespace newsflash
             bitflag<flags> bits;
         };
         std::deque<item> items_;
-        std::size_t size_;
+        // positions of the visible items in items_.
+        std::vector<std::uint32_t> rows_;
+        // visibility bitmap per key indexed by the article index.
+        std::vector<std::vector<std::uint64_t>> visible_;
+        std::vector<const catalog_view*> views_;
     private:
         sorting sorting_;
         sortdir sortdir_;
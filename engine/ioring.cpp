@@ -0,0 +1,480 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#if defined(LINUX_OS)
+#  include <linux/io_uring.h>
+#  include <sys/syscall.h>
+#  include <sys/mman.h>
+#  include <sys/uio.h>
+#  include <sys/eventfd.h>
+#  include <poll.h>
+#  include <unistd.h>
+#  include <climits>
+#endif
+
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstring>
+
+#include "ioring.h"
+#include "assert.h"
+
+namespace newsflash
+{
+
+#if defined(LINUX_OS)
+
+namespace {
+
+int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+template<typename T>
+T load_acquire(const T* ptr)
+{ return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+
+template<typename T>
+void store_release(T* ptr, T value)
+{ __atomic_store_n(ptr, value, __ATOMIC_RELEASE); }
+
+} // namespace
+
+struct IoRing::State {
+    int fd = -1;
+
+    // the submission queue shared with the kernel.
+    void* sq_ring = nullptr;
+    std::size_t sq_ring_size = 0;
+    unsigned* sq_head  = nullptr;
+    unsigned* sq_tail  = nullptr;
+    unsigned* sq_mask  = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned  sq_entries = 0;
+    io_uring_sqe* sqes = nullptr;
+    std::size_t sqes_size = 0;
+
+    // the completion queue shared with the kernel.
+    void* cq_ring = nullptr;
+    std::size_t cq_ring_size = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    struct Chain;
+
+    // a single request in the ring. the address of the request
+    // is the user data that identifies the completion.
+    struct Request {
+        Chain* chain = nullptr;
+        std::size_t bytes = 0;
+    };
+
+    struct Chain {
+        std::vector<Request> requests;
+        std::vector<std::vector<iovec>> iovecs;
+        std::size_t pending = 0;
+        std::error_code error;
+        OnComplete callback;
+    };
+
+    // the submitted requests belong to the thread that passed them to
+    // the kernel and get canceled if the thread exits. so the requests
+    // are only queued by the callers and the ring's own thread passes
+    // them to the kernel and then reaps the completions.
+    int wakeup = -1;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::size_t num_pending = 0;
+    bool shutdown = false;
+
+    std::thread thread;
+
+    void Submit(int file, std::unique_ptr<Chain> chain, const Write* writes, std::size_t count, bool sync)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        const auto num_requests = (unsigned)chain->requests.size();
+        ASSERT(num_requests <= sq_entries);
+
+        // wait until the kernel has consumed enough of the queue.
+        unsigned tail = *sq_tail;
+        cond.wait(lock, [&]() {
+            return sq_entries - (tail - load_acquire(sq_head)) >= num_requests;
+        });
+
+        for (unsigned i=0; i<num_requests; ++i)
+        {
+            const unsigned index = tail & *sq_mask;
+            io_uring_sqe* sqe = &sqes[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+
+            auto& request = chain->requests[i];
+            request.chain = chain.get();
+            if (i < count)
+            {
+                const auto& iov = chain->iovecs[i];
+                sqe->opcode = IORING_OP_WRITEV;
+                sqe->addr   = (std::uint64_t)iov.data();
+                sqe->len    = (unsigned)iov.size();
+                sqe->off    = writes[i].offset;
+            }
+            else
+            {
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+            }
+            sqe->fd = file;
+            if (i + 1 < num_requests)
+                sqe->flags |= IOSQE_IO_LINK;
+            if (i == 0 && sync)
+                sqe->flags |= IOSQE_IO_DRAIN;
+            sqe->user_data = (std::uint64_t)&request;
+
+            sq_array[index] = index;
+            ++tail;
+        }
+        store_release(sq_tail, tail);
+        ++num_pending;
+        chain.release();
+        lock.unlock();
+
+        WakeUp();
+    }
+
+    void WakeUp()
+    {
+        const std::uint64_t value = 1;
+        while (::write(wakeup, &value, sizeof(value)) == -1 && errno == EINTR)
+            ;
+    }
+
+    // pass the queued requests to the kernel. returns false
+    // if the kernel is busy and the completions need to be reaped first.
+    bool Enter()
+    {
+        const unsigned to_submit = load_acquire(sq_tail) - load_acquire(sq_head);
+        if (!to_submit)
+            return true;
+
+        const int ret = io_uring_enter(fd, to_submit, 0, 0);
+        if (ret < 0)
+        {
+            if (errno == EBUSY || errno == EAGAIN || errno == EINTR)
+                return false;
+            throw std::system_error(errno, std::system_category(), "io_uring_enter failed");
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        cond.notify_all();
+        return (unsigned)ret == to_submit;
+    }
+
+    // invoke the callbacks of the completed chains.
+    // returns the number of completions.
+    unsigned Reap()
+    {
+        unsigned head = *cq_head;
+        const unsigned tail = load_acquire(cq_tail);
+        const unsigned num_completions = tail - head;
+
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe* cqe = &cqes[head & *cq_mask];
+            auto* request = (Request*)cqe->user_data;
+            auto* chain   = request->chain;
+            std::error_code error;
+            if (cqe->res < 0)
+                error = std::error_code(-cqe->res, std::system_category());
+            else if ((std::size_t)cqe->res != request->bytes)
+                error = std::make_error_code(std::errc::io_error);
+
+            // the requests linked after a failed request complete
+            // as canceled, keep the error that caused it.
+            if (error && (!chain->error || chain->error == std::errc::operation_canceled))
+                chain->error = error;
+
+            if (--chain->pending)
+                continue;
+
+            std::unique_ptr<Chain> done(chain);
+            if (done->callback)
+                done->callback(done->error);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--num_pending == 0)
+                cond.notify_all();
+        }
+        store_release(cq_head, head);
+        return num_completions;
+    }
+
+    void Run()
+    {
+        for (;;)
+        {
+            const bool submitted = Enter();
+            const auto reaped = Reap();
+            if (!submitted || reaped)
+                continue;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (shutdown && num_pending == 0)
+                    return;
+            }
+
+            // wait for more requests or completions.
+            pollfd fds[2];
+            fds[0].fd = fd;
+            fds[0].events = POLLIN;
+            fds[0].revents = 0;
+            fds[1].fd = wakeup;
+            fds[1].events = POLLIN;
+            fds[1].revents = 0;
+            if (::poll(fds, 2, -1) == -1 && errno != EINTR)
+                throw std::system_error(errno, std::system_category(), "poll failed");
+
+            if (fds[1].revents & POLLIN)
+            {
+                std::uint64_t value = 0;
+                ::read(wakeup, &value, sizeof(value));
+            }
+        }
+    }
+};
+
+IoRing::IoRing(unsigned entries)
+{
+    std::unique_ptr<State> state(new State);
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    state->fd = io_uring_setup(entries, &params);
+    if (state->fd < 0)
+        throw std::system_error(errno, std::system_category(), "io_uring_setup failed");
+
+    // without the NODROP feature the completions could get lost
+    // when the completion queue overflows.
+    if (!(params.features & IORING_FEAT_NODROP))
+    {
+        ::close(state->fd);
+        throw std::system_error(ENOSYS, std::system_category(), "io_uring is not supported");
+    }
+
+    state->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    state->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    state->sqes_size    = params.sq_entries * sizeof(io_uring_sqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        state->sq_ring_size = std::max(state->sq_ring_size, state->cq_ring_size);
+        state->cq_ring_size = state->sq_ring_size;
+    }
+
+    const auto map = [&](std::size_t size, off_t offset) {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, state->fd, offset);
+        if (ptr == MAP_FAILED)
+        {
+            const int err = errno;
+            if (state->sq_ring)
+                munmap(state->sq_ring, state->sq_ring_size);
+            if (state->cq_ring && state->cq_ring != state->sq_ring)
+                munmap(state->cq_ring, state->cq_ring_size);
+            ::close(state->fd);
+            throw std::system_error(err, std::system_category(), "io_uring mmap failed");
+        }
+        return ptr;
+    };
+
+    state->sq_ring = map(state->sq_ring_size, IORING_OFF_SQ_RING);
+    state->cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP)
+        ? state->sq_ring
+        : map(state->cq_ring_size, IORING_OFF_CQ_RING);
+    state->sqes = (io_uring_sqe*)map(state->sqes_size, IORING_OFF_SQES);
+
+    char* sq = (char*)state->sq_ring;
+    state->sq_head    = (unsigned*)(sq + params.sq_off.head);
+    state->sq_tail    = (unsigned*)(sq + params.sq_off.tail);
+    state->sq_mask    = (unsigned*)(sq + params.sq_off.ring_mask);
+    state->sq_array   = (unsigned*)(sq + params.sq_off.array);
+    state->sq_entries = params.sq_entries;
+
+    char* cq = (char*)state->cq_ring;
+    state->cq_head = (unsigned*)(cq + params.cq_off.head);
+    state->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    state->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    state->cqes    = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    state->wakeup = eventfd(0, EFD_CLOEXEC);
+    if (state->wakeup == -1)
+    {
+        const int err = errno;
+        munmap(state->sqes, state->sqes_size);
+        if (state->cq_ring != state->sq_ring)
+            munmap(state->cq_ring, state->cq_ring_size);
+        munmap(state->sq_ring, state->sq_ring_size);
+        ::close(state->fd);
+        throw std::system_error(err, std::system_category(), "create eventfd failed");
+    }
+
+    State* ptr = state.get();
+    state->thread = std::thread([ptr]() {
+        ptr->Run();
+    });
+    state_ = std::move(state);
+}
+
+IoRing::~IoRing()
+{
+    {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->cond.wait(lock, [&]() {
+            return state_->num_pending == 0;
+        });
+        state_->shutdown = true;
+    }
+    state_->WakeUp();
+    state_->thread.join();
+
+    munmap(state_->sqes, state_->sqes_size);
+    if (state_->cq_ring != state_->sq_ring)
+        munmap(state_->cq_ring, state_->cq_ring_size);
+    munmap(state_->sq_ring, state_->sq_ring_size);
+    ::close(state_->wakeup);
+    ::close(state_->fd);
+}
+
+void IoRing::Submit(const bigfile& file, const Write* writes, std::size_t count,
+    bool sync, OnComplete callback)
+{
+    ASSERT(count || sync);
+
+    std::unique_ptr<State::Chain> chain(new State::Chain);
+    chain->callback = std::move(callback);
+    chain->iovecs.resize(count);
+    chain->requests.resize(count + (sync ? 1 : 0));
+    chain->pending = chain->requests.size();
+    if (chain->requests.size() > GetMaxChain())
+        throw std::invalid_argument("io_uring chain is too long");
+
+    for (std::size_t i=0; i<count; ++i)
+    {
+        const auto& write = writes[i];
+        if (write.count > GetMaxBuffers())
+            throw std::invalid_argument("io_uring write has too many buffers");
+
+        auto& iov = chain->iovecs[i];
+        for (std::size_t j=0; j<write.count; ++j)
+        {
+            iovec vec;
+            vec.iov_base = const_cast<void*>(write.bufs[j].data);
+            vec.iov_len  = write.bufs[j].size;
+            iov.push_back(vec);
+            chain->requests[i].bytes += vec.iov_len;
+        }
+    }
+    state_->Submit(file.native_handle(), std::move(chain), writes, count, sync);
+}
+
+std::size_t IoRing::GetMaxChain() const
+{
+    return state_->sq_entries;
+}
+
+std::size_t IoRing::GetNumPending() const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->num_pending;
+}
+
+std::size_t IoRing::GetMaxBuffers()
+{
+    return IOV_MAX;
+}
+
+IoRing* IoRing::Get()
+{
+    static std::once_flag once;
+    static std::unique_ptr<IoRing> ring;
+    std::call_once(once, []() {
+        try
+        {
+            ring.reset(new IoRing);
+        }
+        catch (const std::exception&)
+        {}
+    });
+    return ring.get();
+}
+
+bool IoRing::IsSupported()
+{
+    return Get() != nullptr;
+}
+
+#else
+
+IoRing::IoRing(unsigned)
+{
+    throw std::system_error(std::make_error_code(std::errc::function_not_supported),
+        "io_uring is not supported");
+}
+
+IoRing::~IoRing()
+{}
+
+void IoRing::Submit(const bigfile&, const Write*, std::size_t, bool, OnComplete)
+{}
+
+std::size_t IoRing::GetMaxChain() const
+{ return 0; }
+
+std::size_t IoRing::GetNumPending() const
+{ return 0; }
+
+std::size_t IoRing::GetMaxBuffers()
+{ return 0; }
+
+IoRing* IoRing::Get()
+{ return nullptr; }
+
+bool IoRing::IsSupported()
+{ return false; }
+
+#endif
+
+} // newsflash
@@ -0,0 +1,95 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "newsflash/config.h"
+
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <cstddef>
+#include <cstdint>
+
+#include "bigfile.h"
+
+namespace newsflash
+{
+    // IoRing writes files asynchronously through the Linux io_uring
+    // interface. The requests are queued to the kernel without blocking
+    // the calling thread and a completion thread owned by the ring
+    // invokes the completion callbacks as the kernel completes them.
+    // Not available on other platforms or when the kernel doesn't support
+    // io_uring (or it's disabled), see IsSupported.
+    class IoRing
+    {
+    public:
+        // a write of the buffers one after another starting at the offset.
+        struct Write {
+            std::uint64_t offset = 0;
+            const bigfile::iobuf* bufs = nullptr;
+            std::size_t count = 0;
+        };
+
+        // invoked on the completion thread once all the requests of
+        // a chain are complete. the error is the first error if any.
+        // the callback must not block, throw or submit more requests.
+        using OnComplete = std::function<void (const std::error_code&)>;
+
+        // create a new ring with room for the given number of requests.
+        // throws std::system_error if io_uring is not available.
+        IoRing(unsigned entries = 256);
+
+        // waits for the pending requests to complete.
+       ~IoRing();
+
+        // submit the writes to the file as a chain of linked requests, i.e.
+        // each request starts only after the previous one has completed.
+        // if sync is true the chain ends with a fdatasync of the file and
+        // the chain is started only after all the previously submitted
+        // requests have completed so that the sync covers them too.
+        // the buffers must remain valid until the callback is invoked.
+        // the number of writes (plus the sync) must not exceed GetMaxChain
+        // and the number of buffers in a write must not exceed GetMaxBuffers.
+        void Submit(const bigfile& file, const Write* writes, std::size_t count,
+            bool sync, OnComplete callback);
+
+        // get the maximum number of requests in a single chain.
+        std::size_t GetMaxChain() const;
+
+        // get the maximum number of buffers in a single write.
+        static std::size_t GetMaxBuffers();
+
+        // get the number of chains that haven't completed yet.
+        std::size_t GetNumPending() const;
+
+        // get the shared ring used for the data files or nullptr
+        // if io_uring is not available.
+        static IoRing* Get();
+
+        // returns true if io_uring is available.
+        static bool IsSupported();
+
+    private:
+        struct State;
+        std::unique_ptr<State> state_;
+    };
+
+} // newsflash
@@ -0,0 +1,191 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "newsflash/config.h"
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+
+// Sorting on extracted keys. Instead of sorting the objects with a comparator
+// that needs to look up the sort values on every comparison the values are
+// extracted once into a contiguous array of (key, position) pairs which is
+// then sorted and finally used to permute the objects.
+
+namespace newsflash
+{
+namespace keysort
+{
+    struct entry {
+        std::uint64_t key;
+        std::uint32_t pos;
+    };
+
+    // string key with its collation prefix (see to_prefix)
+    template<typename String>
+    struct string_entry {
+        std::uint64_t key;
+        std::uint32_t pos;
+        String str;
+    };
+
+    // map an integral (or enum) value into an unsigned 64bit key
+    // that sorts in the same order as the original value.
+    template<typename T>
+    std::uint64_t to_key(T value, std::true_type /* is_signed */)
+    {
+        return std::uint64_t(std::int64_t(value)) ^ (std::uint64_t(1) << 63);
+    }
+    template<typename T>
+    std::uint64_t to_key(T value, std::false_type /* is_signed */)
+    {
+        return std::uint64_t(value);
+    }
+
+    template<typename T>
+    std::uint64_t to_key(T value)
+    {
+        using type = typename std::conditional<std::is_enum<T>::value,
+            std::underlying_type<T>, std::common_type<T>>::type::type;
+        return to_key(type(value), std::is_signed<type>());
+    }
+
+    // get a collation prefix of a string, i.e. the first 8 bytes as
+    // a big endian integer. Comparing prefixes gives the same order as
+    // comparing the strings unless the prefixes are equal.
+    inline
+    std::uint64_t to_prefix(const char* str, std::size_t len)
+    {
+        std::uint64_t ret = 0;
+        const auto bytes = std::min<std::size_t>(len, 8);
+        for (std::size_t i=0; i<bytes; ++i)
+            ret |= std::uint64_t((unsigned char)str[i]) << (56 - 8 * i);
+        return ret;
+    }
+
+    // compare two strings bytewise. returns <0, 0 or >0
+    inline
+    int compare(const char* lhs, std::size_t lhs_len, const char* rhs, std::size_t rhs_len)
+    {
+        const auto ret = std::memcmp(lhs, rhs, std::min(lhs_len, rhs_len));
+        if (ret)
+            return ret;
+        if (lhs_len < rhs_len)
+            return -1;
+        else if (lhs_len > rhs_len)
+            return 1;
+        return 0;
+    }
+
+    // stable LSD radix sort on the keys 8 bits at a time.
+    // the passes where every key has the same byte value are skipped
+    // which is common with for example dates or small integers.
+    inline
+    void radix_sort(std::vector<entry>& keys)
+    {
+        const auto size = keys.size();
+        if (size < 2)
+            return;
+
+        std::vector<entry> tmp(size);
+        for (unsigned shift=0; shift<64; shift+=8)
+        {
+            std::size_t count[256] = {0};
+            for (const auto& e : keys)
+                ++count[(e.key >> shift) & 0xff];
+
+            if (count[(keys[0].key >> shift) & 0xff] == size)
+                continue;
+
+            std::size_t sum = 0;
+            for (auto& c : count)
+            {
+                const auto n = c;
+                c = sum;
+                sum += n;
+            }
+            for (const auto& e : keys)
+                tmp[count[(e.key >> shift) & 0xff]++] = e;
+
+            keys.swap(tmp);
+        }
+    }
+
+    // stable merge sort that sorts chunks of the range in parallel
+    // and then merges the sorted chunks pairwise (also in parallel).
+    // if threads is 0 the number of hardware threads is used.
+    template<typename RandomIt, typename Compare>
+    void parallel_sort(RandomIt beg, RandomIt end, Compare comp, unsigned threads = 0)
+    {
+        const std::size_t size = std::distance(beg, end);
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        // not worth the overhead of threads.
+        const std::size_t MinChunk = 8192;
+        threads = std::min<std::size_t>(threads, size / MinChunk);
+        if (threads < 2)
+        {
+            std::stable_sort(beg, end, comp);
+            return;
+        }
+
+        std::vector<RandomIt> bounds;
+        for (unsigned i=0; i<threads; ++i)
+            bounds.push_back(beg + size * i / threads);
+        bounds.push_back(end);
+
+        std::vector<std::future<void>> jobs;
+        for (unsigned i=0; i<threads; ++i)
+        {
+            const auto first = bounds[i];
+            const auto last  = bounds[i+1];
+            jobs.push_back(std::async(std::launch::async, [=]() {
+                std::stable_sort(first, last, comp);
+            }));
+        }
+        for (auto& job : jobs)
+            job.get();
+
+        for (std::size_t width=1; width<threads; width*=2)
+        {
+            jobs.clear();
+            for (std::size_t i=0; i+width<threads; i+=2*width)
+            {
+                const auto first  = bounds[i];
+                const auto middle = bounds[i+width];
+                const auto last   = bounds[std::min<std::size_t>(i+2*width, threads)];
+                jobs.push_back(std::async(std::launch::async, [=]() {
+                    std::inplace_merge(first, middle, last, comp);
+                }));
+            }
+            for (auto& job : jobs)
+                job.get();
+        }
+    }
+
+} // keysort
+} // newsflash
@@ -56,7 +56,7 @@ Listing::~Listing()
     state_->discard = true;
 }
 
-std::shared_ptr<CmdList> Listing::CreateCommands()
+std::shared_ptr<CmdList> Listing::CreateCommands(const PipelineDepth&)
 {
     std::shared_ptr<CmdList> cmd(new CmdList(CmdList::Listing{}));
     if (state_->progress_callback)
@@ -55,7 +55,7 @@ namespace newsflash
        ~Listing();
 
         // Task implementation
-        virtual std::shared_ptr<CmdList> CreateCommands() override;
+        virtual std::shared_ptr<CmdList> CreateCommands(const PipelineDepth& depth = PipelineDepth()) override;
         virtual void Complete(CmdList& cmd,
             std::vector<std::unique_ptr<action>>& actions) override;
         virtual bool HasCommands() const override;
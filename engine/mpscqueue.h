@@ -0,0 +1,101 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "newsflash/config.h"
+
+#include <atomic>
+#include <utility>
+
+namespace newsflash
+{
+    // Unbounded multiple producer single consumer queue.
+    // Any number of threads can push into the queue without locking
+    // (a push is a single atomic exchange) but only one thread at a time
+    // may pop. A pop can transiently report the queue as empty while a
+    // push is in progress in another thread, so the producers should
+    // signal the consumer after pushing (and not before).
+    template<typename T>
+    class MpscQueue
+    {
+    public:
+        MpscQueue()
+        {
+            auto* stub = new Node;
+            head_.store(stub);
+            tail_ = stub;
+        }
+       ~MpscQueue()
+        {
+            T value;
+            while (Pop(&value))
+                ;
+            delete tail_;
+        }
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        // push a new value into the queue. this can be called
+        // from any thread.
+        void Push(T value)
+        {
+            auto* node = new Node;
+            node->value = std::move(value);
+            auto* prev = head_.exchange(node, std::memory_order_acq_rel);
+            prev->next.store(node, std::memory_order_release);
+        }
+
+        // pop the oldest value from the queue. returns false if the
+        // queue was empty. this must only be called by the consumer thread.
+        bool Pop(T* value)
+        {
+            auto* tail = tail_;
+            auto* next = tail->next.load(std::memory_order_acquire);
+            if (next == nullptr)
+                return false;
+
+            // the popped node becomes the new stub node.
+            *value = std::move(next->value);
+            next->value = T();
+            tail_ = next;
+            delete tail;
+            return true;
+        }
+
+        // check whether the queue is empty. this must only be
+        // called by the consumer thread.
+        bool IsEmpty() const
+        {
+            return tail_->next.load(std::memory_order_acquire) == nullptr;
+        }
+
+    private:
+        struct Node {
+            std::atomic<Node*> next {nullptr};
+            T value;
+        };
+        // producers append after the head.
+        std::atomic<Node*> head_;
+        // the consumer pops after the tail.
+        Node* tail_ = nullptr;
+    };
+
+} // newsflash
@@ -21,7 +21,6 @@
 #include "newsflash/config.h"
 
 #include "newsflash/warnpush.h"
-#  include <boost/spirit/include/classic.hpp>
 #  include <boost/functional/hash.hpp>
 #  include <boost/regex.hpp>
 #include "newsflash/warnpop.h"
@@ -30,6 +29,8 @@
 #include <algorithm>
 #include <stack>
 #include <cctype>
+#include <cstring>
+#include <limits>
 
 #ifndef BOOST_HAS_THREADS
 #  error Boost is not in thread safe mode.
@@ -63,23 +64,21 @@ namespace {
         field.start = nullptr;
         field.len   = 0;
 
-        size_t len = 0;
         const char* start = &parser.str[parser.pos];
-        for (; parser.pos < parser.len; ++parser.pos)
+        const char* tab   = static_cast<const char*>(std::memchr(start, '\t', parser.len - parser.pos));
+        if (!tab)
         {
-            if (parser.str[parser.pos] == '\t')
-            {
-                if (len > 0)
-                {
-                    field.start = start;
-                    field.len   = len;
-                }
-                ++parser.pos;
-                return true;
-            }
-            ++len;
+            parser.pos = parser.len;
+            return false;
         }
-        return false;
+        const size_t len = tab - start;
+        if (len > 0)
+        {
+            field.start = start;
+            field.len   = len;
+        }
+        parser.pos += len + 1;
+        return true;
     }
 
     bool strip_leading_crap(overview_parser& parser)
@@ -124,6 +123,19 @@ namespace {
         R"([0-9]{1,3}s\.|ffai\.|fws\.|sdn\.|st\.|3ca\.|rrs\.)" \
         R"(v4m\.|vlf\.|mhc\.)";
 
+    inline bool is_digit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+    inline bool is_alpha(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+    inline char to_lower(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
     // part count notation indicates the segment of the file when the file is split
     // to multiple NNTP posts. Usual notation is (xx/yy) but sometimes [xx/yy] is used
     // also note that sometimes subject lines contain both. In this case the [xx/yy] is considered
@@ -131,34 +143,246 @@ namespace {
     // so [xx/yy] is not considered as part count unless (xx/yy) is not found.
     const char* find_part_count(const char* subjectline, std::size_t len, std::size_t& i)
     {
-        // NOTE: the regex is in reverse because the search is from the tail
+        // the search is from the tail and the last match wins.
         // this matches "metallica - enter sandman.mp3 (01/50)"
-         const static boost::regex ex("(\\]|\\))[0-9]*/[0-9]*(\\(|\\[)");
+        // the brackets can be of either kind and the numbers
+        // can be missing, i.e. "(/)" is a match too.
+        for (std::size_t end = len; end > 0; --end)
+        {
+            const char close = subjectline[end - 1];
+            if (close != ')' && close != ']')
+                continue;
+
+            std::size_t pos = end - 1;
+            while (pos > 0 && is_digit(subjectline[pos - 1]))
+                --pos;
+            if (pos == 0 || subjectline[pos - 1] != '/')
+                continue;
+            --pos;
+            while (pos > 0 && is_digit(subjectline[pos - 1]))
+                --pos;
+            if (pos == 0)
+                continue;
+            const char open = subjectline[pos - 1];
+            if (open != '(' && open != '[')
+                continue;
+            --pos;
+
+            // some people use this gay notation of prefixing their stuff with (xx/yy) notation
+            // to indicate all the articles of their posting "batch". This has nothing to do with
+            // with the yEnc part count hack. So if the search returned a match at the beginning, ignore this.
+            if (pos == 0)
+                return nullptr;
+
+            i = end - pos;
+            return subjectline + pos;
+        }
+        return nullptr;
+    }
 
-         nntp::reverse_c_str_iterator itbeg(subjectline + len - 1);
-         nntp::reverse_c_str_iterator itend(subjectline - 1);
+    // parse an unsigned 32bit integer. at least one digit is required.
+    bool parse_uint(const char*& pos, const char* end, unsigned& value)
+    {
+        const char* p = pos;
+        unsigned ret = 0;
+        for (; p != end && is_digit(*p); ++p)
+        {
+            const unsigned digit = *p - '0';
+            if (ret > (std::numeric_limits<unsigned>::max() - digit) / 10)
+                return false;
+            ret = ret * 10 + digit;
+        }
+        if (p == pos)
+            return false;
+        pos   = p;
+        value = ret;
+        return true;
+    }
+
+    // scanner for the fixed format of the article date. spaces are
+    // allowed before every token and between the letters of a word
+    // but the date may not end with a space. if a token isn't
+    // found the position is left where it was.
+    struct date_scanner {
+        const char* pos;
+        const char* end;
+
+        const char* skip() const
+        {
+            const char* p = pos;
+            while (p != end && *p == ' ')
+                ++p;
+            return p;
+        }
+        bool match(char c)
+        {
+            const char* p = skip();
+            if (p == end || *p != c)
+                return false;
+            pos = p + 1;
+            return true;
+        }
+        bool uint(int& value)
+        {
+            const char* p = skip();
+            unsigned ret = 0;
+            if (!parse_uint(p, end, ret))
+                return false;
+            value = int(ret);
+            pos   = p;
+            return true;
+        }
+        // optional signed integer.
+        void sint(int& value)
+        {
+            const char* p = skip();
+            bool negative = false;
+            if (p != end && (*p == '+' || *p == '-'))
+                negative = *p++ == '-';
+
+            unsigned ret = 0;
+            if (!parse_uint(p, end, ret))
+                return;
+            const unsigned limit = negative
+                ? unsigned(std::numeric_limits<int>::max()) + 1
+                : unsigned(std::numeric_limits<int>::max());
+            if (ret > limit)
+                return;
+            value = negative ? int(0u - ret) : int(ret);
+            pos   = p;
+        }
+        // scan a word of at most max letters. returns the number of
+        // letters and the start of the word (if any letters were found).
+        std::size_t alpha(const char*& start, std::size_t max = std::numeric_limits<std::size_t>::max())
+        {
+            std::size_t count = 0;
+            start = skip();
+            while (count < max)
+            {
+                const char* p = skip();
+                if (p == end || !is_alpha(*p))
+                    break;
+                if (count++ == 0)
+                    start = p;
+                pos = p + 1;
+            }
+            return count;
+        }
+    };
 
-         boost::match_results<nntp::reverse_c_str_iterator> res;
+    // the month names are looked up with the 3 lower case
+    // letters packed into a single integer.
+    constexpr std::uint32_t make_key(char a, char b, char c)
+    {
+        return (std::uint32_t(a) << 16) | (std::uint32_t(b) << 8) | std::uint32_t(c);
+    }
 
-         if (!regex_search(itbeg, itend, res, ex))
-             return NULL;
+    const std::uint32_t MonthKeys[] = {
+        make_key('j', 'a', 'n'), make_key('f', 'e', 'b'), make_key('m', 'a', 'r'),
+        make_key('a', 'p', 'r'), make_key('m', 'a', 'y'), make_key('j', 'u', 'n'),
+        make_key('j', 'u', 'l'), make_key('a', 'u', 'g'), make_key('s', 'e', 'p'),
+        make_key('o', 'c', 't'), make_key('n', 'o', 'v'), make_key('d', 'e', 'c')
+    };
 
-         if (res[0].second == itend)
-             return NULL;
+    // returns the month index (0-11) or -1 if the name isn't a known month.
+    int find_month(const std::string& name)
+    {
+        if (name.size() != 3)
+            return -1;
+        const auto key = make_key(to_lower(name[0]), to_lower(name[1]), to_lower(name[2]));
+        for (int i=0; i<12; ++i)
+        {
+            if (MonthKeys[i] == key)
+                return i;
+        }
+        return -1;
+    }
 
-         const char* end   = res[0].first.as_ptr();  // at the last matched character
-         const char* start = res[0].second.as_ptr(); // at one before the start of the match
+    // the time zone names used in the article dates and their
+    // offsets to GMT in the same +hhmm notation as the numeric offset.
+    struct zone_offset {
+        const char* name;
+        int offset;
+    };
+    const zone_offset TimeZones[] = {
+        {"gmt", 0}, {"ut", 0}, {"utc", 0}, {"z", 0},
+        {"est", -500}, {"edt", -400},
+        {"cst", -600}, {"cdt", -500},
+        {"mst", -700}, {"mdt", -600},
+        {"pst", -800}, {"pdt", -700},
+        {"bst", 100}, {"cet", 100}, {"cest", 200},
+        {"eet", 200}, {"eest", 300},
+        {"jst", 900}
+    };
 
-         ++start;
-         ++end;
-         // some people use this gay notation of prefixing their stuff with (xx/yy) notation
-         // to indicate all the articles of their posting "batch". This has nothing to do with
-         // with the yEnc part count hack. So if the search returned a match at the beginning, ignore this.
-         if (start == subjectline)
-             return NULL;
+    // returns the offset of a known time zone or 0 if the name isn't known.
+    int find_timezone(const std::string& name)
+    {
+        for (const auto& tz : TimeZones)
+        {
+            const auto len = std::strlen(tz.name);
+            if (len != name.size())
+                continue;
 
-         i = end - start;
-         return start;
+            std::size_t i = 0;
+            for (; i<len; ++i)
+            {
+                if (to_lower(name[i]) != tz.name[i])
+                    break;
+            }
+            if (i == len)
+                return tz.offset;
+        }
+        return 0;
+    }
+
+    // find the first "File xx of yy" marker in the string.
+    // returns a pointer one past the end of the marker or nullptr if not found.
+    const char* find_file_marker(const char* str, const char* end)
+    {
+        static const char File[] = "File ";
+        static const char Of[]   = " of ";
+        const std::size_t file_len = sizeof(File) - 1;
+        const std::size_t of_len   = sizeof(Of) - 1;
+
+        for (const char* p = str; end - p >= std::ptrdiff_t(file_len + of_len); ++p)
+        {
+            if (std::memcmp(p, File, file_len))
+                continue;
+            const char* q = p + file_len;
+            while (q != end && is_digit(*q))
+                ++q;
+            if (end - q < std::ptrdiff_t(of_len) || std::memcmp(q, Of, of_len))
+                continue;
+            q += of_len;
+            while (q != end && is_digit(*q))
+                ++q;
+            return q;
+        }
+        return nullptr;
+    }
+
+    // find the first "(xx/yy)" or "[xx/yy]" marker in the string.
+    // returns a pointer one past the end of the marker or nullptr if not found.
+    const char* find_part_marker(const char* str, const char* end)
+    {
+        for (const char* p = str; p != end; ++p)
+        {
+            if (*p != '(' && *p != '[')
+                continue;
+            const char* q = p + 1;
+            while (q != end && is_digit(*q))
+                ++q;
+            if (q == end || *q != '/')
+                continue;
+            ++q;
+            while (q != end && is_digit(*q))
+                ++q;
+            if (q == end || (*q != ')' && *q != ']'))
+                continue;
+            return q + 1;
+        }
+        return nullptr;
     }
 
     std::string make_string(const nntp::overview::field& f)
@@ -353,26 +577,9 @@ std::time_t timevalue(const nntp::date& date)
 
     // todo: can this depend on the locale where where
     // the date was generated??
-    const char* arr[] = {
-        "Jan", "Feb", "Mar", "Apr", "May", "Jun",
-        "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
-
-    for (size_t i=0; i<sizeof(arr)/sizeof(char*); ++i)
-    {
-#if defined(LINUX_OS)
-        if (strcasecmp(date.month.c_str(), arr[i]) == 0)
-        {
-            t.tm_mon = i;
-            break;
-        }
-#elif defined(WINDOWS_OS)
-        if (_stricmp(date.month.c_str(), arr[i]) == 0)
-        {
-            t.tm_mon = i;
-            break;
-        }
-#endif
-    }
+    const auto month = find_month(date.month);
+    if (month >= 0)
+        t.tm_mon = month;
 
     ret = mktime(&t);
     if (date.tzoffset)
@@ -384,7 +591,10 @@ std::time_t timevalue(const nntp::date& date)
     }
     else if (!date.tz.empty())
     {
-        // todo: translate the TZ name into a delta to GMT
+        // translate the TZ name into a delta to GMT
+        const auto tzoffset = find_timezone(date.tz);
+        ret += ((tzoffset / 100) * -3600);
+        ret += ((tzoffset % 100) * -60);
     }
     // if the timestamp is in the future, we'll crop it.
     const auto now = std::time(nullptr);
@@ -457,69 +667,56 @@ std::pair<bool, date> parse_date(const char* str, size_t len)
 {
     nntp::date date {};
 
-    using namespace boost::spirit::classic;
-
+    // the supported formats are
     // Thu, 26 Jul 2007 19:44:13 -0500
-    auto ret = parse(str, str+len,
-        (
-         alpha_p >> alpha_p >> alpha_p >> ',' >>
-         (uint_p[assign(date.day)]) >>
-         ((repeat_p(3)[alpha_p])[assign(date.month)]) >>
-         (uint_p[assign(date.year)]) >>
-         (uint_p[assign(date.hours)]) >> ':' >>
-         (uint_p[assign(date.minutes)]) >> ':' >>
-         (uint_p[assign(date.seconds)]) >>
-         !(int_p[assign(date.tzoffset)]) >>
-         !(!ch_p('(') >> (*alpha_p)[assign(date.tz)] >> !ch_p(')'))
-         ), ch_p(' '));
-    if (ret.full)
-    {
-        if (date.year < 100)
-            date.year += 2000;
-        return {true, date};
-    }
-
+    // Wed, 30 Jun 2010 13:24:51 +0000 (UTC)
     // 29 Jul 2007 11:25:26 GMT
-    ret = parse(str, str+len,
-        (
-         (uint_p[assign(date.day)]) >>
-         ((repeat_p(3)[alpha_p])[assign(date.month)]) >>
-         (uint_p[assign(date.year)]) >>
-         (uint_p[assign(date.hours)]) >> ':' >>
-         (uint_p[assign(date.minutes)]) >> ':' >>
-         (uint_p[assign(date.seconds)]) >>
-         !(int_p[assign(date.tzoffset)])     >>
-         !((*alpha_p)[assign(date.tz)])
-        ), ch_p(' '));
-    if (ret.full)
-    {
-        if (date.year < 100)
-            date.year += 2000;
-        return {true, date};
-    }
+    // Wednesday, 24 Oct 2008 11:58:50 -0800
+    date_scanner scanner {str, str + len};
 
+    // the time zone name can be in parenthesis only after
+    // the abbreviated day of the week.
+    bool parenthesis = false;
 
-    // Wednesday, 24 Oct 2008 11:58:50 -0800
-    ret = parse(str, str+len,
-        (
-         (*alpha_p) >>  ',' >>
-         (uint_p[assign(date.day)]) >>
-         ((repeat_p(3)[alpha_p])[assign(date.month)]) >>
-         (uint_p[assign(date.year)]) >>
-         (uint_p[assign(date.hours)]) >> ':' >>
-         (uint_p[assign(date.minutes)]) >> ':' >>
-         (uint_p[assign(date.seconds)]) >>
-         !(int_p[assign(date.tzoffset)]) >>
-         !((*alpha_p)[assign(date.tz)])
-         ), ch_p(' '));
-
-    if (ret.full)
-    {
-        if (date.year < 100)
-            date.year += 2000;
-        return {true, date};
-    }
-    return {false, date};
+    const char* word = nullptr;
+    const auto weekday = scanner.alpha(word);
+    if (scanner.match(','))
+        parenthesis = weekday == 3;
+    else scanner.pos = str;
+
+    if (!scanner.uint(date.day))
+        return {false, date};
+
+    if (scanner.alpha(word, 3) != 3)
+        return {false, date};
+    date.month.assign(word, scanner.pos);
+
+    if (!scanner.uint(date.year) ||
+        !scanner.uint(date.hours) || !scanner.match(':') ||
+        !scanner.uint(date.minutes) || !scanner.match(':') ||
+        !scanner.uint(date.seconds))
+        return {false, date};
+
+    scanner.sint(date.tzoffset);
+
+    if (parenthesis)
+        scanner.match('(');
+
+    // the spaces before the time zone name are consumed
+    // even if there's no name.
+    scanner.pos = scanner.skip();
+    if (scanner.alpha(word))
+        date.tz.assign(word, scanner.pos);
+
+    if (parenthesis)
+        scanner.match(')');
+
+    if (scanner.pos != scanner.end)
+        return {false, date};
+
+    if (date.year < 100)
+        date.year += 2000;
+    return {true, date};
 }
 
 std::pair<bool, part> parse_part(const char* str, size_t len)
@@ -530,28 +727,27 @@ std::pair<bool, part> parse_part(const char* str, size_t len)
     if (!str)
         return {false, part};
 
-    using namespace boost::spirit::classic;
+    // the part count is either (xx/yy) or [xx/yy]
+    const char open  = str[0];
+    const char close = str[len - 1];
+    if (!((open == '(' && close == ')') || (open == '[' && close == ']')))
+        return {false, part};
 
-    // first notation (xx/yy)
-    {
-        const auto& ret = parse(str, str+len,
-            (
-               ch_p('(') >> uint_p[assign(part.numerator)] >>
-                   ch_p('/') >> uint_p[assign(part.denominator)] >>
-                   ch_p(')')
-                   ));
-        if (ret.full)
-            return {ret.full, part};
-    }
+    const char* pos = str + 1;
+    const char* end = str + len - 1;
 
-    // second notation  [xx/yy]
-    const auto& ret = parse(str, str+len,
-        (
-         ch_p('[') >> uint_p[assign(part.numerator)] >>
-             ch_p('/') >> uint_p[assign(part.denominator)] >>
-             ch_p(']')
-             ));
-    return {ret.full, part};
+    unsigned numerator   = 0;
+    unsigned denominator = 0;
+    if (!parse_uint(pos, end, numerator))
+        return {false, part};
+    if (pos == end || *pos++ != '/')
+        return {false, part};
+    if (!parse_uint(pos, end, denominator))
+        return {false, part};
+
+    part.numerator   = numerator;
+    part.denominator = denominator;
+    return {pos == end, part};
 }
 
 void set_hash_function(hash_combine_function h)
@@ -560,14 +756,29 @@ void set_hash_function(hash_combine_function h)
 }
 
 std::uint32_t hashvalue(const char* subjectline, size_t len)
+{
+    return std::uint32_t(fingerprint(subjectline, len));
+}
+
+std::uint64_t fingerprint(const char* subjectline, size_t len)
 {
     std::size_t seed = 0;
     std::size_t skip = 0;
+
+    // FNV-1a for the upper bits. this one can't be replaced
+    // with set_hash_function so the fingerprint still tells the
+    // subject lines apart when the hashvalues are forced to collide.
+    std::uint32_t fnv = 2166136261u;
+    auto combine = [&](char c) {
+        hash_combine(seed, c);
+        fnv = (fnv ^ std::uint8_t(c)) * 16777619u;
+    };
+
     const auto* p = find_part_count(subjectline, len, skip);
     if (!p)
     {
         for (std::size_t i=0; i<len; ++i)
-            hash_combine(seed, subjectline[i]);
+            combine(subjectline[i]);
     }
     else
     {
@@ -575,60 +786,42 @@ std::uint32_t hashvalue(const char* subjectline, size_t len)
         const std::size_t num = p - subjectline;
         std::size_t i;
         for (i=0; i<num; ++i)
-            hash_combine(seed, subjectline[i]);
+            combine(subjectline[i]);
         i += skip;
         for (; i<len; ++i)
-            hash_combine(seed, subjectline[i]);
+            combine(subjectline[i]);
     }
 
-    return std::uint32_t(seed);
+    return (std::uint64_t(fnv) << 32) | std::uint32_t(seed);
 }
 
 
 std::string find_filename(const char* str, size_t len, bool include_extension)
 {
-    using namespace boost::spirit::classic;
-
     const static boost::regex regex(REVERSE_FILE_EXTENSION_REGEX, boost::regbase::icase | boost::regbase::perl);
-    const static boost::regex mk1("File [0-9]* of [0-9]*");
-    const static boost::regex mk2("(\\(|\\[)[0-9]*/[0-9]*(\\)|\\])");
-
-    // see if it's an yEnc subjectline match.
-    {
-        std::string yenc_name;
-        const auto ret = parse(str, str + len,
-            (*(anychar_p - '"'))
-                >> str_p("\"")
-                >> (*(anychar_p - '"'))[assign(yenc_name)]
-                >> str_p("\"")
-                >> (*(anychar_p - '"'))
-                >> str_p("yEnc")
-                >> (*(anychar_p)));
-        if (ret.hit)
-        {
-            if (include_extension)
-                return yenc_name;
-        }
-        else if (ret.stop == str + len && !yenc_name.empty())
-        {
-            // something weird about the parse_info.
-            // when the input is something like:
-            // "8zm6tvYNq2.part14.rar" - 1.53GB <<< www.nfo-underground.xxx >>> yEnc (19/273)
-            // then ret.hit == false, but however ret.stop == str + len
-            // and the filaneme is stored into yenc_name.
-            // I'm not really sure what's going on here and the documentaion
-            // is so fucking super bad it's useless to even read.
-            if (include_extension)
-                return yenc_name;
-        }
 
-        using iterator = std::string::reverse_iterator;
-
-        boost::match_results<iterator> res;
-        if (regex_search(yenc_name.rbegin(), yenc_name.rend(), res, regex))
+    // see if it's an yEnc subjectline match, i.e. the filename is in quotes
+    // '"fooobar.mp3" yEnc (1/10)'. the name is accepted when there are no
+    // more quotes after it. a missing closing quote extends the name
+    // to the end of the subject line.
+    if (include_extension)
+    {
+        const char* end = str + len;
+        const char* q1  = static_cast<const char*>(std::memchr(str, '"', len));
+        if (q1)
         {
-            auto start = res[0].second;
-            yenc_name.erase(start.base());
+            const char* name = q1 + 1;
+            const char* q2   = static_cast<const char*>(std::memchr(name, '"', end - name));
+            if (!q2)
+            {
+                if (name != end)
+                    return {name, end};
+            }
+            else if (!std::memchr(q2 + 1, '"', end - q2 - 1))
+            {
+                if (name != q2)
+                    return {name, q2};
+            }
         }
     }
 
@@ -702,11 +895,11 @@ std::string find_filename(const char* str, size_t len, bool include_extension)
         // if the subject line contains something like
         // Foobar bla blah - File 07 of 10 - foobar.mp3" we use the "File xx of yy" as a marker
         {
-            boost::match_results<const char*> res;
-            if (regex_search(str, dot, res, mk1) ||
-                regex_search(str, dot, res, mk2))
+            const char* e = find_file_marker(str, dot);
+            if (!e)
+                e = find_part_marker(str, dot);
+            if (e)
             {
-                const auto e = res[0].second;
                 const auto m = e - str;
                 str  = e;
                 len -= m;
@@ -804,7 +997,7 @@ std::string find_filename(const char* str, size_t len, bool include_extension)
 
         const char* good = start;
 
-        while (pred.is_allowed((unsigned char)*start) && start >= str)
+        while (start >= str && pred.is_allowed((unsigned char)*start))
         {
             if (pred.is_good())
                 good = start;
@@ -199,6 +199,13 @@ namespace nntp
     std::uint32_t hashvalue(const std::string& s)
     { return hashvalue(s.c_str(), s.size()); }
 
+    // return a 64bit fingerprint of the subject line. the lower 32 bits are the
+    // hashvalue and the upper 32 bits are computed over the same characters with
+    // an independent hash function. subject lines that match (see strcmp) always
+    // have the same fingerprint and subject lines that collide in the hashvalue
+    // are very unlikely to collide in the upper bits.
+    std::uint64_t fingerprint(const char* subjectline, size_t len);
+
     // find a filename in the given subjectline. if no filename was found
     // then returns (nullptr, 0), otherwise a pointer to the start of the filename
     // and the length of the name.
@@ -0,0 +1,96 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "pipeline.h"
+
+namespace newsflash
+{
+
+namespace {
+    // the cmdlist should carry enough data to keep the connection
+    // busy for this many round trips.
+    const double RoundTripsPerCmdList = 16.0;
+
+    // smoothing factor for the moving averages.
+    const double Alpha = 0.25;
+
+    const std::size_t MinArticles = 5;
+    const std::size_t MaxArticles = 100;
+    const std::size_t MinOverviewRange = 500;
+    const std::size_t MaxOverviewRange = 20000;
+
+    double average(double current, double sample)
+    {
+        if (current == 0.0)
+            return sample;
+        return Alpha * sample + (1.0 - Alpha) * current;
+    }
+
+    // move towards the desired value but at most by a factor
+    // of two at a time so that a single odd sample doesn't
+    // swing the depth from one extreme to another.
+    std::size_t adjust(std::size_t current, double desired, std::size_t min, std::size_t max)
+    {
+        const auto lo = std::max<std::size_t>(current / 2, min);
+        const auto hi = std::min<std::size_t>(current * 2, max);
+        const auto value = static_cast<std::size_t>(std::ceil(desired));
+        return std::min(std::max(value, lo), hi);
+    }
+} // namespace
+
+void PipelineControl::Update(const Sample& sample)
+{
+    using seconds = std::chrono::duration<double>;
+
+    if (sample.num_items == 0 || sample.bytes == 0)
+        return;
+
+    const auto latency  = std::chrono::duration_cast<seconds>(sample.latency).count();
+    const auto duration = std::chrono::duration_cast<seconds>(sample.duration).count();
+    // the time spent receiving the data after the first byte arrived.
+    const auto transfer = std::max(duration - latency, 0.001);
+
+    rtt_ = average(rtt_, latency);
+    bps_ = average(bps_, sample.bytes / transfer);
+
+    const auto target_bytes = bps_ * rtt_ * RoundTripsPerCmdList;
+    const auto bytes_per_item = double(sample.bytes) / double(sample.num_items);
+
+    if (sample.type == Type::Articles)
+    {
+        bytes_per_article_ = average(bytes_per_article_, bytes_per_item);
+        depth_.num_articles = adjust(depth_.num_articles,
+            target_bytes / bytes_per_article_, MinArticles, MaxArticles);
+    }
+    else if (sample.type == Type::Overviews)
+    {
+        bytes_per_overview_ = average(bytes_per_overview_, bytes_per_item);
+        depth_.overview_range = adjust(depth_.overview_range,
+            target_bytes / bytes_per_overview_ / depth_.num_overviews,
+            MinOverviewRange, MaxOverviewRange);
+    }
+}
+
+} // newsflash
@@ -0,0 +1,94 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "newsflash/config.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace newsflash
+{
+    // How much work to put in a single cmdlist. The data commands of
+    // a cmdlist are pipelined (when pipelining is enabled) so this is also
+    // the pipelining depth of the connection. Between cmdlists the
+    // connection is idle for (at least) one round trip.
+    struct PipelineDepth {
+        // the number of BODY commands per cmdlist.
+        std::size_t num_articles = 10;
+        // the number of XOVER commands per cmdlist.
+        std::size_t num_overviews = 10;
+        // the number of articles per XOVER range.
+        std::size_t overview_range = 1000;
+    };
+
+    // Adjust the pipeline depth of a connection based on the measured
+    // latency and throughput. The goal is to keep enough data in flight
+    // that the round trip stall at the cmdlist boundary is only a small
+    // fraction of the time spent transferring the cmdlist data, i.e. the
+    // cmdlist carries several times the bandwidth-delay product.
+    // On a low latency connection the depth stays small so that
+    // pausing and cancelling the tasks remains responsive.
+    class PipelineControl
+    {
+    public:
+        enum class Type {
+            Articles, Overviews
+        };
+
+        // measurements from a single executed cmdlist.
+        struct Sample {
+            Type type = Type::Articles;
+            // the number of articles (or article numbers in the XOVER ranges).
+            std::size_t num_items = 0;
+            // the number of bytes received.
+            std::uint64_t bytes = 0;
+            // the time from sending the data commands to the first response byte.
+            std::chrono::microseconds latency {0};
+            // the time from sending the data commands to the last response byte.
+            std::chrono::microseconds duration {0};
+        };
+
+        // Update the depth with the measurements of a complete cmdlist.
+        void Update(const Sample& sample);
+
+        // Get the current depth.
+        const PipelineDepth& GetDepth() const
+        { return depth_; }
+
+        // Get the smoothed round trip time in milliseconds.
+        std::uint32_t GetLatencyMs() const
+        { return static_cast<std::uint32_t>(rtt_ * 1000.0); }
+
+        // Get the smoothed throughput in bytes per second.
+        double GetThroughput() const
+        { return bps_; }
+
+    private:
+        PipelineDepth depth_;
+        double rtt_ = 0.0;
+        double bps_ = 0.0;
+        double bytes_per_article_ = 0.0;
+        double bytes_per_overview_ = 0.0;
+    };
+
+} // newsflash
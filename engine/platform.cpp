@@ -29,6 +29,9 @@
 #  include <time.h>
 #  include <pthread.h>
 #endif
+#if defined(__MSVC__) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>
+#endif
 #include "newsflash/warnpop.h"
 
 #include <system_error>
@@ -81,7 +84,49 @@ unsigned long get_thread_identity()
 #endif
 }
 
+namespace {
+
+cpu_features detect_cpu_features()
+{
+    cpu_features ret;
+#if (defined(__GCC__) || defined(__CLANG__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    ret.sse2   = __builtin_cpu_supports("sse2");
+    ret.ssse3  = __builtin_cpu_supports("ssse3");
+    ret.sse41  = __builtin_cpu_supports("sse4.1");
+    ret.pclmul = __builtin_cpu_supports("pclmul");
+    ret.avx2   = __builtin_cpu_supports("avx2");
+#elif defined(__MSVC__) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4] = {0};
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+    if (max_leaf < 1)
+        return ret;
+
+    __cpuid(info, 1);
+    ret.sse2   = (info[3] & (1 << 26)) != 0;
+    ret.ssse3  = (info[2] & (1 << 9)) != 0;
+    ret.sse41  = (info[2] & (1 << 19)) != 0;
+    ret.pclmul = (info[2] & (1 << 1)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
 
+    // AVX2 also needs the OS to save the YMM registers.
+    if (max_leaf >= 7 && osxsave && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        __cpuidex(info, 7, 0);
+        ret.avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#endif
+    return ret;
+}
+
+} // namespace
+
+const cpu_features& get_cpu_features()
+{
+    static const cpu_features features = detect_cpu_features();
+    return features;
+}
 
 } // newsflash
 
@@ -42,5 +42,18 @@ namespace newsflash
 
     unsigned long get_thread_identity();
 
+    // instruction set extensions supported by the CPU (and the OS)
+    // that the engine can use at runtime.
+    struct cpu_features {
+        bool sse2   = false;
+        bool ssse3  = false;
+        bool sse41  = false;
+        bool pclmul = false;
+        bool avx2   = false;
+    };
+
+    // detect the CPU features. the result is cached after the first call.
+    const cpu_features& get_cpu_features();
+
 } // newsflash
 
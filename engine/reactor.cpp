@@ -0,0 +1,414 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#if defined(LINUX_OS)
+#  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+#  include <unistd.h>
+#  include <cerrno>
+#endif
+
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <map>
+
+#include "reactor.h"
+#include "socket.h"
+#include "event.h"
+#include "waithandle.h"
+#include "minidump.h"
+#include "assert.h"
+
+namespace newsflash
+{
+
+void IoAction::xperform()
+{
+    if (event_driven_)
+    {
+        wait_ = Wait();
+        done_ = Resume(wait_);
+        return;
+    }
+
+    // without the reactor we just wait on the current thread
+    // until the action is done.
+    for (;;)
+    {
+        wait_ = Wait();
+        if (Resume(wait_))
+            break;
+
+        WaitHandle::WaitList handles;
+
+        std::unique_ptr<WaitHandle> socket;
+        std::unique_ptr<WaitHandle> event;
+        if (wait_.socket && (wait_.read || wait_.write))
+        {
+            socket.reset(new WaitHandle(wait_.socket->GetWaitHandle(wait_.read, wait_.write)));
+            handles.push_back(socket.get());
+        }
+        if (wait_.event)
+        {
+            event.reset(new WaitHandle(wait_.event->GetWaitHandle()));
+            handles.push_back(event.get());
+        }
+
+        if (wait_.timeout == Clock::time_point::max())
+        {
+            ASSERT(!handles.empty());
+            WaitHandle::WaitForMultipleHandles(handles);
+            continue;
+        }
+
+        const auto now = Clock::now();
+        const auto ms  = wait_.timeout > now
+            ? std::chrono::duration_cast<std::chrono::milliseconds>(wait_.timeout - now)
+            : std::chrono::milliseconds(0);
+        if (handles.empty())
+            std::this_thread::sleep_for(ms);
+        else WaitHandle::WaitForMultipleHandles(handles, ms);
+    }
+    done_ = true;
+}
+
+struct Reactor::State {
+    std::atomic<std::size_t> num_actions;
+
+    OnActionDone callback;
+
+    State() : num_actions(0)
+    {}
+};
+
+#if defined(LINUX_OS)
+
+class Reactor::Thread
+{
+public:
+    Thread(std::shared_ptr<State> state) : state_(state)
+    {
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_ == -1)
+            throw std::runtime_error("epoll_create1 failed");
+
+        wakeup_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeup_ == -1)
+        {
+            ::close(epoll_);
+            throw std::runtime_error("create eventfd failed");
+        }
+
+        // the wakeup event is the only one with no action.
+        epoll_event ev = {};
+        ev.events   = EPOLLIN;
+        ev.data.ptr = nullptr;
+        CHECK(epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_, &ev), 0);
+
+        run_loop_ = true;
+        thread_.reset(new std::thread(std::bind(&Thread::ThreadSehMain, this)));
+    }
+   ~Thread()
+    {
+        ::close(wakeup_);
+        ::close(epoll_);
+    }
+
+    void Submit(IoAction* act)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        inbox_.push_back(act);
+        wakeup();
+    }
+
+    void Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            run_loop_ = false;
+            wakeup();
+        }
+        thread_->join();
+
+        // the actions that didn't complete are simply discarded.
+        for (auto* act : inbox_)
+            delete act;
+        for (auto& pair : waiting_)
+        {
+            if (pair.second.event != -1)
+                ::close(pair.second.event);
+            delete pair.first;
+        }
+
+        state_->num_actions -= inbox_.size();
+        state_->num_actions -= waiting_.size();
+        inbox_.clear();
+        waiting_.clear();
+    }
+
+private:
+    struct Registration {
+        int socket = -1;
+        int event  = -1;
+        IoAction::Clock::time_point timeout;
+    };
+
+    void ThreadMain()
+    {
+        std::vector<IoAction*> ready;
+        std::vector<IoAction*> incoming;
+        epoll_event events[64];
+
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!run_loop_)
+                    return;
+                incoming.swap(inbox_);
+            }
+            for (auto* act : incoming)
+            {
+                act->SetEventDriven(true);
+                resume(act);
+            }
+            incoming.clear();
+
+            const int ret = epoll_wait(epoll_, events, 64, compute_timeout());
+            if (ret == -1)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("epoll_wait failed");
+            }
+
+            for (int i=0; i<ret; ++i)
+            {
+                auto* act = static_cast<IoAction*>(events[i].data.ptr);
+                if (act == nullptr)
+                {
+                    std::uint64_t count = 0;
+                    ::read(wakeup_, &count, sizeof(count));
+                    continue;
+                }
+                ready.push_back(act);
+            }
+
+            const auto now = IoAction::Clock::now();
+            for (const auto& pair : waiting_)
+            {
+                if (pair.second.timeout <= now)
+                    ready.push_back(pair.first);
+            }
+
+            // the socket and the event of an action can
+            // both be signaled at the same time.
+            std::sort(ready.begin(), ready.end());
+            ready.erase(std::unique(ready.begin(), ready.end()), ready.end());
+
+            for (auto* act : ready)
+                resume(act);
+
+            ready.clear();
+        }
+    }
+
+    void ThreadSehMain()
+    {
+        SEH_BLOCK(ThreadMain();)
+    }
+
+    void resume(IoAction* act)
+    {
+        // the action is removed from the epoll set before it's resumed
+        // since the action might close its socket. otherwise the socket
+        // descriptor could be reused by another socket before we'd get
+        // to remove it which would remove the wrong socket.
+        auto it = waiting_.find(act);
+        if (it != waiting_.end())
+        {
+            const auto& reg = it->second;
+            if (reg.socket != -1)
+                epoll_ctl(epoll_, EPOLL_CTL_DEL, reg.socket, nullptr);
+            if (reg.event != -1)
+            {
+                epoll_ctl(epoll_, EPOLL_CTL_DEL, reg.event, nullptr);
+                ::close(reg.event);
+            }
+            waiting_.erase(it);
+        }
+
+        act->perform();
+
+        if (act->IsDone())
+        {
+            // the action is no longer ours once it's handed
+            // over to the callback.
+            state_->num_actions--;
+            state_->callback(act);
+            return;
+        }
+
+        const auto& wait = act->GetWait();
+
+        Registration reg;
+        reg.timeout = wait.timeout;
+
+        epoll_event ev = {};
+        ev.data.ptr = act;
+        if (wait.socket && (wait.read || wait.write))
+        {
+            const auto handle = wait.socket->GetWaitHandle(wait.read, wait.write);
+            reg.socket = handle.GetNativeHandle();
+            ev.events  = (wait.read ? EPOLLIN : 0) | (wait.write ? EPOLLOUT : 0);
+            CHECK(epoll_ctl(epoll_, EPOLL_CTL_ADD, reg.socket, &ev), 0);
+        }
+        if (wait.event)
+        {
+            // the same event object can be shared by several actions
+            // but a descriptor can only be added once to the epoll set.
+            // so each action waits on a duplicate of the descriptor.
+            // note that closing the duplicate doesn't remove it from the
+            // set since the original descriptor is still open.
+            const auto handle = wait.event->GetWaitHandle();
+            reg.event = ::dup(handle.GetNativeHandle());
+            if (reg.event == -1)
+                throw std::runtime_error("dup failed");
+            ev.events = EPOLLIN;
+            CHECK(epoll_ctl(epoll_, EPOLL_CTL_ADD, reg.event, &ev), 0);
+        }
+        waiting_[act] = reg;
+    }
+
+    int compute_timeout() const
+    {
+        auto next = IoAction::Clock::time_point::max();
+        for (const auto& pair : waiting_)
+            next = std::min(next, pair.second.timeout);
+
+        if (next == IoAction::Clock::time_point::max())
+            return -1;
+
+        const auto now = IoAction::Clock::now();
+        if (next <= now)
+            return 0;
+
+        // round up so that we don't wake up before the timeout
+        // and then spin with zero timeouts.
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(next - now);
+        return static_cast<int>((us.count() + 999) / 1000);
+    }
+
+    void wakeup()
+    {
+        const std::uint64_t one = 1;
+        CHECK(::write(wakeup_, &one, sizeof(one)), sizeof(one));
+    }
+
+private:
+    std::shared_ptr<State> state_;
+    std::unique_ptr<std::thread> thread_;
+    std::mutex mutex_;
+    std::vector<IoAction*> inbox_;
+    std::map<IoAction*, Registration> waiting_;
+    bool run_loop_ = false;
+    int epoll_  = -1;
+    int wakeup_ = -1;
+};
+
+#else
+
+class Reactor::Thread
+{
+public:
+    Thread(std::shared_ptr<State>)
+    {
+        throw std::runtime_error("reactor is not supported");
+    }
+    void Submit(IoAction*)
+    {}
+    void Shutdown()
+    {}
+};
+
+#endif
+
+Reactor::Reactor(std::size_t num_threads)
+{
+    state_ = std::make_shared<State>();
+
+    for (std::size_t i=0; i<num_threads; ++i)
+    {
+        std::unique_ptr<Thread> thread(new Thread(state_));
+        threads_.push_back(std::move(thread));
+    }
+}
+
+Reactor::~Reactor()
+{
+    Shutdown();
+}
+
+void Reactor::Submit(IoAction* act)
+{
+    ASSERT(!threads_.empty());
+
+    auto& thread = threads_[round_robin_ % threads_.size()];
+    round_robin_++;
+
+    state_->num_actions++;
+
+    thread->Submit(act);
+}
+
+void Reactor::Shutdown()
+{
+    for (auto& thread : threads_)
+        thread->Shutdown();
+
+    threads_.clear();
+}
+
+std::size_t Reactor::GetNumPendingActions() const
+{
+    return state_->num_actions;
+}
+
+void Reactor::SetCallback(const OnActionDone& callback)
+{
+    state_->callback = callback;
+}
+
+bool Reactor::IsSupported()
+{
+#if defined(LINUX_OS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+} // newsflash
@@ -0,0 +1,142 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "newsflash/config.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+
+#include "action.h"
+
+namespace newsflash
+{
+    class Socket;
+    class Event;
+
+    // IoAction performs non-blocking socket IO one step at a time.
+    // Each step either completes the action or tells what the action
+    // needs to wait for before it can make more progress. When the action
+    // is run by the Reactor the waiting is done by the reactor thread
+    // together with the other actions. Otherwise perform() waits
+    // on the calling thread until the action is done.
+    class IoAction : public action
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // what the action is waiting for.
+        struct Wait {
+            // the socket to wait on or nullptr for none.
+            Socket* socket = nullptr;
+            // wait for the socket to become readable.
+            bool read = false;
+            // wait for the socket to become writeable.
+            bool write = false;
+            // the event to wait on (typically the cancellation event)
+            // or nullptr for none.
+            Event* event = nullptr;
+            // resume the action at this time at the latest even if
+            // neither the socket nor the event becomes signaled.
+            Clock::time_point timeout = Clock::time_point::max();
+        };
+
+        IoAction() : action(affinity::event_loop)
+        {}
+
+        // returns true when the action is done. (or failed with an exception)
+        bool IsDone() const
+        { return done_ || has_exception(); }
+
+        // get what the action is waiting for after the last step.
+        const Wait& GetWait() const
+        { return wait_; }
+
+        // when event driven a call to perform() performs a single
+        // step only and returns. the reactor sets this.
+        void SetEventDriven(bool on_off)
+        { event_driven_ = on_off; }
+
+    protected:
+        // perform the next step. returns true when the action is done.
+        // otherwise the wait is filled with what to wait for next.
+        virtual bool Resume(Wait& wait) = 0;
+
+    private:
+        virtual void xperform() override;
+
+    private:
+        Wait wait_;
+        bool done_ = false;
+        bool event_driven_ = false;
+    };
+
+    // Reactor runs IoActions on a small number of threads. Each thread
+    // waits for the sockets and events of all of its actions with a single
+    // epoll instance and resumes an action when the thing it's waiting for
+    // becomes signaled or its timeout expires. Once an action is done the
+    // callback is invoked the same way as with the ThreadPool.
+    // Currently only available on Linux.
+    class Reactor
+    {
+    public:
+        // create the reactor with num_threads threads.
+        Reactor(std::size_t num_threads);
+       ~Reactor();
+
+        void Submit(std::unique_ptr<IoAction> act)
+        {
+            Submit(act.get());
+            act.release();
+        }
+
+        // submit an action to be run. the reactor owns the action
+        // until it's handed out through the callback.
+        void Submit(IoAction* act);
+
+        // shutdown the reactor. will block and join all the threads.
+        // any actions that are still pending are deleted.
+        void Shutdown();
+
+        // get the number of actions currently in the reactor.
+        std::size_t GetNumPendingActions() const;
+
+        // callback to be invoked when an action has been completed
+        using OnActionDone = std::function<void (action*)>;
+        void SetCallback(const OnActionDone& callback);
+
+        // returns true if the reactor is available on this platform.
+        static bool IsSupported();
+
+    private:
+        struct State;
+        class Thread;
+
+    private:
+        std::shared_ptr<State> state_;
+        std::vector<std::unique_ptr<Thread>> threads_;
+        std::size_t round_robin_ = 0;
+    };
+
+} // newsflash
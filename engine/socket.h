@@ -71,6 +71,34 @@ namespace newsflash
 
         // returns true if the socket buffer has more data for immediate read.
         virtual bool CanRecv() const = 0;
+
+        // The result of a non-blocking socket operation.
+        enum class IoStatus {
+            // the operation is complete. (check the error)
+            Done,
+            // retry the operation once the socket is readable.
+            WantRead,
+            // retry the operation once the socket is writeable.
+            WantWrite
+        };
+
+        // Non-blocking version of CompleteConnect. Call this once the
+        // socket has become writeable after BeginConnect and then again
+        // each time the socket is ready for the wanted operation until
+        // Done is returned. On an SSL socket this performs the SSL
+        // handshake one step at a time.
+        virtual IoStatus TryCompleteConnect(std::error_code* error) = 0;
+
+        // Try to write some data to the socket without blocking.
+        // When Done is returned the number of bytes written is stored
+        // in sent. Otherwise the operation must be retried with the
+        // same data once the socket is ready.
+        virtual IoStatus TrySend(const void* buff, int len, int* sent, std::error_code* error) = 0;
+
+        // Try to read some data from the socket without blocking.
+        // When Done is returned the number of bytes read is stored
+        // in received. 0 bytes means that the connection was closed.
+        virtual IoStatus TryRecv(void* buff, int capacity, int* received, std::error_code* error) = 0;
     protected:
     private:
     };
@@ -344,6 +344,148 @@ bool SslSocket::CanRecv() const
     return WaitForSingleHandle(handle, std::chrono::milliseconds(0));
 }
 
+Socket::IoStatus SslSocket::TryCompleteConnect(std::error_code* error)
+{
+    assert(socket_);
+    assert(handle_);
+
+    // the first call completes the TCP connection and sets up
+    // the SSL objects. the following calls continue the handshake.
+    if (!ssl_)
+    {
+        auto connection_error = complete_socket_connect(handle_, socket_);
+        if (connection_error)
+        {
+            *error = connection_error;
+            return IoStatus::Done;
+        }
+        create_ssl();
+    }
+
+    ERR_clear_error();
+
+    const int ret = SSL_connect(ssl_);
+    if (ret == 1)
+        return IoStatus::Done;
+
+    switch (SSL_get_error(ssl_, ret))
+    {
+        case SSL_ERROR_WANT_READ:
+            return IoStatus::WantRead;
+
+        case SSL_ERROR_WANT_WRITE:
+            return IoStatus::WantWrite;
+
+        case SSL_ERROR_SYSCALL:
+            if (ret == -1)
+                throw std::runtime_error("SSL socket I/O error");
+            // fallthrough intended
+
+        default:
+            throw std::runtime_error("SSL_connect failed");
+    }
+    return IoStatus::Done;
+}
+
+Socket::IoStatus SslSocket::TrySend(const void* buff, int len, int* sent, std::error_code* error)
+{
+    ERR_clear_error();
+
+    *sent = 0;
+
+    // see the comments in SendSome. the difference here is that
+    // instead of waiting for the socket we return and let the
+    // caller retry with the same parameters.
+    const int ret = SSL_write(ssl_, buff, len);
+    switch (SSL_get_error(ssl_, ret))
+    {
+        case SSL_ERROR_NONE:
+            break;
+
+        case SSL_ERROR_WANT_READ:
+            return IoStatus::WantRead;
+
+        case SSL_ERROR_WANT_WRITE:
+            return IoStatus::WantWrite;
+
+        case SSL_ERROR_SYSCALL:
+            {
+                const auto ssl_err = ERR_get_error();
+                if (ssl_err)
+                    throw std::runtime_error(get_ssl_error(ssl_err));
+                if (ret == 0)
+                    throw std::runtime_error("socket was closed unexpectedly");
+
+                const auto sock_err = get_last_socket_error();
+                if (sock_err == std::errc::operation_would_block)
+                    return IoStatus::WantWrite;
+
+                *error = sock_err;
+                return IoStatus::Done;
+            }
+
+        default:
+            throw std::runtime_error("SSL_write");
+    }
+
+#if defined(WINDOWS_OS)
+    // see the comment in SendSome
+    SetEvent(handle_);
+#endif
+
+    *sent = ret;
+    return IoStatus::Done;
+}
+
+Socket::IoStatus SslSocket::TryRecv(void* buff, int capacity, int* received, std::error_code* error)
+{
+    ERR_clear_error();
+
+    *received = 0;
+
+    // note that SSL can have decrypted data buffered that is not
+    // visible on the socket. so when data is read the caller should
+    // keep reading until WantRead before waiting on the socket again.
+    const int ret = SSL_read(ssl_, buff, capacity);
+    switch (SSL_get_error(ssl_, ret))
+    {
+        case SSL_ERROR_NONE:
+            break;
+
+        case SSL_ERROR_WANT_READ:
+            return IoStatus::WantRead;
+
+        case SSL_ERROR_WANT_WRITE:
+            return IoStatus::WantWrite;
+
+        case SSL_ERROR_SYSCALL:
+            {
+                const auto ssl_err = ERR_get_error();
+                if (ssl_err)
+                    throw std::runtime_error(get_ssl_error(ssl_err));
+                if (ret == 0)
+                    throw std::runtime_error("socket was closed unexpectedly");
+
+                const auto sock_err = get_last_socket_error();
+                if (sock_err == std::errc::operation_would_block)
+                    return IoStatus::WantRead;
+
+                *error = sock_err;
+                return IoStatus::Done;
+            }
+
+        // socket was closed.
+        case SSL_ERROR_ZERO_RETURN:
+            return IoStatus::Done;
+
+        default:
+            throw std::runtime_error("SSL_read");
+    }
+
+    *received = ret;
+    return IoStatus::Done;
+}
+
 SslSocket& SslSocket::operator=(SslSocket&& other)
 {
     if (&other == this)
@@ -414,22 +556,7 @@ void SslSocket::ssl_wait_read()
 
 void SslSocket::complete_secure_connect()
 {
-    // create SSL and BIO objects and then initialize ssl client mode.
-    // setup SSL session now that we have TCP connection.
-    SSL_CTX* ctx = context_.ssl();
-
-    ssl_ = SSL_new(ctx);
-    if (!ssl_)
-        throw std::runtime_error("SSL_new failed");
-
-    // create new IO object
-    bio_ = BIO_new_socket(socket_, BIO_NOCLOSE);
-    if (!bio_)
-        throw std::runtime_error("BIO_new_socket failed");
-
-    // connect the IO object with SSL, this takes the ownership
-    // of the BIO object.
-    SSL_set_bio(ssl_, bio_, bio_);
+    create_ssl();
 
     ERR_clear_error();
 
@@ -462,5 +589,24 @@ void SslSocket::complete_secure_connect()
     }
 }
 
+void SslSocket::create_ssl()
+{
+    // create SSL and BIO objects and then initialize ssl client mode.
+    // setup SSL session now that we have TCP connection.
+    SSL_CTX* ctx = context_.ssl();
+
+    ssl_ = SSL_new(ctx);
+    if (!ssl_)
+        throw std::runtime_error("SSL_new failed");
+
+    // create new IO object
+    bio_ = BIO_new_socket(socket_, BIO_NOCLOSE);
+    if (!bio_)
+        throw std::runtime_error("BIO_new_socket failed");
+
+    // connect the IO object with SSL, this takes the ownership
+    // of the BIO object.
+    SSL_set_bio(ssl_, bio_, bio_);
+}
 
 } // newsflash
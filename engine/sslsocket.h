@@ -62,12 +62,16 @@ namespace newsflash
         virtual WaitHandle GetWaitHandle() const override;
         virtual WaitHandle GetWaitHandle(bool waitread, bool waitwrite) const override;
         virtual bool CanRecv() const override;
+        virtual IoStatus TryCompleteConnect(std::error_code* error) override;
+        virtual IoStatus TrySend(const void* buff, int len, int* sent, std::error_code* error) override;
+        virtual IoStatus TryRecv(void* buff, int capacity, int* received, std::error_code* error) override;
 
        SslSocket& operator=(SslSocket&& other);
     private:
         void ssl_wait_write();
         void ssl_wait_read();
         void complete_secure_connect();
+        void create_ssl();
 
     private:
         // actual socket handle
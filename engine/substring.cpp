@@ -0,0 +1,175 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#  define SUBSTRING_X86
+#  include <emmintrin.h> // SSE2
+#endif
+
+#if defined(SUBSTRING_X86) && (defined(__GCC__) || defined(__CLANG__))
+#  define SUBSTRING_TARGET(x) __attribute__((target(x)))
+#else
+#  define SUBSTRING_TARGET(x)
+#endif
+
+#include <cstring>
+
+#include "platform.h"
+#include "substring.h"
+
+namespace {
+
+inline
+bool is_alpha(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+inline
+unsigned char to_lower(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+} // namespace
+
+namespace newsflash
+{
+
+void substring_matcher::reset(const std::string& needle, bool case_sensitive)
+{
+    needle_ = needle;
+    case_sensitive_ = case_sensitive;
+    first_mask_ = 0;
+    last_mask_  = 0;
+    ascii_ = true;
+
+    for (auto& c : needle_)
+    {
+        if ((unsigned char)c >= 0x80)
+            ascii_ = false;
+        if (!case_sensitive)
+            c = to_lower(c);
+    }
+    if (needle_.empty() || case_sensitive)
+        return;
+
+    if (is_alpha(needle_.front()))
+        first_mask_ = 0x20;
+    if (is_alpha(needle_.back()))
+        last_mask_ = 0x20;
+}
+
+bool substring_matcher::verify(const char* candidate) const
+{
+    // the first and the last byte have been matched already.
+    const auto len = needle_.size();
+    if (len <= 2)
+        return true;
+
+    if (case_sensitive_)
+        return std::memcmp(candidate + 1, needle_.data() + 1, len - 2) == 0;
+
+    for (std::size_t i=1; i<len-1; ++i)
+    {
+        if (to_lower(candidate[i]) != (unsigned char)needle_[i])
+            return false;
+    }
+    return true;
+}
+
+bool substring_matcher::search_scalar(const char* haystack, std::size_t len) const
+{
+    const auto n = needle_.size();
+    if (n == 0)
+        return true;
+    if (n > len)
+        return false;
+
+    const unsigned char first = needle_.front();
+    const unsigned char last  = needle_.back();
+    const auto* p = (const unsigned char*)haystack;
+
+    for (std::size_t i=0; i+n<=len; ++i)
+    {
+        if ((p[i] | first_mask_) != first)
+            continue;
+        if ((p[i+n-1] | last_mask_) != last)
+            continue;
+        if (verify(haystack + i))
+            return true;
+    }
+    return false;
+}
+
+#if defined(SUBSTRING_X86)
+
+SUBSTRING_TARGET("sse2")
+bool substring_matcher::search_sse2(const char* haystack, std::size_t len, std::size_t& pos) const
+{
+    const auto n = needle_.size();
+
+    const __m128i first = _mm_set1_epi8(needle_.front());
+    const __m128i last  = _mm_set1_epi8(needle_.back());
+    const __m128i fmask = _mm_set1_epi8(first_mask_);
+    const __m128i lmask = _mm_set1_epi8(last_mask_);
+
+    for (; pos + n - 1 + 16 <= len; pos += 16)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(haystack + pos));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(haystack + pos + n - 1));
+        const __m128i eq_first = _mm_cmpeq_epi8(_mm_or_si128(a, fmask), first);
+        const __m128i eq_last  = _mm_cmpeq_epi8(_mm_or_si128(b, lmask), last);
+
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last));
+        for (unsigned bit=0; mask; ++bit, mask >>= 1)
+        {
+            if ((mask & 1) && verify(haystack + pos + bit))
+                return true;
+        }
+    }
+    return false;
+}
+
+#endif
+
+bool substring_matcher::search(const char* haystack, std::size_t len) const
+{
+    const auto n = needle_.size();
+    if (n == 0)
+        return true;
+    if (n > len)
+        return false;
+
+    std::size_t pos = 0;
+
+#if defined(SUBSTRING_X86)
+    static const bool sse2 = get_cpu_features().sse2;
+    if (sse2 && search_sse2(haystack, len, pos))
+        return true;
+#endif
+
+    // the rest of the haystack that doesn't fill a whole block.
+    return search_scalar(haystack + pos, len - pos);
+}
+
+} // newsflash
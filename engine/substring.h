@@ -0,0 +1,84 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "newsflash/config.h"
+
+#include <string>
+#include <cstddef>
+
+namespace newsflash
+{
+    // Search for a fixed substring in subject lines. This is used for
+    // filtering the headers so the same needle is searched for in millions
+    // of (short) lines. The search scans 16 bytes at a time with SSE2 for
+    // positions where both the first and the last byte of the needle match
+    // and only then compares the bytes in between. Case insensitive matching
+    // folds ASCII letters only, i.e. for a needle with non-ASCII characters
+    // the caller should do a proper unicode aware search.
+    class substring_matcher
+    {
+    public:
+        substring_matcher()
+        {}
+        substring_matcher(const std::string& needle, bool case_sensitive)
+        {
+            reset(needle, case_sensitive);
+        }
+
+        // set a new needle.
+        void reset(const std::string& needle, bool case_sensitive);
+
+        // returns true if the needle is an empty string.
+        bool empty() const
+        { return needle_.empty(); }
+
+        // returns true if the needle consists of ASCII characters only.
+        bool is_ascii() const
+        { return ascii_; }
+
+        bool is_case_sensitive() const
+        { return case_sensitive_; }
+
+        // search the haystack for the needle. an empty needle is always found.
+        bool search(const char* haystack, std::size_t len) const;
+
+        // same as search but without the SIMD kernel.
+        bool search_scalar(const char* haystack, std::size_t len) const;
+
+    private:
+        bool verify(const char* candidate) const;
+        bool search_sse2(const char* haystack, std::size_t len, std::size_t& pos) const;
+
+    private:
+        // the needle, lower cased when not case sensitive.
+        std::string needle_;
+        // the mask that is or'ed with the haystack bytes before comparing
+        // to the first and last byte of the needle. 0x20 when the byte is
+        // an ASCII letter and the search is not case sensitive. this maps
+        // 'A' to 'a' and keeps every other byte from matching 'a'.
+        unsigned char first_mask_ = 0;
+        unsigned char last_mask_  = 0;
+        bool case_sensitive_ = true;
+        bool ascii_ = true;
+    };
+
+} // newsflash
@@ -29,6 +29,7 @@
 
 #include "action.h"
 #include "bitflag.h"
+#include "pipeline.h"
 
 namespace newsflash
 {
@@ -61,8 +62,9 @@ namespace newsflash
         virtual ~Task() = default;
 
         // Create a command list object with details about
-        // what data to read from the remote host.
-        virtual std::shared_ptr<CmdList> CreateCommands() = 0;
+        // what data to read from the remote host. The depth is
+        // the amount of work the executing connection wants per cmdlist.
+        virtual std::shared_ptr<CmdList> CreateCommands(const PipelineDepth& depth = PipelineDepth()) = 0;
 
         // cancel the task. if the task is not complete then this has the effect
         // of canceling all the work that has been done, for example removing
@@ -176,6 +176,65 @@ bool TcpSocket::CanRecv() const
 
 }
 
+Socket::IoStatus TcpSocket::TryCompleteConnect(std::error_code* error)
+{
+    assert(socket_);
+
+    *error = complete_socket_connect(handle_, socket_);
+    return IoStatus::Done;
+}
+
+Socket::IoStatus TcpSocket::TrySend(const void* buff, int len, int* sent, std::error_code* error)
+{
+    assert(socket_);
+
+    int flags = 0;
+
+#if defined(LINUX_OS)
+    flags = MSG_NOSIGNAL;
+#endif
+
+    *sent = 0;
+
+    const int ret = ::send(socket_, static_cast<const char*>(buff), len, flags);
+    if (ret == OS_SOCKET_ERROR)
+    {
+        const auto err = get_last_socket_error();
+        if (err == std::errc::operation_would_block)
+            return IoStatus::WantWrite;
+
+        *error = err;
+        return IoStatus::Done;
+    }
+#if defined(WINDOWS_OS)
+    // see the comment in SendSome
+    CHECK(SetEvent(handle_), TRUE);
+#endif
+
+    *sent = ret;
+    return IoStatus::Done;
+}
+
+Socket::IoStatus TcpSocket::TryRecv(void* buff, int capacity, int* received, std::error_code* error)
+{
+    assert(socket_);
+
+    *received = 0;
+
+    const int ret = ::recv(socket_, static_cast<char*>(buff), capacity, 0);
+    if (ret == OS_SOCKET_ERROR)
+    {
+        const auto err = get_last_socket_error();
+        if (err == std::errc::operation_would_block)
+            return IoStatus::WantRead;
+
+        *error = err;
+        return IoStatus::Done;
+    }
+    *received = ret;
+    return IoStatus::Done;
+}
+
 TcpSocket& TcpSocket::operator=(TcpSocket&& other)
 {
     if (&other == this)
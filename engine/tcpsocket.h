@@ -64,6 +64,9 @@ namespace newsflash
         virtual WaitHandle GetWaitHandle() const override;
         virtual WaitHandle GetWaitHandle(bool waitread, bool waitwrite) const override;
         virtual bool CanRecv() const override;
+        virtual IoStatus TryCompleteConnect(std::error_code* error) override;
+        virtual IoStatus TrySend(const void* buff, int len, int* sent, std::error_code* error) override;
+        virtual IoStatus TryRecv(void* buff, int capacity, int* received, std::error_code* error) override;
 
         TcpSocket& operator=(TcpSocket&& other);
 
@@ -26,19 +26,124 @@
 #include <algorithm>
 #include <cassert>
 #include <thread>
+#include <vector>
 
 #include "threadpool.h"
 #include "action.h"
 #include "minidump.h"
+#include "assert.h"
 
 namespace newsflash
 {
+namespace {
+
+// bounded lock-free multi-producer multi-consumer queue.
+// (Dmitry Vyukov's bounded MPMC queue). every cell carries a sequence
+// number that tells whether the cell is ready to be written or read
+// in the current lap around the ring buffer.
+class ActionQueue
+{
+public:
+    ActionQueue(std::size_t capacity) : cells_(new Cell[capacity]), mask_(capacity - 1)
+    {
+        // capacity must be a power of two
+        assert((capacity & mask_) == 0);
+
+        for (std::size_t i=0; i<capacity; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    // try to push an action at the back of the queue.
+    // returns false if the queue is full.
+    bool TryPush(action* act)
+    {
+        auto pos = tail_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells_[pos & mask_];
+            const auto seq  = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = (std::intptr_t)seq - (std::intptr_t)pos;
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.act = act;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    // try to pop the action at the front of the queue.
+    // returns nullptr if the queue is empty.
+    action* TryPop()
+    {
+        auto pos = head_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells_[pos & mask_];
+            const auto seq  = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = (std::intptr_t)seq - (std::intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    auto* act = cell.act;
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return act;
+                }
+            }
+            else if (diff < 0)
+                return nullptr;
+            else pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool IsEmpty() const
+    {
+        return head_.load(std::memory_order_seq_cst) ==
+               tail_.load(std::memory_order_seq_cst);
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        action* act = nullptr;
+    };
+    std::unique_ptr<Cell[]> cells_;
+    const std::size_t mask_;
+
+    // keep the producer and consumer indices on separate cache lines.
+    alignas(64) std::atomic<std::size_t> head_;
+    alignas(64) std::atomic<std::size_t> tail_;
+};
+
+} // namespace
+
 struct ThreadPool::State {
     std::atomic<std::size_t> queue_size;
 
+    // the number of stealing threads currently waiting for work.
+    std::atomic<std::size_t> num_idle;
+
+    // the threads that take part in the work stealing.
+    std::vector<StealingThread*> stealers;
+
+    // shared overflow queue for the rare case when the
+    // thread's own queue is full. any thread can take from here.
+    std::mutex overflow_mutex;
+    std::queue<action*> overflow;
+    std::atomic<std::size_t> overflow_size;
+
     OnActionDone callback;
 
-    State() : queue_size(0)
+    State() : queue_size(0), num_idle(0), overflow_size(0)
     {}
 };
 
@@ -168,7 +273,202 @@ private:
     std::shared_ptr<State> state_;
 };
 
-ThreadPool::ThreadPool(std::size_t initial_pool_size)
+// pooled thread that takes part in work stealing. the any_thread actions
+// are queued in a lock-free queue that the other threads can steal from
+// when they run out of work. the pinned (single_thread) actions are
+// kept in a separate queue that only this thread takes actions from.
+class ThreadPool::StealingThread : public ThreadPool::Thread
+{
+public:
+    StealingThread(std::shared_ptr<State> state, std::size_t index)
+        : state_(state), index_(index), queue_(QueueCapacity)
+    {}
+
+    // start the thread. this is separate from the constructor so that
+    // all the threads can be created before any thread starts stealing.
+    void Start()
+    {
+        run_loop_ = true;
+        thread_.reset(new std::thread(std::bind(&StealingThread::ThreadSehMain, this)));
+    }
+
+    virtual void Submit(action* act) override
+    {
+        const bool pinned = act->get_affinity() == action::affinity::single_thread;
+        if (pinned)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pinned_.push(act);
+            pinned_size_++;
+        }
+        else if (!queue_.TryPush(act))
+        {
+            std::lock_guard<std::mutex> lock(state_->overflow_mutex);
+            state_->overflow.push(act);
+            state_->overflow_size++;
+        }
+
+        // pairs with the fence in ThreadMain. either we see the thread
+        // as idle and wake it up or the thread sees the new action.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (WakeUp() || pinned)
+            return;
+
+        // this thread is busy, wake up some idle thread
+        // so that it can steal the action.
+        if (state_->num_idle == 0)
+            return;
+        for (auto* thread : state_->stealers)
+        {
+            if (thread->WakeUp())
+                break;
+        }
+    }
+    virtual void Shutdown() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            run_loop_ = false;
+            cond_.notify_one();
+        }
+        thread_->join();
+    }
+
+    // wake up the thread if it's waiting for work.
+    // returns true if the thread was woken up.
+    bool WakeUp()
+    {
+        if (!idle_)
+            return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_)
+            return false;
+
+        idle_ = false;
+        state_->num_idle--;
+        cond_.notify_one();
+        return true;
+    }
+
+private:
+    void ThreadMain()
+    {
+        while (run_loop_)
+        {
+            if (auto* next = FindAction())
+            {
+                next->perform();
+
+                state_->callback(next);
+                state_->queue_size--;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!run_loop_)
+                return;
+
+            idle_ = true;
+            state_->num_idle++;
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // check again after announcing that we're idle
+            // in case an action was submitted in between.
+            if (HasWork())
+            {
+                idle_ = false;
+                state_->num_idle--;
+                continue;
+            }
+            cond_.wait(lock, [&]() {
+                return !idle_ || !run_loop_;
+            });
+            if (idle_)
+            {
+                idle_ = false;
+                state_->num_idle--;
+            }
+        }
+    }
+
+    void ThreadSehMain()
+    {
+        SEH_BLOCK(ThreadMain();)
+    }
+
+    action* FindAction()
+    {
+        if (pinned_size_)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!pinned_.empty())
+            {
+                auto* next = pinned_.front();
+                pinned_.pop();
+                pinned_size_--;
+                return next;
+            }
+        }
+        if (auto* next = queue_.TryPop())
+            return next;
+
+        if (state_->overflow_size)
+        {
+            std::lock_guard<std::mutex> lock(state_->overflow_mutex);
+            if (!state_->overflow.empty())
+            {
+                auto* next = state_->overflow.front();
+                state_->overflow.pop();
+                state_->overflow_size--;
+                return next;
+            }
+        }
+
+        // steal from the other threads. start from the next thread
+        // so that the threads don't all go after the same victim.
+        const auto& stealers = state_->stealers;
+        for (std::size_t i=1; i<stealers.size(); ++i)
+        {
+            auto* victim = stealers[(index_ + i) % stealers.size()];
+            if (auto* next = victim->queue_.TryPop())
+                return next;
+        }
+        return nullptr;
+    }
+
+    // called with the mutex held.
+    bool HasWork() const
+    {
+        if (!pinned_.empty() || state_->overflow_size)
+            return true;
+        for (const auto* thread : state_->stealers)
+        {
+            if (!thread->queue_.IsEmpty())
+                return true;
+        }
+        return false;
+    }
+
+private:
+    static const std::size_t QueueCapacity = 4096;
+
+    std::shared_ptr<State> state_;
+    const std::size_t index_;
+    ActionQueue queue_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::queue<action*> pinned_;
+    std::atomic<std::size_t> pinned_size_ {0};
+    std::atomic<bool> idle_ {false};
+    std::atomic<bool> run_loop_ {false};
+    std::unique_ptr<std::thread> thread_;
+};
+
+ThreadPool::ThreadPool(std::size_t initial_pool_size, Scheduling scheduling)
 {
     state_ = std::make_shared<State>();
 
@@ -177,11 +477,24 @@ ThreadPool::ThreadPool(std::size_t initial_pool_size)
     // thus turning the whole system into a single threaded system
     // this is mostly convenient for debugging purposes.
 
+    if (scheduling == Scheduling::RoundRobin)
+    {
+        for (std::size_t i=0; i<initial_pool_size; ++i)
+        {
+            std::unique_ptr<ThreadPool::Thread> thread(new RealThread(state_));
+            pooled_threads_.push_back(std::move(thread));
+        }
+        return;
+    }
+
     for (std::size_t i=0; i<initial_pool_size; ++i)
     {
-        std::unique_ptr<ThreadPool::Thread> thread(new RealThread(state_));
+        std::unique_ptr<StealingThread> thread(new StealingThread(state_, i));
+        state_->stealers.push_back(thread.get());
         pooled_threads_.push_back(std::move(thread));
     }
+    for (auto* thread : state_->stealers)
+        thread->Start();
 }
 
 ThreadPool::~ThreadPool()
@@ -260,6 +573,7 @@ void ThreadPool::Shutdown()
     {
         thread->Shutdown();
     }
+    state_->stealers.clear();
     pooled_threads_.clear();
     private_threads_.clear();
 }
@@ -25,6 +25,7 @@
 #include <functional>
 #include <memory>
 #include <queue>
+#include <vector>
 #include <atomic>
 #include <cstddef>
 
@@ -37,8 +38,22 @@ namespace newsflash
     public:
         class Thread;
 
+        // how the actions with any_thread affinity are scheduled
+        // on the pooled threads.
+        enum class Scheduling {
+            // each action is assigned to the next thread in a round robin
+            // fashion. an action that takes a long time to complete
+            // stalls all the actions queued behind it in the same thread.
+            RoundRobin,
+
+            // the actions are still assigned round robin but idle threads
+            // steal queued actions from the busy threads. actions with
+            // single_thread affinity are pinned to their thread and are never stolen.
+            WorkStealing
+        };
+
         // initialize the pool with num_threads.
-        ThreadPool(std::size_t initial_pool_size);
+        ThreadPool(std::size_t initial_pool_size, Scheduling scheduling = Scheduling::WorkStealing);
        ~ThreadPool();
 
         void AddMainThread(bool pooled, bool private_thread);
@@ -83,6 +98,7 @@ namespace newsflash
         struct State;
         class RealThread;
         class MainThread;
+        class StealingThread;
 
     private:
         std::shared_ptr<State> state_;
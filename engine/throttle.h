@@ -23,27 +23,36 @@
 #include "newsflash/config.h"
 
 #include <atomic>
-#include <mutex>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <algorithm>
+#include <cmath>
 #include <limits>
-#include <thread>
 
 namespace newsflash
 {
-    // implement throttling to conserve/limit bandwidth usage
+    // implement throttling to conserve/limit bandwidth usage.
+    // the throttle is a token bucket that refills continuously at the
+    // quota rate and holds up to a burst worth of bytes, so a connection
+    // that has been idle can take a larger chunk at once.
+    // the bucket state is a single atomic "theoretical arrival time"
+    // (the time when the bucket would be full again) so taking and
+    // returning quota never blocks.
+    // throttles can be chained so that the quota given by a throttle
+    // is also limited by its parent throttle, for example task -> account -> global.
     class throttle
     {
     public:
-        throttle()
+        throttle(throttle* parent = nullptr) : parent_(parent)
         {
-            start_ = clock_t::now();
+            reset();
         }
 
         void enable(bool on_off)
         {
             enabled_ = on_off;
+            reset();
         }
 
         // enable throttling.
@@ -51,47 +60,69 @@ namespace newsflash
         void set_quota(std::size_t bytes_per_second)
         {
             quota_ = bytes_per_second;
+            reset();
         }
 
-        void accumulate(std::size_t actual, std::size_t quota)
+        // set the maximum number of bytes that can be given at once after
+        // the throttle has been idle. 0 means a quarter second worth of quota.
+        // the burst is limited to at most a second worth of quota.
+        void set_burst(std::size_t bytes)
         {
-            if (!enabled_)
-                return;
+            burst_ = bytes;
+        }
 
-            std::lock_guard<std::mutex> lock(mutex_);
-            if (actual > quota)
-                actual = quota;
+        // set the parent throttle whose quota also limits this throttle.
+        void set_parent(throttle* parent)
+        {
+            parent_ = parent;
+        }
 
-            // if actual number of bytes received is less than
-            // the quote that was allowed to be returned
-            // we can return the difference to "avaiable" quota, i.e.
-            // reduce accum so far.
-            accum_ -= (quota - actual);
+        // return the unused part of the quota given by give_quota.
+        void accumulate(std::size_t actual, std::size_t quota)
+        {
+            if (actual < quota)
+                give_back(quota - actual);
+
+            if (auto* parent = parent_.load())
+                parent->accumulate(actual, quota);
         }
 
-        std::size_t give_quota()
+        // take up to max bytes of quota from this throttle and its parents.
+        // returns 0 if there's no quota available right now, in which case
+        // get_wait_time tells how long until there is.
+        std::size_t give_quota(std::size_t max = std::numeric_limits<std::size_t>::max())
         {
-            if (!enabled_)
-                return std::numeric_limits<std::size_t>::max();
-
-            // at any given moment we have a fraction of the total
-            // quota available to be shared between all connections.
-            std::lock_guard<std::mutex> lock(mutex_);
-            const auto now  = millis();
-            const auto gone = now - time_;
-            if (gone > 1000)
-            {
-                accum_ = (gone % 1000) / 1000.0 * quota_;
-                time_  = now;
-            }
-            if (accum_ >= quota_)
+            auto quota = take(max);
+            if (!quota)
                 return 0;
 
-            const auto avail = quota_ - accum_;
-            const auto chunk = std::min<std::size_t>(avail, 1024);
+            if (auto* parent = parent_.load())
+            {
+                const auto given = parent->give_quota(quota);
+                if (given < quota)
+                    give_back(quota - given);
+                quota = given;
+            }
+            return quota;
+        }
 
-            accum_ += chunk;
-            return chunk;
+        // get the time to wait until the given number of bytes can be
+        // given by this throttle and its parents.
+        std::chrono::microseconds get_wait_time(std::size_t bytes = 1024) const
+        {
+            std::int64_t wait = 0;
+            if (enabled_)
+            {
+                const auto rate = rate_of(quota_);
+                const auto now  = nanos();
+                const auto base = std::max(tat_.load(), now);
+                const auto cost = nanos_of(bytes, rate);
+                wait = std::max<std::int64_t>(0, base + cost - burst_nanos() - now);
+            }
+            std::chrono::microseconds ret(wait / 1000);
+            if (const auto* parent = parent_.load())
+                ret = std::max(ret, parent->get_wait_time(bytes));
+            return ret;
         }
 
         bool is_enabled() const
@@ -100,26 +131,87 @@ namespace newsflash
         std::size_t get_quota() const
         { return quota_; }
 
-
     private:
         using clock_t = std::chrono::steady_clock;
-        using point_t = std::chrono::time_point<clock_t>;
 
-        std::size_t millis() const
+        static std::int64_t nanos()
+        {
+            const auto now = clock_t::now().time_since_epoch();
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+        }
+
+        // nanoseconds per byte.
+        static double rate_of(std::size_t quota)
         {
-            const auto now  = clock_t::now();
-            const auto span = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_);
-            const auto tick = span.count();
-            return tick;
+            return quota ? 1000000000.0 / quota : std::numeric_limits<double>::max();
         }
 
+        // nanoseconds to transfer the bytes at the given rate. clamped
+        // to a day so that a zero quota doesn't overflow. the quota given
+        // is rounded up and the quota returned is rounded down so that
+        // the rounding errors never add up to more than the quota.
+        static std::int64_t nanos_of(std::size_t bytes, double rate, bool round_up = false)
+        {
+            const auto ns = std::min<double>(bytes * rate, 86400.0 * 1000000000.0);
+            return static_cast<std::int64_t>(round_up ? std::ceil(ns) : ns);
+        }
+
+        std::int64_t burst_nanos() const
+        {
+            const std::size_t quota = quota_;
+            const std::size_t burst = burst_ ? burst_.load() : quota / 4;
+            return std::min<std::int64_t>(nanos_of(burst, rate_of(quota)), 1000000000);
+        }
+
+        // start with an empty bucket so that the quota is never
+        // exceeded when measured from the start.
+        void reset()
+        {
+            tat_ = nanos() + burst_nanos();
+        }
+
+        std::size_t take(std::size_t max)
+        {
+            if (!enabled_)
+                return max;
+
+            const auto rate  = rate_of(quota_);
+            const auto burst = burst_nanos();
+            const auto now   = nanos();
+
+            auto tat = tat_.load();
+            for (;;)
+            {
+                const auto base = std::max(tat, now);
+                const auto room = now + burst - base;
+                if (room <= 0)
+                    return 0;
+
+                const auto avail = room / rate;
+                const auto quota = avail >= max ? max : static_cast<std::size_t>(avail);
+                if (!quota)
+                    return 0;
+
+                const auto next = base + nanos_of(quota, rate, true);
+                if (tat_.compare_exchange_weak(tat, next))
+                    return quota;
+            }
+        }
+
+        void give_back(std::size_t bytes)
+        {
+            if (!enabled_)
+                return;
+            // the bucket can't hold more than a burst so there's
+            // no point in returning more than that.
+            tat_ -= std::min(nanos_of(bytes, rate_of(quota_)), burst_nanos());
+        }
 
     private:
-        point_t start_;
-        std::size_t time_ = 0;
-        std::size_t quota_ = 0;
-        std::size_t accum_ = 0;
-        std::mutex  mutex_;
+        std::atomic<throttle*> parent_;
+        std::atomic<std::int64_t> tat_ {0};
+        std::atomic<std::size_t> quota_ {0};
+        std::atomic<std::size_t> burst_ {0};
         std::atomic<bool> enabled_ {false};
     };
 
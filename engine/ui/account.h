@@ -84,6 +84,15 @@ namespace newsflash
         // on some hosts command pipelining *may* improve performance.
         bool enable_pipelining = false;
 
+        // run the connections from the shared event loop (reactor)
+        // threads with non-blocking sockets instead of giving each
+        // connection a thread of its own. (Linux only)
+        bool enable_event_loop = false;
+
+        // maximum download speed in bytes per second for all
+        // the connections of this account. 0 for no limit.
+        std::uint32_t max_bps = 0;
+
         // user specific opaque data object that will be associated
         // with *all* the connection objects created for this account.
         // the client is responsinble for managin the lifetime of this
@@ -123,6 +123,15 @@ namespace newsflash
         // current speed in bytes per second.
         std::uint32_t bps = 0;
 
+        // the number of BODY commands currently sent per cmdlist.
+        std::uint32_t pipeline = 0;
+
+        // the number of articles currently requested per XOVER.
+        std::uint32_t xover_range = 0;
+
+        // the measured command round trip time in milliseconds.
+        std::uint32_t rtt = 0;
+
     };
 
 } // ui
@@ -0,0 +1,173 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "engine/datafile.h"
+#include "engine/threadpool.h"
+#include "engine/ioring.h"
+#include "engine/action.h"
+#include "engine/utility.h"
+#include "unit_test_common.h"
+
+// Write synthetic segments into data files through the thread pool
+// the same way a download does and compare the synchronous writes with
+// the writes queued to io_uring. The segments of each file arrive out of
+// order within a small window like they do from many connections.
+// Prints the throughput and the time the pool threads spend in the writes.
+// The total amount of data is given in GB on the command line (the default
+// is 1, for example 100 to write 100 GB) and optionally the directory
+// where to write the files.
+// This isn't run as a part of the unit tests.
+
+namespace {
+
+const std::size_t SegmentSize = 768000;
+const std::size_t SegmentsPerFile = 350;
+const std::size_t NumFiles = 4;
+const std::size_t NumThreads = 4;
+const std::size_t ReorderWindow = 8;
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<std::uint64_t> busy_nanos;
+
+class TimedWrite : public newsflash::action
+{
+public:
+    TimedWrite(std::unique_ptr<newsflash::action> write) : write_(std::move(write))
+    {
+        set_affinity(write_->get_affinity());
+    }
+    virtual void xperform() override
+    {
+        const auto start = Clock::now();
+        write_->perform();
+        const auto end = Clock::now();
+        busy_nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    }
+    virtual std::string describe() const override
+    { return "TimedWrite"; }
+
+    bool failed() const
+    { return write_->has_exception(); }
+private:
+    std::unique_ptr<newsflash::action> write_;
+};
+
+void run(const char* name, const std::string& path, std::uint64_t total_bytes, newsflash::IoRing* ring)
+{
+    const std::vector<char> segment = generate_buffer(SegmentSize);
+
+    const std::uint64_t file_bytes = SegmentSize * SegmentsPerFile;
+    const std::uint64_t num_rounds = std::max<std::uint64_t>(1,
+        total_bytes / (file_bytes * NumFiles));
+
+    std::atomic<std::size_t> num_failed(0);
+
+    newsflash::ThreadPool threads(NumThreads);
+    threads.SetCallback([&](newsflash::action* a) {
+        if (static_cast<TimedWrite*>(a)->failed())
+            ++num_failed;
+        delete a;
+    });
+
+    busy_nanos = 0;
+    std::uint64_t bytes = 0;
+
+    const auto start = Clock::now();
+    for (std::uint64_t round=0; round<num_rounds; ++round)
+    {
+        std::vector<std::shared_ptr<newsflash::DataFile>> files;
+        for (std::size_t i=0; i<NumFiles; ++i)
+        {
+            const auto& name = "benchmark_datafile_" + std::to_string(i);
+            files.push_back(std::make_shared<newsflash::DataFile>(path, name,
+                file_bytes, true, true, ring));
+        }
+
+        std::vector<std::size_t> order;
+        for (std::size_t i=0; i<SegmentsPerFile; ++i)
+            order.push_back(i);
+        for (std::size_t i=0; i<SegmentsPerFile; i+=ReorderWindow)
+        {
+            const auto end = std::min(i + ReorderWindow, SegmentsPerFile);
+            std::random_shuffle(order.begin() + i, order.begin() + end);
+        }
+
+        for (auto index : order)
+        {
+            for (auto& file : files)
+            {
+                // see the comment in DataFile about the +1
+                const auto offset = index * SegmentSize + 1;
+                threads.Submit(new TimedWrite(file->Write(offset, segment)));
+                bytes += SegmentSize;
+            }
+        }
+        for (auto& file : files)
+            file->Close();
+        threads.WaitAllActions();
+
+        for (auto& file : files)
+            newsflash::bigfile::erase(fs::joinpath(file->GetFilePath(), file->GetFileName()));
+    }
+    const std::chrono::duration<double> secs = Clock::now() - start;
+    threads.Shutdown();
+
+    BOOST_REQUIRE(num_failed == 0);
+
+    std::printf("%-10s %10.1f MB/s  %8.1f s  pool threads busy %8.1f s\n",
+        name,
+        bytes / secs.count() / (1024.0 * 1024.0),
+        secs.count(),
+        busy_nanos / 1000000000.0);
+}
+
+} // namespace
+
+int test_main(int argc, char* argv[])
+{
+    const std::uint64_t gigabytes = argc > 1 ? std::atoi(argv[1]) : 1;
+    const std::string path = argc > 2 ? argv[2] : "";
+
+    const std::uint64_t total_bytes = newsflash::GB(gigabytes);
+
+    run("sync", path, total_bytes, nullptr);
+
+    if (newsflash::IoRing::IsSupported())
+        run("io_uring", path, total_bytes, newsflash::IoRing::Get());
+    else std::printf("io_uring is not supported\n");
+
+    return 0;
+}
@@ -0,0 +1,273 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "engine/ui/account.h"
+#include "engine/ui/download.h"
+#include "engine/ui/task.h"
+#include "engine/engine.h"
+#include "engine/connection.h"
+#include "engine/cmdlist.h"
+#include "engine/task.h"
+#include "engine/logging.h"
+
+// Measure the engine's scheduling overhead with a very large download queue.
+// The tasks and the connections are simulated in process so that each
+// cmdlist completes immediately and the time spent is dominated by the
+// engine picking the next task and the next idle connection for every
+// completed cmdlist. This isn't run as a part of the unit tests.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const std::size_t NumTasks = 10000;
+const std::size_t NumConnections = 20;
+
+class BenchmarkTask : public newsflash::Task
+{
+public:
+    BenchmarkTask(const newsflash::ui::FileDownload& file)
+    {
+        articles_ = file.articles;
+        groups_   = file.groups;
+    }
+
+    virtual std::shared_ptr<newsflash::CmdList> CreateCommands(const newsflash::PipelineDepth&) override
+    {
+        newsflash::CmdList::Messages m;
+        m.groups   = groups_;
+        m.numbers  = articles_;
+        articles_.clear();
+        return std::make_shared<newsflash::CmdList>(m);
+    }
+
+    virtual bool HasCommands() const override
+    { return !articles_.empty(); }
+
+    virtual bool HasProgress() const override
+    { return false; }
+
+    virtual float GetProgress() const override
+    { return 0.0f; }
+private:
+    std::vector<std::string> articles_;
+    std::vector<std::string> groups_;
+};
+
+class BenchmarkConnection : public newsflash::Connection
+{
+public:
+    struct Connect : public newsflash::action
+    {
+        virtual void xperform() override
+        {}
+    };
+
+    struct Execute : public newsflash::action
+    {
+        virtual void xperform() override
+        {}
+
+        virtual void run_completion_callbacks() override
+        {
+            newsflash::Connection::CmdListCompletionData completion;
+            completion.cmds          = cmdlist;
+            completion.total_bytes   = 0;
+            completion.content_bytes = 0;
+            completion.execution_did_complete = true;
+            callback(completion);
+        }
+        std::shared_ptr<newsflash::CmdList> cmdlist;
+        newsflash::Connection::OnCmdlistDone callback;
+    };
+
+    virtual std::unique_ptr<newsflash::action> Connect(const HostDetails&) override
+    {
+        state_ = State::Connecting;
+        return std::make_unique<struct Connect>();
+    }
+
+    virtual std::unique_ptr<newsflash::action> Disconnect() override
+    { return nullptr; }
+
+    virtual std::unique_ptr<newsflash::action> Ping() override
+    { return nullptr; }
+
+    virtual std::unique_ptr<newsflash::action> Complete(std::unique_ptr<newsflash::action>) override
+    {
+        state_ = State::Connected;
+        return nullptr;
+    }
+
+    virtual std::unique_ptr<newsflash::action> Execute(std::shared_ptr<newsflash::CmdList> cmd) override
+    {
+        auto ret = std::make_unique<struct Execute>();
+        ret->cmdlist  = cmd;
+        ret->callback = callback_;
+        state_ = State::Active;
+        return std::move(ret);
+    }
+
+    virtual void Cancel() override
+    {}
+
+    virtual std::string GetUsername() const override
+    { return "user"; }
+
+    virtual std::string GetPassword() const override
+    { return "pass"; }
+
+    virtual std::uint32_t GetCurrentSpeedBps() const override
+    { return 0; }
+
+    virtual std::uint64_t GetNumBytesTransferred() const override
+    { return 0; }
+
+    virtual State GetState() const override
+    { return state_; }
+
+    virtual Error GetError() const override
+    { return Error::None; }
+
+    virtual void SetCallback(const OnCmdlistDone& callback) override
+    { callback_ = callback; }
+private:
+    State state_ = State::Disconnected;
+    OnCmdlistDone callback_;
+};
+
+struct Factory : public newsflash::Engine::Factory
+{
+    virtual std::unique_ptr<newsflash::Task> AllocateTask(const newsflash::ui::FileDownload& file) override
+    { return std::make_unique<BenchmarkTask>(file); }
+
+    virtual std::unique_ptr<newsflash::Task> AllocateTask(const newsflash::ui::HeaderDownload&) override
+    { return nullptr; }
+
+    virtual std::unique_ptr<newsflash::Task> AllocateTask(const newsflash::ui::GroupListDownload&) override
+    { return nullptr; }
+
+    virtual std::unique_ptr<newsflash::Task> AllocateTask(std::size_t) override
+    { return nullptr; }
+
+    virtual std::unique_ptr<newsflash::Connection> AllocateConnection(const newsflash::ui::Account&) override
+    { return std::make_unique<BenchmarkConnection>(); }
+
+    virtual std::unique_ptr<newsflash::ui::Result> MakeResult(const newsflash::Task&, const newsflash::ui::TaskDesc&) const override
+    { return nullptr; }
+
+    virtual std::unique_ptr<newsflash::Logger> AllocateEngineLogger() override
+    { return std::make_unique<newsflash::NullLogger>(); }
+
+    virtual std::unique_ptr<newsflash::Logger> AllocateConnectionLogger() override
+    { return std::make_unique<newsflash::NullLogger>(); }
+};
+
+newsflash::ui::FileBatchDownload make_batch(std::size_t num_files)
+{
+    newsflash::ui::FileBatchDownload batch;
+    batch.account = 1;
+    batch.path    = "benchmark";
+    batch.desc    = "benchmark";
+    for (std::size_t i=0; i<num_files; ++i)
+    {
+        newsflash::ui::FileDownload file;
+        file.account = 1;
+        file.size    = 1;
+        file.path    = "benchmark";
+        file.desc    = "file" + std::to_string(i);
+        file.articles.push_back("<" + std::to_string(i) + "@benchmark>");
+        file.groups.push_back("alt.binaries.benchmark");
+        batch.files.push_back(std::move(file));
+        batch.size += 1;
+    }
+    return batch;
+}
+
+void report(const char* name, double seconds, std::size_t items)
+{
+    std::printf("%-10s %8.3f s %12.0f tasks/s\n", name, seconds, items / seconds);
+}
+
+} // namespace
+
+int test_main(int, char*[])
+{
+    const bool debug_single_thread = true;
+
+    newsflash::Engine engine(std::make_unique<Factory>(), debug_single_thread);
+
+    bool finished = false;
+    engine.SetFinishCallback([&]() {
+        finished = true;
+    });
+
+    newsflash::ui::Account account;
+    account.id = 1;
+    account.name = "benchmark";
+    account.secure_host = "benchmark.host";
+    account.secure_port = 1919;
+    account.connections = NumConnections;
+    account.enable_secure_server = true;
+    account.enable_general_server = false;
+
+    const auto& batch = make_batch(NumTasks);
+
+    engine.SetAccount(account, false);
+
+    auto start = Clock::now();
+    engine.DownloadFiles(batch, false);
+    std::chrono::duration<double> secs = Clock::now() - start;
+    report("queue", secs.count(), NumTasks);
+
+    start = Clock::now();
+    engine.Start();
+    while (!finished)
+    {
+        engine.RunMainThread();
+        engine.Pump();
+    }
+    secs = Clock::now() - start;
+    report("execute", secs.count(), NumTasks);
+
+    std::deque<newsflash::ui::TaskDesc> tasks;
+    engine.GetTasks(&tasks);
+    BOOST_REQUIRE(tasks.size() == NumTasks);
+    for (const auto& task : tasks)
+        BOOST_REQUIRE(task.state == newsflash::ui::TaskDesc::States::Complete);
+
+    engine.Stop();
+    while (engine.Pump())
+        engine.RunMainThread();
+
+    return 0;
+}
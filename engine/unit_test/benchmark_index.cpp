@@ -0,0 +1,281 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "engine/catalog.h"
+#include "engine/catalogview.h"
+#include "engine/index.h"
+#include "engine/filebuf.h"
+#include "engine/filemap.h"
+#include "unit_test_common.h"
+
+// Measure sorting the header index on the worst case columns.
+// The baseline is the previous comparator sort that loaded both
+// articles for every comparison, "columns" compares the values
+// read straight from the catalog views and "keysort" is the current
+// header_index::sort with extracted keys (radix sort for integer keys and
+// parallel merge sort on collation prefixes for strings).
+// Inserting new headers into the sorted index is measured by inserting
+// the items one by one vs. inserting them as a single batch.
+// This isn't run as a part of the unit tests.
+
+namespace {
+
+const int NumVolumes = 8;
+
+using Clock   = std::chrono::steady_clock;
+using catalog = newsflash::catalog<newsflash::filemap>;
+using view    = newsflash::catalog_view;
+using header_index = newsflash::index<newsflash::filemap>;
+using article = newsflash::article<newsflash::filemap>;
+
+std::string volume_name(int vol)
+{
+    return "benchmark_index_vol" + std::to_string(vol);
+}
+
+void generate_volumes()
+{
+    using catalog = newsflash::catalog<newsflash::filebuf>;
+    using article = newsflash::article<newsflash::filebuf>;
+
+    std::mt19937 rand(1);
+
+    for (int vol=0; vol<NumVolumes; ++vol)
+    {
+        delete_file(volume_name(vol).c_str());
+
+        auto db = std::make_unique<catalog>();
+        db->open(volume_name(vol));
+        for (std::size_t i=0; i<newsflash::CATALOG_SIZE; ++i)
+        {
+            // the subjects share a prefix that is longer than the
+            // collation prefix so every comparison of the prefixes is a tie.
+            char subject[128];
+            std::snprintf(subject, sizeof(subject),
+                "[PRiVATE]-[WtFnZb]-[%u]-[%u/%u] - \"%08x.part%02u.rar\" yEnc (%u/%u)",
+                unsigned(rand() % 100000), unsigned(i % 40 + 1), 40u, unsigned(rand()),
+                unsigned(i % 40 + 1), 1u, unsigned(rand() % 200 + 1));
+
+            article a;
+            a.set_index(i);
+            a.set_author("poster@example.com (Poster)");
+            a.set_subject(subject);
+            a.set_bytes(rand() % 500000);
+            a.set_pubdate(1400000000 + rand() % 100000000);
+            a.set_bits(newsflash::fileflag::broken, rand() % 2);
+            db->insert(a, catalog::index_t{i});
+        }
+        db->flush();
+    }
+}
+
+struct item {
+    std::size_t key;
+    std::size_t index;
+};
+
+template<typename Compare>
+double time_sort(std::vector<item> items, Compare comp)
+{
+    const auto start = Clock::now();
+    std::sort(items.begin(), items.end(), comp);
+    const std::chrono::duration<double> secs = Clock::now() - start;
+    return secs.count();
+}
+
+double time_sort(header_index& idx, header_index::sorting column)
+{
+    // sort by some other column first so that the index
+    // does a full sort instead of just reversing the items.
+    idx.sort(column == header_index::sorting::sort_by_size
+        ? header_index::sorting::sort_by_date
+        : header_index::sorting::sort_by_size, header_index::sortdir::ascending);
+
+    const auto start = Clock::now();
+    idx.sort(column, header_index::sortdir::ascending);
+    const std::chrono::duration<double> secs = Clock::now() - start;
+    return secs.count();
+}
+
+void report(const char* column, const char* name, double seconds, std::size_t items)
+{
+    std::printf("%-10s %-12s %8.3f s %12.0f items/s\n", column, name, seconds, items / seconds);
+}
+
+} // namespace
+
+int test_main(int, char*[])
+{
+    generate_volumes();
+
+    std::vector<std::unique_ptr<catalog>> catalogs;
+    std::vector<std::unique_ptr<view>> views;
+    std::vector<item> items;
+
+    header_index idx;
+    idx.on_load = [&](std::size_t key, std::size_t i) {
+        return catalogs[key]->load(catalog::index_t{i});
+    };
+    idx.on_filter_row = [](const view&, std::size_t) {
+        return true;
+    };
+
+    for (int vol=0; vol<NumVolumes; ++vol)
+    {
+        catalogs.emplace_back(new catalog);
+        catalogs.back()->open(volume_name(vol));
+        views.emplace_back(new view);
+        views.back()->bind(*catalogs.back());
+        idx.attach(vol, views.back().get());
+
+        std::size_t offset = 0;
+        while (offset != views.back()->end())
+        {
+            const auto i = views.back()->load(offset);
+            items.push_back({std::size_t(vol), i});
+        }
+    }
+    // insert in the catalog order, the index is sorted
+    // again before each measurement anyway.
+    idx.sort(header_index::sorting::sort_by_type, header_index::sortdir::ascending);
+    for (const auto& i : items)
+        idx.insert(i.key, i.index);
+    BOOST_REQUIRE(idx.size() == items.size());
+
+    std::shuffle(items.begin(), items.end(), std::mt19937(2));
+
+    auto load = [&](const item& i) {
+        return catalogs[i.key]->load(catalog::index_t{i.index});
+    };
+
+    // date
+    {
+        report("date", "comparator", time_sort(items, [&](const item& lhs, const item& rhs) {
+            return load(lhs).pubdate() < load(rhs).pubdate();
+        }), items.size());
+        report("date", "columns", time_sort(items, [&](const item& lhs, const item& rhs) {
+            return views[lhs.key]->pubdate(lhs.index) < views[rhs.key]->pubdate(rhs.index);
+        }), items.size());
+        report("date", "keysort", time_sort(idx, header_index::sorting::sort_by_date), items.size());
+        for (std::size_t i=1; i<idx.size(); ++i)
+            BOOST_REQUIRE(idx[i-1].pubdate() <= idx[i].pubdate());
+    }
+
+    // broken flag, i.e. lots of equal keys
+    {
+        const auto broken = newsflash::fileflag::broken;
+        report("broken", "comparator", time_sort(items, [&](const item& lhs, const item& rhs) {
+            return load(lhs).test(broken) < load(rhs).test(broken);
+        }), items.size());
+        report("broken", "columns", time_sort(items, [&](const item& lhs, const item& rhs) {
+            return views[lhs.key]->test(lhs.index, broken) < views[rhs.key]->test(rhs.index, broken);
+        }), items.size());
+        report("broken", "keysort", time_sort(idx, header_index::sorting::sort_by_broken), items.size());
+    }
+
+    // subject with a shared prefix
+    {
+        report("subject", "comparator", time_sort(items, [&](const item& lhs, const item& rhs) {
+            return load(lhs).subject() < load(rhs).subject();
+        }), items.size());
+        report("subject", "columns", time_sort(items, [&](const item& lhs, const item& rhs) {
+            return views[lhs.key]->subject(lhs.index) < views[rhs.key]->subject(rhs.index);
+        }), items.size());
+        report("subject", "keysort", time_sort(idx, header_index::sorting::sort_by_subject), items.size());
+        for (std::size_t i=1; i<idx.size(); ++i)
+            BOOST_REQUIRE(!(idx[i].subject() < idx[i-1].subject()));
+    }
+
+    // insert the headers of the last volume into the index
+    // that has the other volumes already.
+    {
+        const std::size_t NumInserts = 16384;
+
+        std::vector<std::size_t> batch;
+        for (const auto& i : items)
+        {
+            if (i.key == NumVolumes - 1 && batch.size() < NumInserts)
+                batch.push_back(i.index);
+        }
+
+        auto build = [&](header_index& idx) {
+            idx.on_load = [&](std::size_t key, std::size_t i) {
+                return catalogs[key]->load(catalog::index_t{i});
+            };
+            idx.on_filter_row = [](const view&, std::size_t) {
+                return true;
+            };
+            for (int vol=0; vol<NumVolumes; ++vol)
+                idx.attach(vol, views[vol].get());
+            idx.sort(header_index::sorting::sort_by_date, header_index::sortdir::ascending);
+
+            for (int vol=0; vol<NumVolumes - 1; ++vol)
+            {
+                std::vector<std::size_t> all;
+                for (const auto& i : items)
+                {
+                    if (i.key == std::size_t(vol))
+                        all.push_back(i.index);
+                }
+                idx.insert(vol, all.begin(), all.end());
+            }
+        };
+
+        header_index single;
+        header_index batched;
+        build(single);
+        build(batched);
+
+        auto start = Clock::now();
+        for (auto i : batch)
+            single.insert(NumVolumes - 1, i);
+        std::chrono::duration<double> secs = Clock::now() - start;
+        report("insert", "single", secs.count(), batch.size());
+
+        start = Clock::now();
+        batched.insert(NumVolumes - 1, batch.begin(), batch.end());
+        secs = Clock::now() - start;
+        report("insert", "batch", secs.count(), batch.size());
+
+        BOOST_REQUIRE(single.size() == batched.size());
+        for (std::size_t i=1; i<batched.size(); ++i)
+            BOOST_REQUIRE(batched[i-1].pubdate() <= batched[i].pubdate());
+    }
+
+    catalogs.clear();
+    for (int vol=0; vol<NumVolumes; ++vol)
+        delete_file(volume_name(vol).c_str());
+
+    return 0;
+}
@@ -0,0 +1,279 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#  include <boost/spirit/include/classic.hpp>
+#  include <boost/regex.hpp>
+#  include <boost/functional/hash.hpp>
+#include "newsflash/warnpop.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "engine/nntp.h"
+
+// Measure the XOVER line parsing throughput, i.e. the work done for
+// every overview line when updating the headers (see article.h).
+// The baseline is the previous boost::spirit date parser and the
+// boost::regex part count search which are kept here for comparison.
+// This isn't run as a part of the unit tests.
+
+namespace {
+
+const std::size_t NumLines = 200000;
+const int Rounds = 5;
+
+using Clock = std::chrono::steady_clock;
+
+namespace legacy {
+
+const char* find_part_count(const char* subjectline, std::size_t len, std::size_t& i)
+{
+    const static boost::regex ex("(\\]|\\))[0-9]*/[0-9]*(\\(|\\[)");
+
+    nntp::reverse_c_str_iterator itbeg(subjectline + len - 1);
+    nntp::reverse_c_str_iterator itend(subjectline - 1);
+
+    boost::match_results<nntp::reverse_c_str_iterator> res;
+    if (!regex_search(itbeg, itend, res, ex))
+        return nullptr;
+    if (res[0].second == itend)
+        return nullptr;
+
+    const char* end   = res[0].first.as_ptr() + 1;
+    const char* start = res[0].second.as_ptr() + 1;
+    i = end - start;
+    return start;
+}
+
+std::uint32_t hashvalue(const char* subjectline, size_t len)
+{
+    std::size_t seed = 0;
+    std::size_t skip = 0;
+
+    const auto* p = find_part_count(subjectline, len, skip);
+    const std::size_t num = p ? p - subjectline : len;
+    std::size_t i = 0;
+    for (; i<num; ++i)
+        boost::hash_combine(seed, subjectline[i]);
+    for (i += skip; i<len; ++i)
+        boost::hash_combine(seed, subjectline[i]);
+    return std::uint32_t(seed);
+}
+
+std::pair<bool, nntp::date> parse_date(const char* str, size_t len)
+{
+    nntp::date date {};
+
+    using namespace boost::spirit::classic;
+
+    auto ret = parse(str, str+len,
+        (
+         alpha_p >> alpha_p >> alpha_p >> ',' >>
+         (uint_p[assign(date.day)]) >>
+         ((repeat_p(3)[alpha_p])[assign(date.month)]) >>
+         (uint_p[assign(date.year)]) >>
+         (uint_p[assign(date.hours)]) >> ':' >>
+         (uint_p[assign(date.minutes)]) >> ':' >>
+         (uint_p[assign(date.seconds)]) >>
+         !(int_p[assign(date.tzoffset)]) >>
+         !(!ch_p('(') >> (*alpha_p)[assign(date.tz)] >> !ch_p(')'))
+         ), ch_p(' '));
+    if (ret.full)
+        return {true, date};
+
+    ret = parse(str, str+len,
+        (
+         (uint_p[assign(date.day)]) >>
+         ((repeat_p(3)[alpha_p])[assign(date.month)]) >>
+         (uint_p[assign(date.year)]) >>
+         (uint_p[assign(date.hours)]) >> ':' >>
+         (uint_p[assign(date.minutes)]) >> ':' >>
+         (uint_p[assign(date.seconds)]) >>
+         !(int_p[assign(date.tzoffset)])     >>
+         !((*alpha_p)[assign(date.tz)])
+        ), ch_p(' '));
+    if (ret.full)
+        return {true, date};
+
+    ret = parse(str, str+len,
+        (
+         (*alpha_p) >>  ',' >>
+         (uint_p[assign(date.day)]) >>
+         ((repeat_p(3)[alpha_p])[assign(date.month)]) >>
+         (uint_p[assign(date.year)]) >>
+         (uint_p[assign(date.hours)]) >> ':' >>
+         (uint_p[assign(date.minutes)]) >> ':' >>
+         (uint_p[assign(date.seconds)]) >>
+         !(int_p[assign(date.tzoffset)]) >>
+         !((*alpha_p)[assign(date.tz)])
+         ), ch_p(' '));
+    return {ret.full, date};
+}
+
+std::pair<bool, nntp::part> parse_part(const char* str, size_t len)
+{
+    nntp::part part {0};
+
+    str = find_part_count(str, len, len);
+    if (!str)
+        return {false, part};
+
+    using namespace boost::spirit::classic;
+
+    const auto& ret = parse(str, str+len,
+        (ch_p('(') >> uint_p[assign(part.numerator)] >>
+         ch_p('/') >> uint_p[assign(part.denominator)] >> ch_p(')')));
+    if (ret.full)
+        return {true, part};
+
+    const auto& ret2 = parse(str, str+len,
+        (ch_p('[') >> uint_p[assign(part.numerator)] >>
+         ch_p('/') >> uint_p[assign(part.denominator)] >> ch_p(']')));
+    return {ret2.full, part};
+}
+
+} // legacy
+
+std::vector<std::string> generate_lines()
+{
+    const char* subjects[] = {
+        "Metallica - Enter Sandman yEnc (%u/%u).mp3",
+        "[%u/%u] - \"ubuntu-14.04-desktop-amd64.part%u.rar\" yEnc (%u/%u)",
+        "#A.B.MM @  EFNet Presents: REQ 40092 - Seinfeld.S09.DVDRip.XviD-SiNK - %u/%u - sink-seinfeld.s09e21e22.r23 (%u/%u)",
+        "girls flirting with is neat GiBBA files Soft I love you to BF-Vol3 (%u).jpg (%u/%u)",
+        "Re: Shuffling the deck %u %u %u",
+        "<Aokay>  Your ccde2010 Fills - %u|%u - yEnc - ccde_Klara_%u.jpg [%u/%u]"
+    };
+    const char* dates[] = {
+        "Thu, 26 Jul 2007 19:44:13 -0500",
+        "Wed, 30 Jun 2010 13:24:51 +0000 (UTC)",
+        "29 Jul 2007 11:25:26 GMT",
+        "Wednesday, 24 Oct 2008 11:58:50 -0800"
+    };
+
+    std::vector<std::string> lines;
+    for (std::size_t i=0; i<NumLines; ++i)
+    {
+        char subject[256];
+        const unsigned a = std::rand() % 100 + 1;
+        const unsigned b = a + std::rand() % 100;
+        std::snprintf(subject, sizeof(subject), subjects[i % 6], a, b, a, a, b);
+
+        nntp::overview ov = {};
+        const auto number = std::to_string(i + 1);
+        const auto bytes  = std::to_string(std::rand() % 500000);
+        const auto msgid  = "<" + number + "@news.example.com>";
+        ov.number.start    = number.c_str();
+        ov.subject.start   = subject;
+        ov.author.start    = "poster@example.com (Poster)";
+        ov.date.start      = dates[(i / 6) % 4];
+        ov.messageid.start = msgid.c_str();
+        ov.bytecount.start = bytes.c_str();
+        ov.linecount.start = "3000";
+        lines.push_back(nntp::make_overview(ov));
+    }
+    return lines;
+}
+
+template<typename ParseDate, typename ParsePart, typename HashValue>
+double run(const std::vector<std::string>& lines, ParseDate parse_date, ParsePart parse_part, HashValue hashvalue)
+{
+    std::size_t checksum = 0;
+
+    const auto start = Clock::now();
+    for (int round=0; round<Rounds; ++round)
+    {
+        for (const auto& line : lines)
+        {
+            const auto& ov = nntp::parse_overview(line.c_str(), line.size());
+            BOOST_REQUIRE(ov.first);
+
+            const auto& subject = ov.second.subject;
+            checksum += hashvalue(subject.start, subject.len);
+
+            const auto& part = parse_part(subject.start, subject.len);
+            checksum += part.second.numerator;
+
+            const auto& date = parse_date(ov.second.date.start, ov.second.date.len);
+            BOOST_REQUIRE(date.first);
+            checksum += date.second.day;
+        }
+    }
+    const std::chrono::duration<double> secs = Clock::now() - start;
+
+    // make sure the work doesn't get optimized away.
+    std::printf("(checksum %zu) ", checksum);
+    return secs.count();
+}
+
+void report(const char* name, double seconds)
+{
+    const double lines = double(NumLines) * Rounds;
+    std::printf("%-10s %10.0f lines/s\n", name, lines / seconds);
+}
+
+} // namespace
+
+int test_main(int, char*[])
+{
+    const auto& lines = generate_lines();
+
+    // the results must be identical before timing anything.
+    for (const auto& line : lines)
+    {
+        const auto& ov = nntp::parse_overview(line.c_str(), line.size());
+        const auto& subject = ov.second.subject;
+        const auto& date    = ov.second.date;
+
+        const auto& d0 = legacy::parse_date(date.start, date.len);
+        const auto& d1 = nntp::parse_date(date.start, date.len);
+        BOOST_REQUIRE(d0.first == d1.first);
+        BOOST_REQUIRE(d0.second.day == d1.second.day);
+        BOOST_REQUIRE(d0.second.month == d1.second.month);
+        BOOST_REQUIRE(d0.second.tzoffset == d1.second.tzoffset);
+        BOOST_REQUIRE(d0.second.tz == d1.second.tz);
+
+        const auto& p0 = legacy::parse_part(subject.start, subject.len);
+        const auto& p1 = nntp::parse_part(subject.start, subject.len);
+        BOOST_REQUIRE(p0.first == p1.first);
+        BOOST_REQUIRE(p0.second.numerator == p1.second.numerator);
+        BOOST_REQUIRE(p0.second.denominator == p1.second.denominator);
+    }
+
+    using ParseDate = std::pair<bool, nntp::date> (*)(const char*, size_t);
+    using ParsePart = std::pair<bool, nntp::part> (*)(const char*, size_t);
+    using HashValue = std::uint32_t (*)(const char*, size_t);
+
+    const auto legacy_secs = run(lines, ParseDate(&legacy::parse_date),
+        ParsePart(&legacy::parse_part), HashValue(&legacy::hashvalue));
+    report("spirit", legacy_secs);
+
+    const auto secs = run(lines, ParseDate(&nntp::parse_date),
+        ParsePart(&nntp::parse_part), HashValue(&nntp::hashvalue));
+    report("current", secs);
+    return 0;
+}
@@ -0,0 +1,207 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/threadpool.h"
+#include "engine/action.h"
+#include "engine/yenc.h"
+
+// Compare the queueing latency and the throughput of the round robin
+// and the work stealing thread pool scheduling with a mix of decoding
+// and file writing actions similar to what a download produces.
+// Every 50th decoding action is a large one that keeps its thread busy
+// for a long time. The actions are submitted at a steady pace the way
+// they'd arrive from the connections so that the latency reflects the
+// scheduling and not just the length of the backlog.
+// This isn't run as a part of the unit tests.
+
+namespace {
+
+const std::size_t PartSize   = 768000;
+const std::size_t NumActions = 4000;
+const std::size_t NumThreads = 4;
+const std::size_t LargeDecodeRounds = 40;
+const std::size_t BurstSize = 4;
+const std::chrono::milliseconds BurstInterval(2);
+
+using Clock = std::chrono::steady_clock;
+
+struct Stats {
+    std::mutex mutex;
+    std::vector<double> latencies;
+};
+
+class BenchmarkAction : public newsflash::action
+{
+public:
+    BenchmarkAction(Stats& stats) : stats_(stats), submitted_(Clock::now())
+    {}
+
+    void Record()
+    {
+        const std::chrono::duration<double, std::milli> latency = started_ - submitted_;
+        std::lock_guard<std::mutex> lock(stats_.mutex);
+        stats_.latencies.push_back(latency.count());
+    }
+protected:
+    virtual void xperform() override
+    {
+        started_ = Clock::now();
+        work();
+    }
+    virtual void work() = 0;
+private:
+    Stats& stats_;
+    Clock::time_point submitted_;
+    Clock::time_point started_;
+};
+
+class DecodeAction : public BenchmarkAction
+{
+public:
+    DecodeAction(Stats& stats, const std::vector<char>& part, std::size_t rounds)
+        : BenchmarkAction(stats), part_(part), rounds_(rounds)
+    {}
+private:
+    virtual void work() override
+    {
+        std::vector<char> out(part_.size());
+        for (std::size_t i=0; i<rounds_; ++i)
+        {
+            std::size_t written = 0;
+            yenc::decode_buffer(part_.data(), 0, part_.size(), out.data(), written);
+            BOOST_REQUIRE(written == PartSize);
+        }
+    }
+private:
+    const std::vector<char>& part_;
+    const std::size_t rounds_;
+};
+
+class WriteAction : public BenchmarkAction
+{
+public:
+    WriteAction(Stats& stats, std::FILE* file, const std::vector<char>& data)
+        : BenchmarkAction(stats), file_(file), data_(data)
+    {}
+private:
+    virtual void work() override
+    {
+        std::fwrite(data_.data(), 1, data_.size(), file_);
+        std::fflush(file_);
+    }
+private:
+    std::FILE* file_ = nullptr;
+    const std::vector<char>& data_;
+};
+
+std::vector<char> generate_part()
+{
+    std::vector<char> junk;
+    junk.resize(PartSize);
+    for (auto& c : junk)
+        c = std::rand();
+
+    std::vector<char> part;
+    yenc::encode(junk.begin(), junk.end(), std::back_inserter(part), 128, true);
+    const std::string trailer("\r\n=yend size=768000 part=1 pcrc32=00000000\r\n.\r\n");
+    std::copy(trailer.begin(), trailer.end(), std::back_inserter(part));
+    return part;
+}
+
+void run(const char* name, newsflash::ThreadPool::Scheduling scheduling, const std::vector<char>& part)
+{
+    std::FILE* files[NumThreads];
+    for (auto& file : files)
+        file = std::tmpfile();
+
+    const std::vector<char> data(PartSize);
+
+    Stats stats;
+
+    newsflash::ThreadPool threads(NumThreads, scheduling);
+    threads.SetCallback([](newsflash::action* a) {
+        static_cast<BenchmarkAction*>(a)->Record();
+        delete a;
+    });
+
+    const auto start = Clock::now();
+    for (std::size_t i=0; i<NumActions; ++i)
+    {
+        // writes to the same file go through the same thread
+        // the same way the data file writes do.
+        if (i % 2)
+        {
+            auto* write = new WriteAction(stats, files[i % NumThreads], data);
+            write->set_affinity(newsflash::action::affinity::single_thread);
+            write->set_owner(i % NumThreads);
+            threads.Submit(write);
+        }
+        else
+        {
+            const auto rounds = (i % 50) == 0 ? LargeDecodeRounds : 1;
+            threads.Submit(new DecodeAction(stats, part, rounds));
+        }
+        if ((i % BurstSize) == BurstSize - 1)
+            std::this_thread::sleep_for(BurstInterval);
+    }
+    threads.WaitAllActions();
+    const std::chrono::duration<double> secs = Clock::now() - start;
+    threads.Shutdown();
+
+    for (auto* file : files)
+        std::fclose(file);
+
+    auto& latencies = stats.latencies;
+    BOOST_REQUIRE(latencies.size() == NumActions);
+    std::sort(latencies.begin(), latencies.end());
+
+    std::printf("%-14s %8.1f actions/s  latency p50 %8.2f ms  p99 %8.2f ms  max %8.2f ms\n",
+        name,
+        NumActions / secs.count(),
+        latencies[latencies.size() / 2],
+        latencies[latencies.size() * 99 / 100],
+        latencies.back());
+}
+
+} // namespace
+
+int test_main(int, char*[])
+{
+    const auto& part = generate_part();
+
+    run("round robin",   newsflash::ThreadPool::Scheduling::RoundRobin, part);
+    run("work stealing", newsflash::ThreadPool::Scheduling::WorkStealing, part);
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "engine/yenc.h"
+#include "engine/bodyiter.h"
+
+// Measure the yEnc decoding throughput of the template decoder and
+// each of the block decoding kernels over a set of typical article
+// sized yEnc parts. This isn't run as a part of the unit tests.
+
+namespace {
+
+const std::size_t PartSize  = 768000;
+const std::size_t PartCount = 64;
+const int Rounds = 5;
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<std::vector<char>> generate_parts()
+{
+    std::vector<std::vector<char>> parts;
+    std::vector<char> junk;
+    junk.resize(PartSize);
+
+    for (std::size_t i=0; i<PartCount; ++i)
+    {
+        for (auto& c : junk)
+            c = std::rand();
+
+        std::vector<char> part;
+        part.reserve(PartSize + PartSize / 32);
+        yenc::encode(junk.begin(), junk.end(), std::back_inserter(part), 128, true);
+        const std::string trailer("\r\n=yend size=768000 part=1 pcrc32=00000000\r\n.\r\n");
+        std::copy(trailer.begin(), trailer.end(), std::back_inserter(part));
+        parts.push_back(std::move(part));
+    }
+    return parts;
+}
+
+void report(const char* name, double seconds, std::size_t bytes)
+{
+    const double mb = bytes / (1024.0 * 1024.0);
+    std::printf("%-10s %8.1f MB/s\n", name, mb / seconds);
+}
+
+} // namespace
+
+int test_main(int, char*[])
+{
+    const auto& parts = generate_parts();
+
+    std::size_t input_bytes = 0;
+    for (const auto& part : parts)
+        input_bytes += part.size();
+
+    std::vector<char> out;
+    out.reserve(PartSize * 2);
+
+    // the template decoder with nntp::bodyiter is the baseline.
+    {
+        const auto start = Clock::now();
+        for (int round=0; round<Rounds; ++round)
+        {
+            for (const auto& part : parts)
+            {
+                out.clear();
+                nntp::bodyiter beg(part.data(), part.size());
+                nntp::bodyiter end(part.data() + part.size(), 0);
+                yenc::decode(beg, end, std::back_inserter(out));
+                BOOST_REQUIRE(out.size() == PartSize);
+            }
+        }
+        const std::chrono::duration<double> secs = Clock::now() - start;
+        report("template", secs.count(), input_bytes * Rounds);
+    }
+
+    const yenc::kernel kernels[] = {
+        yenc::kernel::scalar,
+        yenc::kernel::sse2,
+        yenc::kernel::ssse3,
+        yenc::kernel::avx2
+    };
+    for (auto kernel : kernels)
+    {
+        if (kernel > yenc::best_kernel())
+        {
+            std::printf("%-10s not supported\n", yenc::kernel_name(kernel));
+            continue;
+        }
+
+        const auto start = Clock::now();
+        for (int round=0; round<Rounds; ++round)
+        {
+            for (const auto& part : parts)
+            {
+                out.resize(part.size());
+                std::size_t written = 0;
+                yenc::decode_buffer(part.data(), 0, part.size(), out.data(), written, kernel);
+                BOOST_REQUIRE(written == PartSize);
+            }
+        }
+        const std::chrono::duration<double> secs = Clock::now() - start;
+        report(yenc::kernel_name(kernel), secs.count(), input_bytes * Rounds);
+    }
+    return 0;
+}
@@ -27,9 +27,165 @@
 #include <cstring>
 
 #include "engine/buffer.h"
+#include "engine/bufferpool.h"
+
+void test_pool()
+{
+    namespace nf = newsflash;
+
+    // allocations are rounded to size classes and recycled.
+    {
+        nf::BufferPool pool(1024 * 1024);
+
+        std::size_t size = 0;
+        char* a = pool.Allocate(1000, &size);
+        BOOST_REQUIRE(a);
+        BOOST_REQUIRE(size == 1024);
+        BOOST_REQUIRE(pool.GetStats().misses == 1);
+        BOOST_REQUIRE(pool.GetStats().hits == 0);
+        BOOST_REQUIRE(pool.GetStats().bytes_in_use == 1024);
+
+        pool.Release(a, size);
+        BOOST_REQUIRE(pool.GetStats().bytes_in_use == 0);
+        BOOST_REQUIRE(pool.GetStats().bytes_pooled == 1024);
+
+        char* b = pool.Allocate(600, &size);
+        BOOST_REQUIRE(b == a);
+        BOOST_REQUIRE(pool.GetStats().hits == 1);
+        BOOST_REQUIRE(pool.GetStats().bytes_pooled == 0);
+
+        // different size class
+        char* c = pool.Allocate(5000, &size);
+        BOOST_REQUIRE(size == 8192);
+        BOOST_REQUIRE(c != b);
+        BOOST_REQUIRE(pool.GetStats().misses == 2);
+        BOOST_REQUIRE(pool.GetStats().bytes_in_use == 1024 + 8192);
+        pool.Release(b, 1024);
+        pool.Release(c, 8192);
+        BOOST_REQUIRE(pool.GetStats().bytes_pooled == 1024 + 8192);
+
+        pool.Purge();
+        BOOST_REQUIRE(pool.GetStats().bytes_pooled == 0);
+    }
+
+    // the pool doesn't keep more than the maximum.
+    {
+        nf::BufferPool pool(4096);
+
+        std::size_t size = 0;
+        char* a = pool.Allocate(4096, &size);
+        char* b = pool.Allocate(4096, &size);
+        pool.Release(a, size);
+        pool.Release(b, size);
+        BOOST_REQUIRE(pool.GetStats().bytes_pooled == 4096);
+        BOOST_REQUIRE(pool.GetStats().bytes_in_use == 0);
+
+        pool.SetMaxPoolSize(0);
+        BOOST_REQUIRE(pool.GetStats().bytes_pooled == 0);
+    }
+
+    // buffers return their memory to the shared pool.
+    {
+        auto& pool = nf::BufferPool::Get();
+        pool.Purge();
+
+        const auto before = pool.GetStats();
+        {
+            nf::Buffer buff(nf::MB(4));
+            BOOST_REQUIRE(pool.GetStats().bytes_in_use == before.bytes_in_use + nf::MB(4));
+
+            nf::Buffer copy(buff);
+            BOOST_REQUIRE(pool.GetStats().bytes_in_use == before.bytes_in_use + nf::MB(8));
+
+            nf::Buffer moved(std::move(copy));
+            BOOST_REQUIRE(pool.GetStats().bytes_in_use == before.bytes_in_use + nf::MB(8));
+        }
+        BOOST_REQUIRE(pool.GetStats().bytes_in_use == before.bytes_in_use);
+
+        const auto misses = pool.GetStats().misses;
+        {
+            nf::Buffer buff(nf::MB(4));
+        }
+        BOOST_REQUIRE(pool.GetStats().misses == misses);
+    }
+
+    // growing keeps the contents.
+    {
+        nf::Buffer buff(10);
+        buff.Append("foobar");
+        buff.Allocate(nf::MB(1));
+        BOOST_REQUIRE(buff.GetCapacity() == nf::MB(1));
+        BOOST_REQUIRE(buff.GetSize() == 6);
+        BOOST_REQUIRE(!std::memcmp(buff.Head(), "foobar", 6));
+    }
+}
+
+void test_split()
+{
+    namespace nf = newsflash;
+
+    auto& pool = nf::BufferPool::Get();
+    const auto in_use = pool.GetStats().bytes_in_use;
+
+    nf::Buffer buff(100);
+    buff.Append("response 1\r\nresponse 2\r\nresp");
+
+    const auto* head = buff.Head();
+
+    // split doesn't copy or move any data.
+    auto first = buff.Split(12);
+    BOOST_REQUIRE(first.Head() == head);
+    BOOST_REQUIRE(first.GetSize() == 12);
+    BOOST_REQUIRE(first.GetCapacity() == 12);
+    BOOST_REQUIRE(first.IsShared());
+    BOOST_REQUIRE(buff.Head() == head + 12);
+    BOOST_REQUIRE(buff.GetCapacity() == 100 - 12);
+    BOOST_REQUIRE(!std::memcmp(buff.Head(), "response 2\r\nresp", 16));
+
+    auto second = buff.Split(12);
+    BOOST_REQUIRE(second.Head() == head + 12);
+    BOOST_REQUIRE(!std::memcmp(second.Head(), "response 2\r\n", 12));
+    BOOST_REQUIRE(!std::memcmp(first.Head(), "response 1\r\n", 12));
+
+    // the memory is shared so compacting moves the remaining
+    // data to a new block leaving the split buffers intact.
+    buff.Compact(200);
+    BOOST_REQUIRE(!buff.IsShared());
+    BOOST_REQUIRE(buff.GetSize() == 4);
+    BOOST_REQUIRE(buff.GetCapacity() == 200);
+    BOOST_REQUIRE(!std::memcmp(buff.Head(), "resp", 4));
+    BOOST_REQUIRE(!std::memcmp(first.Head(), "response 1\r\n", 12));
+    BOOST_REQUIRE(!std::memcmp(second.Head(), "response 2\r\n", 12));
+
+    // the original memory is released once the last split buffer goes away.
+    first  = nf::Buffer();
+    BOOST_REQUIRE(second.IsShared() == false);
+    second = nf::Buffer();
+    BOOST_REQUIRE(pool.GetStats().bytes_in_use == in_use + 1024);
+
+    // compacting an exclusive buffer reuses the memory.
+    buff.Append("onse 3\r\n");
+    buff.Pop(4);
+    const auto* current = buff.Head();
+    buff.Compact(100);
+    BOOST_REQUIRE(buff.Head() == current - 4);
+    BOOST_REQUIRE(buff.GetCapacity() == 100);
+    BOOST_REQUIRE(!std::memcmp(buff.Head(), "onse 3\r\n", 8));
+
+    // growing a split buffer doesn't overwrite the data after it.
+    auto split = buff.Split(4);
+    split.Grow(10);
+    std::memcpy(split.Back(), "xxxxxxxxxx", 10);
+    split.Append(10);
+    BOOST_REQUIRE(!std::memcmp(buff.Head(), " 3\r\n", 4));
+    BOOST_REQUIRE(!std::memcmp(split.Head(), "onsexxxxxxxxxx", 14));
+}
 
 int test_main(int, char*[])
 {
+    test_pool();
+    test_split();
+
     newsflash::Buffer buff(1024);
     BOOST_REQUIRE(buff.GetCapacity() == 1024);
     BOOST_REQUIRE(buff.GetSize() == 0);
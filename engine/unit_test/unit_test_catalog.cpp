@@ -29,6 +29,7 @@
 #include "engine/filemap.h"
 #include "engine/filebuf.h"
 #include "engine/catalog.h"
+#include "engine/catalogview.h"
 #include "engine/filetype.h"
 #include "unit_test_common.h"
 
@@ -201,6 +202,93 @@ void unit_test_create_new()
     delete_file("file");
 }
 
+void unit_test_view()
+{
+    using fileflag = newsflash::fileflag;
+    using filetype = newsflash::filetype;
+
+    delete_file("file");
+
+    {
+        using catalog = newsflash::catalog<newsflash::filebuf>;
+        using article = newsflash::article<newsflash::filebuf>;
+
+        auto db = std::make_unique<catalog>();
+        db->open("file");
+
+        article a;
+        a.set_index(2);
+        a.set_author("John Doe");
+        a.set_subject("Metallica - Enter Sandman yEnc (1/3).mp3");
+        a.set_bytes(1024);
+        a.set_pubdate(600);
+        a.set_bits(fileflag::broken, true);
+        db->insert(a, catalog::index_t{2});
+
+        a.clear();
+        a.set_index(0);
+        a.set_author("Mickey Mouse");
+        a.set_subject("Mickey and Goofy in Disneyland");
+        a.set_bytes(456);
+        a.set_pubdate(500);
+        a.set_bits(fileflag::downloaded, true);
+        db->insert(a, catalog::index_t{0});
+        db->flush();
+    }
+
+    {
+        using catalog = newsflash::catalog<newsflash::filemap>;
+        using view    = newsflash::catalog_view;
+
+        auto db = std::make_unique<catalog>();
+        db->open("file");
+
+        view v;
+        v.bind(*db);
+
+        std::size_t offset = 0;
+        BOOST_REQUIRE(v.load(offset) == 2);
+        BOOST_REQUIRE(v.load(offset) == 0);
+        BOOST_REQUIRE(offset == v.end());
+
+        BOOST_REQUIRE(v.size() == 3);
+        BOOST_REQUIRE(v.has_row(0));
+        BOOST_REQUIRE(!v.has_row(1));
+        BOOST_REQUIRE(v.has_row(2));
+        BOOST_REQUIRE(!v.has_row(3));
+
+        BOOST_REQUIRE(v.subject(2) == "Metallica - Enter Sandman yEnc (1/3).mp3");
+        BOOST_REQUIRE(v.author(2) == "John Doe");
+        BOOST_REQUIRE(v.bytes(2) == 1024);
+        BOOST_REQUIRE(v.pubdate(2) == 600);
+        BOOST_REQUIRE(v.type(2) == filetype::none);
+        BOOST_REQUIRE(v.test(2, fileflag::broken));
+        BOOST_REQUIRE(!v.test(2, fileflag::downloaded));
+
+        BOOST_REQUIRE(v.subject(0) == "Mickey and Goofy in Disneyland");
+        BOOST_REQUIRE(v.author(0) == "Mickey Mouse");
+        BOOST_REQUIRE(v.bytes(0) == 456);
+        BOOST_REQUIRE(v.pubdate(0) == 500);
+        BOOST_REQUIRE(v.num_parts_total(0) == 0);
+        BOOST_REQUIRE(v.test(0, fileflag::downloaded));
+
+        // flag changes go to both the column and the mapped data.
+        v.set_bits(0, fileflag::bookmarked, true);
+        BOOST_REQUIRE(v.test(0, fileflag::bookmarked));
+        BOOST_REQUIRE(db->load(catalog::index_t{0}).is_bookmarked());
+
+        // rebinding to a new mapping keeps the rows and refreshes the columns.
+        db->open("file");
+        db->load(catalog::index_t{2}).set_bits(fileflag::deleted, true);
+        v.bind(*db);
+        BOOST_REQUIRE(v.test(2, fileflag::deleted));
+        BOOST_REQUIRE(v.subject(2) == "Metallica - Enter Sandman yEnc (1/3).mp3");
+        BOOST_REQUIRE(v.test(0, fileflag::bookmarked));
+    }
+
+    delete_file("file");
+}
+
 void unit_test_performance()
 {
     // delete_file("file");
@@ -301,6 +389,7 @@ void check_file()
 int test_main(int, char*[])
 {
     unit_test_create_new();
+    unit_test_view();
     //check_file();
 
     //unit_test_performance();
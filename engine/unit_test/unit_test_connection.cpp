@@ -25,6 +25,7 @@
 #include "newsflash/warnpop.h"
 
 #include <thread>
+#include <future>
 #include <deque>
 #include <string>
 #include <fstream>
@@ -40,6 +41,7 @@
 #include "engine/logging.h"
 #include "engine/decode.h"
 #include "engine/throttle.h"
+#include "engine/reactor.h"
 #include "unit_test_common.h"
 
 namespace nf = newsflash;
@@ -456,6 +458,132 @@ void test_cancel_execute()
 
 
 
+void test_event_connection()
+{
+    auto log = std::make_shared<nf::StdLogger>(std::cout);
+
+    std::unique_ptr<nf::action> act;
+
+    nf::throttle throttle;
+
+    nf::Connection::HostDetails s;
+    s.hostname = "localhost";
+    s.hostport = 1919;
+    s.use_ssl  = false;
+    s.enable_compression = false;
+    s.enable_pipelining  = false;
+    s.username  = "pass";
+    s.password  = "pass";
+    s.pthrottle = &throttle;
+
+    nf::Connection::CmdListCompletionData completion;
+
+    // without the reactor the actions run to completion in perform()
+    // exactly like the actions of the blocking connection.
+    {
+        nf::EventConnection conn;
+        conn.SetCallback([&](const nf::Connection::CmdListCompletionData& data) {
+            completion = data;
+        });
+
+        act = conn.Connect(s);
+        while (act)
+        {
+            act->set_log(log);
+            act->perform();
+            act = conn.Complete(std::move(act));
+        }
+        BOOST_REQUIRE(conn.GetState() == nf::Connection::State::Connected);
+        BOOST_REQUIRE(conn.GetError() == nf::Connection::Error::None);
+
+        nf::CmdList::Messages m;
+        m.groups  = {"alt.binaries.foo"};
+        m.numbers = {"3"};
+        auto cmds = std::make_shared<nf::CmdList>(m);
+
+        act = conn.Execute(cmds);
+        act->set_log(log);
+        act->perform();
+        act->run_completion_callbacks();
+        act = conn.Complete(std::move(act));
+        BOOST_REQUIRE(conn.GetState() == nf::Connection::State::Connected);
+        BOOST_REQUIRE(completion.execution_did_complete);
+        BOOST_REQUIRE(cmds->NumBuffers() == 1);
+        BOOST_REQUIRE(cmds->GetBuffer(0).GetContentStatus()== nf::Buffer::Status::Success);
+
+        act = conn.Disconnect();
+        act->set_log(log);
+        act->perform();
+        act = conn.Complete(std::move(act));
+        BOOST_REQUIRE(conn.GetState() == nf::Connection::State::Disconnected);
+    }
+
+    // with the reactor.
+    {
+        nf::Reactor reactor(1);
+
+        std::unique_ptr<std::promise<nf::action*>> promise;
+        reactor.SetCallback([&](nf::action* a) {
+            promise->set_value(a);
+        });
+        auto run = [&](std::unique_ptr<nf::action> a) {
+            promise.reset(new std::promise<nf::action*>);
+            auto future = promise->get_future();
+            a->set_log(log);
+            if (a->get_affinity() == nf::action::affinity::event_loop)
+                reactor.Submit(static_cast<nf::IoAction*>(a.release()));
+            else
+            {
+                a->perform();
+                promise->set_value(a.release());
+            }
+            return std::unique_ptr<nf::action>(future.get());
+        };
+
+        nf::EventConnection conn;
+        conn.SetCallback([&](const nf::Connection::CmdListCompletionData& data) {
+            completion = data;
+        });
+
+        act = conn.Connect(s);
+        while (act)
+            act = conn.Complete(run(std::move(act)));
+        BOOST_REQUIRE(conn.GetState() == nf::Connection::State::Connected);
+        BOOST_REQUIRE(conn.GetError() == nf::Connection::Error::None);
+
+        for (const char* number : {"3", "1"})
+        {
+            nf::CmdList::Messages m;
+            m.groups  = {"alt.binaries.foo"};
+            m.numbers = {number};
+            auto cmds = std::make_shared<nf::CmdList>(m);
+
+            act = run(conn.Execute(cmds));
+            act->run_completion_callbacks();
+            act = conn.Complete(std::move(act));
+            BOOST_REQUIRE(!act);
+            BOOST_REQUIRE(conn.GetState() == nf::Connection::State::Connected);
+            BOOST_REQUIRE(conn.GetError() == nf::Connection::Error::None);
+            BOOST_REQUIRE(completion.execution_did_complete);
+            BOOST_REQUIRE(completion.cmds == cmds);
+            BOOST_REQUIRE(cmds->NumBuffers() == 1);
+            if (std::string(number) == "3")
+                BOOST_REQUIRE(cmds->GetBuffer(0).GetContentStatus()== nf::Buffer::Status::Success);
+            else BOOST_REQUIRE(cmds->GetBuffer(0).GetContentStatus()== nf::Buffer::Status::Unavailable);
+        }
+
+        act = run(conn.Ping());
+        act = conn.Complete(std::move(act));
+        BOOST_REQUIRE(conn.GetState() == nf::Connection::State::Connected);
+
+        act = run(conn.Disconnect());
+        act = conn.Complete(std::move(act));
+        BOOST_REQUIRE(conn.GetState() == nf::Connection::State::Disconnected);
+
+        reactor.Shutdown();
+    }
+}
+
 int test_main(int argc, char* argv[])
 {
     test_initial_state();
@@ -463,5 +591,6 @@ int test_main(int argc, char* argv[])
     test_execute_success();
     test_execute_failure();
     test_cancel_execute();
+    test_event_connection();
     return 0;
 }
@@ -0,0 +1,119 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#  include <boost/crc.hpp>
+#include "newsflash/warnpop.h"
+
+#include <cstdlib>
+#include <ctime>
+#include <cstring>
+#include <vector>
+
+#include "engine/crc32.h"
+
+namespace nf = newsflash;
+
+std::uint32_t boost_crc32(const unsigned char* data, std::size_t len)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(data, len);
+    return crc.checksum();
+}
+
+void test_known_values()
+{
+    const char* str = "123456789";
+    BOOST_REQUIRE(nf::crc32(0, str, std::strlen(str)) == 0xcbf43926);
+    BOOST_REQUIRE(nf::crc32_slice8(0, str, std::strlen(str)) == 0xcbf43926);
+    BOOST_REQUIRE(nf::crc32(0, str, 0) == 0);
+}
+
+// compare against boost with different lengths and alignments
+// since the fast paths depend on both.
+void test_compare()
+{
+    std::srand(std::time(nullptr));
+
+    for (int i=0; i<2000; ++i)
+    {
+        const std::size_t len = std::rand() % 5000;
+        const std::size_t off = std::rand() % 16;
+        std::vector<unsigned char> data;
+        data.resize(len + off);
+        for (auto& c : data)
+            c = std::rand();
+
+        const auto* ptr = &data[0] + off;
+        const auto expected = boost_crc32(ptr, len);
+        BOOST_REQUIRE(nf::crc32(0, ptr, len) == expected);
+        BOOST_REQUIRE(nf::crc32_slice8(0, ptr, len) == expected);
+
+        // incremental update
+        const std::size_t split = len ? std::rand() % len : 0;
+        const auto first = nf::crc32(0, ptr, split);
+        BOOST_REQUIRE(nf::crc32(first, ptr + split, len - split) == expected);
+    }
+}
+
+void test_combine()
+{
+    for (int i=0; i<1000; ++i)
+    {
+        const std::size_t len = std::rand() % 20000;
+        std::vector<unsigned char> data;
+        data.resize(len + 1);
+        for (auto& c : data)
+            c = std::rand();
+
+        const auto expected = boost_crc32(&data[0], len);
+        const std::size_t split = len ? std::rand() % len : 0;
+        const auto crc1 = nf::crc32(0, &data[0], split);
+        const auto crc2 = nf::crc32(0, &data[0] + split, len - split);
+        BOOST_REQUIRE(nf::crc32_combine(crc1, crc2, len - split) == expected);
+    }
+
+    // combining many parts in order gives the crc of the whole.
+    {
+        std::vector<unsigned char> data;
+        data.resize(1024 * 1024);
+        for (auto& c : data)
+            c = std::rand();
+
+        std::uint32_t crc = 0;
+        for (std::size_t i=0; i<data.size(); i += 1000)
+        {
+            const auto len = std::min<std::size_t>(1000, data.size() - i);
+            crc = nf::crc32_combine(crc, nf::crc32(0, &data[i], len), len);
+        }
+        BOOST_REQUIRE(crc == boost_crc32(&data[0], data.size()));
+    }
+}
+
+int test_main(int, char*[])
+{
+    test_known_values();
+    test_compare();
+    test_combine();
+    return 0;
+}
@@ -24,6 +24,7 @@
 #  include <boost/test/minimal.hpp>
 #include "newsflash/warnpop.h"
 #include <thread>
+#include <algorithm>
 
 #include "engine/datafile.h"
 #include "engine/threadpool.h"
@@ -81,14 +82,14 @@ void unit_test_append()
     delete_file("DataFile");
 }
 
-void unit_test_discard()
+void unit_test_discard(nf::IoRing* ring)
 {
     delete_file("DataFile");
 
     // single threaded discard
     {
         {
-            nf::DataFile file("", "DataFile", 0, true, true);
+            nf::DataFile file("", "DataFile", 0, true, true, ring);
             BOOST_REQUIRE(file_exists("DataFile"));
             file.DiscardOnClose();
         }
@@ -109,7 +110,7 @@ void unit_test_discard()
 
         for (int i=0; i<1000; ++i)
         {
-            auto file = std::make_shared<nf::DataFile>("", "DataFile", 0, true, true);
+            auto file = std::make_shared<nf::DataFile>("", "DataFile", 0, true, true, ring);
 
             std::vector<char> buff;
             buff.resize(1024);
@@ -131,12 +132,82 @@ void unit_test_discard()
     }
 }
 
+// write segments at offsets in random order from multiple threads.
+// the segments go through the reorder buffer and the file must
+// end up with the segments in the right places.
+void unit_test_reorder(nf::IoRing* ring)
+{
+    delete_file("DataFile");
+
+    const std::size_t segment_size = 1024 * 100;
+
+    for (std::size_t num_segments : {1, 7, 100, 800})
+    {
+        std::vector<char> expected = generate_buffer(segment_size * num_segments);
+
+        std::vector<std::size_t> order;
+        for (std::size_t i=0; i<num_segments; ++i)
+            order.push_back(i);
+        std::random_shuffle(order.begin(), order.end());
+
+        nf::ThreadPool threads(4);
+        threads.SetCallback(
+            [&](nf::action* a)
+            {
+                BOOST_REQUIRE(a->has_exception() == false);
+                delete a;
+            });
+
+        {
+            auto file = std::make_shared<nf::DataFile>("", "DataFile", expected.size(), true, true, ring);
+
+            for (auto i : order)
+            {
+                const auto offset = i * segment_size;
+                std::vector<char> segment(&expected[offset], &expected[offset] + segment_size);
+                // see the comment in DataFile about the +1
+                threads.Submit(file->Write(offset + 1, std::move(segment)));
+            }
+            file->Close();
+        }
+        threads.WaitAllActions();
+        threads.Shutdown();
+
+        BOOST_REQUIRE(read_file_contents("DataFile") == expected);
+        delete_file("DataFile");
+    }
+
+    // appending writes
+    {
+        std::vector<char> expected;
+        {
+            nf::DataFile file("", "DataFile", 0, false, true, ring);
+            for (int i=0; i<10; ++i)
+            {
+                auto data = generate_buffer(1000 + i);
+                expected.insert(expected.end(), data.begin(), data.end());
+                file.Write(0, std::move(data))->perform();
+            }
+            file.Close();
+            BOOST_REQUIRE(file.GetFileSize() == expected.size());
+        }
+        BOOST_REQUIRE(read_file_contents("DataFile") == expected);
+    }
+
+    delete_file("DataFile");
+}
 
 int test_main(int, char*[])
 {
     unit_test_overwrite();
     unit_test_append();
-    unit_test_discard();
+    unit_test_discard(nullptr);
+    unit_test_reorder(nullptr);
+    if (nf::IoRing::IsSupported())
+    {
+        unit_test_reorder(nf::IoRing::Get());
+        unit_test_discard(nf::IoRing::Get());
+    }
 
     return 0;
 }
\ No newline at end of file
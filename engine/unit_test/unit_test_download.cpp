@@ -127,6 +127,66 @@ void unit_test_decode_yenc()
 
     download.Commit();
 
+    // the crc32 of the whole file is verified from the part crcs.
+    BOOST_REQUIRE(download.GetErrors().test(nf::Task::Error::CrcMismatch) == false);
+
+    const auto& jpg = read_file_contents("1489406.jpg");
+    const auto& ref = read_file_contents("test_data/1489406.jpg");
+    BOOST_REQUIRE(jpg == ref);
+
+    delete_file("1489406.jpg");
+}
+
+// the parts are fine but the crc32 of the whole file doesn't match.
+void unit_test_decode_yenc_file_crc()
+{
+    delete_file("1489406.jpg");
+
+    nf::Download download({"alt.binaries.foobar"}, {"1", "2", "3"}, "", "test");
+    nf::Session session;
+    session.SetSendCallback([&](const std::string&) {});
+
+    auto cmdlist = download.CreateCommands();
+
+    const auto& data = read_file_contents("test_data/1489406.jpg-003.ync");
+    std::string last(data.begin(), data.end());
+    const auto pos = last.find("crc32=A2E37A54");
+    BOOST_REQUIRE(pos != std::string::npos);
+    last.replace(pos, 14, "crc32=A2E37A55");
+
+    nf::Buffer buff(last.size());
+    std::memcpy(buff.Back(), last.data(), last.size());
+    buff.Append(last.size());
+    buff.SetContentType(nf::Buffer::Type::Article);
+    buff.SetStatus(nf::Buffer::Status::Success);
+    buff.SetContentLength(last.size());
+    buff.SetContentStart(0);
+
+    cmdlist->SubmitDataCommands(session);
+    cmdlist->ReceiveDataBuffer(std::move(buff));
+    cmdlist->ReceiveDataBuffer(read_file_buffer("test_data/1489406.jpg-001.ync"));
+    cmdlist->ReceiveDataBuffer(read_file_buffer("test_data/1489406.jpg-002.ync"));
+
+    std::vector<std::unique_ptr<nf::action>> actions1;
+    std::vector<std::unique_ptr<nf::action>> actions2;
+    download.Complete(*cmdlist, actions1);
+
+    while (!actions1.empty())
+    {
+        for (auto& it : actions1)
+        {
+            it->perform();
+            download.Complete(*it, actions2);
+        }
+        actions1 = std::move(actions2);
+        actions2 = std::vector<std::unique_ptr<nf::action>>();
+    }
+
+    download.Commit();
+
+    BOOST_REQUIRE(download.GetErrors().test(nf::Task::Error::CrcMismatch));
+
+    // the file content itself is still what it is.
     const auto& jpg = read_file_contents("1489406.jpg");
     const auto& ref = read_file_contents("test_data/1489406.jpg");
     BOOST_REQUIRE(jpg == ref);
@@ -397,6 +457,7 @@ int test_main(int, char*[])
 {
     unit_test_create_cmds();
     unit_test_decode_yenc();
+    unit_test_decode_yenc_file_crc();
     unit_test_decode_yenc_bug_32();
     unit_test_decode_uuencode();
     unit_test_decode_text();
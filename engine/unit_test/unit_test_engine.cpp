@@ -30,6 +30,10 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
 
 #include "engine/ui/account.h"
 #include "engine/ui/task.h"
@@ -67,7 +71,7 @@ public:
         BOOST_REQUIRE(state_.expect_cmdlist == received_cmdlist_);
     }
 
-    virtual std::shared_ptr<CmdList> CreateCommands() override
+    virtual std::shared_ptr<CmdList> CreateCommands(const PipelineDepth&) override
     {
         CmdList::Messages m;
         m.groups = groups_;
@@ -273,7 +277,7 @@ public:
                       state_.should_commit == committed_);
     }
 
-    virtual std::shared_ptr<CmdList> CreateCommands() override
+    virtual std::shared_ptr<CmdList> CreateCommands(const PipelineDepth&) override
     {
         std::shared_ptr<CmdList> ret;
 
@@ -344,7 +348,7 @@ public:
                       state_.should_commit == committed_);
     }
 
-    virtual std::shared_ptr<CmdList> CreateCommands() override
+    virtual std::shared_ptr<CmdList> CreateCommands(const PipelineDepth&) override
     {
         std::shared_ptr<CmdList> ret;
 
@@ -533,11 +537,15 @@ public:
             });
 
             if (cmdlist->NeedsToConfigure())
+                cmdlist->SubmitConfigureCommand(0, *session);
+
+            // the session skips the group command when the group
+            // was already selected by a previous cmdlist.
+            if (session->HasPending())
             {
                 Buffer incoming(1024);
                 Buffer out;
 
-                cmdlist->SubmitConfigureCommand(0, *session);
                 session->SendNext();
                 if (command == "GROUP alt.binaries.success\r\n")
                 {
@@ -1521,6 +1529,209 @@ void test_task_execute_success()
     }
 }
 
+// execute queued tasks through a single connection.
+// expected: tasks are scheduled in the task list order
+// after the tasks have been moved and a priority batch has been added.
+void test_task_execute_order()
+{
+    const bool debug_single_thread = true;
+
+    ConnState test_conn_params;
+
+    Engine eng(std::make_unique<Factory>(), debug_single_thread);
+
+    std::vector<std::string> completed;
+    eng.SetTaskCallback([&](const ui::TaskDesc& task) {
+        completed.push_back(task.desc);
+    });
+
+    ui::Account account;
+    account.id = 123;
+    account.name = "test";
+    account.username = "user";
+    account.password = "pass";
+    account.secure_host = "test.host.com";
+    account.secure_port = 1000;
+    account.connections = 1;
+    account.enable_secure_server = true;
+    account.enable_general_server = false;
+    account.enable_compression = false;
+    account.enable_pipelining = false;
+    account.user_data = &test_conn_params;
+    eng.SetAccount(account);
+
+    const int NumTestFiles = 5;
+    std::vector<TaskParams> params;
+    params.resize(NumTestFiles);
+
+    ui::FileBatchDownload batch;
+    batch.account = 123;
+    batch.size    = 666;
+    batch.path    = "test/foo/bar";
+    batch.desc    = "batch";
+    for (int i=0; i<NumTestFiles; ++i)
+    {
+        params[i].should_commit  = true;
+        params[i].expect_cmdlist = true;
+        params[i].num_buffers    = 1;
+
+        ui::FileDownload download;
+        download.account = 123;
+        download.size    = 666;
+        download.path    = "test/foo/bar";
+        download.desc    = "file " + std::to_string(i+1);
+        download.articles.push_back("<success>");
+        download.groups.push_back("alt.binaries.success");
+        download.user_data = &params[i];
+
+        batch.files.push_back(download);
+    }
+    ui::FileBatchDownload priority = batch;
+    priority.desc = "priority batch";
+    priority.files.erase(priority.files.begin(), priority.files.end() - 1);
+    batch.files.pop_back();
+
+    eng.DownloadFiles(batch);
+    eng.MoveTaskUp(3);
+    eng.MoveTaskDown(0);
+    eng.DownloadFiles(priority, true);
+
+    std::deque<ui::TaskDesc> tasks;
+    eng.GetTasks(&tasks);
+    BOOST_REQUIRE(tasks.size() == 5);
+    BOOST_REQUIRE(tasks[0].desc == "file 5");
+    BOOST_REQUIRE(tasks[1].desc == "file 2");
+    BOOST_REQUIRE(tasks[2].desc == "file 1");
+    BOOST_REQUIRE(tasks[3].desc == "file 4");
+    BOOST_REQUIRE(tasks[4].desc == "file 3");
+
+    eng.Start();
+    do
+    {
+        eng.RunMainThread();
+        eng.Pump();
+    }
+    while (completed.size() != tasks.size());
+
+    BOOST_REQUIRE(completed[0] == "file 5");
+    BOOST_REQUIRE(completed[1] == "file 2");
+    BOOST_REQUIRE(completed[2] == "file 1");
+    BOOST_REQUIRE(completed[3] == "file 4");
+    BOOST_REQUIRE(completed[4] == "file 3");
+
+    eng.Stop();
+    do
+    {
+        eng.RunMainThread();
+        eng.Pump();
+    }
+    while (eng.HasPendingActions());
+}
+
+// execute a task with the actions processed by the engine thread.
+// expected: task completes and the callbacks are invoked by the
+// thread that calls Pump.
+void test_task_execute_engine_thread()
+{
+    const bool spawn_immediately = true;
+    const bool debug_single_thread = false;
+
+    ConnState test_conn_params;
+
+    Engine eng(std::make_unique<Factory>(), debug_single_thread);
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool notified = false;
+    eng.SetNotifyCallback([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        notified = true;
+        cond.notify_one();
+    });
+    const auto client_thread = std::this_thread::get_id();
+    std::size_t num_task_callbacks = 0;
+    eng.SetTaskCallback([&](const ui::TaskDesc& desc) {
+        BOOST_REQUIRE(std::this_thread::get_id() == client_thread);
+        ++num_task_callbacks;
+    });
+    eng.SetEngineThread(true);
+
+    // wait for a notification and then pump.
+    auto pump = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait_for(lock, std::chrono::milliseconds(100), [&]() { return notified; });
+        notified = false;
+        lock.unlock();
+        return eng.Pump();
+    };
+
+    ui::Account account;
+    account.id = 123;
+    account.name = "test";
+    account.username = "user";
+    account.password = "pass";
+    account.secure_host = "test.host.com";
+    account.secure_port = 1000;
+    account.connections = 1;
+    account.enable_secure_server = true;
+    account.enable_general_server = false;
+    account.enable_compression = false;
+    account.enable_pipelining = false;
+    account.user_data = &test_conn_params;
+    eng.Start();
+    eng.SetAccount(account, spawn_immediately);
+    for (;;)
+    {
+        pump();
+
+        ui::Connection conn;
+        eng.GetConn(0, &conn);
+        if (conn.state == ui::Connection::States::Connected)
+            break;
+    }
+
+    TaskParams params;
+    params.should_commit = true;
+    params.expect_cmdlist = true;
+    params.num_buffers = 2;
+
+    ui::FileDownload download;
+    download.account   = 123;
+    download.size      = 666;
+    download.path      = "test/foo/bar";
+    download.desc      = "download";
+    download.articles.push_back("<success>");
+    download.articles.push_back("<success>");
+    download.groups.push_back("alt.binaries.success");
+    download.user_data = &params;
+    ui::FileBatchDownload batch;
+    batch.account = 123;
+    batch.size    = 666;
+    batch.path    = "test/foo/bar";
+    batch.desc    = "download";
+    batch.files.push_back(download);
+    eng.DownloadFiles(batch);
+
+    for (;;)
+    {
+        pump();
+
+        ui::TaskDesc task;
+        eng.GetTask(0, &task);
+        if (task.state == ui::TaskDesc::States::Complete)
+            break;
+    }
+    while (pump());
+
+    BOOST_REQUIRE(num_task_callbacks == 1);
+
+    eng.KillConnection(0);
+    eng.Stop();
+    while (pump());
+
+    eng.SetEngineThread(false);
+}
+
 // unexpected failure, i.e. an exception happens.
 // expected: task goes into error state.
 void test_task_execute_failure()
@@ -2284,6 +2495,8 @@ int test_main(int argc, char*[])
     test_task_entry_and_delete();
     test_task_move();
     test_task_execute_success();
+    test_task_execute_order();
+    test_task_execute_engine_thread();
     test_task_execute_failure();
     test_task_execute_restart();
     test_task_execute_fill_success();
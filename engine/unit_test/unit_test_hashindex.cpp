@@ -0,0 +1,184 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <vector>
+#include <algorithm>
+
+#include "engine/hashindex.h"
+#include "engine/bigfile.h"
+#include "engine/nntp.h"
+#include "unit_test_common.h"
+
+namespace nf = newsflash;
+
+std::vector<std::uint64_t> find_all(const nf::HashIndex& index, std::uint32_t hash)
+{
+    std::vector<std::uint64_t> ret;
+    for (auto slot = index.FindFirst(hash); slot != nf::HashIndex::npos; slot = index.FindNext(hash, slot))
+        ret.push_back(index.GetEntry(slot).value);
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+void test_insert_find()
+{
+    nf::HashIndex index;
+    BOOST_REQUIRE(index.GetSize() == 0);
+    BOOST_REQUIRE(index.FindFirst(123) == nf::HashIndex::npos);
+
+    index.Insert(123, 1, 1000);
+    index.Insert(456, 2, 1001);
+    index.Insert(123, 3, 1002);
+    BOOST_REQUIRE(index.GetSize() == 3);
+
+    BOOST_REQUIRE((find_all(index, 123) == std::vector<std::uint64_t>{1000, 1002}));
+    BOOST_REQUIRE((find_all(index, 456) == std::vector<std::uint64_t>{1001}));
+    BOOST_REQUIRE(find_all(index, 789).empty());
+
+    // erase one of the colliding entries.
+    const auto slot = index.FindFirst(123);
+    const auto value = index.GetEntry(slot).value;
+    index.Erase(slot);
+    BOOST_REQUIRE(index.GetSize() == 2);
+    BOOST_REQUIRE(find_all(index, 123).size() == 1);
+    BOOST_REQUIRE(find_all(index, 123)[0] != value);
+    BOOST_REQUIRE((find_all(index, 456) == std::vector<std::uint64_t>{1001}));
+
+    // grow the table with lots of entries and colliding entries.
+    for (std::uint64_t i=0; i<100000; ++i)
+        index.Insert(std::uint32_t(i % 5000), 1, 2000 + i);
+
+    BOOST_REQUIRE(index.GetSize() == 100002);
+    BOOST_REQUIRE(index.GetCapacity() * 7 >= index.GetSize() * 10);
+    for (std::uint32_t i=0; i<5000; ++i)
+    {
+        const auto& values = find_all(index, i);
+        BOOST_REQUIRE(values.size() == 20 + ((i == 123 || i == 456) ? 1 : 0));
+    }
+
+    // erase and insert again, the erased slots are reused.
+    for (std::uint32_t i=0; i<5000; ++i)
+    {
+        for (auto slot = index.FindFirst(i); slot != nf::HashIndex::npos; slot = index.FindNext(i, slot))
+            index.Erase(slot);
+    }
+    BOOST_REQUIRE(index.GetSize() == 0);
+    const auto capacity = index.GetCapacity();
+    for (std::uint64_t i=0; i<100000; ++i)
+        index.Insert(std::uint32_t(i), 1, 2000 + i);
+    BOOST_REQUIRE(index.GetSize() == 100000);
+    BOOST_REQUIRE(index.GetCapacity() == capacity);
+    BOOST_REQUIRE((find_all(index, 456) == std::vector<std::uint64_t>{2456}));
+}
+
+void test_save_load()
+{
+    delete_file("hashindex.bin");
+
+    nf::HashIndex index;
+    for (std::uint64_t i=1; i<=10000; ++i)
+        index.Insert(std::uint32_t(i * 7), std::uint32_t(i), i);
+
+    // erased entries are not written.
+    for (auto slot = index.FindFirst(7); slot != nf::HashIndex::npos; slot = index.FindNext(7, slot))
+        index.Erase(slot);
+
+    {
+        nf::bigfile big;
+        big.open("hashindex.bin", nf::bigfile::o_create | nf::bigfile::o_truncate);
+        const std::uint32_t magic = 0xdeadbeef;
+        big.write(&magic, sizeof(magic));
+        index.Save(big);
+    }
+
+    nf::HashIndex other;
+    {
+        nf::bigfile big;
+        big.open("hashindex.bin");
+        std::uint32_t magic = 0;
+        big.read(&magic, sizeof(magic));
+        BOOST_REQUIRE(magic == 0xdeadbeef);
+        other.Load(big);
+    }
+    BOOST_REQUIRE(other.GetSize() == 9999);
+    BOOST_REQUIRE(other.FindFirst(7) == nf::HashIndex::npos);
+    for (std::uint64_t i=2; i<=10000; ++i)
+    {
+        const auto slot = other.FindFirst(std::uint32_t(i * 7));
+        BOOST_REQUIRE(slot != nf::HashIndex::npos);
+        BOOST_REQUIRE(other.GetEntry(slot).value == i);
+        BOOST_REQUIRE(other.GetEntry(slot).fingerprint == i);
+    }
+
+    // the loaded table can be modified.
+    other.Insert(7, 1, 1);
+    BOOST_REQUIRE((find_all(other, 7) == std::vector<std::uint64_t>{1}));
+
+    // truncated file
+    {
+        nf::bigfile::resize("hashindex.bin", 1000);
+        nf::bigfile big;
+        big.open("hashindex.bin");
+        std::uint32_t magic = 0;
+        big.read(&magic, sizeof(magic));
+
+        nf::HashIndex index;
+        bool exception = false;
+        try
+        {
+            index.Load(big);
+        }
+        catch (const std::exception&)
+        {
+            exception = true;
+        }
+        BOOST_REQUIRE(exception);
+    }
+    delete_file("hashindex.bin");
+}
+
+void test_fingerprint()
+{
+    const std::string a("foobar.mp3 (01/10)");
+    const std::string b("foobar.mp3 (02/10)");
+    const std::string c("foobar.mp4 (01/10)");
+
+    const auto fa = nntp::fingerprint(a.c_str(), a.size());
+    const auto fb = nntp::fingerprint(b.c_str(), b.size());
+    const auto fc = nntp::fingerprint(c.c_str(), c.size());
+    BOOST_REQUIRE(fa == fb);
+    BOOST_REQUIRE(fa != fc);
+    BOOST_REQUIRE(std::uint32_t(fa) == nntp::hashvalue(a));
+    BOOST_REQUIRE((fa >> 32) != (fc >> 32));
+}
+
+int test_main(int, char*[])
+{
+    test_insert_find();
+    test_save_load();
+    test_fingerprint();
+    return 0;
+}
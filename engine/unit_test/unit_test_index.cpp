@@ -24,8 +24,18 @@
 #  include <boost/test/minimal.hpp>
 #include "newsflash/warnpop.h"
 
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+
 #include "engine/index.h"
 #include "engine/article.h"
+#include "engine/catalog.h"
+#include "engine/catalogview.h"
+#include "engine/filebuf.h"
+#include "engine/filemap.h"
+#include "unit_test_common.h"
 
 struct storage
 {
@@ -45,6 +55,208 @@ bool operator==(const article& lhs, const article& rhs)
            lhs.bytes() == rhs.bytes();
 }
 
+// sort and filter with the columnar views and check that the
+// results match sorting and filtering with the loaded articles.
+void unit_test_views()
+{
+    using fileflag = newsflash::fileflag;
+
+    const char* files[] = {"vol0", "vol1"};
+
+    {
+        using catalog = newsflash::catalog<newsflash::filebuf>;
+        using article = newsflash::article<newsflash::filebuf>;
+
+        const char* subjects[] = {
+            "Metallica - Enter Sandman yEnc (0/3).mp3",
+            "Red Dwarf Season 8.vol001+02.PAR2",
+            ".net question",
+            "Terminator.2.Judgement.Day.h264.720p-FOO (001/100).par",
+            "Seinfeld.S09.DVDRip.XviD-SiNK (1/3)",
+            "Mickey and Goofy in Disneyland"
+        };
+
+        for (int vol=0; vol<2; ++vol)
+        {
+            delete_file(files[vol]);
+            auto db = std::make_unique<catalog>();
+            db->open(files[vol]);
+            for (int i=0; i<6; ++i)
+            {
+                article a;
+                a.set_index(i);
+                a.set_author("foo@bar.com");
+                a.set_subject(subjects[(i + vol) % 6]);
+                a.set_bytes(100 + ((i * 7 + vol * 3) % 11) * 10);
+                a.set_pubdate(600 + ((i * 5 + vol) % 13));
+                a.set_bits(fileflag::broken, (i + vol) % 2);
+                db->insert(a, catalog::index_t{std::size_t(i)});
+            }
+            db->flush();
+        }
+    }
+
+    using catalog = newsflash::catalog<newsflash::filemap>;
+    using index   = newsflash::index<newsflash::filemap>;
+    using article = newsflash::article<newsflash::filemap>;
+    using view    = newsflash::catalog_view;
+
+    std::vector<std::unique_ptr<catalog>> catalogs;
+    std::vector<std::unique_ptr<view>> views;
+
+    index with_articles;
+    index with_views;
+
+    with_articles.on_load = [&](std::size_t key, std::size_t idx) {
+        return catalogs[key]->load(catalog::index_t{idx});
+    };
+    with_articles.on_filter = [](const article& a) {
+        return a.bytes() >= 150;
+    };
+    with_views.on_load = with_articles.on_load;
+    with_views.on_filter_row = [&](const view& v, std::size_t idx) {
+        return v.bytes(idx) >= 150;
+    };
+
+    for (int vol=0; vol<2; ++vol)
+    {
+        catalogs.emplace_back(new catalog);
+        catalogs[vol]->open(files[vol]);
+        views.emplace_back(new view);
+        views[vol]->bind(*catalogs[vol]);
+        with_views.attach(vol, views[vol].get());
+
+        std::size_t offset = 0;
+        while (offset != views[vol]->end())
+        {
+            const auto idx = views[vol]->load(offset);
+            with_articles.insert(catalogs[vol]->load(catalog::index_t{idx}), vol, idx);
+            with_views.insert(vol, idx);
+        }
+    }
+
+    auto same = [&]() {
+        BOOST_REQUIRE(with_articles.size() == with_views.size());
+        BOOST_REQUIRE(with_articles.real_size() == with_views.real_size());
+        for (std::size_t i=0; i<with_articles.size(); ++i)
+        {
+            const auto& a = with_articles[i];
+            const auto& b = with_views[i];
+            BOOST_REQUIRE(with_views.item_key(i) < 2);
+            BOOST_REQUIRE(a.pubdate() == b.pubdate());
+            BOOST_REQUIRE(a.bytes() == b.bytes());
+            BOOST_REQUIRE(a.bits() == b.bits());
+            BOOST_REQUIRE(a.subject() == b.subject());
+            BOOST_REQUIRE(with_views.item_index(i) == b.index());
+        }
+    };
+    same();
+    BOOST_REQUIRE(with_views.size() < with_views.real_size());
+
+    // inserting the items in batches gives the same order as
+    // inserting them one by one.
+    {
+        const index::sortdir dirs[] = {
+            index::sortdir::ascending, index::sortdir::descending
+        };
+        for (auto dir : dirs)
+        {
+            index batched;
+            batched.on_load = with_views.on_load;
+            batched.on_filter_row = with_views.on_filter_row;
+            batched.sort(index::sorting::sort_by_subject, dir);
+            with_views.sort(index::sorting::sort_by_subject, dir);
+            for (int vol=0; vol<2; ++vol)
+            {
+                batched.attach(vol, views[vol].get());
+                std::vector<std::size_t> batch;
+                std::size_t offset = 0;
+                while (offset != views[vol]->end())
+                    batch.push_back(views[vol]->load(offset));
+                batched.insert(vol, batch.begin(), batch.end());
+            }
+            BOOST_REQUIRE(batched.size() == with_views.size());
+            BOOST_REQUIRE(batched.real_size() == with_views.real_size());
+            for (std::size_t i=0; i<batched.size(); ++i)
+            {
+                BOOST_REQUIRE(batched[i].subject() == with_views[i].subject());
+                BOOST_REQUIRE(batched[i].bytes() >= 150);
+            }
+        }
+        with_views.sort(index::sorting::sort_by_date, index::sortdir::ascending);
+        same();
+    }
+
+    const index::sorting columns[] = {
+        index::sorting::sort_by_broken,
+        index::sorting::sort_by_date,
+        index::sorting::sort_by_size,
+        index::sorting::sort_by_subject,
+        index::sorting::sort_by_author
+    };
+    for (auto column : columns)
+    {
+        with_articles.sort(column, index::sortdir::ascending);
+        with_views.sort(column, index::sortdir::ascending);
+        same();
+        with_articles.sort(column, index::sortdir::descending);
+        with_views.sort(column, index::sortdir::descending);
+        same();
+    }
+
+    // relax the filter and bring the hidden items back in order.
+    with_articles.sort(index::sorting::sort_by_size, index::sortdir::ascending);
+    with_views.sort(index::sorting::sort_by_size, index::sortdir::ascending);
+    with_articles.on_filter = [](const article& a) {
+        return a.bytes() >= 120;
+    };
+    with_views.on_filter_row = [](const view& v, std::size_t idx) {
+        return v.bytes(idx) >= 120;
+    };
+    with_articles.filter();
+    with_views.filter();
+    same();
+
+    for (std::size_t i=1; i<with_views.size(); ++i)
+    {
+        BOOST_REQUIRE(with_views[i-1].bytes() <= with_views[i].bytes());
+    }
+
+    // a stricter filter only needs to check the currently visible items.
+    const auto visible = with_views.size();
+    std::atomic<std::size_t> checked(0);
+    with_articles.on_filter = [](const article& a) {
+        return a.bytes() >= 180;
+    };
+    with_views.on_filter_row = [&](const view& v, std::size_t idx) {
+        ++checked;
+        return v.bytes(idx) >= 180;
+    };
+    with_articles.filter();
+    with_views.refine();
+    same();
+    BOOST_REQUIRE(checked == visible);
+    BOOST_REQUIRE(with_views.size() < visible);
+
+    // selection is cleared from the items that are filtered out.
+    for (std::size_t i=0; i<with_views.size(); ++i)
+        with_views.select(i, true);
+    with_views.on_filter_row = [](const view& v, std::size_t idx) {
+        return v.bytes(idx) >= 190;
+    };
+    with_views.refine();
+    with_views.on_filter_row = [](const view& v, std::size_t idx) {
+        return v.bytes(idx) >= 180;
+    };
+    with_views.filter();
+    for (std::size_t i=0; i<with_views.size(); ++i)
+        BOOST_REQUIRE(with_views.is_selected(i) == (with_views[i].bytes() >= 190));
+
+    catalogs.clear();
+    delete_file("vol0");
+    delete_file("vol1");
+}
+
 int test_main(int, char*[])
 {
 
@@ -213,5 +425,7 @@ int test_main(int, char*[])
 
     }
 
+    unit_test_views();
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,231 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <condition_variable>
+#include <thread>
+#include <mutex>
+#include <vector>
+
+#include "engine/ioring.h"
+#include "engine/bigfile.h"
+#include "unit_test_common.h"
+
+namespace nf = newsflash;
+
+// wait for the ring to complete a chain.
+struct Completion {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::error_code error;
+    bool done = false;
+
+    nf::IoRing::OnComplete Callback()
+    {
+        return [this](const std::error_code& err) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = err;
+            done  = true;
+            cond.notify_one();
+        };
+    }
+    std::error_code Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return done; });
+        done = false;
+        return error;
+    }
+};
+
+void unit_test_write()
+{
+    delete_file("IoRing");
+
+    nf::IoRing ring(8);
+
+    const auto a = generate_buffer(4096);
+    const auto b = generate_buffer(1000);
+    const auto c = generate_buffer(12345);
+
+    nf::bigfile file("IoRing", nf::bigfile::o_create | nf::bigfile::o_truncate);
+
+    // two writes out of order, the first with two buffers.
+    {
+        const nf::bigfile::iobuf first[] = {
+            {a.data(), a.size()}, {b.data(), b.size()}
+        };
+        const nf::bigfile::iobuf second[] = {
+            {c.data(), c.size()}
+        };
+        nf::IoRing::Write writes[2];
+        writes[0].offset = a.size() + b.size();
+        writes[0].bufs   = second;
+        writes[0].count  = 1;
+        writes[1].offset = 0;
+        writes[1].bufs   = first;
+        writes[1].count  = 2;
+
+        Completion done;
+        ring.Submit(file, writes, 2, true, done.Callback());
+        BOOST_REQUIRE(!done.Wait());
+        BOOST_REQUIRE(ring.GetNumPending() == 0);
+    }
+
+    // only sync
+    {
+        Completion done;
+        ring.Submit(file, nullptr, 0, true, done.Callback());
+        BOOST_REQUIRE(!done.Wait());
+    }
+    file.close();
+
+    std::vector<char> expected;
+    expected.insert(expected.end(), a.begin(), a.end());
+    expected.insert(expected.end(), b.begin(), b.end());
+    expected.insert(expected.end(), c.begin(), c.end());
+    BOOST_REQUIRE(read_file_contents("IoRing") == expected);
+
+    delete_file("IoRing");
+}
+
+void unit_test_error()
+{
+    delete_file("IoRing");
+
+    nf::IoRing ring(8);
+
+    nf::bigfile file("IoRing", nf::bigfile::o_create | nf::bigfile::o_truncate);
+
+    const auto a = generate_buffer(100);
+    const nf::bigfile::iobuf bufs[] = {
+        {a.data(), a.size()}
+    };
+
+    // the write at an impossible offset fails and the linked
+    // write and sync get canceled. the first error is reported.
+    nf::IoRing::Write writes[2];
+    writes[0].offset = std::uint64_t(1) << 63;
+    writes[0].bufs   = bufs;
+    writes[0].count  = 1;
+    writes[1].offset = 0;
+    writes[1].bufs   = bufs;
+    writes[1].count  = 1;
+
+    Completion done;
+    ring.Submit(file, writes, 2, true, done.Callback());
+    const auto error = done.Wait();
+    BOOST_REQUIRE(error);
+    BOOST_REQUIRE(error != std::errc::operation_canceled);
+    BOOST_REQUIRE(file.size() == 0);
+
+    // the chain must fit in the ring.
+    std::vector<nf::IoRing::Write> many(ring.GetMaxChain());
+    for (auto& write : many)
+    {
+        write.bufs  = bufs;
+        write.count = 1;
+    }
+    try
+    {
+        ring.Submit(file, many.data(), many.size(), true, done.Callback());
+        BOOST_FAIL("exception expected");
+    }
+    catch (const std::invalid_argument&)
+    {}
+
+    file.close();
+    delete_file("IoRing");
+}
+
+// many chains in flight from multiple threads.
+void unit_test_concurrent()
+{
+    delete_file("IoRing");
+
+    const std::size_t segment_size = 1024 * 64;
+    const std::size_t num_segments = 1000;
+
+    const auto expected = generate_buffer(segment_size * num_segments);
+
+    nf::bigfile file("IoRing", nf::bigfile::o_create | nf::bigfile::o_truncate);
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::size_t num_done = 0;
+    bool failed = false;
+
+    {
+        nf::IoRing ring(16);
+
+        std::vector<nf::bigfile::iobuf> bufs;
+        for (std::size_t i=0; i<num_segments; ++i)
+            bufs.push_back({&expected[i * segment_size], segment_size});
+
+        const auto submit = [&](std::size_t first) {
+            for (std::size_t i=first; i<num_segments; i+=4)
+            {
+                nf::IoRing::Write write;
+                write.offset = i * segment_size;
+                write.bufs   = &bufs[i];
+                write.count  = 1;
+                ring.Submit(file, &write, 1, false, [&](const std::error_code& error) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    failed = failed || error;
+                    ++num_done;
+                    cond.notify_one();
+                });
+            }
+        };
+        std::thread t0(submit, 0);
+        std::thread t1(submit, 1);
+        std::thread t2(submit, 2);
+        std::thread t3(submit, 3);
+        t0.join();
+        t1.join();
+        t2.join();
+        t3.join();
+
+        // the ring waits for the pending writes on destruction.
+    }
+    BOOST_REQUIRE(num_done == num_segments);
+    BOOST_REQUIRE(!failed);
+
+    file.close();
+    BOOST_REQUIRE(read_file_contents("IoRing") == expected);
+
+    delete_file("IoRing");
+}
+
+int test_main(int, char*[])
+{
+    if (!nf::IoRing::IsSupported())
+        return 0;
+
+    unit_test_write();
+    unit_test_error();
+    unit_test_concurrent();
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <ctime>
+
+#include "engine/keysort.h"
+#include "engine/filetype.h"
+
+namespace ks = newsflash::keysort;
+
+void test_keys()
+{
+    // signed values keep their order.
+    BOOST_REQUIRE(ks::to_key(std::time_t(-5)) < ks::to_key(std::time_t(-1)));
+    BOOST_REQUIRE(ks::to_key(std::time_t(-1)) < ks::to_key(std::time_t(0)));
+    BOOST_REQUIRE(ks::to_key(std::time_t(0)) < ks::to_key(std::time_t(100)));
+    BOOST_REQUIRE(ks::to_key(std::uint32_t(0xffffffff)) > ks::to_key(std::uint32_t(1)));
+    BOOST_REQUIRE(ks::to_key(newsflash::filetype::none) < ks::to_key(newsflash::filetype::other));
+
+    // prefixes
+    BOOST_REQUIRE(ks::to_prefix("", 0) == 0);
+    BOOST_REQUIRE(ks::to_prefix("a", 1) < ks::to_prefix("b", 1));
+    BOOST_REQUIRE(ks::to_prefix("a", 1) < ks::to_prefix("ab", 2));
+    BOOST_REQUIRE(ks::to_prefix("abcdefgh1", 9) == ks::to_prefix("abcdefgh2", 9));
+    BOOST_REQUIRE(ks::to_prefix("\xe4", 1) > ks::to_prefix("z", 1));
+
+    BOOST_REQUIRE(ks::compare("abc", 3, "abc", 3) == 0);
+    BOOST_REQUIRE(ks::compare("abc", 3, "abcd", 4) < 0);
+    BOOST_REQUIRE(ks::compare("abd", 3, "abcd", 4) > 0);
+    BOOST_REQUIRE(ks::compare("\xe4", 1, "z", 1) > 0);
+}
+
+void test_radix_sort()
+{
+    std::mt19937_64 rand(1234);
+
+    for (const auto mask : {0xffull, 0xffff0000ull, ~0ull})
+    {
+        std::vector<ks::entry> keys;
+        for (std::uint32_t i=0; i<10000; ++i)
+            keys.push_back({rand() & mask, i});
+
+        auto expected = keys;
+        std::stable_sort(expected.begin(), expected.end(),
+            [](const ks::entry& lhs, const ks::entry& rhs) {
+                return lhs.key < rhs.key;
+            });
+
+        ks::radix_sort(keys);
+        BOOST_REQUIRE(keys.size() == expected.size());
+        for (std::size_t i=0; i<keys.size(); ++i)
+        {
+            BOOST_REQUIRE(keys[i].key == expected[i].key);
+            BOOST_REQUIRE(keys[i].pos == expected[i].pos);
+        }
+    }
+
+    std::vector<ks::entry> empty;
+    ks::radix_sort(empty);
+    BOOST_REQUIRE(empty.empty());
+}
+
+void test_parallel_sort()
+{
+    std::mt19937 rand(4321);
+
+    std::vector<std::string> strings;
+    for (int i=0; i<100000; ++i)
+        strings.push_back("prefix " + std::to_string(rand() % 5000));
+
+    // stable, i.e. equal strings keep their relative order.
+    std::vector<std::uint32_t> expected;
+    for (std::uint32_t i=0; i<strings.size(); ++i)
+        expected.push_back(i);
+    auto actual = expected;
+
+    auto comp = [&](std::uint32_t lhs, std::uint32_t rhs) {
+        return strings[lhs] < strings[rhs];
+    };
+    std::stable_sort(expected.begin(), expected.end(), comp);
+
+    for (unsigned threads : {1u, 3u, 4u, 0u})
+    {
+        auto tmp = actual;
+        ks::parallel_sort(tmp.begin(), tmp.end(), comp, threads);
+        BOOST_REQUIRE(tmp == expected);
+    }
+}
+
+int test_main(int, char*[])
+{
+    test_keys();
+    test_radix_sort();
+    test_parallel_sort();
+    return 0;
+}
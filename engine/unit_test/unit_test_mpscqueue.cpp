@@ -0,0 +1,107 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "engine/mpscqueue.h"
+
+void unit_test_single_thread()
+{
+    newsflash::MpscQueue<std::unique_ptr<int>> queue;
+    BOOST_REQUIRE(queue.IsEmpty());
+
+    std::unique_ptr<int> value;
+    BOOST_REQUIRE(!queue.Pop(&value));
+
+    queue.Push(std::unique_ptr<int>(new int(1)));
+    queue.Push(std::unique_ptr<int>(new int(2)));
+    queue.Push(std::unique_ptr<int>(new int(3)));
+    BOOST_REQUIRE(!queue.IsEmpty());
+
+    BOOST_REQUIRE(queue.Pop(&value));
+    BOOST_REQUIRE(*value == 1);
+    BOOST_REQUIRE(queue.Pop(&value));
+    BOOST_REQUIRE(*value == 2);
+
+    queue.Push(std::unique_ptr<int>(new int(4)));
+    BOOST_REQUIRE(queue.Pop(&value));
+    BOOST_REQUIRE(*value == 3);
+    BOOST_REQUIRE(queue.Pop(&value));
+    BOOST_REQUIRE(*value == 4);
+    BOOST_REQUIRE(!queue.Pop(&value));
+    BOOST_REQUIRE(queue.IsEmpty());
+
+    // values left in the queue are deleted with the queue.
+    queue.Push(std::unique_ptr<int>(new int(5)));
+}
+
+// multiple producers, each producer's values must come out
+// in the order they were pushed.
+void unit_test_multiple_producers()
+{
+    const int NumProducers = 4;
+    const int NumValues = 100000;
+
+    newsflash::MpscQueue<int> queue;
+
+    std::vector<std::thread> producers;
+    for (int i=0; i<NumProducers; ++i)
+    {
+        producers.emplace_back([&queue, i]() {
+            for (int j=0; j<NumValues; ++j)
+                queue.Push(i * NumValues + j);
+        });
+    }
+
+    std::vector<int> next(NumProducers, 0);
+    int received = 0;
+    while (received < NumProducers * NumValues)
+    {
+        int value = 0;
+        if (!queue.Pop(&value))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        const auto producer = value / NumValues;
+        BOOST_REQUIRE(value % NumValues == next[producer]);
+        ++next[producer];
+        ++received;
+    }
+    for (auto& t : producers)
+        t.join();
+
+    BOOST_REQUIRE(queue.IsEmpty());
+}
+
+int test_main(int, char*[])
+{
+    unit_test_single_thread();
+    unit_test_multiple_producers();
+    return 0;
+}
@@ -245,6 +245,42 @@ void test_parse_date()
     }
 
 
+    {
+        const char* str = "Wednesday, 24 Oct 08 11:58:50 -0800";
+
+        const auto& ret = nntp::parse_date(str, std::strlen(str));
+        BOOST_REQUIRE(ret.first);
+        BOOST_REQUIRE(ret.second.day == 24);
+        BOOST_REQUIRE(ret.second.month == "Oct");
+        BOOST_REQUIRE(ret.second.year == 2008);
+        BOOST_REQUIRE(ret.second.seconds == 50);
+        BOOST_REQUIRE(ret.second.tzoffset == -800);
+    }
+
+    {
+        const char* str = "Wed, 30 Jun 2010 13:24:51 (CET)";
+
+        const auto& ret = nntp::parse_date(str, std::strlen(str));
+        BOOST_REQUIRE(ret.first);
+        BOOST_REQUIRE(ret.second.tzoffset == 0);
+        BOOST_REQUIRE(ret.second.tz == "CET");
+    }
+
+    {
+        // the time zone name can be in parenthesis only after the abbreviated day
+        const char* str = "30 Jun 2010 13:24:51 (CET)";
+
+        const auto& ret = nntp::parse_date(str, std::strlen(str));
+        BOOST_REQUIRE(ret.first == false);
+    }
+
+    {
+        const char* str = "29 Jul 2007 11:25:26 GMT ";
+
+        const auto& ret = nntp::parse_date(str, std::strlen(str));
+        BOOST_REQUIRE(ret.first == false);
+    }
+
     {
         const char* str = "29 Foo 12111aaaa";
 
@@ -294,6 +330,17 @@ void test_parse_part()
     BOOST_REQUIRE(ret.first == true);
     BOOST_REQUIRE(ret.second.numerator == 7);
     BOOST_REQUIRE(ret.second.denominator == 16);
+
+    // the brackets must match.
+    ret = nntp::parse_part("Girls have fun !!! foobar.avi (01/50]");
+    BOOST_REQUIRE(ret.first == false);
+
+    ret = nntp::parse_part("Girls have fun !!! foobar.avi (/50)");
+    BOOST_REQUIRE(ret.first == false);
+
+    // the batch notation at the start is not a part count.
+    ret = nntp::parse_part("(01/50) Girls have fun !!! foobar.avi");
+    BOOST_REQUIRE(ret.first == false);
 }
 
 void test_parse_group()
@@ -395,6 +442,24 @@ void test_date()
         date.tzoffset = 200;
         date.hours = 4;
         BOOST_REQUIRE(nntp::timevalue(date) == t1);
+
+        // the time zone name is used when there's no numeric offset.
+        date.tzoffset = 0;
+        date.hours = 7;
+        date.tz = "EST";
+        BOOST_REQUIRE(nntp::timevalue(date) == t1 + 10 * 3600);
+        date.tz = "gmt";
+        BOOST_REQUIRE(nntp::timevalue(date) == t1 + 5 * 3600);
+        date.tz = "foobar";
+        BOOST_REQUIRE(nntp::timevalue(date) == t1 + 5 * 3600);
+        date.hours = 2;
+        date.tz = "cet";
+        BOOST_REQUIRE(nntp::timevalue(date) == t1 - 3600);
+
+        // month names are not case sensitive.
+        date.tz = "";
+        date.month = "jAN";
+        BOOST_REQUIRE(nntp::timevalue(date) == t1);
     }
 }
 
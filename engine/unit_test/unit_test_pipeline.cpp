@@ -0,0 +1,150 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <chrono>
+
+#include "engine/pipeline.h"
+
+namespace nf = newsflash;
+
+// simulate the execution of a cmdlist with the given number of items
+// over a connection with the given latency and bandwidth.
+nf::PipelineControl::Sample simulate(nf::PipelineControl::Type type, std::size_t items,
+    double bytes_per_item, double rtt, double bps)
+{
+    const auto bytes = items * bytes_per_item;
+
+    nf::PipelineControl::Sample sample;
+    sample.type      = type;
+    sample.num_items = items;
+    sample.bytes     = bytes;
+    sample.latency   = std::chrono::microseconds((std::int64_t)(rtt * 1000000));
+    sample.duration  = std::chrono::microseconds((std::int64_t)((rtt + bytes / bps) * 1000000));
+    return sample;
+}
+
+void test_defaults()
+{
+    nf::PipelineControl control;
+
+    const auto& depth = control.GetDepth();
+    BOOST_REQUIRE(depth.num_articles == 10);
+    BOOST_REQUIRE(depth.num_overviews == 10);
+    BOOST_REQUIRE(depth.overview_range == 1000);
+    BOOST_REQUIRE(control.GetLatencyMs() == 0);
+
+    // empty samples are ignored
+    control.Update(nf::PipelineControl::Sample());
+    BOOST_REQUIRE(control.GetDepth().num_articles == 10);
+}
+
+// a high latency connection grows the pipeline but at most
+// doubles it on every cmdlist.
+void test_high_latency()
+{
+    nf::PipelineControl control;
+
+    const auto type = nf::PipelineControl::Type::Articles;
+
+    std::size_t prev = control.GetDepth().num_articles;
+    for (int i=0; i<20; ++i)
+    {
+        const auto items = control.GetDepth().num_articles;
+        control.Update(simulate(type, items, 750000, 0.2, 10000000));
+
+        const auto next = control.GetDepth().num_articles;
+        BOOST_REQUIRE(next >= prev);
+        BOOST_REQUIRE(next <= prev * 2);
+        prev = next;
+    }
+    // 10mb/s * 200ms * 16 / 750kb
+    BOOST_REQUIRE(prev >= 40 && prev <= 45);
+    BOOST_REQUIRE(control.GetLatencyMs() == 200);
+
+    // satellite link
+    for (int i=0; i<20; ++i)
+    {
+        const auto items = control.GetDepth().num_articles;
+        control.Update(simulate(type, items, 750000, 0.8, 50000000));
+    }
+    BOOST_REQUIRE(control.GetDepth().num_articles == 100);
+}
+
+// a low latency connection keeps the cmdlists small.
+void test_low_latency()
+{
+    nf::PipelineControl control;
+
+    const auto type = nf::PipelineControl::Type::Articles;
+
+    control.Update(simulate(type, 10, 750000, 0.001, 100000000));
+    BOOST_REQUIRE(control.GetDepth().num_articles == 5);
+
+    for (int i=0; i<10; ++i)
+    {
+        const auto items = control.GetDepth().num_articles;
+        control.Update(simulate(type, items, 750000, 0.001, 100000000));
+    }
+    BOOST_REQUIRE(control.GetDepth().num_articles == 5);
+    BOOST_REQUIRE(control.GetDepth().overview_range == 1000);
+}
+
+void test_overviews()
+{
+    nf::PipelineControl control;
+
+    const auto type = nf::PipelineControl::Type::Overviews;
+
+    for (int i=0; i<20; ++i)
+    {
+        const auto& depth = control.GetDepth();
+        const auto items  = depth.num_overviews * depth.overview_range;
+        control.Update(simulate(type, items, 300, 0.1, 5000000));
+    }
+    // 5mb/s * 100ms * 16 / 300b / 10
+    const auto range = control.GetDepth().overview_range;
+    BOOST_REQUIRE(range >= 2600 && range <= 2700);
+
+    // the article depth isn't affected.
+    BOOST_REQUIRE(control.GetDepth().num_articles == 10);
+
+    for (int i=0; i<20; ++i)
+    {
+        const auto& depth = control.GetDepth();
+        const auto items  = depth.num_overviews * depth.overview_range;
+        control.Update(simulate(type, items, 300, 0.002, 5000000));
+    }
+    BOOST_REQUIRE(control.GetDepth().overview_range == 500);
+}
+
+int test_main(int, char*[])
+{
+    test_defaults();
+    test_high_latency();
+    test_low_latency();
+    test_overviews();
+    return 0;
+}
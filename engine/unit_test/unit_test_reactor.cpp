@@ -0,0 +1,279 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "engine/reactor.h"
+#include "engine/tcpsocket.h"
+#include "engine/socketapi.h"
+#include "engine/event.h"
+
+namespace nf = newsflash;
+
+// wait for a number of timeouts.
+class TimerAction : public nf::IoAction
+{
+public:
+    TimerAction(int count) : count_(count)
+    {}
+
+    virtual bool Resume(Wait& wait) override
+    {
+        if (count_ == 0)
+            return true;
+
+        --count_;
+        wait.timeout = Clock::now() + std::chrono::milliseconds(1);
+        return false;
+    }
+private:
+    int count_ = 0;
+};
+
+// wait for the event to become signaled.
+class EventAction : public nf::IoAction
+{
+public:
+    EventAction(nf::Event& event) : event_(event)
+    {}
+
+    virtual bool Resume(Wait& wait) override
+    {
+        if (event_.IsSignalled())
+            return true;
+
+        wait.event = &event_;
+        return false;
+    }
+private:
+    nf::Event& event_;
+};
+
+// read the given number of bytes from the socket.
+class RecvAction : public nf::IoAction
+{
+public:
+    RecvAction(nf::Socket& socket, std::size_t bytes) : socket_(socket), bytes_(bytes)
+    {}
+
+    virtual bool Resume(Wait& wait) override
+    {
+        while (data_.size() < bytes_)
+        {
+            char buff[100];
+            int received = 0;
+            std::error_code error;
+            const auto ret = socket_.TryRecv(buff, sizeof(buff), &received, &error);
+            if (ret != nf::Socket::IoStatus::Done)
+            {
+                wait.socket = &socket_;
+                wait.read   = ret == nf::Socket::IoStatus::WantRead;
+                wait.write  = ret == nf::Socket::IoStatus::WantWrite;
+                return false;
+            }
+            if (error || received == 0)
+                throw std::runtime_error("recv failed");
+
+            data_.append(buff, received);
+        }
+        return true;
+    }
+    const std::string& GetData() const
+    { return data_; }
+private:
+    nf::Socket& socket_;
+    std::size_t bytes_ = 0;
+    std::string data_;
+};
+
+// collect the completed actions from the reactor.
+struct Completion {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<std::unique_ptr<nf::action>> actions;
+
+    void Push(nf::action* a)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        actions.emplace_back(a);
+        cond.notify_one();
+    }
+    void WaitFor(std::size_t count)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (actions.size() != count)
+            cond.wait(lock);
+    }
+};
+
+std::pair<std::unique_ptr<nf::TcpSocket>, int> make_socket_pair()
+{
+    int fds[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+
+    std::unique_ptr<nf::TcpSocket> socket(new nf::TcpSocket(fds[0], fds[0]));
+    return {std::move(socket), fds[1]};
+}
+
+void unit_test_synchronous()
+{
+    // without the reactor perform() blocks until the action is done.
+    {
+        TimerAction timer(5);
+        timer.perform();
+        BOOST_REQUIRE(timer.IsDone());
+    }
+
+    {
+        nf::Event event;
+        EventAction action(event);
+
+        std::thread thread([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            event.SetSignal();
+        });
+        action.perform();
+        BOOST_REQUIRE(action.IsDone());
+        thread.join();
+    }
+
+    {
+        auto pair = make_socket_pair();
+
+        RecvAction action(*pair.first, 6);
+
+        std::thread thread([&]() {
+            ::write(pair.second, "foo", 3);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            ::write(pair.second, "bar", 3);
+        });
+        action.perform();
+        BOOST_REQUIRE(action.IsDone());
+        BOOST_REQUIRE(action.GetData() == "foobar");
+        thread.join();
+        nf::closesocket(pair.second);
+    }
+}
+
+void unit_test_reactor()
+{
+    Completion done;
+
+    nf::Reactor reactor(2);
+    reactor.SetCallback(std::bind(&Completion::Push, &done, std::placeholders::_1));
+
+    // timers
+    {
+        for (int i=0; i<100; ++i)
+            reactor.Submit(std::unique_ptr<nf::IoAction>(new TimerAction(i % 10)));
+
+        done.WaitFor(100);
+        for (const auto& a : done.actions)
+            BOOST_REQUIRE(!a->has_exception());
+        done.actions.clear();
+        BOOST_REQUIRE(reactor.GetNumPendingActions() == 0);
+    }
+
+    // events
+    {
+        nf::Event event;
+        for (int i=0; i<10; ++i)
+            reactor.Submit(std::unique_ptr<nf::IoAction>(new EventAction(event)));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        BOOST_REQUIRE(done.actions.empty());
+
+        event.SetSignal();
+        done.WaitFor(10);
+        done.actions.clear();
+    }
+
+    // sockets
+    {
+        std::vector<std::pair<std::unique_ptr<nf::TcpSocket>, int>> sockets;
+        for (int i=0; i<50; ++i)
+        {
+            auto pair = make_socket_pair();
+            reactor.Submit(std::unique_ptr<nf::IoAction>(new RecvAction(*pair.first, 1000)));
+            sockets.push_back(std::move(pair));
+        }
+
+        const std::string data(100, 'x');
+        for (int i=0; i<10; ++i)
+        {
+            for (const auto& pair : sockets)
+                BOOST_REQUIRE(::write(pair.second, data.data(), data.size()) == 100);
+        }
+        done.WaitFor(50);
+        for (const auto& a : done.actions)
+        {
+            const auto* recv = dynamic_cast<RecvAction*>(a.get());
+            BOOST_REQUIRE(!recv->has_exception());
+            BOOST_REQUIRE(recv->GetData().size() == 1000);
+        }
+        done.actions.clear();
+
+        for (const auto& pair : sockets)
+            nf::closesocket(pair.second);
+    }
+
+    // exception from an action completes the action.
+    {
+        auto pair = make_socket_pair();
+        reactor.Submit(std::unique_ptr<nf::IoAction>(new RecvAction(*pair.first, 100)));
+        nf::closesocket(pair.second);
+
+        done.WaitFor(1);
+        BOOST_REQUIRE(done.actions[0]->has_exception());
+        done.actions.clear();
+    }
+
+    // pending actions are discarded on shutdown.
+    {
+        nf::Event event;
+        reactor.Submit(std::unique_ptr<nf::IoAction>(new EventAction(event)));
+        reactor.Submit(std::unique_ptr<nf::IoAction>(new EventAction(event)));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        reactor.Shutdown();
+        BOOST_REQUIRE(done.actions.empty());
+        BOOST_REQUIRE(reactor.GetNumPendingActions() == 0);
+    }
+}
+
+int test_main(int, char*[])
+{
+    unit_test_synchronous();
+    unit_test_reactor();
+    return 0;
+}
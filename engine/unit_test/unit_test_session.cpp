@@ -319,10 +319,15 @@ void unit_test_retrieve_article()
         set(incoming, "222 body follows\r\nthis is first content\r\n.\r\n"
             "222 body fol");
 
+        // the responses are handed out without copying the data.
+        const auto* head = incoming.Head();
+
         BOOST_REQUIRE(session.RecvNext(incoming, content));
         BOOST_REQUIRE(content.GetContentType() == nf::Buffer::Type::Article);
         BOOST_REQUIRE(!std::strncmp(content.Content(),
             "this is first content\r\n.\r\n", content.GetContentLength()));
+        BOOST_REQUIRE(content.Head() == head);
+        BOOST_REQUIRE(incoming.Head() == head + content.GetSize());
 
         append(incoming, "lows\r\nsecond content\r\n.\r\n"
             "423 no such article with that number\r\n");
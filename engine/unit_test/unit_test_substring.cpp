@@ -0,0 +1,118 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#include "newsflash/warnpush.h"
+#  include <boost/test/minimal.hpp>
+#include "newsflash/warnpop.h"
+
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cctype>
+
+#include "engine/substring.h"
+
+using matcher = newsflash::substring_matcher;
+
+bool search(const matcher& m, const std::string& haystack)
+{
+    const auto simd   = m.search(haystack.data(), haystack.size());
+    const auto scalar = m.search_scalar(haystack.data(), haystack.size());
+    BOOST_REQUIRE(simd == scalar);
+    return simd;
+}
+
+void test_basic()
+{
+    const std::string subject = "Metallica - Enter Sandman yEnc (01/13) \"enter_sandman.mp3\"";
+
+    BOOST_REQUIRE(matcher().empty());
+    BOOST_REQUIRE(search(matcher(), subject));
+    BOOST_REQUIRE(search(matcher("", true), ""));
+
+    BOOST_REQUIRE(search(matcher("Metallica", true), subject));
+    BOOST_REQUIRE(search(matcher("M", true), subject));
+    BOOST_REQUIRE(search(matcher("3\"", true), subject));
+    BOOST_REQUIRE(search(matcher(subject, true), subject));
+    BOOST_REQUIRE(search(matcher("sandman.mp3", true), subject));
+    BOOST_REQUIRE(!search(matcher("metallica", true), subject));
+    BOOST_REQUIRE(!search(matcher("Sandman.mp3", true), subject));
+    BOOST_REQUIRE(!search(matcher(subject + " ", true), subject));
+    BOOST_REQUIRE(!search(matcher("foo", true), ""));
+
+    BOOST_REQUIRE(search(matcher("metallica", false), subject));
+    BOOST_REQUIRE(search(matcher("METALLICA", false), subject));
+    BOOST_REQUIRE(search(matcher("YENC (01/13)", false), subject));
+    BOOST_REQUIRE(search(matcher("ENTER_SANDMAN.MP3\"", false), subject));
+    BOOST_REQUIRE(!search(matcher("enter-sandman", false), subject));
+
+    // case folding is only for ASCII letters. '@' | 0x20 == '`'
+    BOOST_REQUIRE(!search(matcher("`foo", false), "@foo"));
+    BOOST_REQUIRE(!search(matcher("[", false), "{"));
+
+    // utf-8
+    const std::string utf8 = "J\xc3\xa4nis - \xc3\x84lbum";
+    BOOST_REQUIRE(matcher("\xc3\xa4", true).is_ascii() == false);
+    BOOST_REQUIRE(matcher("nis", true).is_ascii());
+    BOOST_REQUIRE(search(matcher("\xc3\xa4nis", true), utf8));
+    BOOST_REQUIRE(search(matcher("\xc3\x84lbum", false), utf8));
+}
+
+void test_random()
+{
+    // compare against a reference implementation with
+    // random haystacks and needles from a small alphabet.
+    std::mt19937 rand(42);
+    const char alphabet[] = "abAB-@`[{ \xc3\xa4";
+
+    auto random_string = [&](std::size_t len) {
+        std::string ret;
+        for (std::size_t i=0; i<len; ++i)
+            ret.push_back(alphabet[rand() % (sizeof(alphabet) - 1)]);
+        return ret;
+    };
+    auto lower = [](std::string s) {
+        for (auto& c : s)
+            if (c >= 'A' && c <= 'Z') c |= 0x20;
+        return s;
+    };
+
+    for (int i=0; i<20000; ++i)
+    {
+        const auto haystack = random_string(rand() % 80);
+        const auto needle   = random_string(rand() % 6 + 1);
+        const bool case_sensitive = rand() % 2;
+
+        const bool expected = case_sensitive
+            ? haystack.find(needle) != std::string::npos
+            : lower(haystack).find(lower(needle)) != std::string::npos;
+
+        BOOST_REQUIRE(search(matcher(needle, case_sensitive), haystack) == expected);
+    }
+}
+
+int test_main(int, char*[])
+{
+    test_basic();
+    test_random();
+    return 0;
+}
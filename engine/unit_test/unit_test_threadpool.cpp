@@ -26,6 +26,9 @@
 
 #include <atomic>
 #include <thread>
+#include <chrono>
+#include <vector>
+#include <mutex>
 
 #include "engine/threadpool.h"
 #include "engine/action.h"
@@ -39,7 +42,7 @@
 // <snip>
 // these come from boost.tls in logging.cpp. the TLS object is disabled the diagnostics goes away.
 
-void unit_test_pool()
+void unit_test_pool(newsflash::ThreadPool::Scheduling scheduling)
 {
     std::atomic_int counter {0};
 
@@ -57,7 +60,7 @@ void unit_test_pool()
         std::atomic_int& counter_;
     };
 
-    newsflash::ThreadPool threads(4);
+    newsflash::ThreadPool threads(4, scheduling);
     threads.SetCallback(
         [](newsflash::action* a) {
             delete a;
@@ -174,9 +177,124 @@ void unit_test_main_thread()
     }
 }
 
+// a long running action should not hold up the actions
+// queued in the same thread when the other threads are idle.
+void unit_test_work_stealing()
+{
+    std::atomic_int counter {0};
+    std::atomic_bool release {false};
+
+    struct blocking_action : public newsflash::action
+    {
+    public:
+        blocking_action(std::atomic_bool& r) : release_(r)
+        {}
+
+        virtual void xperform()
+        {
+            while (!release_)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    private:
+        std::atomic_bool& release_;
+    };
+
+    struct action : public newsflash::action
+    {
+    public:
+        action(std::atomic_int& c) : counter_(c)
+        {}
+
+        virtual void xperform()
+        {
+            counter_++;
+        }
+    private:
+        std::atomic_int& counter_;
+    };
+
+    newsflash::ThreadPool threads(4);
+    threads.SetCallback(
+        [](newsflash::action* a) {
+            delete a;
+        });
+
+    // every 4th action is queued behind the blocking action.
+    threads.Submit(new blocking_action(release));
+    for (int i=0; i<1000; ++i)
+        threads.Submit(new action(counter));
+
+    const auto start = std::chrono::steady_clock::now();
+    while (counter != 1000)
+    {
+        BOOST_REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    BOOST_REQUIRE(threads.GetNumPendingActions() == 1);
+
+    release = true;
+    threads.WaitAllActions();
+    threads.Shutdown();
+}
+
+// the actions with single_thread affinity and the same owner
+// must execute in the same thread in the order they were submitted.
+void unit_test_pinned_actions()
+{
+    struct action : public newsflash::action
+    {
+    public:
+        action(std::mutex& m, std::vector<std::pair<int, std::thread::id>>& log, int seq)
+          : newsflash::action(affinity::single_thread), mutex_(m), log_(log), seq_(seq)
+        {}
+
+        virtual void xperform()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            log_.push_back({seq_, std::this_thread::get_id()});
+        }
+    private:
+        std::mutex& mutex_;
+        std::vector<std::pair<int, std::thread::id>>& log_;
+        int seq_ = 0;
+    };
+
+    std::mutex mutex;
+    std::vector<std::pair<int, std::thread::id>> logs[3];
+
+    newsflash::ThreadPool threads(4);
+    threads.SetCallback(
+        [](newsflash::action* a) {
+            delete a;
+        });
+
+    for (int i=0; i<3000; ++i)
+    {
+        const auto owner = i % 3;
+        auto* a = new action(mutex, logs[owner], i / 3);
+        a->set_owner(owner);
+        threads.Submit(a);
+    }
+    threads.WaitAllActions();
+    threads.Shutdown();
+
+    for (const auto& log : logs)
+    {
+        BOOST_REQUIRE(log.size() == 1000);
+        for (std::size_t i=0; i<log.size(); ++i)
+        {
+            BOOST_REQUIRE(log[i].first == (int)i);
+            BOOST_REQUIRE(log[i].second == log[0].second);
+        }
+    }
+}
+
 int test_main(int, char*[])
 {
-    unit_test_pool();
+    unit_test_pool(newsflash::ThreadPool::Scheduling::RoundRobin);
+    unit_test_pool(newsflash::ThreadPool::Scheduling::WorkStealing);
+    unit_test_work_stealing();
+    unit_test_pinned_actions();
     unit_test_private_thread();
     unit_test_main_thread();
 
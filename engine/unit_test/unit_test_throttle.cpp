@@ -118,5 +118,66 @@ int test_main(int, char*[])
         std::cout << "bytes received: " << bytes_total << " (" << bytes_total / 1024 << " kb)\n";
     }
 
+    // burst after idle and waiting for the refill
+    {
+        newsflash::throttle throttle;
+        throttle.enable(true);
+        throttle.set_quota(1024 * 100); // 100kb/s
+        throttle.set_burst(1024 * 50);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+
+        // the bucket holds at most the burst
+        const auto quota = throttle.give_quota();
+        BOOST_REQUIRE(quota >= 1024 * 49 && quota <= 1024 * 50);
+        BOOST_REQUIRE(throttle.give_quota() < 1024);
+
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(throttle.get_wait_time(1024 * 10));
+        BOOST_REQUIRE(wait.count() >= 80 && wait.count() <= 100);
+
+        // unused quota is returned
+        throttle.accumulate(0, quota);
+        BOOST_REQUIRE(throttle.give_quota() >= 1024 * 49);
+    }
+
+    // hierarchical limits. the capped account doesn't
+    // get more than its quota and doesn't take the global
+    // quota away from the other account.
+    {
+        newsflash::throttle global;
+        global.enable(true);
+        global.set_quota(1024 * 100); // 100kb/s
+
+        newsflash::throttle backfill(&global);
+        backfill.enable(true);
+        backfill.set_quota(1024 * 20); // 20kb/s
+
+        newsflash::throttle primary(&global);
+
+        std::size_t backfill_total = 0;
+        std::size_t primary_total  = 0;
+
+        const auto start = clock_type::now();
+        for (;;)
+        {
+            const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - start);
+            if (ms.count() >= 3000)
+                break;
+
+            const auto a = backfill.give_quota(1024 * 4);
+            const auto b = primary.give_quota(1024 * 4);
+            backfill_total += a;
+            primary_total  += b;
+            if (!a && !b)
+                std::this_thread::sleep_for(std::min(backfill.get_wait_time(), primary.get_wait_time()));
+        }
+        BOOST_REQUIRE(backfill_total <= 3 * 1024 * 20);
+        BOOST_REQUIRE(backfill_total >= 2 * 1024 * 20);
+        BOOST_REQUIRE(backfill_total + primary_total <= 3 * 1024 * 100);
+        BOOST_REQUIRE(primary_total >= 2 * 1024 * 80);
+
+        std::cout << "backfill: " << backfill_total / 1024 << " kb primary: " << primary_total / 1024 << " kb\n";
+    }
+
     return 0;
 }
\ No newline at end of file
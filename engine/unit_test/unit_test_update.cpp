@@ -24,6 +24,9 @@
 #  include <boost/test/minimal.hpp>
 #include "newsflash/warnpop.h"
 
+#include <thread>
+#include <algorithm>
+
 #include "engine/update.h"
 #include "engine/cmdlist.h"
 #include "engine/session.h"
@@ -343,6 +346,12 @@ void unit_test_data()
         BOOST_REQUIRE(!act->has_exception());
         actions.clear();
         u.Complete(*act, actions);
+        for (auto& a : actions)
+        {
+            a->perform();
+            BOOST_REQUIRE(!a->has_exception());
+        }
+        actions.clear();
         u.Commit();
     }
 
@@ -527,6 +536,12 @@ void unit_test_data()
         BOOST_REQUIRE(!act->has_exception());
         actions.clear();
         u.Complete(*act, actions);
+        for (auto& a : actions)
+        {
+            a->perform();
+            BOOST_REQUIRE(!a->has_exception());
+        }
+        actions.clear();
         u.Commit();
 
     }
@@ -629,6 +644,217 @@ void unit_test_data()
 }
 
 
+// articles whose internal numbers span catalog volumes are written
+// into their volumes by separate actions that can run concurrently.
+void unit_test_volumes()
+{
+    std::vector<std::unique_ptr<newsflash::action>> actions;
+
+    fs::createpath("alt.binaries.test");
+    delete_file("alt.binaries.test/vol000000000000000.dat");
+    delete_file("alt.binaries.test/vol000000000000001.dat");
+    delete_file("alt.binaries.test/alt.binaries.test.nfo");
+    delete_file("alt.binaries.test/alt.binaries.test.idb");
+
+    std::vector<std::string> catalogs;
+
+    {
+        newsflash::Update u("", "alt.binaries.test");
+        u.SetProgressCallback([&](const newsflash::HeaderTask::Progress& progress) {
+            for (const auto& file : progress.catalogs)
+                catalogs.push_back(file);
+        });
+
+        auto cmd = u.CreateCommands();
+
+        newsflash::Buffer buff(1024);
+        buff.Append("211 1000 131000 132000 alt.binaries.test group selected\r\n");
+        buff.SetContentLength(std::strlen("211 1000 131000 132000 alt.binaries.test group selected\r\n"));
+        buff.SetContentStart(0);
+        buff.SetContentType(newsflash::Buffer::Type::GroupInfo);
+        cmd->ReceiveDataBuffer(buff);
+
+        u.Complete(*cmd, actions);
+
+        cmd = u.CreateCommands();
+
+        // the first article is the landmark and maps to itself
+        // (just below the volume boundary) and the rest of the
+        // articles get the following internal numbers.
+        std::string str;
+        nntp::overview ov = {};
+        ov.author.start    = "ensi@gmail.com";
+        ov.subject.start   = "Metallica - Enter Sandman yEnc (1/2).mp3";
+        ov.bytecount.start = "1024";
+        ov.date.start      = "Tue, 13 May 2006 00:00:00";
+        ov.number.start    = "131070";
+        ov.messageid.start = "<131070>";
+        str += nntp::make_overview(ov);
+
+        ov.subject.start   = "Metallica - Master of Puppets.mp3";
+        ov.bytecount.start = "100";
+        ov.number.start    = "131080";
+        ov.messageid.start = "<131080>";
+        str += nntp::make_overview(ov);
+
+        ov.subject.start   = "Metallica - Battery.mp3";
+        ov.bytecount.start = "200";
+        ov.number.start    = "131090";
+        ov.messageid.start = "<131090>";
+        str += nntp::make_overview(ov);
+
+        ov.subject.start   = "Metallica - One.mp3";
+        ov.bytecount.start = "300";
+        ov.number.start    = "131100";
+        ov.messageid.start = "<131100>";
+        str += nntp::make_overview(ov);
+
+        ov.subject.start   = "Metallica - Enter Sandman yEnc (2/2).mp3";
+        ov.bytecount.start = "512";
+        ov.number.start    = "131110";
+        ov.messageid.start = "<131110>";
+        str += nntp::make_overview(ov);
+
+        buff.Clear();
+        buff.Append(str);
+        buff.SetContentLength(str.size());
+        buff.SetContentStart(0);
+        buff.SetContentType(newsflash::Buffer::Type::Overview);
+        buff.SetStatus(newsflash::Buffer::Status::Success);
+        cmd->ReceiveDataBuffer(buff);
+
+        u.Complete(*cmd, actions);
+        auto act = std::move(actions[0]);
+        act->perform();
+        BOOST_REQUIRE(!act->has_exception());
+        actions.clear();
+        u.Complete(*act, actions);
+        act = std::move(actions[0]);
+        act->perform();
+        BOOST_REQUIRE(!act->has_exception());
+        actions.clear();
+        u.Complete(*act, actions);
+
+        // one write action per volume.
+        BOOST_REQUIRE(actions.size() == 2);
+
+        std::thread t0([&]() { actions[0]->perform(); });
+        std::thread t1([&]() { actions[1]->perform(); });
+        t0.join();
+        t1.join();
+
+        for (auto& a : actions)
+        {
+            BOOST_REQUIRE(!a->has_exception());
+            std::vector<std::unique_ptr<newsflash::action>> next;
+            u.Complete(*a, next);
+            BOOST_REQUIRE(next.empty());
+        }
+        u.Commit();
+    }
+
+    BOOST_REQUIRE(catalogs.size() == 2);
+    std::sort(catalogs.begin(), catalogs.end());
+    BOOST_REQUIRE(catalogs[0] == "alt.binaries.test/vol000000000000000.dat");
+    BOOST_REQUIRE(catalogs[1] == "alt.binaries.test/vol000000000000001.dat");
+
+    {
+        using catalog = newsflash::catalog<newsflash::filemap>;
+        using article = newsflash::article<newsflash::filemap>;
+        using arraydb = newsflash::idlist<newsflash::filemap>;
+
+        arraydb idb;
+        idb.open("alt.binaries.test/alt.binaries.test.idb");
+
+        catalog vol0;
+        vol0.open("alt.binaries.test/vol000000000000000.dat");
+        BOOST_REQUIRE(vol0.size() == 2);
+
+        catalog::offset_t off(0);
+        article a = vol0.load(off);
+        BOOST_REQUIRE(a.subject() == "Metallica - Enter Sandman yEnc (1/2).mp3");
+        BOOST_REQUIRE(a.num_parts_avail() == 2);
+        BOOST_REQUIRE(a.bytes() == 1024 + 512);
+        BOOST_REQUIRE(idb[a.idbkey() + 1] + a.number() == 131070);
+        BOOST_REQUIRE(idb[a.idbkey() + 2] + a.number() == 131110);
+
+        off += a.size_on_disk();
+        a = vol0.load(off);
+        BOOST_REQUIRE(a.subject() == "Metallica - Master of Puppets.mp3");
+
+        catalog vol1;
+        vol1.open("alt.binaries.test/vol000000000000001.dat");
+        BOOST_REQUIRE(vol1.size() == 2);
+
+        off = catalog::offset_t(0);
+        a = vol1.load(off);
+        BOOST_REQUIRE(a.subject() == "Metallica - Battery.mp3");
+        off += a.size_on_disk();
+        a = vol1.load(off);
+        BOOST_REQUIRE(a.subject() == "Metallica - One.mp3");
+    }
+
+    // the allocator state is restored on the next update
+    // and new articles continue in the second volume.
+    {
+        newsflash::Update u("", "alt.binaries.test");
+
+        auto cmd = u.CreateCommands();
+
+        newsflash::Buffer buff(1024);
+        buff.Append("211 1000 131000 132000 alt.binaries.test group selected\r\n");
+        buff.SetContentLength(std::strlen("211 1000 131000 132000 alt.binaries.test group selected\r\n"));
+        buff.SetContentStart(0);
+        buff.SetContentType(newsflash::Buffer::Type::GroupInfo);
+        cmd->ReceiveDataBuffer(buff);
+        u.Complete(*cmd, actions);
+
+        cmd = u.CreateCommands();
+
+        std::string str;
+        nntp::overview ov = {};
+        ov.author.start    = "ensi@gmail.com";
+        ov.subject.start   = "Metallica - Fade to Black.mp3";
+        ov.bytecount.start = "400";
+        ov.date.start      = "Tue, 13 May 2006 00:00:00";
+        ov.number.start    = "131200";
+        ov.messageid.start = "<131200>";
+        str += nntp::make_overview(ov);
+
+        buff.Clear();
+        buff.Append(str);
+        buff.SetContentLength(str.size());
+        buff.SetContentStart(0);
+        buff.SetContentType(newsflash::Buffer::Type::Overview);
+        buff.SetStatus(newsflash::Buffer::Status::Success);
+        cmd->ReceiveDataBuffer(buff);
+
+        actions.clear();
+        u.Complete(*cmd, actions);
+        auto act = std::move(actions[0]);
+        act->perform();
+        actions.clear();
+        u.Complete(*act, actions);
+        act = std::move(actions[0]);
+        act->perform();
+        actions.clear();
+        u.Complete(*act, actions);
+        BOOST_REQUIRE(actions.size() == 1);
+        actions[0]->perform();
+        BOOST_REQUIRE(!actions[0]->has_exception());
+        u.Commit();
+    }
+
+    {
+        using catalog = newsflash::catalog<newsflash::filemap>;
+        using article = newsflash::article<newsflash::filemap>;
+
+        catalog vol1;
+        vol1.open("alt.binaries.test/vol000000000000001.dat");
+        BOOST_REQUIRE(vol1.size() == 3);
+    }
+}
+
 void unit_test_index()
 {
     std::vector<std::unique_ptr<newsflash::action>> actions;
@@ -673,6 +899,9 @@ void unit_test_index()
         BOOST_REQUIRE(!a->has_exception());
         actions.clear();
         u.Complete(*a, actions);
+        for (auto& next : actions)
+            next->perform();
+        actions.clear();
         u.Commit();
     }
 
@@ -732,6 +961,7 @@ int test_main(int, char* [])
 {
     unit_test_ranges();
     unit_test_data();
+    unit_test_volumes();
     unit_test_index();
 
     // let's force some hash collision and run the same test
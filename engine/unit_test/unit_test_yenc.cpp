@@ -19,6 +19,7 @@
 // THE SOFTWARE.
 
 #include "newsflash/warnpush.h"
+#  include <boost/crc.hpp>
 #  include <boost/test/minimal.hpp>
 #include "newsflash/warnpop.h"
 
@@ -26,6 +27,9 @@
 #include <fstream>
 #include <string>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <vector>
 
 #include "engine/yenc.h"
 #include "engine/bodyiter.h"
@@ -115,6 +119,19 @@ void test_parsing()
 
     }
 
+    {
+        // multipart end with the total repeated from the header
+        const char* str = "=yend size=40219 part=3 total=3 pcrc32=87129EB2 crc32=A2E37A54";
+
+        const auto& ret = yenc::parse_footer(str, str+strlen(str));
+
+        BOOST_REQUIRE(ret.first == true);
+        BOOST_REQUIRE(ret.second.size == 40219);
+        BOOST_REQUIRE(ret.second.part == 3);
+        BOOST_REQUIRE(ret.second.pcrc32 == 0x87129EB2);
+        BOOST_REQUIRE(ret.second.crc32 == 0xA2E37A54);
+    }
+
 
     {
         const char* str = "=ybegin part=1 line=128 size=824992 name=foobar.PAR2\r\n" \
@@ -405,6 +422,148 @@ void test_decode_encode()
 
 }
 
+// decode with the template decoder and the given kernel and compare
+// the results. both the output and the stop position must be the same.
+void compare_decode(const std::vector<char>& input, std::size_t pos, yenc::kernel kernel)
+{
+    const char* ptr = input.data();
+    const std::size_t len = input.size();
+
+    nntp::bodyiter beg(ptr, pos, len);
+    nntp::bodyiter end(ptr + len, 0);
+
+    std::vector<char> expected;
+    yenc::decode(beg, end, std::back_inserter(expected));
+
+    std::vector<char> actual;
+    actual.resize(len - pos);
+    std::size_t written = 0;
+    const auto stop = yenc::decode_buffer(ptr, pos, len, actual.data(), written, kernel);
+    actual.resize(written);
+
+    BOOST_REQUIRE(stop == beg.position());
+    BOOST_REQUIRE(actual == expected);
+
+    // the fused decode + crc must produce the same output and
+    // the same crc as computing the crc separately.
+    boost::crc_32_type crc;
+    crc.process_bytes(expected.data(), expected.size());
+
+    std::vector<char> fused;
+    fused.resize(len - pos);
+    std::uint32_t crc32 = 0;
+    written = 0;
+    const auto fused_stop = yenc::decode_buffer_crc(ptr, pos, len, fused.data(), written, crc32, kernel);
+    fused.resize(written);
+
+    BOOST_REQUIRE(fused_stop == beg.position());
+    BOOST_REQUIRE(fused == expected);
+    BOOST_REQUIRE(crc32 == crc.checksum());
+}
+
+/*
+ * Synopsis: Decode data with the block decoder using every kernel and compare to the template decoder.
+ *
+ * Expected: Output and the stop position are identical.
+ */
+void test_decode_buffer()
+{
+    const yenc::kernel kernels[] = {
+        yenc::kernel::scalar,
+        yenc::kernel::sse2,
+        yenc::kernel::ssse3,
+        yenc::kernel::avx2
+    };
+    std::printf("\nbest yenc kernel %s\n", yenc::kernel_name(yenc::best_kernel()));
+
+    // reference data
+    {
+        std::ifstream src;
+        src.open("test_data/vip.part4.yenc.txt", std::ios::binary);
+        BOOST_REQUIRE(src.is_open());
+
+        std::vector<char> temp;
+        std::copy(std::istreambuf_iterator<char>(src), std::istreambuf_iterator<char>(), std::back_inserter(temp));
+
+        nntp::bodyiter beg(temp.data(), temp.size());
+        nntp::bodyiter end(temp.data() + temp.size(), 0);
+        BOOST_REQUIRE(yenc::parse_header(beg, end).first);
+        BOOST_REQUIRE(yenc::parse_part(beg, end).first);
+
+        for (auto kernel : kernels)
+            compare_decode(temp, beg.position(), kernel);
+    }
+
+    // random data encoded with and without leading dot doubling
+    // with various line lengths.
+    {
+        std::srand(std::time(nullptr));
+
+        for (int i=0; i<200; ++i)
+        {
+            std::vector<char> junk;
+            junk.resize(std::rand() % 5000);
+            for (auto& c : junk)
+                c = std::rand();
+
+            std::vector<char> yenc;
+            yenc::encode(junk.begin(), junk.end(), std::back_inserter(yenc), 1 + std::rand() % 130, i & 1);
+            const std::string trailer("\r\n=yend size=123\r\n");
+            std::copy(trailer.begin(), trailer.end(), std::back_inserter(yenc));
+
+            for (auto kernel : kernels)
+                compare_decode(yenc, 0, kernel);
+        }
+    }
+
+    // special sequences at every position relative to the block boundaries.
+    {
+        const char* specials[] = {
+            "\r\n..", "\r\n...", "..", "=M", "==", "=\r\n", "=", "=y", "\r\n=y", "=\r\n..", "\r\n.=M"
+        };
+        for (const char* special : specials)
+        {
+            for (std::size_t prefix=0; prefix<40; ++prefix)
+            {
+                for (std::size_t suffix=0; suffix<40; ++suffix)
+                {
+                    std::vector<char> data;
+                    data.resize(prefix, 'a');
+                    data.insert(data.end(), special, special + std::strlen(special));
+                    data.resize(data.size() + suffix, 'b');
+                    for (std::size_t pos=0; pos<5 && pos<=data.size(); ++pos)
+                    {
+                        for (auto kernel : kernels)
+                            compare_decode(data, pos, kernel);
+                    }
+                }
+            }
+        }
+    }
+
+    // garbage made up of the special characters in random positions.
+    {
+        const char alphabet[] = { '=', '=', '\r', '\n', '.', '.', 'y', 'a', 'b', 'c', 'd' };
+
+        for (int i=0; i<2000; ++i)
+        {
+            std::vector<char> junk;
+            junk.resize(std::rand() % 300);
+            for (auto& c : junk)
+                c = alphabet[std::rand() % sizeof(alphabet)];
+
+            // make sure the =y isn't found too early too often
+            for (auto& c : junk)
+                if (c == 'y' && std::rand() % 4)
+                    c = 'e';
+
+            const std::size_t pos = junk.empty() ? 0 : std::rand() % junk.size();
+            for (auto kernel : kernels)
+                compare_decode(junk, pos, kernel);
+        }
+    }
+}
+
 void test_encode_special()
 {
     // verify leading dot expansion
@@ -430,6 +589,7 @@ int test_main(int, char* [])
     test_decoding();
     test_encoding();
     test_decode_encode();
+    test_decode_buffer();
     test_encode_special();
     return 0;
 }
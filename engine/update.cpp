@@ -23,8 +23,10 @@
 #include <limits>
 #include <fstream>
 #include <map>
-#include <set>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <iterator>
 
 #include "bigfile.h"
 #include "filesys.h"
@@ -40,6 +42,7 @@
 #include "cmdlist.h"
 #include "catalog.h"
 #include "idlist.h"
+#include "hashindex.h"
 #include "filesys.h"
 #include "assert.h"
 
@@ -52,14 +55,16 @@ using idlist_t = idlist<filebuf>;
 
 #pragma pack(push, 1)
 // these are just an internal helper structure that we use to read
-// and write the hash structure to file
+// the hash structure from a version 1 file.
 struct FileHash {
     std::uint32_t article_hash = 0;
     std::uint64_t article_number_internal = 0;
 };
 
 enum {
-    CurrentVersion = 1
+    // version 1 has the hashes as an array of FileHash after the header.
+    // version 2 has the HashIndex table after the header.
+    CurrentVersion = 2
 };
 
 struct FileHeader {
@@ -85,22 +90,54 @@ struct Update::state {
     // will stay in a consistent state.
     std::mutex file_io_mutex;
 
+    // an article that has been assigned an internal article number
+    // and is waiting to be written into the catalog volume.
+    struct Pending {
+        article_t article;
+        std::uint64_t number = 0;
+    };
+
+    // the articles are written into the catalog volumes by store_volume
+    // actions and different volumes can be written concurrently.
+    struct Volume {
+        // held while accessing the catalog.
+        std::mutex mutex;
+        std::unique_ptr<catalog_t> db;
+
+        // these are protected by the volume_mutex.
+        std::vector<Pending> pending;
+        bool scheduled = false;
+    };
+
+    // protects the files map and the pending lists of the volumes.
+    std::mutex volume_mutex;
+
     // maps a volume index to a file.
-    std::map<std::uint32_t, std::unique_ptr<catalog_t>> files;
+    std::map<std::uint32_t, std::unique_ptr<Volume>> files;
 
-    // maps a hash value to a *internal* article number
-    // we use a multimap so that we can resolve hash collisions
-    std::multimap<std::uint32_t, std::uint64_t> hashmap;
+    // maps a hash value to a *internal* article number.
+    // there can be multiple articles with the same hash value
+    // and the collisions are resolved with the subject fingerprint.
+    // only accessed by the store actions which execute sequentially.
+    HashIndex hashmap;
 
-    // message id db
+    // cached volume existence state. maps a volume index
+    // to a flag indicating whether the volume file exists.
+    std::map<std::uint32_t, bool> volumes;
+
+    // message id db. shared by all the volumes.
+    std::mutex idb_mutex;
     idlist_t idb;
 
     // this mutex is to eliminate the possible race condition
     // between the tasks's commit operation and some possible
     // enqueued operations that would like to modify the data files.
     std::mutex cancel_operation_mutex;
+    std::condition_variable cancel_operation_done;
     // cancel rest of the enqueued operations.
     bool cancel_operation = false;
+    // the number of operations currently modifying the data files.
+    std::size_t num_operations = 0;
 
     // these variables track our internal article numbering.
     // landmark defines the very first article number we have
@@ -111,34 +148,166 @@ struct Update::state {
     // these variables are in the state object since each store action
     // needs to access the latest data, i.e. the state is global
     // and not something each task can replicate on it's own_
-    // these are not procted by a mutex since the store
-    // actions execute sequentially.
-    // if store actions are multithreaded then these need to be mutexed.
-    std::uint64_t landmark_article_number = 0;
-    std::int64_t  positive_offset = 0;
-    std::int64_t  negative_offset = 0;
+    std::atomic<std::uint64_t> landmark_article_number {0};
+    std::atomic<std::int64_t>  positive_offset {0};
+    std::atomic<std::int64_t>  negative_offset {0};
 
     // allocate a new internal article id.
     std::uint64_t allocate_internal(const article_t& article)
     {
-        if (!landmark_article_number)
+        const std::uint64_t external_number = article.number();
+
+        std::uint64_t landmark = 0;
+        if (landmark_article_number.compare_exchange_strong(landmark, external_number))
+            return external_number;
+
+        std::uint64_t internal_number = 0;
+        if (external_number > landmark)
+            internal_number = landmark + ++positive_offset;
+        else if (external_number < landmark)
+            internal_number = landmark + --negative_offset;
+        return internal_number;
+    }
+
+    // check whether the volume has been purged or not.
+    bool volume_exists(std::uint32_t index)
+    {
         {
-            landmark_article_number = article.number();
-            return landmark_article_number;
+            std::lock_guard<std::mutex> lock(volume_mutex);
+            if (files.find(index) != files.end())
+                return true;
         }
-        std::uint64_t external_number = article.number();
-        std::uint64_t internal_number = 0;
-        if (external_number > landmark_article_number)
+        auto it = volumes.find(index);
+        if (it == volumes.end())
+            it = volumes.insert(std::make_pair(index, fs::exists(file_volume_name(index)))).first;
+        return it->second;
+    }
+
+    Volume& get_volume(std::uint32_t index)
+    {
+        std::lock_guard<std::mutex> lock(volume_mutex);
+        auto& vol = files[index];
+        if (!vol)
+            vol.reset(new Volume);
+        return *vol;
+    }
+
+    // get the catalog of the volume. the volume mutex must be held.
+    catalog_t& get_catalog(std::uint32_t index, Volume& vol)
+    {
+        if (!vol.db)
         {
-            positive_offset++;
-            internal_number = landmark_article_number + positive_offset;
+            std::unique_ptr<catalog_t> db(new catalog_t);
+            db->open(file_volume_name(index));
+            vol.db = std::move(db);
         }
-        else if (external_number < landmark_article_number)
+        return *vol.db;
+    }
+
+    // begin an operation that modifies the data files.
+    // returns false if the operations have been cancelled.
+    bool begin_operation()
+    {
+        std::lock_guard<std::mutex> lock(cancel_operation_mutex);
+        if (cancel_operation)
+            return false;
+        ++num_operations;
+        return true;
+    }
+    void end_operation()
+    {
+        std::lock_guard<std::mutex> lock(cancel_operation_mutex);
+        if (--num_operations == 0)
+            cancel_operation_done.notify_all();
+    }
+
+    // write the pending articles of the volume into the catalog.
+    // returns false if there was nothing to write in which case
+    // the volume is no longer scheduled for writing.
+    bool write_volume(std::uint32_t volume, Volume& vol)
+    {
+        std::vector<Pending> pending;
         {
-            negative_offset--;
-            internal_number = landmark_article_number + negative_offset;
+            std::lock_guard<std::mutex> lock(volume_mutex);
+            pending.swap(vol.pending);
+            if (pending.empty())
+            {
+                vol.scheduled = false;
+                return false;
+            }
         }
-        return internal_number;
+
+        std::lock_guard<std::mutex> lock(vol.mutex);
+
+        auto& db = get_catalog(volume, vol);
+
+        for (auto& p : pending)
+        {
+            auto& article = p.article;
+
+            const auto file_bucket = p.number & (CATALOG_SIZE-1);
+            const auto index = catalog_t::index_t(file_bucket);
+            if (!db.is_empty(index))
+            {
+                auto a = db.load(index);
+                assert(a.is_match(article));
+                assert(a.has_parts());
+
+                const auto max_parts = a.num_parts_total();
+                const auto num_part  = article.partno();
+                if (max_parts == 1)
+                    continue;
+                if (num_part > max_parts)
+                    continue;
+
+                const auto base = a.number();
+                const auto num  = article.number();
+                std::int16_t diff = 0;
+                if (base > num)
+                    diff -= (std::int16_t)(base - num);
+                else diff = (std::int16_t)(num - base);
+
+                {
+                    std::lock_guard<std::mutex> lock(idb_mutex);
+                    idb[a.idbkey() + num_part] = diff;
+                }
+
+                a.combine(article);
+                db.update(a, index);
+            }
+            else
+            {
+                article.set_index(index.value );
+                // we store one complete 64bit article number for the whole pack
+                // and then for the additional parts we store a 16 bit delta value.
+                // note that while yenc generally uses 1 based part indexing some
+                // posters use 0 based instead. Hence we just add + 1 to cater for
+                // both cases safely.
+                if (article.has_parts())
+                {
+                    std::lock_guard<std::mutex> lock(idb_mutex);
+                    const auto key = idb.size();
+
+                    article.set_idbkey(key);
+                    idb.resize(idb.size() + article.num_parts_total() + 1);
+                    idb[key + article.partno()] = 0; // 0 difference to the message id stored with the article.
+                }
+                db.insert(article, index);
+            }
+        }
+
+        // important: we take the mutex here to acquire exclusive access to the
+        // files. when we hold the lock the UI should *not* be reloading the
+        // catalog files since their state may be inconsistent.
+        // instead the UI *must* only do that in a response to on_write callback
+        // since during the execution of that callback the UI holds this mutex.
+        std::lock_guard<std::mutex> file_lock(file_io_mutex);
+        {
+            std::lock_guard<std::mutex> lock(idb_mutex);
+            idb.flush();
+        }
+        db.flush();
+        return true;
     }
 
     std::string file_volume_name(std::size_t index) const
@@ -179,7 +348,13 @@ public:
             if (!a.parse_initial_data(line.start, line.length))
                 continue;
 
+            // the rest of the data is only needed when the article
+            // turns out to be a new one but parsing it here in parallel
+            // is cheaper than parsing it later in the serialized store.
+            const bool complete = a.parse_rest_of_the_data();
+
             articles_.push_back(a);
+            complete_.push_back(complete);
         }
     }
     virtual std::size_t size() const override
@@ -191,10 +366,14 @@ private:
     friend class Update;
     std::shared_ptr<state> state_;
     std::vector<article_t> articles_;
+    std::vector<bool> complete_;
 private:
     Buffer buffer_;
 };
 
+// assign internal article numbers to the parsed articles and
+// queue them up for writing in their catalog volumes.
+// the store actions execute sequentially.
 class Update::store : public action
 {
 public:
@@ -203,15 +382,34 @@ public:
 
     virtual void xperform() override
     {
-        std::lock_guard<std::mutex> cancel_lock(state_->cancel_operation_mutex);
-        if (state_->cancel_operation)
+        if (!state_->begin_operation())
             return;
 
+        try
+        {
+            assign();
+        }
+        catch (const std::exception&)
+        {
+            state_->end_operation();
+            throw;
+        }
+        state_->end_operation();
+    }
+
+    virtual std::string describe() const override
+    { return "Update Db"; }
+
+    virtual std::size_t size() const override
+    { return bytes_; }
+private:
+    void assign()
+    {
         first_ = std::numeric_limits<decltype(first_)>::max();
 
-        auto& files = state_->files;
-        auto& hmap  = state_->hashmap;
-        auto& idb   = state_->idb;
+        auto& hmap = state_->hashmap;
+
+        std::map<std::uint32_t, std::vector<state::Pending>> pending;
 
         for (std::size_t i=0; i<articles_.size(); ++i)
         {
@@ -225,142 +423,109 @@ public:
             if (article.has_parts())
             {
                 const auto hash = article.hash();
+                const auto fingerprint = HashIndex::MakeFingerprint(article.fingerprint());
                 // if it's a multipart see if we know the hash value
                 // already and can map it to a article number that way
                 // but since it's possible that there are hash collisions
                 // we need to go over the potential hash matches and check
-                // that they actually match.
-                auto beg = hmap.lower_bound(hash);
-                auto end = hmap.upper_bound(hash);
-                for (; beg != end; ++beg)
+                // that they actually match. the subject fingerprint
+                // settles this without going to the catalog unless the
+                // entry was read from an older file without fingerprints.
+                for (auto slot = hmap.FindFirst(hash); slot != HashIndex::npos; slot = hmap.FindNext(hash, slot))
                 {
-                    const auto number = beg->second;
+                    auto& entry = hmap.GetEntry(slot);
+                    const auto number = entry.value;
                     const auto file_index  = number / CATALOG_SIZE;
                     const auto file_bucket = number & (CATALOG_SIZE-1);
-                    const auto file_name   = state_->file_volume_name(file_index);
-                    if (!fs::exists(file_name))
+                    if (!state_->volume_exists(file_index))
                     {
                         // if the file doesn't exist anymore then whole volume
                         // has probably been purged in which case we just discard the hash
-                        beg = hmap.erase(beg);
+                        hmap.Erase(slot);
                         continue;
                     }
-                    auto it = files.find(file_index);
-                    if (it == std::end(files))
+                    if (entry.fingerprint)
                     {
-                        std::unique_ptr<catalog_t> db(new catalog_t);
-                        db->open(file_name);
-                        it = files.insert(std::make_pair(file_index, std::move(db))).first;
+                        if (entry.fingerprint != fingerprint)
+                            continue;
+
+                        internal_article_number = number;
+                        break;
                     }
-                    const auto& db    = it->second;
+
+                    // the volume is possibly being written concurrently but the
+                    // article we're comparing against has been written already
+                    // since it was assigned before the current batch.
+                    auto& vol = state_->get_volume(file_index);
+                    std::lock_guard<std::mutex> lock(vol.mutex);
+                    auto& db = state_->get_catalog(file_index, vol);
                     const auto index  = catalog_t::index_t(file_bucket);
-                    const auto& other = db->load(index);
+                    const auto& other = db.load(index);
                     if (other.is_match(article))
                     {
+                        // remember the fingerprint for the next time.
+                        entry.fingerprint = fingerprint;
                         internal_article_number = number;
                         break;
                     }
                 }
                 if (!internal_article_number)
                 {
-                    if (!article.parse_rest_of_the_data())
+                    if (!complete_[i])
                         continue;
 
                     internal_article_number = state_->allocate_internal(article);
-                    hmap.insert(std::make_pair(article.hash(), internal_article_number));
+                    hmap.Insert(hash, fingerprint, internal_article_number);
                 }
             }
             else
             {
-                if (!article.parse_rest_of_the_data())
+                if (!complete_[i])
                     continue;
                 internal_article_number = state_->allocate_internal(article);
             }
 
-
             assert(internal_article_number  && "Article number is undefined.");
 
-            const auto file_index  = internal_article_number / CATALOG_SIZE;
-            const auto file_bucket = internal_article_number & (CATALOG_SIZE-1);
-            auto it = files.find(file_index);
-            if (it == std::end(files))
-            {
-                std::unique_ptr<catalog_t> db(new catalog_t);
-                db->open(state_->file_volume_name(file_index));
-                it = files.insert(std::make_pair(file_index, std::move(db))).first;
-            }
-            auto& db = it->second;
+            const auto file_index = internal_article_number / CATALOG_SIZE;
 
-            const auto index = catalog_t::index_t(file_bucket);
-            if (!db->is_empty(index))
-            {
-                auto a = db->load(index);
-                assert(a.is_match(article));
-                assert(a.has_parts());
+            // the volume will be created by the write so it must not
+            // be considered purged by the articles that follow.
+            state_->volumes[file_index] = true;
 
-                const auto max_parts = a.num_parts_total();
-                const auto num_part  = article.partno();
-                if (max_parts == 1)
-                    continue;
-                if (num_part > max_parts)
-                    continue;
+            state::Pending p;
+            p.article = std::move(article);
+            p.number  = internal_article_number;
+            pending[file_index].push_back(std::move(p));
+        }
 
-                const auto base = a.number();
-                const auto num  = article.number();
-                std::int16_t diff = 0;
-                if (base > num)
-                    diff -= (std::int16_t)(base - num);
-                else diff = (std::int16_t)(num - base);
-                idb[a.idbkey() + num_part] = diff;
+        // hand the articles over to the volumes. the volumes that aren't
+        // being written currently need a new store_volume action.
+        for (auto& pair : pending)
+        {
+            const auto file_index = pair.first;
+            auto& vol = state_->get_volume(file_index);
 
-                a.combine(article);
-                db->update(a, index);
-            }
-            else
-            {
-                article.set_index(index.value );
-                // we store one complete 64bit article number for the whole pack
-                // and then for the additional parts we store a 16 bit delta value.
-                // note that while yenc generally uses 1 based part indexing some
-                // posters use 0 based instead. Hence we just add + 1 to cater for
-                // both cases safely.
-                if (article.has_parts())
-                {
-                    const auto key = idb.size();
+            std::lock_guard<std::mutex> lock(state_->volume_mutex);
+            auto& list = pair.second;
+            if (vol.pending.empty())
+                vol.pending = std::move(list);
+            else std::move(list.begin(), list.end(), std::back_inserter(vol.pending));
 
-                    article.set_idbkey(key);
-                    idb.resize(idb.size() + article.num_parts_total() + 1);
-                    idb[key + article.partno()] = 0; // 0 difference to the message id stored with the article.
-                }
-                db->insert(article, index);
+            if (!vol.scheduled)
+            {
+                vol.scheduled = true;
+                volumes_.push_back(file_index);
             }
-            updates_.insert(db.get());
         }
-
-        // important: we take the mutex here to acquire exclusive access to the
-        // files. when we hold the lock the UI should *not* be reloading the
-        // catalog files since their state may be inconsistent.
-        // instead the UI *must* only do that in a response to on_write callback
-        // since during the execution of that callback the UI holds this mutex.
-        std::lock_guard<std::mutex> lock(state_->file_io_mutex);
-
-        // write out changes to the disk
-        idb.flush();
-
-        for (auto* db : updates_)
-            db->flush();
     }
 
-    virtual std::string describe() const override
-    { return "Update Db"; }
-
-    virtual std::size_t size() const override
-    { return bytes_; }
 private:
     friend class Update;
     std::shared_ptr<state> state_;
     std::vector<article_t> articles_;
-    std::set<catalog_t*> updates_;
+    std::vector<bool> complete_;
+    std::vector<std::uint32_t> volumes_;
 private:
     std::uint64_t first_ = 0;
     std::uint64_t last_  = 0;
@@ -368,6 +533,55 @@ private:
     std::size_t bytes_ = 0;
 };
 
+// write the articles queued for a catalog volume. the volumes are
+// independent of each other and can be written concurrently. the action
+// keeps writing until there's no more articles queued for the volume.
+class Update::store_volume : public action
+{
+public:
+    store_volume(std::shared_ptr<state> s, std::uint32_t index) : state_(s), index_(index)
+    {}
+
+    virtual void xperform() override
+    {
+        if (!state_->begin_operation())
+            return;
+
+        auto& vol = state_->get_volume(index_);
+        try
+        {
+            while (state_->write_volume(index_, vol))
+            {
+                std::lock_guard<std::mutex> vol_lock(vol.mutex);
+                std::lock_guard<std::mutex> io_lock(state_->file_io_mutex);
+                snapshot_ = vol.db->snapshot();
+                file_     = vol.db->device().filename();
+            }
+        }
+        catch (const std::exception&)
+        {
+            // let the next store action schedule the volume again.
+            {
+                std::lock_guard<std::mutex> lock(state_->volume_mutex);
+                vol.scheduled = false;
+            }
+            state_->end_operation();
+            throw;
+        }
+        state_->end_operation();
+    }
+
+    virtual std::string describe() const override
+    { return "Update Db Volume"; }
+
+private:
+    friend class Update;
+    std::shared_ptr<state> state_;
+    std::uint32_t index_ = 0;
+    std::unique_ptr<Snapshot> snapshot_;
+    std::string file_;
+};
+
 Update::Update(const std::string& path, const std::string& group)
 {
     const auto nfo = fs::joinpath(fs::joinpath(path, group), group + ".nfo");
@@ -387,7 +601,7 @@ Update::Update(const std::string& path, const std::string& group)
         const auto total_size   = big.size();
         const auto header_size  = sizeof(FileHeader);
         const auto payload_size = total_size - header_size;
-        const auto num_hashes   = payload_size / sizeof(FileHash);
+        const auto num_hashes   = payload_size / sizeof(FileHash); // version 1
 
         // previously there was no versioning of the meta database file
         // but if there was a need to change the structure the catalog
@@ -400,20 +614,25 @@ Update::Update(const std::string& path, const std::string& group)
         // version when opening the group and has (thus) failed.
         FileHeader header;
         big.read((char*)&header, sizeof(header));
-        if (header.version != CurrentVersion)
+        if (header.version != CurrentVersion && header.version != 1)
             throw std::runtime_error("unsupported file version");
 
-        assert((payload_size % sizeof(FileHash)) == 0);
-
         local_first_ = header.local_first;
         local_last_  = header.local_last;
         state_->landmark_article_number = header.landmark_article_number;
         state_->positive_offset = header.positive_offset;
         state_->negative_offset = header.negative_offset;
 
-        if (num_hashes)
+        if (header.version == CurrentVersion)
+        {
+            state_->hashmap.Load(big);
+        }
+        else if (num_hashes)
         {
-            // read back the hashes
+            assert((payload_size % sizeof(FileHash)) == 0);
+
+            // read back the hashes. these don't have the subject
+            // fingerprints so the first match needs to go to the catalog.
             std::vector<FileHash> vec;
             vec.resize(num_hashes);
             big.read((char*)&vec[0], num_hashes * sizeof(FileHash));
@@ -421,7 +640,7 @@ Update::Update(const std::string& path, const std::string& group)
             {
                 const auto key = vec[i].article_hash;
                 const auto val = vec[i].article_number_internal;
-                state_->hashmap.insert(std::make_pair(key, val));
+                state_->hashmap.Insert(key, 0, val);
             }
         }
         xover_last_  = local_last_;
@@ -462,7 +681,7 @@ Update::~Update()
     {}
 }
 
-std::shared_ptr<CmdList> Update::CreateCommands()
+std::shared_ptr<CmdList> Update::CreateCommands(const PipelineDepth& depth)
 {
     std::shared_ptr<CmdList> ret;
 
@@ -481,10 +700,12 @@ std::shared_ptr<CmdList> Update::CreateCommands()
         // commands to retrieve the newer messages starting at the current
         // newest message on the local machine and progressing towards the newest
         // on the remote host.
-        for (int i=0; i<10; ++i)
+        const std::uint64_t span = depth.overview_range;
+
+        for (std::size_t i=0; i<depth.num_overviews; ++i)
         {
             const auto first = xover_last_ + 1;
-            const auto last  = std::min(first + 999, remote_last_);
+            const auto last  = std::min(first + (span - 1), remote_last_);
             xover_last_ = last;
             std::string range;
             std::stringstream ss;
@@ -505,10 +726,12 @@ std::shared_ptr<CmdList> Update::CreateCommands()
         // commands to retrieve the older messges starting at the current oldest
         // message on the local machine and progressing towards the oldest on the
         // remote server.
-        for (int i=0; i<10; ++i)
+        const std::uint64_t span = depth.overview_range;
+
+        for (std::size_t i=0; i<depth.num_overviews; ++i)
         {
             const auto last  = xover_first_ - 1;
-            const auto first = last - remote_first_ >= 999 ?  last - 999 : remote_first_;
+            const auto first = last - remote_first_ >= span - 1 ?  last - (span - 1) : remote_first_;
             xover_first_ = first;
             std::string range;
             std::stringstream ss;
@@ -539,8 +762,12 @@ void Update::Commit()
 
     // there might be pending operations to write more data to the
     // data files, but we're just going to turn them into non-ops
-    std::lock_guard<std::mutex> lock(state_->cancel_operation_mutex);
+    // and wait for the ones currently running to finish.
+    std::unique_lock<std::mutex> lock(state_->cancel_operation_mutex);
     state_->cancel_operation = true;
+    state_->cancel_operation_done.wait(lock, [this] {
+        return state_->num_operations == 0;
+    });
 
     const auto& path  = state_->folder;
     const auto& group = state_->group;
@@ -549,6 +776,21 @@ void Update::Commit()
     if (local_first_ == 0 || local_last_ == 0)
         return;
 
+    // the articles that have been assigned a number but not
+    // yet written need to be written now since the hash index
+    // refers to them already.
+    std::vector<std::pair<std::uint32_t, state::Volume*>> volumes;
+    {
+        std::lock_guard<std::mutex> lock(state_->volume_mutex);
+        for (auto& p : state_->files)
+            volumes.push_back(std::make_pair(p.first, p.second.get()));
+    }
+    for (auto& p : volumes)
+    {
+        while (state_->write_volume(p.first, *p.second))
+            ;
+    }
+
     bigfile big;
     big.open(file, bigfile::o_truncate | bigfile::o_create);
 
@@ -562,27 +804,14 @@ void Update::Commit()
 
     big.write((const char*)&header, sizeof(header));
 
-    auto& files = state_->files;
-    for (auto& p : files)
+    for (auto& p : volumes)
     {
-        auto& db = p.second;
-        db->flush();
+        auto& db = p.second->db;
+        if (db)
+            db->flush();
     }
 
-    std::vector<FileHash> vec;
-    const auto& hashmap = state_->hashmap;
-    vec.resize(hashmap.size());
-    size_t i=0;
-    for (const auto& pair : hashmap)
-    {
-        vec[i].article_hash = pair.first;
-        vec[i].article_number_internal = pair.second;
-        ++i;
-    }
-    if (!vec.empty())
-    {
-        big.write((const char*)&vec[0], vec.size() * sizeof(FileHash));
-    }
+    state_->hashmap.Save(big);
     big.close();
 
     commit_done_ = true;
@@ -630,6 +859,7 @@ void Update::Complete(action& a, std::vector<std::unique_ptr<action>>& next)
     {
         std::unique_ptr<store> s(new store(state_));
         s->articles_ = std::move(p->articles_);
+        s->complete_ = std::move(p->complete_);
         s->bytes_ = p->size();
         s->set_affinity(action::affinity::single_thread);
         next.push_back(std::move(s));
@@ -641,7 +871,16 @@ void Update::Complete(action& a, std::vector<std::unique_ptr<action>>& next)
         local_first_ = std::min(local_first_, first);
         local_last_  = std::max(local_last_, last);
 
-        if (state_->callback)
+        for (const auto index : p->volumes_)
+        {
+            std::unique_ptr<store_volume> s(new store_volume(state_, index));
+            s->set_affinity(action::affinity::any_thread);
+            next.push_back(std::move(s));
+        }
+    }
+    if (auto* p = dynamic_cast<store_volume*>(&a))
+    {
+        if (state_->callback && p->snapshot_)
         {
             HeaderTask::Progress progress;
             progress.group = state_->group;
@@ -652,12 +891,8 @@ void Update::Complete(action& a, std::vector<std::unique_ptr<action>>& next)
             progress.remote_last  = remote_last_;
             progress.num_local_articles  = local_last_ - local_first_ + 1;
             progress.num_remote_articles = remote_last_ - remote_first_ + 1;
-            for (auto* catalog : p->updates_)
-            {
-                std::unique_ptr<Snapshot> snapshot = catalog->snapshot();
-                progress.catalogs.push_back(catalog->device().filename());
-                progress.snapshots.push_back(std::move(snapshot));
-            }
+            progress.catalogs.push_back(p->file_);
+            progress.snapshots.push_back(std::move(p->snapshot_));
             state_->callback(progress);
         }
     }
@@ -46,7 +46,8 @@ namespace newsflash
             std::vector<std::unique_ptr<Snapshot>> snapshots;
             std::vector<std::string> catalogs;
         };
-        using OnProgress = std::function<void (const Progress&)>;
+        // the callback is free to take ownership of the snapshots.
+        using OnProgress = std::function<void (Progress&)>;
 
         virtual void SetProgressCallback(const OnProgress& callback) = 0;
     private:
@@ -59,7 +60,7 @@ namespace newsflash
        ~Update();
 
         // Task implementation
-        virtual std::shared_ptr<CmdList> CreateCommands() override;
+        virtual std::shared_ptr<CmdList> CreateCommands(const PipelineDepth& depth = PipelineDepth()) override;
         virtual void Cancel() override;
         virtual void Commit() override;
         virtual void Complete(CmdList& cmd,
@@ -96,6 +97,7 @@ namespace newsflash
     private:
         class parse;
         class store;
+        class store_volume;
         struct state;
 
     private:
@@ -77,6 +77,13 @@ namespace newsflash
             return CanRead();
         }
 
+        // get the underlying OS handle. on linux this is the
+        // file descriptor of the socket or the event.
+        native_handle_t GetNativeHandle() const
+        {
+            return handle_;
+        }
+
 
         // WaitForMultipleHandles indefinitely for the listed handles.
         // returns when any handle becomes signaled.
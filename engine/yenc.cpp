@@ -0,0 +1,534 @@
+// Copyright (c) 2010-2015 Sami Väisänen, Ensisoft
+//
+// http://www.ensisoft.com
+//
+// This software is copyrighted software. Unauthorized hacking, cracking, distribution
+// and general assing around is prohibited.
+// Redistribution and use in source and binary forms, with or without modification,
+// without permission are prohibited.
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "newsflash/config.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#  define YENC_X86
+#  include <emmintrin.h> // SSE2
+#  include <tmmintrin.h> // SSSE3
+#  include <immintrin.h> // AVX2
+#endif
+
+#if defined(YENC_X86) && (defined(__GCC__) || defined(__CLANG__))
+#  define YENC_TARGET(x) __attribute__((target(x)))
+#else
+#  define YENC_TARGET(x)
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "crc32.h"
+#include "platform.h"
+#include "yenc.h"
+
+// The vectorized kernels work on blocks of 16 (or 32) bytes at a time.
+// For each block we compute bit masks for the characters that need special
+// treatment (CR, LF, '=' escape and the second dot of a leading double dot).
+// If the block has none of those the whole block is decoded with a single
+// subtraction. Otherwise the escaped characters are adjusted and the unwanted
+// characters are removed from the block. Anything tricky such as an escape
+// that spans a block boundary, "==" or the =yend line is handed over to the
+// scalar loop which has exactly the same semantics as yenc::decode with
+// nntp::bodyiter.
+
+namespace {
+
+// this mirrors nntp::bodyiter::double_dot
+inline
+bool double_dot(const char* data, std::size_t pos)
+{
+    if (pos > 3)
+        return data[pos] == '.' && data[pos-1] == '.' && data[pos-2] == '\n' && data[pos-3] == '\r';
+    else if (pos == 1)
+        return data[pos] == '.' && data[pos-1] == '.';
+    return false;
+}
+
+// this mirrors nntp::bodyiter::forward
+inline
+std::size_t forward(const char* data, std::size_t pos, std::size_t len)
+{
+    ++pos;
+    if (pos < len && double_dot(data, pos))
+        ++pos;
+    return pos;
+}
+
+// decode until pos reaches stop. returns false when the decoding is complete,
+// i.e. either the end of data was reached or the =yend line was found.
+inline
+bool decode_scalar(const char* data, std::size_t& pos, std::size_t stop, std::size_t len, unsigned char*& out)
+{
+    while (pos < stop)
+    {
+        unsigned char c = data[pos];
+        if (c == '\r' || c == '\n')
+        {
+            pos = forward(data, pos, len);
+            continue;
+        }
+        else if (c == '=')
+        {
+            const auto tmp = pos;
+            pos = forward(data, pos, len);
+            if (pos == len)
+            {
+                *out++ = c - 42;
+                return false;
+            }
+            else if (data[pos] == 'y')
+            {
+                pos = tmp;
+                return false;
+            }
+            c  = data[pos];
+            c -= 64;
+        }
+        *out++ = c - 42;
+        pos = forward(data, pos, len);
+    }
+    return pos < len;
+}
+
+// The kernels decode from data[pos] until pos reaches stop (or a little past it)
+// and return false when the decoding is complete. len is the total length of
+// the data so that the kernels can look ahead past the stop position.
+using Kernel = bool (*)(const char* data, std::size_t& pos, std::size_t stop, std::size_t len, unsigned char*& out);
+
+bool decode_kernel_scalar(const char* data, std::size_t& pos, std::size_t stop, std::size_t len, unsigned char*& out)
+{
+    return decode_scalar(data, pos, stop, len, out);
+}
+
+#if defined(YENC_X86)
+
+// shuffle masks for compacting 8 bytes according to a mask
+// of bytes that need to be removed.
+struct ShuffleTable {
+    unsigned char shuffle[256][16];
+    unsigned char count[256];
+
+    ShuffleTable()
+    {
+        std::memset(shuffle, 0x80, sizeof(shuffle));
+        for (unsigned mask=0; mask<256; ++mask)
+        {
+            unsigned char kept = 0;
+            for (unsigned char i=0; i<8; ++i)
+            {
+                if (mask & (1 << i))
+                    continue;
+                shuffle[mask][kept++] = i;
+            }
+            count[mask] = kept;
+        }
+    }
+};
+
+const ShuffleTable& GetShuffleTable()
+{
+    static const ShuffleTable table;
+    return table;
+}
+
+// finish a block by moving to the next position the same way
+// as the scalar loop would, i.e. possibly skipping a dot.
+inline
+std::size_t block_done(const char* data, std::size_t pos)
+{
+    return double_dot(data, pos) ? pos + 1 : pos;
+}
+
+// compute the special character masks for the 16 byte block starting at data[pos].
+// returns false if the block needs to be processed by the scalar loop.
+// Requires that pos >= 4 and pos + 17 <= len
+YENC_TARGET("sse2")
+inline bool compute_masks(const char* data, std::size_t pos, __m128i v, unsigned& remove, unsigned& escaped)
+{
+    const auto* ptr = data + pos;
+    const __m128i eq = _mm_cmpeq_epi8(v, _mm_set1_epi8('='));
+    const __m128i cr = _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'));
+    const __m128i lf = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+    const __m128i dt = _mm_cmpeq_epi8(v, _mm_set1_epi8('.'));
+
+    const unsigned eqm = _mm_movemask_epi8(eq);
+    const unsigned crlf = _mm_movemask_epi8(_mm_or_si128(cr, lf));
+    unsigned dots = _mm_movemask_epi8(dt);
+
+    // escape at the end of the block spills over to the next block
+    // and "==" is something that the mask logic can't express.
+    if (eqm & 0x8000)
+        return false;
+    if (eqm & (eqm << 1))
+        return false;
+
+    if (eqm)
+    {
+        // =yend terminates the decoding.
+        const __m128i n1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + 1));
+        const unsigned ym = _mm_movemask_epi8(_mm_cmpeq_epi8(n1, _mm_set1_epi8('y')));
+        if (eqm & ym)
+            return false;
+    }
+    if (dots)
+    {
+        // second dot of "\r\n.." gets removed.
+        const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr - 1));
+        const __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr - 2));
+        const __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr - 3));
+        dots &= _mm_movemask_epi8(_mm_cmpeq_epi8(p1, _mm_set1_epi8('.')));
+        dots &= _mm_movemask_epi8(_mm_cmpeq_epi8(p2, _mm_set1_epi8('\n')));
+        dots &= _mm_movemask_epi8(_mm_cmpeq_epi8(p3, _mm_set1_epi8('\r')));
+        // the first character in the block has already been checked when
+        // the previous block was finished (see block_done) or it's where
+        // the decoding started and the iterator doesn't collapse that one.
+        dots &= ~1u;
+    }
+    escaped = (eqm << 1) & 0xffff;
+    remove  = (eqm | crlf | dots) & ~escaped;
+    return true;
+}
+
+// decode the escaped characters. the characters that will get removed are
+// left as garbage.
+YENC_TARGET("sse2")
+inline __m128i decode_block(__m128i v, unsigned escaped)
+{
+    __m128i ret = _mm_sub_epi8(v, _mm_set1_epi8(42));
+    if (escaped)
+    {
+        const __m128i eq  = _mm_cmpeq_epi8(v, _mm_set1_epi8('='));
+        const __m128i esc = _mm_and_si128(_mm_slli_si128(eq, 1), _mm_set1_epi8(64));
+        ret = _mm_sub_epi8(ret, esc);
+    }
+    return ret;
+}
+
+YENC_TARGET("sse2")
+inline bool block_sse2(const char* data, std::size_t& pos, unsigned char*& out)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+    unsigned remove  = 0;
+    unsigned escaped = 0;
+    if (!compute_masks(data, pos, v, remove, escaped))
+        return false;
+
+    const __m128i dec = decode_block(v, escaped);
+    if (remove == 0)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), dec);
+        out += 16;
+    }
+    else
+    {
+        unsigned char tmp[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(tmp), dec);
+        for (unsigned i=0; i<16; ++i)
+        {
+            if (remove & (1 << i))
+                continue;
+            *out++ = tmp[i];
+        }
+    }
+    pos = block_done(data, pos + 16);
+    return true;
+}
+
+YENC_TARGET("ssse3")
+inline bool block_ssse3(const char* data, std::size_t& pos, unsigned char*& out, const ShuffleTable& table)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+    unsigned remove  = 0;
+    unsigned escaped = 0;
+    if (!compute_masks(data, pos, v, remove, escaped))
+        return false;
+
+    const __m128i dec = decode_block(v, escaped);
+    if (remove == 0)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), dec);
+        out += 16;
+    }
+    else
+    {
+        const unsigned lo = remove & 0xff;
+        const unsigned hi = remove >> 8;
+        const __m128i shuffle_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.shuffle[lo]));
+        const __m128i shuffle_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.shuffle[hi]));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(dec, shuffle_lo));
+        out += table.count[lo];
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(_mm_srli_si128(dec, 8), shuffle_hi));
+        out += table.count[hi];
+    }
+    pos = block_done(data, pos + 16);
+    return true;
+}
+
+YENC_TARGET("sse2")
+bool decode_kernel_sse2(const char* data, std::size_t& pos, std::size_t stop, std::size_t len, unsigned char*& out)
+{
+    bool more = true;
+    while (more && pos < stop && pos + 17 <= len)
+    {
+        if (pos >= 4 && block_sse2(data, pos, out))
+            continue;
+        more = decode_scalar(data, pos, pos + 16, len, out);
+    }
+    if (more && pos < stop)
+        more = decode_scalar(data, pos, stop, len, out);
+    return more && pos < len;
+}
+
+YENC_TARGET("ssse3")
+inline bool decode_loop_ssse3(const char* data, std::size_t& pos, std::size_t stop, std::size_t len,
+    unsigned char*& dst, const ShuffleTable& table)
+{
+    bool more = true;
+    while (more && pos < stop && pos + 17 <= len)
+    {
+        if (pos >= 4 && block_ssse3(data, pos, dst, table))
+            continue;
+        more = decode_scalar(data, pos, pos + 16, len, dst);
+    }
+    return more;
+}
+
+YENC_TARGET("ssse3")
+bool decode_kernel_ssse3(const char* data, std::size_t& pos, std::size_t stop, std::size_t len, unsigned char*& out)
+{
+    const auto& table = GetShuffleTable();
+    bool more = decode_loop_ssse3(data, pos, stop, len, out, table);
+    if (more && pos < stop)
+        more = decode_scalar(data, pos, stop, len, out);
+    return more && pos < len;
+}
+
+// same as block_ssse3 but for 32 bytes at a time. the masks are computed
+// over the whole block and the compaction is done 8 bytes at a time.
+// Requires that pos >= 4 and pos + 33 <= len
+YENC_TARGET("avx2")
+inline bool block_avx2(const char* data, std::size_t& pos, unsigned char*& out, const ShuffleTable& table)
+{
+    const auto* ptr = data + pos;
+    const __m256i v  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+    const __m256i eq = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('='));
+    const __m256i cr = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'));
+    const __m256i lf = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+    const __m256i dt = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'));
+
+    const std::uint32_t eqm  = _mm256_movemask_epi8(eq);
+    const std::uint32_t crlf = _mm256_movemask_epi8(_mm256_or_si256(cr, lf));
+    std::uint32_t dots = _mm256_movemask_epi8(dt);
+
+    __m256i dec = _mm256_sub_epi8(v, _mm256_set1_epi8(42));
+
+    // fast path for the typical case of plain data only.
+    if ((eqm | crlf | dots) == 0)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), dec);
+        out += 32;
+        pos += 32;
+        return true;
+    }
+
+    // see compute_masks
+    if (eqm & 0x80000000u)
+        return false;
+    if (eqm & (eqm << 1))
+        return false;
+
+    std::uint32_t escaped = 0;
+    if (eqm)
+    {
+        const __m256i n1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + 1));
+        const std::uint32_t ym = _mm256_movemask_epi8(_mm256_cmpeq_epi8(n1, _mm256_set1_epi8('y')));
+        if (eqm & ym)
+            return false;
+
+        // the lane shift can't cross the 128 bit lanes so instead
+        // look at the previous byte. the first byte of the block can't
+        // be escaped since that would have been handled already.
+        const __m256i p1  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr - 1));
+        const __m256i esc = _mm256_and_si256(_mm256_cmpeq_epi8(p1, _mm256_set1_epi8('=')),
+            _mm256_setr_epi8(0, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+                            64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64));
+        dec = _mm256_sub_epi8(dec, esc);
+        escaped = eqm << 1;
+    }
+    if (dots)
+    {
+        const __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr - 1));
+        const __m256i p2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr - 2));
+        const __m256i p3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr - 3));
+        dots &= _mm256_movemask_epi8(_mm256_cmpeq_epi8(p1, _mm256_set1_epi8('.')));
+        dots &= _mm256_movemask_epi8(_mm256_cmpeq_epi8(p2, _mm256_set1_epi8('\n')));
+        dots &= _mm256_movemask_epi8(_mm256_cmpeq_epi8(p3, _mm256_set1_epi8('\r')));
+        dots &= ~1u;
+    }
+    const std::uint32_t remove = (eqm | crlf | dots) & ~escaped;
+    if (remove == 0)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), dec);
+        out += 32;
+    }
+    else
+    {
+        const __m128i halves[2] = {
+            _mm256_castsi256_si128(dec),
+            _mm256_extracti128_si256(dec, 1)
+        };
+        for (unsigned i=0; i<2; ++i)
+        {
+            const unsigned lo = (remove >> (i * 16)) & 0xff;
+            const unsigned hi = (remove >> (i * 16 + 8)) & 0xff;
+            const __m128i shuffle_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.shuffle[lo]));
+            const __m128i shuffle_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.shuffle[hi]));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(halves[i], shuffle_lo));
+            out += table.count[lo];
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(_mm_srli_si128(halves[i], 8), shuffle_hi));
+            out += table.count[hi];
+        }
+    }
+    pos = block_done(data, pos + 32);
+    return true;
+}
+
+YENC_TARGET("avx2")
+bool decode_kernel_avx2(const char* data, std::size_t& pos, std::size_t stop, std::size_t len, unsigned char*& out)
+{
+    const auto& table = GetShuffleTable();
+    bool more = true;
+    while (more && pos < stop && pos + 33 <= len)
+    {
+        if (pos >= 4 && block_avx2(data, pos, out, table))
+            continue;
+        more = decode_loop_ssse3(data, pos, pos + 32, len, out, table);
+    }
+    if (more && pos < stop)
+        more = decode_loop_ssse3(data, pos, stop, len, out, table);
+    if (more && pos < stop)
+        more = decode_scalar(data, pos, stop, len, out);
+    return more && pos < len;
+}
+
+#endif // YENC_X86
+
+Kernel select_kernel(yenc::kernel k)
+{
+#if defined(YENC_X86)
+    // never use a kernel that the CPU doesn't support.
+    if (k > yenc::best_kernel())
+        k = yenc::best_kernel();
+
+    switch (k)
+    {
+        case yenc::kernel::avx2:
+            return &decode_kernel_avx2;
+        case yenc::kernel::ssse3:
+            return &decode_kernel_ssse3;
+        case yenc::kernel::sse2:
+            return &decode_kernel_sse2;
+        case yenc::kernel::scalar:
+            break;
+    }
+#endif
+    return &decode_kernel_scalar;
+}
+
+} // namespace
+
+namespace yenc
+{
+
+kernel detect_kernel()
+{
+#if defined(YENC_X86)
+    const auto& cpu = newsflash::get_cpu_features();
+    if (cpu.avx2)
+        return kernel::avx2;
+    if (cpu.ssse3)
+        return kernel::ssse3;
+    if (cpu.sse2)
+        return kernel::sse2;
+#endif
+    return kernel::scalar;
+}
+
+kernel best_kernel()
+{
+    static const kernel best = detect_kernel();
+    return best;
+}
+
+const char* kernel_name(kernel k)
+{
+    switch (k)
+    {
+        case kernel::scalar: return "scalar";
+        case kernel::sse2:   return "SSE2";
+        case kernel::ssse3:  return "SSSE3";
+        case kernel::avx2:   return "AVX2";
+    }
+    return "???";
+}
+
+std::size_t decode_buffer(const char* data, std::size_t pos, std::size_t len, char* out, std::size_t& written, kernel k)
+{
+    auto* dst = reinterpret_cast<unsigned char*>(out);
+    const auto decode = select_kernel(k);
+    decode(data, pos, len, len, dst);
+    written = dst - reinterpret_cast<unsigned char*>(out);
+    return pos;
+}
+
+std::size_t decode_buffer(const char* data, std::size_t pos, std::size_t len, char* out, std::size_t& written)
+{
+    return decode_buffer(data, pos, len, out, written, best_kernel());
+}
+
+std::size_t decode_buffer_crc(const char* data, std::size_t pos, std::size_t len, char* out, std::size_t& written, std::uint32_t& crc, kernel k)
+{
+    // decode a small window of input at a time and compute the
+    // crc over the decoded output while it's still in the L1 cache
+    // instead of doing a second pass over the whole output.
+    const std::size_t window = 1024 * 16;
+
+    auto* dst = reinterpret_cast<unsigned char*>(out);
+    const auto decode = select_kernel(k);
+    bool more = true;
+    while (more)
+    {
+        const auto* begin = dst;
+        more = decode(data, pos, std::min(pos + window, len), len, dst);
+        crc  = newsflash::crc32(crc, begin, dst - begin);
+    }
+    written = dst - reinterpret_cast<unsigned char*>(out);
+    return pos;
+}
+
+std::size_t decode_buffer_crc(const char* data, std::size_t pos, std::size_t len, char* out, std::size_t& written, std::uint32_t& crc)
+{
+    return decode_buffer_crc(data, pos, len, out, written, crc, best_kernel());
+}
+
+} // yenc
@@ -27,6 +27,7 @@
 #include <newsflash/warnpop.h>
 #include <string>
 #include <iterator>
+#include <cstdint>
 
 // yEnc decoder/encoder implementation.
 // http://www.yenc.org/
@@ -124,6 +125,7 @@ namespace yenc
            str_p("=yend") >>
            (str_p("size=") >> uint_p[assign(footer.size)]) >>
            !(str_p("part=") >> uint_p[assign(footer.part)]) >>
+           !(str_p("total=") >> uint_p) >> // some posters repeat the total from the header
            !(str_p("pcrc32=") >> hex_p[assign(footer.pcrc32)]) >>
            !(str_p("crc32=") >> hex_p[assign(footer.crc32)]) >> 
            !eol_p
@@ -170,6 +172,42 @@ namespace yenc
         return true;
     }
 
+    // The decoding kernels available for decode_buffer. The kernels are
+    // listed in the order of preference and the best one supported by
+    // the CPU is picked at runtime.
+    enum class kernel {
+        scalar, sse2, ssse3, avx2
+    };
+
+    // detect the best decoding kernel supported by the current CPU.
+    kernel detect_kernel();
+
+    // get the (cached) result of detect_kernel.
+    kernel best_kernel();
+
+    // get a human readable name for the kernel.
+    const char* kernel_name(kernel k);
+
+    // Decode yEnc encoded NNTP body data from a contiguous buffer.
+    // This does exactly the same as decode() with nntp::bodyiter, i.e. skips CR/LF,
+    // handles escapes and collapses leading double dots in a single pass, but works
+    // on blocks of data with SIMD instructions when the CPU supports them.
+    // Decoding starts at data[pos] and stops at the end of the data or at the
+    // start of the =yend line. The output buffer must have room for at least
+    // len - pos bytes. Returns the position where the decoding stopped and
+    // stores the number of decoded bytes in written.
+    std::size_t decode_buffer(const char* data, std::size_t pos, std::size_t len, char* out, std::size_t& written);
+
+    // Same as above but use a specific kernel. If the CPU doesn't support
+    // the requested kernel the best supported kernel is used instead.
+    std::size_t decode_buffer(const char* data, std::size_t pos, std::size_t len, char* out, std::size_t& written, kernel k);
+
+    // Same as decode_buffer but also update the running CRC32 (see crc32.h)
+    // of the decoded data while decoding so that the output doesn't need
+    // to be read again for computing the checksum.
+    std::size_t decode_buffer_crc(const char* data, std::size_t pos, std::size_t len, char* out, std::size_t& written, std::uint32_t& crc);
+    std::size_t decode_buffer_crc(const char* data, std::size_t pos, std::size_t len, char* out, std::size_t& written, std::uint32_t& crc, kernel k);
+
     // Encode data into yEnc. Line should be the preferred
     // line length after wich a new line (\r\n) is written into the output stream.
     template<typename InputIterator, typename OutputIterator>
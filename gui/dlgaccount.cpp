@@ -49,6 +49,7 @@ DlgAccount::DlgAccount(QWidget* parent, app::Accounts::Account& acc, bool isNew)
     ui_.edtPassword->setText(acc_.password);
     ui_.chkCompression->setChecked(acc_.enableCompression);
     ui_.chkPipelining->setChecked(acc_.enablePipelining);
+    ui_.chkEventLoop->setChecked(acc_.enableEventLoop);
     ui_.grpSecure->setChecked(acc_.enableSecureServer);
     ui_.grpGeneral->setChecked(acc_.enableGeneralServer);
     ui_.grpLogin->setChecked(acc_.enableLogin);
@@ -101,6 +102,7 @@ void DlgAccount::on_btnTest_clicked()
     acc.maxConnections      = ui_.maxConnections->value();
     acc.enableCompression   = ui_.chkCompression->isChecked();
     acc.enablePipelining    = ui_.chkPipelining->isChecked();
+    acc.enableEventLoop     = ui_.chkEventLoop->isChecked();
     acc.datapath            = ui_.edtDataPath->text();
 
     if (acc.enableSecureServer)
@@ -166,6 +168,7 @@ void DlgAccount::on_btnAccept_clicked()
     acc_.maxConnections      = ui_.maxConnections->value();
     acc_.enableCompression   = ui_.chkCompression->isChecked();
     acc_.enablePipelining    = ui_.chkPipelining->isChecked();
+    acc_.enableEventLoop     = ui_.chkEventLoop->isChecked();
     acc_.datapath            = ui_.edtDataPath->text();
 
     if (acc_.name.isEmpty())